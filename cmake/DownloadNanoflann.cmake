@@ -1,15 +1,25 @@
-set(NANOFLANN_DIR ${PROJECT_SOURCE_DIR}/ext/nanoflann)
-ExternalProject_Add(nanoflann
-                    PREFIX ${NANOFLANN_DIR}
-                    GIT_REPOSITORY "https://github.com/jlblancoc/nanoflann.git"
-                    GIT_TAG master
-                    SOURCE_DIR ""
-                    # Disable configure, build and install steps
-                    CONFIGURE_COMMAND ""
-                    UPDATE_COMMAND ""
-                    BUILD_COMMAND ""
-                    INSTALL_COMMAND "")
-
-set(nanoflann_INCLUDE_DIR "ext/nanoflann/src/nanoflann/include")
-set(nanoflann_INCLUDE_DIRS "ext/nanoflann/src/nanoflann/include")
-# include_directories(ext/nanoflann/include)
\ No newline at end of file
+# nanoflann is header-only. Fetch a pinned release at configure time and
+# provide the same target a find_package(nanoflann) would
+include(FetchContent)
+
+set(RMCL_NANOFLANN_TAG "v1.5.5")
+
+FetchContent_Declare(nanoflann
+    GIT_REPOSITORY "https://github.com/jlblancoc/nanoflann.git"
+    GIT_TAG ${RMCL_NANOFLANN_TAG}
+    GIT_SHALLOW TRUE)
+
+FetchContent_GetProperties(nanoflann)
+if(NOT nanoflann_POPULATED)
+    FetchContent_Populate(nanoflann)
+endif()
+
+set(nanoflann_INCLUDE_DIR "${nanoflann_SOURCE_DIR}/include")
+set(nanoflann_INCLUDE_DIRS "${nanoflann_SOURCE_DIR}/include")
+string(REGEX REPLACE "^v" "" nanoflann_VERSION ${RMCL_NANOFLANN_TAG})
+
+if(NOT TARGET nanoflann::nanoflann)
+    add_library(nanoflann::nanoflann INTERFACE IMPORTED)
+    set_target_properties(nanoflann::nanoflann PROPERTIES
+        INTERFACE_INCLUDE_DIRECTORIES "${nanoflann_INCLUDE_DIR}")
+endif()
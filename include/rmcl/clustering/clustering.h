@@ -43,19 +43,95 @@
 
 #include <vector>
 #include <algorithm>
+#include <rmagine/types/Memory.hpp>
+#include <rmagine/math/types.h>
 #include <rmcl/spatial/KdTree.hpp>
 
 namespace rmcl
 {
 
+/**
+ * @brief Radius neighborhoods of all points of a KdTree in CSR layout.
+ * The neighbors of point i are neighbors[offsets[i]] ... 
+ * neighbors[offsets[i+1]-1], the point itself included
+ */
+struct NeighborGraph
+{
+    std::vector<size_t> offsets;
+    std::vector<KdIndex> neighbors;
+
+    inline size_t size() const
+    {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    inline size_t degree(size_t i) const
+    {
+        return offsets[i+1] - offsets[i];
+    }
+};
+
+/**
+ * @brief Computes the radius neighborhoods of all points in parallel
+ */
+NeighborGraph radius_graph(
+    KdTreePtr index,
+    float search_dist);
+
 void sort_clusters(std::vector<std::vector<size_t> >& clusters);
 
+/**
+ * @brief DBSCAN on a precomputed neighbor graph. The same graph can be
+ * clustered repeatedly with different thresholds.
+ * 
+ * Core points are merged with a lock-free union-find in parallel. A
+ * border point joins the cluster of one of its core neighbors.
+ */
+std::vector<std::vector<size_t> > dbscan(
+    const NeighborGraph& graph,
+    unsigned int min_pts_in_radius,
+    unsigned int min_pts_per_cluster);
+
 std::vector<std::vector<size_t> > dbscan(
     KdTreePtr index, 
     float search_dist, 
     unsigned int min_pts_in_radius,
     unsigned int min_pts_per_cluster);
 
+/**
+ * @brief Grid based clustering in O(N) without a kd-tree. 
+ * 
+ * Points are hashed into voxels of size search_dist. Voxels with at
+ * least min_pts_in_voxel points are core voxels and connected to their
+ * 26 occupied core neighbors with a parallel union-find. Points of 
+ * sparse voxels join an adjacent core voxel, otherwise they are noise.
+ * 
+ * Coarser than dbscan: points up to 2 * sqrt(3) * search_dist apart 
+ * can be connected directly.
+ */
+std::vector<std::vector<size_t> > voxel_clustering(
+    const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& points,
+    float search_dist,
+    unsigned int min_pts_in_voxel,
+    unsigned int min_pts_per_cluster);
+
+enum class ClusteringMethod
+{
+    DBSCAN,
+    VOXEL
+};
+
+/**
+ * @brief Clusters points with the chosen method. min_pts is the 
+ * minimum number of points in the radius (DBSCAN) or voxel (VOXEL)
+ */
+std::vector<std::vector<size_t> > cluster_points(
+    const rmagine::Memory<rmagine::Vector, rmagine::RAM>& points,
+    ClusteringMethod method,
+    float search_dist,
+    unsigned int min_pts,
+    unsigned int min_pts_per_cluster);
+
 } // namespace rmcl
 
 #endif // RMCL_CLUSTERING_CLUSTERING_H
\ No newline at end of file
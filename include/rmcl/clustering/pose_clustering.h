@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief DBSCAN over poses
+ * 
+ * Collapses large pose sets (particles, relocalization hypotheses)
+ * into a few weighted modes. Neighborhoods are searched in a kd-tree
+ * over the embedding (x, y, z, r cos(yaw), r sin(yaw)). r is chosen
+ * so that a yaw difference of dist_yaw weighs as much as a translation
+ * of dist_trans. Roll and pitch are not part of the metric, but of the
+ * cluster means.
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_CLUSTERING_POSE_CLUSTERING_H
+#define RMCL_CLUSTERING_POSE_CLUSTERING_H
+
+#include <vector>
+#include <rmagine/math/types.h>
+#include <rmagine/types/Memory.hpp>
+
+namespace rmcl
+{
+
+struct PoseClusteringParams
+{
+    // neighborhood radius in translation (m)
+    float dist_trans = 0.3;
+    // yaw difference that is as far as dist_trans (rad, <= pi)
+    float dist_yaw = 0.3;
+    // minimum number of poses in the neighborhood of a core pose,
+    // the pose itself included
+    unsigned int min_pts = 3;
+    // smaller clusters are dropped
+    unsigned int min_cluster_size = 1;
+};
+
+struct PoseCluster
+{
+    // indices into the input poses
+    std::vector<size_t> ids;
+    // sum of the input weights of the members
+    float weight = 0.0;
+    // weighted mean
+    rmagine::Transform pose;
+    // weighted covariance of the translation
+    rmagine::Matrix3x3 cov_trans;
+    // circular variance of the yaw
+    float var_yaw = 0.0;
+};
+
+/**
+ * @brief Clusters poses with DBSCAN. Radius searches run in parallel
+ * 
+ * @param weights One non-negative weight per pose (e.g. particle 
+ *   weights). Only used for the cluster statistics
+ * 
+ * @return Clusters sorted by weight, heaviest first. Noise poses
+ *   are not part of any cluster
+ */
+std::vector<PoseCluster> dbscan_poses(
+    const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& poses,
+    const rmagine::MemoryView<float, rmagine::RAM>& weights,
+    const PoseClusteringParams& params);
+
+/**
+ * @brief Same as above with uniform weights. Cluster weights are
+ * the member counts
+ */
+std::vector<PoseCluster> dbscan_poses(
+    const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& poses,
+    const PoseClusteringParams& params);
+
+} // namespace rmcl
+
+#endif // RMCL_CLUSTERING_POSE_CLUSTERING_H
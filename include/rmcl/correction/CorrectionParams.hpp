@@ -41,6 +41,7 @@ struct CorrectionParams {
     float max_distance = 0.5;
     unsigned int optimization_method = 0; // 0: umeyama reduction
     unsigned int iterations = 10; // optimization steps per RCC
+    unsigned int ray_mask = 0xFFFFFFFF; // only geometries with a matching mask are hit (embree)
 };
 
 } // namespace rmcl
@@ -133,6 +133,9 @@ struct CorrectionPreResults
     rmagine::Memory<rmagine::Matrix3x3, MemT>   Cs;
     // number of correspondences
     rmagine::Memory<unsigned int, MemT>         Ncorr;
+    // optional: mean point to plane distance of the correspondences. 
+    // Only filled by the Embree correctors if it has one entry per pose
+    rmagine::Memory<float, MemT>                residuals;
 };
 
 template<typename MemT>
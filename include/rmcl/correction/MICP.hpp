@@ -50,6 +50,10 @@
 #include <rmagine/types/sensor_models.h>
 #include <memory>
 #include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 
 // rmcl core
@@ -62,6 +66,8 @@
 
 #ifdef RMCL_EMBREE
 #include <rmagine/map/EmbreeMap.hpp>
+#include <rmcl/map/MapTileStreamerEmbree.hpp>
+#include <rmcl/map/MapUpdaterEmbree.hpp>
 
 #include <rmcl/correction/SphereCorrectorEmbree.hpp>
 #include <rmcl/correction/PinholeCorrectorEmbree.hpp>
@@ -95,13 +101,31 @@
 
 #include <tf2_ros/transform_listener.h>
 #include <tf2_ros/buffer.h>
+#include <tf2_msgs/msg/tf_message.hpp>
 #include <image_transport/image_transport.hpp>
 
 #include "MICPRangeSensor.hpp"
+#include "MICPSensorStack.hpp"
+#include "RelocalizationParams.hpp"
+
+#include <rmcl/place_recognition/PlaceDatabase.hpp>
 
 namespace rmcl
 {
 
+/**
+ * @brief How well the current scans fit the map at a pose (MICP::scorePoses)
+ */
+struct PoseScore
+{
+    // correspondences of all sensors
+    unsigned int Ncorr = 0;
+    // Ncorr / valid ranges of all sensors
+    float match_ratio = 0.0;
+    // mean point to plane distance of the correspondences
+    float residual = 0.0;
+};
+
 /**
  * @brief 
  * 
@@ -109,24 +133,115 @@ namespace rmcl
 class MICP
 {
 public:
-    MICP(rclcpp::Node::SharedPtr node);
+    /**
+     * @param node not owned. Must outlive MICP
+     */
+    MICP(rclcpp::Node* node);
     ~MICP();
 
+    /**
+     * @brief Loads the map and starts loading the sensors in parallel 
+     * threads. Returns before the sensors are ready: each sensor takes 
+     * part in the correction as soon as its model and data arrived
+     */
     void loadParams();
 
+    /**
+     * @brief Blocks until the topics and the model of the sensor are 
+     * found or timed out. Thread-safe
+     */
     bool loadSensor(
         ParamTree<rclcpp::Parameter>::SharedPtr sensor_params);
 
     void loadMap(std::string filename);
+
+    /**
+     * @brief Loads and builds the map in a background thread. Correction 
+     * continues on the current map until the new one is swapped in.
+     * Also triggered by setting the "map_file" parameter at runtime
+     * 
+     * @return false if another map is still loading
+     */
+    bool loadMapAsync(std::string filename);
     
+    /**
+     * @brief Not thread-safe. Only call this between correction steps 
+     * or from the correction thread. Otherwise use queueMap
+     */
     #ifdef RMCL_EMBREE
     void setMap(rmagine::EmbreeMapPtr map);
+    // simplified map for coarse corrections (micp.lod)
+    void setLODMap(rmagine::EmbreeMapPtr map);
     #endif // RMCL_EMBREE
 
     #ifdef RMCL_OPTIX
     void setMap(rmagine::OptixMapPtr map);
+    void setLODMap(rmagine::OptixMapPtr map);
+    #endif // RMCL_OPTIX
+
+    /**
+     * @brief Thread-safe. The maps are set before the next correction step
+     * 
+     * @param map_lod simplified map. nullptr: keep the current one
+     */
+    #ifdef RMCL_EMBREE
+    void queueMap(
+        rmagine::EmbreeMapPtr map, 
+        rmagine::EmbreeMapPtr map_lod = nullptr);
+    #endif // RMCL_EMBREE
+
+    #ifdef RMCL_OPTIX
+    void queueMap(
+        rmagine::OptixMapPtr map, 
+        rmagine::OptixMapPtr map_lod = nullptr);
     #endif // RMCL_OPTIX
 
+    #ifdef RMCL_EMBREE
+    /**
+     * @brief Thread-safe. Incremental updates of single meshes of the 
+     * (full) map, identified by name. Applied before the next correction 
+     * step. Dynamic meshes are refit instead of rebuilt
+     */
+    void setMeshDynamic(const std::string& mesh_name, bool dynamic = true);
+
+    void setMeshTransform(const std::string& mesh_name, const rmagine::Transform& T);
+
+    void setMeshVertices(
+        const std::string& mesh_name, 
+        const rmagine::MemoryView<rmagine::Point, rmagine::RAM>& vertices);
+
+    void setMeshEnabled(const std::string& mesh_name, bool enabled);
+
+    /**
+     * @brief Thread-safe. Rays only hit the meshes of this region (map_regions)
+     * and meshes without region. "" or "all": every mesh
+     * 
+     * @return false if the region is unknown
+     */
+    bool setActiveRegion(const std::string& region);
+    #endif // RMCL_EMBREE
+
+    /**
+     * @brief Thread-safe. Pass the last correction: if it is larger 
+     * than micp.lod.trans_thresh / rot_thresh, the next steps are coarse
+     */
+    void updateLOD(const rmagine::Transform& dT);
+
+    /**
+     * @brief Thread-safe. E.g. coarse after a new pose guess
+     */
+    void setLODCoarse(bool coarse);
+
+    /**
+     * @brief Current robot position in map. Tiled maps stream in the tiles around it
+     */
+    void setMapCenter(const rmagine::Vector& center);
+
+    /**
+     * @brief Thread-safe. File of the map that is currently in use
+     */
+    std::string mapFile();
+
     #ifdef RMCL_CUDA
     void correct(
         const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbm,
@@ -155,8 +270,43 @@ public:
         CorrectionPreResults<rmagine::RAM>& pre_res,
         rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& dT);
 
+    /**
+     * @brief Global relocalization without a pose guess
+     * 
+     * Candidate poses on a grid over the map (x, y, yaw and one height per
+     * floor) are scored by their number of correspondences in batched 
+     * correction calls. The best ones are clustered and the top K refined
+     * with MICP in one batch.
+     * 
+     * With params.place_db the candidates are the most similar places of
+     * the database to the current scans instead of the grid.
+     * 
+     * @param hypotheses refined hypotheses, best first
+     * @return false if no sensor is ready yet or without Embree
+     */
+    bool relocalize(
+        const RelocalizationParams& params,
+        std::vector<RelocalizationHypothesis>& hypotheses);
+
+    /**
+     * @brief Scores a batch of poses against the current sensor data 
+     * without correcting them. One batched computeCovs call per sensor 
+     * on the full map, with the current correspondence parameters. 
+     * CPU (Embree) sensors only. Not thread-safe with correct()
+     * 
+     * @param scores one per pose
+     * @return false if no sensor is ready yet
+     */
+    bool scorePoses(
+        const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
+        std::vector<PoseScore>& scores);
+
+    /**
+     * @brief Thread-safe. All sensors that are loaded, with or without data
+     */
     inline std::unordered_map<std::string, MICPRangeSensorPtr> sensors()
     {
+        std::lock_guard<std::mutex> guard(m_sensors_mutex);
         return m_sensors;
     }
 
@@ -184,13 +334,44 @@ protected:
         rclcpp::Duration timeout);
 
     void initCorrectors();
+
+    // called at the beginning of every correct
+    void preCorrect();
+
+    // the name of a swapped in map becomes mapFile()
+    void publishMapFile();
+
+    // builds the maps of all backends. queue: queueMap instead of setMap
+    void importMap(const std::string& filename, bool queue);
+
+    rmagine::Vector mapCenter();
+
+    rcl_interfaces::msg::SetParametersResult onParameters(
+        const std::vector<rclcpp::Parameter>& params);
+
+    #ifdef RMCL_EMBREE
+    /**
+     * @brief computeCovs of an Embree sensor. Sensors that are part of the 
+     * sensor stack are computed together in the slot of the stacks leader
+     * 
+     * @return weight of the results
+     */
+    float computeCovsEmbree(
+        const MICPRangeSensorPtr& sensor,
+        const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbm,
+        CorrectionPreResults<rmagine::RAM>& res);
+    #endif // RMCL_EMBREE
 private:
     // ROS
-    rclcpp::Node::SharedPtr m_nh;
+    // not owned: the node owns MICP
+    rclcpp::Node*           m_nh;
     rclcpp::Node::SharedPtr m_nh_p;
     TFBufferPtr     m_tf_buffer;
     TFListenerPtr   m_tf_listener;
 
+    rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr m_tf_static_sub;
+    std::shared_ptr<std::atomic<uint64_t> > m_tf_static_version;
+
     std::string m_base_frame;
     std::string m_map_frame;
 
@@ -198,18 +379,82 @@ private:
     bool        m_use_odom_frame;
 
     // MAP
+    // map_file parameter at startup
     std::string m_map_filename;
-
+    // the file of the current map. Guarded by m_map_file_mutex
+    std::mutex        m_map_file_mutex;
+    std::string       m_map_file;
+    // file of the queued map. Becomes m_map_file once the map is swapped in
+    std::string       m_pending_map_file;
+    std::thread       m_map_loader;
+    std::atomic<bool> m_map_loading{false};
+    rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr m_param_cb_handle;
+
+    std::mutex        m_map_center_mutex;
+    rmagine::Vector   m_map_center = {0.0, 0.0, 0.0};
+
+    // level of detail
+    bool              m_lod = false;
+    std::string       m_lod_map_filename;
+    double            m_lod_cell_size = 0.25;
+    double            m_lod_trans_thresh = 0.05;
+    double            m_lod_rot_thresh = 0.02;
+    std::atomic<bool> m_lod_coarse{true};
+
+    // sensors are loaded in parallel (m_sensor_loaders) and added once they are ready
+    std::mutex                                          m_sensors_mutex;
     std::unordered_map<std::string, MICPRangeSensorPtr> m_sensors;
+    std::vector<std::thread>                            m_sensor_loaders;
+    // sensors with data. Set by preCorrect for the current correction step
+    std::unordered_map<std::string, MICPRangeSensorPtr> m_sensors_active;
+    size_t                                              m_n_sensors_active = 0;
+
+    // place database of the relocalization. Loaded on first use
+    PlaceDatabasePtr m_place_db;
     
     
 
     #ifdef RMCL_EMBREE
     rmagine::EmbreeMapPtr m_map_embree;
+
+    // keep instances of the scene graph (Assimp maps)
+    bool                     m_map_instances = true;
+
+    // correspondence weights of meshes by name prefix
+    std::vector<std::pair<std::string, float> > m_map_weights;
+
+    // tiled maps
+    bool                     m_map_tiles = false;
+    double                   m_map_tiles_radius = 200.0;
+    double                   m_map_tiles_update_period = 1.0;
+    MapTileStreamerEmbreePtr m_tile_streamer;
+
+    rmagine::EmbreeMapPtr    m_map_embree_lod;
+
+    // maps built in other threads. Swapped in by preCorrect.
+    // The LOD map is queued first and only taken together with a full map
+    rmagine::EmbreeMapPtr    m_pending_map_embree;
+    rmagine::EmbreeMapPtr    m_pending_map_embree_lod;
+
+    // incremental updates of dynamic map regions
+    MapUpdaterEmbreePtr m_map_updater = std::make_shared<MapUpdaterEmbree>();
+    // region masks of the LOD map
+    MapUpdaterEmbreePtr m_map_updater_lod = std::make_shared<MapUpdaterEmbree>();
+
+    // map regions (floors). Bit i of the ray mask: region i
+    std::vector<std::string>  m_region_names;
+    std::atomic<unsigned int> m_ray_mask{0xFFFFFFFF};
+
+    // fuse all embree sensors into one ray set
+    bool               m_stack_sensors = false;
+    MICPSensorStackPtr m_stack;
     #endif // RMCL_EMBREE
 
     #ifdef RMCL_OPTIX
     rmagine::OptixMapPtr m_map_optix;
+    rmagine::OptixMapPtr m_map_optix_lod;
+    rmagine::OptixMapPtr m_pending_map_optix;
+    rmagine::OptixMapPtr m_pending_map_optix_lod;
     #endif // RMCL_OPTIX
 
 
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief MICPLocalizationNode. MICP-L as composable ROS 2 node
+ * 
+ * - Estimates odom -> map (or base -> map) by registering all configured
+ *   range sensors to a mesh map
+ * - Can be loaded into a component container together with sensor 
+ *   preprocessing nodes (e.g. rmcl::Pcl2ToScanNode). With intra-process 
+ *   communication enabled sensor messages are then passed as shared
+ *   pointers without serialization or copies
+ * - Periodically checkpoints its state (checkpoint.file) and resumes 
+ *   from it after a restart if the map did not change
+ * - Relocalizes globally on the 'relocalize' service, at startup or 
+ *   when tracking is lost (relocalization.*)
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_CORRECTION_MICP_LOCALIZATION_NODE_HPP
+#define RMCL_CORRECTION_MICP_LOCALIZATION_NODE_HPP
+
+#include <rclcpp/rclcpp.hpp>
+
+#include <rmagine/math/types.h>
+
+#include <rmcl/correction/MICP.hpp>
+#include <rmcl/util/ros_defines.h>
+
+#include <geometry_msgs/msg/pose_with_covariance_stamped.hpp>
+#include <geometry_msgs/msg/pose_stamped.hpp>
+#include <std_srvs/srv/trigger.hpp>
+#include <geometry_msgs/msg/transform_stamped.hpp>
+#include <tf2_ros/transform_broadcaster.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace rmcl
+{
+
+/**
+ * @brief MICP localization node
+ * 
+ * The heavy initialization (map loading, waiting for sensor topics and
+ * TF) is deferred to the first spin of the executor, because waiting for 
+ * messages requires shared_from_this(). It blocks the executor thread 
+ * that runs it until done.
+ */
+class MICPLocalizationNode : public rclcpp::Node
+{
+public:
+    explicit MICPLocalizationNode(
+        const rclcpp::NodeOptions& options = rclcpp::NodeOptions());
+
+    ~MICPLocalizationNode();
+
+    /**
+     * @brief Scores a batch of poses (base -> map) against the current 
+     * scans, e.g. for planners or external pose verification. The batch
+     * is scored in the correction thread between two corrections
+     * 
+     * @return one score per pose. Empty if no sensor is ready yet. Holds a 
+     * std::runtime_error if the node shuts down before the batch is scored
+     */
+    std::future<std::vector<PoseScore> > scorePoses(
+        rmagine::Memory<rmagine::Transform, rmagine::RAM> Tbms);
+
+private:
+    void init();
+
+    // stops and joins the correction thread and writes a last checkpoint.
+    // Called once, on context shutdown or on destruction, whichever comes first
+    void shutdown();
+
+    void fetchTF();
+
+    void updateTF();
+
+    void correctOnce();
+
+    void correct();
+
+    void tfLoop();
+
+    void correctionLoop();
+
+    // writes the current state to checkpoint.file
+    void saveCheckpoint();
+
+    // resumes from checkpoint.file if it belongs to the loaded map
+    bool restoreCheckpoint();
+
+    // global relocalization. Runs in the correction thread.
+    // false: no sensor is ready yet
+    bool relocalize();
+
+    // serves the pending scorePoses calls. Runs in the correction thread
+    void scorePendingPoses();
+
+    // fails the pending scorePoses calls once the correction thread stops
+    void cancelPendingPoses();
+
+    // Storing Pose information globally
+    // Calculate transformation from map to odom from pose in map frame
+    void poseCB(
+        const geometry_msgs::msg::PoseStamped::ConstSharedPtr msg);
+
+    void poseWcCB(
+        const geometry_msgs::msg::PoseWithCovarianceStamped::ConstSharedPtr msg);
+
+    MICPPtr m_micp;
+
+    std::string m_map_frame;
+    std::string m_odom_frame;
+    bool        m_has_odom_frame = true;
+    std::string m_base_frame;
+
+    bool        m_adaptive_max_dist = true;
+
+    // Estimate this
+    rmagine::Transform m_Tom;
+    std::mutex         m_T_odom_map_mutex;
+
+    // dynamic: ekf
+    geometry_msgs::msg::TransformStamped m_T_base_odom;
+    rmagine::Transform m_Tbo;
+    std::mutex         m_T_base_odom_mutex;
+
+    bool m_invert_tf = false;
+    bool m_correction_disabled = false;
+
+    rmagine::Transform m_initial_pose_offset;
+    unsigned int m_combining_unit = 0;
+
+    double m_tf_rate = 50.0;
+    double m_corr_rate_max = 10000.0;
+    bool   m_print_corr_rate = false;
+
+    // checkpoints. Empty file: disabled
+    std::string m_checkpoint_file;
+    double      m_checkpoint_period = 1.0;
+    bool        m_checkpoint_restore = true;
+    // older checkpoints are not restored. 0: no limit
+    double      m_checkpoint_max_age = 0.0;
+    std::mutex  m_checkpoint_mutex;
+    // restored max_distance of sensors that were not loaded yet
+    std::unordered_map<std::string, float> m_checkpoint_max_distances;
+
+    // relocalization
+    RelocalizationParams m_reloc_params;
+    std::atomic<bool>    m_relocalize_requested{false};
+    // relocalize if the match ratio stays below this for lost_time. 0: disabled
+    float                m_reloc_lost_match_ratio = 0.0;
+    double               m_reloc_lost_time = 5.0;
+    bool                 m_lost = false;
+    std::chrono::steady_clock::time_point m_lost_since;
+
+    // pose scoring
+    struct ScoreRequest
+    {
+        rmagine::Memory<rmagine::Transform, rmagine::RAM> Tbms;
+        std::promise<std::vector<PoseScore> > scores;
+    };
+    std::vector<ScoreRequest> m_score_requests;
+    std::mutex                m_score_requests_mutex;
+
+    // testing
+    size_t m_Nposes = 1;
+
+    std::thread       m_correction_thread;
+    std::atomic<bool> m_stop_correction_thread{false};
+    // guards starting and stopping the correction thread
+    std::mutex        m_shutdown_mutex;
+    bool              m_shut_down = false;
+    rclcpp::OnShutdownCallbackHandle m_on_shutdown_handle;
+
+    std::atomic<bool> m_pose_received{false};
+
+    TFBufferPtr   m_tf_buffer;
+    TFListenerPtr m_tf_listener;
+    std::unique_ptr<tf2_ros::TransformBroadcaster> m_br;
+    rclcpp::Time  m_last_tf_stamp;
+
+    rclcpp::TimerBase::SharedPtr m_init_timer;
+    rclcpp::TimerBase::SharedPtr m_tf_timer;
+    rclcpp::TimerBase::SharedPtr m_checkpoint_timer;
+
+    rclcpp::Subscription<geometry_msgs::msg::PoseStamped>::SharedPtr m_pose_sub;
+    rclcpp::Subscription<geometry_msgs::msg::PoseWithCovarianceStamped>::SharedPtr m_pose_wc_sub;
+    rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr m_relocalize_srv;
+};
+
+using MICPLocalizationNodePtr = std::shared_ptr<MICPLocalizationNode>;
+
+} // namespace rmcl
+
+#endif // RMCL_CORRECTION_MICP_LOCALIZATION_NODE_HPP
@@ -50,6 +50,10 @@
 #include <rclcpp/rclcpp.hpp>
 #include <memory>
 #include <variant>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
 #include <rmcl/util/ros_defines.h>
 #include <rmagine/types/sensor_models.h>
 
@@ -109,6 +113,23 @@ using SensorModelV = std::variant<
     rmagine::OnDnModel
 >;
 
+struct TFCacheEntry
+{
+    rmagine::Transform  T;
+    bool                is_static = false;
+    // value of MICPRangeSensor::tf_static_version at lookup
+    uint64_t            static_version = 0;
+    std::chrono::steady_clock::time_point last_lookup;
+};
+
+// which map level of detail a sensor corrects against
+enum class LODPolicy
+{
+    NEVER = 0,  // always the full map
+    ALWAYS = 1, // always the simplified map
+    COARSE = 2  // simplified map while the pose is far off (large corrections)
+};
+
 struct TopicInfo
 {
     std::string     name;
@@ -160,13 +181,15 @@ public: // TODO: dont have everything public
     bool            count_valid_ranges = false;
     bool            adaptive_max_dist = false;
     size_t          n_ranges_valid = 0;
+    // incremented on every data update. Used to detect new data
+    uint64_t        data_version = 0;
 
     
     
     // subscriber to data
     
-    // Main node nh
-    rclcpp::Node::SharedPtr nh;
+    // Main node nh. Not owned
+    rclcpp::Node* nh = nullptr;
     // Subnodes nh_p, nh_sensor
     // private node. Publisher is publishing on /ns/node_name
     rclcpp::Node::SharedPtr nh_p;
@@ -176,18 +199,43 @@ public: // TODO: dont have everything public
     // subscriber to data
     rclcpp::SubscriptionBase::SharedPtr data_sub;
     rclcpp::SubscriptionBase::SharedPtr info_sub;
+
+    // callback group of data_sub, info_sub and img_sub
+    bool use_sensor_callback_group = true;
+    rclcpp::CallbackGroup::SharedPtr cb_group;
     
 
     ImageTransportPtr it;
     ITSubscriberPtr img_sub;
     bool optical_coordinates = false;
 
+    // depth image to range factors per pixel. Recomputed if the model changes
+    rmagine::Memory<float, rmagine::RAM> depth_scales;
+    rmagine::PinholeModel   depth_scales_model;
+    bool                    depth_scales_optical = false;
+
     TFBufferPtr  tf_buffer;
 
+    // cached transforms. key: "target <- source"
+    std::unordered_map<std::string, TFCacheEntry> tf_cache;
+    // incremented by MICP for every message on /tf_static
+    std::shared_ptr<std::atomic<uint64_t> > tf_static_version;
+    // maximum age of a cached static transform in seconds. <= 0: no limit
+    double tf_static_refresh = 10.0;
+
+    // guards corr_params_init, corr_params and the corrector setup.
+    // Taken by the data callbacks (updateCorrectors) and by every writer
+    // of the parameters outside of them
+    std::mutex                  corr_mutex;
     CorrectionParams            corr_params_init;
     CorrectionParams            corr_params;
+    // replaces corr_params.max_distance at the correctors if > 0
+    float                       max_distance_override = 0.0;
     float                       adaptive_max_dist_min = 0.15;
     float                       corr_weight = 1.0;
+    // take part in sensor stacking (micp.stack_sensors)
+    bool                        stack = true;
+    LODPolicy                   lod = LODPolicy::COARSE;
 
     // DEBUGGING
     bool            viz_corr = false;
@@ -213,6 +261,19 @@ public: // TODO: dont have everything public
     OnDnCorrectorOptixPtr       corr_ondn_optix;
     #endif // RMCL_OPTIX
 
+    // full and simplified map. The correctors use one of them
+    #ifdef RMCL_EMBREE
+    rmagine::EmbreeMapPtr       map_embree;
+    rmagine::EmbreeMapPtr       map_embree_lod;
+    #endif // RMCL_EMBREE
+
+    #ifdef RMCL_OPTIX
+    rmagine::OptixMapPtr        map_optix;
+    rmagine::OptixMapPtr        map_optix_lod;
+    #endif // RMCL_OPTIX
+
+    bool                        lod_coarse = false;
+
     // connect to topics
     void connect();
 
@@ -220,16 +281,39 @@ public: // TODO: dont have everything public
 
     // called once every new data message
     void fetchTF();
+
+    /**
+     * @brief Cached version of tf_buffer->lookupTransform(target_frame, source_frame, TimePointZero)
+     * 
+     * Transforms consisting of static transforms only are served from the cache
+     * 
+     * @return false if the transform is not available
+     */
+    bool lookupTransform(
+        const std::string& target_frame,
+        const std::string& source_frame,
+        rmagine::Transform& T);
+
     void updateCorrectors();
 
     #ifdef RMCL_EMBREE
     void setMap(rmagine::EmbreeMapPtr map);
+    void setLODMap(rmagine::EmbreeMapPtr map);
     #endif // RMCL_EMBREE
 
     #ifdef RMCL_OPTIX
     void setMap(rmagine::OptixMapPtr map);
+    void setLODMap(rmagine::OptixMapPtr map);
     #endif // RMCL_OPTIX
 
+    /**
+     * @brief Coarse correction phase. Sensors with LODPolicy::COARSE 
+     * switch to the simplified map, if there is one
+     */
+    void setLODCoarse(bool coarse);
+
+    bool usesLOD() const;
+
     // do corrections depending on the current sensor state
     void computeCovs(
         const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
@@ -247,38 +331,69 @@ public: // TODO: dont have everything public
 
     void countValidRanges();
 
+    void updateDepthScaleTable();
+
     void adaptCorrectionParams(float match_ratio, float adaption_rate);
 
+    /**
+     * @brief Hands the parameters to the correctors right away instead 
+     * of with the next sensor data
+     */
+    void setCorrectionParams(const CorrectionParams& params);
+
+    /**
+     * @brief Restricts the correspondence search to the map geometry of 
+     * the mask (active map region). Applied to the correctors right away
+     */
+    void setRayMask(unsigned int ray_mask);
+
+    /**
+     * @brief Temporarily corrects with another maximum correspondence 
+     * distance (relocalization) without touching corr_params. 
+     * Data callbacks in between keep it. <= 0: back to corr_params
+     */
+    void overrideMaxDistance(float max_distance);
+
 protected:
+    // hand the map of the current level of detail to the correctors. 
+    // Requires corr_mutex
+    void applyMaps();
+
+    // corr_params with the override applied. Requires corr_mutex
+    CorrectionParams activeParams() const;
+
+    // hand activeParams() to the correctors. Requires corr_mutex
+    void applyParams();
+
     // callbacks
     // internal rmcl msgs
     void sphericalCB(
-        const rmcl_msgs::msg::ScanStamped::SharedPtr msg);
+        const rmcl_msgs::msg::ScanStamped::ConstSharedPtr msg);
 
     void pinholeCB(
-        const rmcl_msgs::msg::DepthStamped::SharedPtr msg);
+        const rmcl_msgs::msg::DepthStamped::ConstSharedPtr msg);
 
     void o1dnCB(
-        const rmcl_msgs::msg::O1DnStamped::SharedPtr msg);
+        const rmcl_msgs::msg::O1DnStamped::ConstSharedPtr msg);
 
     void ondnCB(
-        const rmcl_msgs::msg::OnDnStamped::SharedPtr msg);
+        const rmcl_msgs::msg::OnDnStamped::ConstSharedPtr msg);
 
     // external commonly used messages
     void pclSphericalCB(
-        const sensor_msgs::msg::PointCloud2::SharedPtr msg);
+        const sensor_msgs::msg::PointCloud2::ConstSharedPtr msg);
 
     void pclPinholeCB(
-        const sensor_msgs::msg::PointCloud2::SharedPtr msg);
+        const sensor_msgs::msg::PointCloud2::ConstSharedPtr msg);
 
     void pclO1DnCB(
-        const sensor_msgs::msg::PointCloud2::SharedPtr msg);
+        const sensor_msgs::msg::PointCloud2::ConstSharedPtr msg);
     
     // void pclOnDnCB(
     //     const sensor_msgs::msg::PointCloud2::SharedPtr msg);
 
     void laserCB(
-        const sensor_msgs::msg::LaserScan::SharedPtr msg);
+        const sensor_msgs::msg::LaserScan::ConstSharedPtr msg);
 
     void imageCB(
         const sensor_msgs::msg::Image::ConstSharedPtr& msg);
@@ -286,20 +401,20 @@ protected:
     // info callbacks
     // internal
     void sphericalModelCB(
-        const rmcl_msgs::msg::ScanInfo::SharedPtr msg);
+        const rmcl_msgs::msg::ScanInfo::ConstSharedPtr msg);
 
     void pinholeModelCB(
-        const rmcl_msgs::msg::DepthInfo::SharedPtr msg);
+        const rmcl_msgs::msg::DepthInfo::ConstSharedPtr msg);
 
     void o1dnModelCB(
-        const rmcl_msgs::msg::O1DnInfo::SharedPtr msg);
+        const rmcl_msgs::msg::O1DnInfo::ConstSharedPtr msg);
 
     void ondnModelCB(
-        const rmcl_msgs::msg::OnDnInfo::SharedPtr msg);
+        const rmcl_msgs::msg::OnDnInfo::ConstSharedPtr msg);
     
     // external commonly used
     void cameraInfoCB(
-        const sensor_msgs::msg::CameraInfo::SharedPtr msg);
+        const sensor_msgs::msg::CameraInfo::ConstSharedPtr msg);
 };
 
 using MICPRangeSensorPtr = std::shared_ptr<MICPRangeSensor>;
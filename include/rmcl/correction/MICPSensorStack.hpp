@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Stacking of several range sensors into one OnDn ray set
+ * 
+ * All participating Embree sensors are fused into a single OnDnModel 
+ * with ray origins and directions given in base frame. Every ray 
+ * carries the correction weight of its sensor. The combined set is 
+ * corrected by one OnDnCorrectorEmbree in a single parallel pass, 
+ * instead of running one corrector per sensor and merging the 
+ * covariances afterwards.
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+#ifndef RMCL_CORRECTION_MICP_SENSOR_STACK_HPP
+#define RMCL_CORRECTION_MICP_SENSOR_STACK_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <rmagine/types/sensor_models.h>
+
+#include "MICPRangeSensor.hpp"
+
+#ifdef RMCL_EMBREE
+#include <rmagine/map/EmbreeMap.hpp>
+#include <rmcl/correction/OnDnCorrectorEmbree.hpp>
+#endif // RMCL_EMBREE
+
+namespace rmcl
+{
+
+#ifdef RMCL_EMBREE
+
+class MICPSensorStack
+{
+public:
+    MICPSensorStack(rmagine::EmbreeMapPtr map);
+
+    void setMap(rmagine::EmbreeMapPtr map);
+
+    /**
+     * @brief Collect all stackable Embree sensors that received data. 
+     * The ray set is only rebuilt if a sensor got new data since the last call.
+     * The stack is only active for two or more sensors
+     */
+    void update(
+        const std::unordered_map<std::string, MICPRangeSensorPtr>& sensors);
+
+    bool active() const;
+
+    bool contains(const std::string& sensor_name) const;
+
+    /**
+     * @brief The stacked results are stored in the slot of this sensor.
+     * All other stacked sensors get a weight of zero
+     */
+    std::string leader() const;
+
+    /**
+     * @brief Sum of the correction weights of all stacked sensors
+     */
+    float weight() const;
+
+    size_t numRays() const;
+
+    // active region of the map (micp ray masks)
+    void setRayMask(unsigned int ray_mask);
+
+    // until the next rebuild
+    void setMaxDistance(float max_distance);
+
+    void computeCovs(
+        const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
+        CorrectionPreResults<rmagine::RAM>& res);
+
+protected:
+    void rebuild();
+
+    OnDnCorrectorEmbreePtr m_corr;
+
+    std::vector<MICPRangeSensorPtr> m_members;
+    std::vector<uint64_t>           m_data_versions;
+
+    rmagine::OnDnModel                      m_model;
+    rmagine::Memory<float, rmagine::RAM>    m_ranges;
+    rmagine::Memory<float, rmagine::RAM>    m_weights;
+
+    float m_weight = 0.0;
+};
+
+using MICPSensorStackPtr = std::shared_ptr<MICPSensorStack>;
+
+#endif // RMCL_EMBREE
+
+} // namespace rmcl
+
+#endif // RMCL_CORRECTION_MICP_SENSOR_STACK_HPP
@@ -86,6 +86,16 @@ public:
     void setInputData(
         const rmagine::MemoryView<float, rmagine::RAM>& ranges);
 
+    /**
+     * @brief Optional per-ray weights, same layout as the ranges.
+     * Rays with weight <= 0 are skipped. Only used by computeCovs 
+     * and correct if the size matches the ranges
+     */
+    void setInputWeights(
+        const rmagine::MemoryView<float, rmagine::RAM>& weights);
+
+    void clearInputWeights();
+
     /**
      * @brief Correct one ore multiple Poses towards the map
      * 
@@ -104,6 +114,19 @@ public:
         rmagine::MemoryView<unsigned int, rmagine::RAM>& Ncorr
     );
 
+    /**
+     * @brief computeCovs with the mean point to plane distance of the 
+     * correspondences per pose. residuals is skipped unless it has one entry per pose
+     */
+    void computeCovs(
+        const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
+        rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& data_means,
+        rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& model_means,
+        rmagine::MemoryView<rmagine::Matrix3x3, rmagine::RAM>& Cs,
+        rmagine::MemoryView<unsigned int, rmagine::RAM>& Ncorr,
+        rmagine::MemoryView<float, rmagine::RAM>& residuals
+    );
+
     void computeCovs(
         const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
         CorrectionPreResults<rmagine::RAM>& res
@@ -222,7 +245,21 @@ protected:
     //     const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms
     // );
 
+    /**
+     * @brief computeCovs for a single pose, parallelized over the rays.
+     * Used if there are not enough poses to parallelize over
+     */
+    void computeCovsRayParallel(
+        const rmagine::Transform& Tbm,
+        rmagine::Vector& data_mean,
+        rmagine::Vector& model_mean,
+        rmagine::Matrix3x3& C,
+        unsigned int& Ncorr,
+        float& residual
+    );
+
     rmagine::Memory<float, rmagine::RAM> m_ranges;
+    rmagine::Memory<float, rmagine::RAM> m_weights;
 
     CorrectionParams m_params;
 
@@ -111,6 +111,19 @@ public:
         rmagine::MemoryView<unsigned int, rmagine::RAM>& Ncorr
     );
 
+    /**
+     * @brief computeCovs with the mean point to plane distance of the 
+     * correspondences per pose. residuals is skipped unless it has one entry per pose
+     */
+    void computeCovs(
+        const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
+        rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& data_means,
+        rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& model_means,
+        rmagine::MemoryView<rmagine::Matrix3x3, rmagine::RAM>& Cs,
+        rmagine::MemoryView<unsigned int, rmagine::RAM>& Ncorr,
+        rmagine::MemoryView<float, rmagine::RAM>& residuals
+    );
+
     void computeCovs(
         const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
         CorrectionPreResults<rmagine::RAM>& res
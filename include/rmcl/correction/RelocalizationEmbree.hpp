@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Candidate positions of the global relocalization on Embree maps
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_CORRECTION_RELOCALIZATION_EMBREE_HPP
+#define RMCL_CORRECTION_RELOCALIZATION_EMBREE_HPP
+
+#include <rmagine/map/EmbreeMap.hpp>
+#include <rmagine/math/types.h>
+
+#include <rmcl/correction/RelocalizationParams.hpp>
+
+#include <vector>
+
+namespace rmcl
+{
+
+/**
+ * @brief Grid cells of params.step over the map. With params.floor one 
+ * position per floor below a cell with enough headroom above it, lifted 
+ * by params.base_height. Otherwise one position per cell at params.z
+ */
+std::vector<rmagine::Vector> relocalization_positions(
+    const rmagine::EmbreeMapPtr& map,
+    const RelocalizationParams& params,
+    unsigned int ray_mask = 0xFFFFFFFF);
+
+} // namespace rmcl
+
+#endif // RMCL_CORRECTION_RELOCALIZATION_EMBREE_HPP
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Parameters and results of the global relocalization (MICP::relocalize)
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_CORRECTION_RELOCALIZATION_PARAMS_HPP
+#define RMCL_CORRECTION_RELOCALIZATION_PARAMS_HPP
+
+#include <rmagine/math/types.h>
+
+#include <string>
+
+namespace rmcl {
+
+struct RelocalizationParams {
+    // grid resolution of the candidate poses
+    float step = 1.0;
+    unsigned int yaw_steps = 12;
+
+    // true: one candidate per floor below the grid cell, lifted by base_height.
+    // false: all candidates at height z
+    bool floor = true;
+    float base_height = 0.0;
+    // free space above the floor that the robot needs
+    float min_headroom = 0.5;
+    float z = 0.0;
+
+    // place database (map_to_place_db). Replaces the grid by the 
+    // places most similar to the current scans. Empty: grid
+    std::string place_db;
+    unsigned int place_candidates = 50;
+
+    // correspondence distance for scoring and refinement
+    float max_distance = 1.0;
+    // poses per batched correction call
+    unsigned int batch_size = 4096;
+
+    // hypotheses closer than this are merged, keeping the best
+    float cluster_dist = 2.0;
+    float cluster_yaw = 0.5;
+    // hypotheses refined with MICP
+    unsigned int top_k = 10;
+    unsigned int iterations = 20;
+};
+
+struct RelocalizationHypothesis {
+    rmagine::Transform Tbm;
+    unsigned int Ncorr = 0;
+    // Ncorr / valid ranges of all sensors
+    float match_ratio = 0.0;
+};
+
+} // namespace rmcl
+
+#endif // RMCL_CORRECTION_RELOCALIZATION_PARAMS_HPP
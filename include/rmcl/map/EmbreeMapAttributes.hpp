@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Per-geometry attributes of Embree maps
+ * 
+ * Information the correctors need about hits that Embree does not 
+ * provide itself. Embree reports the geometric normal of an instance 
+ * hit in the object space of the instanced geometry, so the correctors 
+ * rotate it into map frame with the table of the instances.
+ * 
+ * Every mesh additionally gets a table of unit face normals and 
+ * correspondence weights, stored as separate arrays and indexed by 
+ * primitive id. The correctors read the normal of a hit from it instead 
+ * of normalizing the hit normal, and multiply the weight into the 
+ * accumulation. Surfaces with weight 0 (glass, vegetation) are ignored.
+ * 
+ * Attributes are registered per scene and looked up once per correction.
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_MAP_EMBREE_MAP_ATTRIBUTES_HPP
+#define RMCL_MAP_EMBREE_MAP_ATTRIBUTES_HPP
+
+#include <rmagine/map/EmbreeMap.hpp>
+#include <rmagine/math/types.h>
+#include <rmagine/types/Memory.hpp>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rmcl
+{
+
+/**
+ * @brief Per-primitive attributes of one mesh, one array per attribute
+ */
+struct PrimitiveTable
+{
+    // unit face normals in object space, oriented like the Embree hit 
+    // normal. Empty: normalize the hit normal
+    std::vector<float> nx;
+    std::vector<float> ny;
+    std::vector<float> nz;
+
+    // correspondence weights. Empty: 1 for all primitives
+    std::vector<float> weight;
+};
+
+using PrimitiveTablePtr = std::shared_ptr<PrimitiveTable>;
+
+// indexed by geometry id
+using PrimitiveTables = std::vector<PrimitiveTablePtr>;
+using PrimitiveTablesPtr = std::shared_ptr<PrimitiveTables>;
+
+/**
+ * @brief Normal transform of an instance: n_map = R * (n_obj / scale)
+ */
+struct InstanceNormalTransform
+{
+    rmagine::Quaternion R;
+    rmagine::Vector     scale_inv = {1.0, 1.0, 1.0};
+    // scale differs per axis: the transformed normal has to be normalized
+    bool                anisotropic = false;
+    bool                valid = false;
+
+    // weight of the whole instance
+    float               weight = 1.0;
+    // tables of the instanced scene, shared by all of its instances
+    PrimitiveTablesPtr  geometries;
+};
+
+struct EmbreeMapAttributes
+{
+    // indexed by instance id (geometry id in the top-level scene)
+    std::vector<InstanceNormalTransform> instances;
+
+    // tables of the meshes of the top-level scene
+    PrimitiveTables geometries;
+};
+
+/**
+ * @brief Unit normal in map frame and weight of the surface hit by a ray
+ * 
+ * Reads the tables if there are any, otherwise normalizes the hit normal.
+ * 
+ * @param attr attributes of the map or nullptr
+ * @return false if the surface has weight 0 and should be ignored
+ */
+inline bool hit_surface(
+    const EmbreeMapAttributes* attr,
+    const RTCHit& hit,
+    rmagine::Vector& n,
+    float& weight)
+{
+    weight = 1.0;
+    const InstanceNormalTransform* inst = nullptr;
+    const PrimitiveTable* table = nullptr;
+
+    if(attr)
+    {
+        const unsigned int inst_id = hit.instID[0];
+        if(inst_id != RTC_INVALID_GEOMETRY_ID)
+        {
+            if(inst_id < attr->instances.size() && attr->instances[inst_id].valid)
+            {
+                inst = &attr->instances[inst_id];
+                weight = inst->weight;
+                if(inst->geometries && hit.geomID < inst->geometries->size())
+                {
+                    table = (*inst->geometries)[hit.geomID].get();
+                }
+            }
+        } else if(hit.geomID < attr->geometries.size()) {
+            table = attr->geometries[hit.geomID].get();
+        }
+    }
+
+    bool unit = false;
+    if(table && hit.primID < table->nx.size())
+    {
+        n.x = table->nx[hit.primID];
+        n.y = table->ny[hit.primID];
+        n.z = table->nz[hit.primID];
+        unit = true;
+    } else {
+        n.x = hit.Ng_x;
+        n.y = hit.Ng_y;
+        n.z = hit.Ng_z;
+    }
+
+    if(table && hit.primID < table->weight.size())
+    {
+        weight *= table->weight[hit.primID];
+    }
+
+    if(inst)
+    {
+        if(inst->anisotropic)
+        {
+            n = {n.x * inst->scale_inv.x, n.y * inst->scale_inv.y, n.z * inst->scale_inv.z};
+            unit = false;
+        }
+        n = inst->R * n;
+    }
+
+    if(!unit)
+    {
+        n.normalizeInplace();
+    }
+
+    return weight > 0.0;
+}
+
+/**
+ * @brief Unit normal in map frame and weight of the result of a closest 
+ * point query. Same as hit_surface
+ */
+inline bool closest_point_surface(
+    const EmbreeMapAttributes* attr,
+    const rmagine::EmbreeClosestPointResult& res,
+    rmagine::Vector& n,
+    float& weight)
+{
+    weight = 1.0;
+    const PrimitiveTable* table = nullptr;
+    if(attr && res.geomID < attr->geometries.size())
+    {
+        table = attr->geometries[res.geomID].get();
+    }
+
+    if(table && res.primID < table->nx.size())
+    {
+        n.x = table->nx[res.primID];
+        n.y = table->ny[res.primID];
+        n.z = table->nz[res.primID];
+    } else {
+        n = res.n;
+        n.normalizeInplace();
+    }
+
+    if(table && res.primID < table->weight.size())
+    {
+        weight = table->weight[res.primID];
+    }
+
+    return weight > 0.0;
+}
+
+using EmbreeMapAttributesPtr = std::shared_ptr<EmbreeMapAttributes>;
+
+/**
+ * @brief Attach attributes to the scene of a map. Thread-safe
+ */
+void register_map_attributes(
+    const rmagine::EmbreeMapPtr& map,
+    EmbreeMapAttributesPtr attributes);
+
+/**
+ * @brief Attributes of the scene of a map. Thread-safe
+ * 
+ * @return nullptr if there are none (plain map without instances)
+ */
+EmbreeMapAttributesPtr find_map_attributes(
+    const rmagine::EmbreeMapPtr& map);
+
+/**
+ * @brief Fills the primitive tables of all meshes of the map and 
+ * registers them. Instance transforms of registered attributes are kept
+ * 
+ * @param weights mesh name prefix -> weight. The first matching prefix 
+ *   wins, meshes without match get weight 1. Instances match by their name
+ */
+EmbreeMapAttributesPtr build_map_attributes(
+    const rmagine::EmbreeMapPtr& map,
+    const std::vector<std::pair<std::string, float> >& weights = {});
+
+/**
+ * @brief Table of a mesh: unit face normals, oriented like the Embree 
+ * hit normal. Weights are left empty if weight is 1
+ */
+PrimitiveTablePtr make_primitive_table(
+    const rmagine::MemoryView<rmagine::Point, rmagine::RAM>& vertices,
+    const rmagine::MemoryView<rmagine::Face, rmagine::RAM>& faces,
+    float weight = 1.0);
+
+} // namespace rmcl
+
+#endif // RMCL_MAP_EMBREE_MAP_ATTRIBUTES_HPP
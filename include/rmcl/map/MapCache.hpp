@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Binary map cache
+ * 
+ * Memory-mappable triangle mesh format for fast startup. The file 
+ * stores vertices, faces and face normals of every mesh as flat 
+ * arrays, so they can be used directly after mapping the file
+ * without any parsing. Create it with the map_to_cache tool.
+ * 
+ * Layout (little endian, all offsets from file start, 64 byte aligned):
+ * - MapCacheHeader
+ * - MapCacheMeshEntry[n_meshes]
+ * - per mesh: vertices (rm::Point), faces (rm::Face), face normals (rm::Vector)
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_MAP_MAP_CACHE_HPP
+#define RMCL_MAP_MAP_CACHE_HPP
+
+#include <rmagine/types/Memory.hpp>
+#include <rmagine/math/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct aiScene;
+
+namespace rmcl
+{
+
+static constexpr char     MAP_CACHE_MAGIC[8] = {'R', 'M', 'C', 'L', 'M', 'A', 'P', '\0'};
+// 2: tile_size in header
+static constexpr uint32_t MAP_CACHE_VERSION = 2;
+static constexpr size_t   MAP_CACHE_ALIGNMENT = 64;
+
+enum class MapBuildQuality : uint32_t
+{
+    LOW = 0,
+    MEDIUM = 1,
+    HIGH = 2
+};
+
+/**
+ * @brief Hints for building the acceleration structures of the map
+ */
+struct MapBuildHints
+{
+    MapBuildQuality quality = MapBuildQuality::MEDIUM;
+    // trade speed for less memory
+    bool            compact = false;
+    // robust intersection tests (slower)
+    bool            robust = false;
+};
+
+struct MapCacheHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t n_meshes;
+    uint32_t build_quality;
+    uint32_t build_flags;
+    uint64_t meshes_offset;
+    // edge length of the square xy-tiles. 0: not tiled
+    float    tile_size;
+    uint32_t reserved;
+};
+
+struct MapCacheMeshEntry
+{
+    char     name[64];
+    uint64_t n_vertices;
+    uint64_t n_faces;
+    uint64_t vertices_offset;
+    uint64_t faces_offset;
+    uint64_t normals_offset;
+    float    bb_min[3];
+    float    bb_max[3];
+};
+
+/**
+ * @brief Mesh as it is written to a cache file
+ */
+struct MapCacheMeshData
+{
+    std::string name;
+    rmagine::Memory<rmagine::Point, rmagine::RAM>   vertices;
+    rmagine::Memory<rmagine::Face, rmagine::RAM>    faces;
+    // optional. computed while writing if empty
+    rmagine::Memory<rmagine::Vector, rmagine::RAM>  face_normals;
+};
+
+/**
+ * @brief Mesh of a mapped cache file. The views point directly into the mapping
+ */
+struct MapCacheMesh
+{
+    std::string name;
+    rmagine::MemoryView<rmagine::Point, rmagine::RAM>   vertices;
+    rmagine::MemoryView<rmagine::Face, rmagine::RAM>    faces;
+    rmagine::MemoryView<rmagine::Vector, rmagine::RAM>  face_normals;
+    rmagine::Vector bb_min;
+    rmagine::Vector bb_max;
+};
+
+/**
+ * @brief Read-only, memory mapped cache file
+ */
+class MapCache
+{
+public:
+    /**
+     * @brief Maps the file into memory. Throws std::runtime_error if
+     * the file cannot be opened or is no valid map cache
+     */
+    MapCache(const std::string& filename);
+
+    ~MapCache();
+
+    MapCache(const MapCache&) = delete;
+    MapCache& operator=(const MapCache&) = delete;
+
+    inline const std::vector<MapCacheMesh>& meshes() const
+    {
+        return m_meshes;
+    }
+
+    inline const MapBuildHints& hints() const
+    {
+        return m_hints;
+    }
+
+    inline const std::string& filename() const
+    {
+        return m_filename;
+    }
+
+    /**
+     * @brief Edge length of the tiles if every mesh is one xy-tile. 0 otherwise
+     */
+    inline float tileSize() const
+    {
+        return m_tile_size;
+    }
+
+    size_t numFaces() const;
+
+private:
+    std::string m_filename;
+    int         m_fd = -1;
+    uint8_t*    m_data = nullptr;
+    size_t      m_size = 0;
+
+    MapBuildHints               m_hints;
+    float                       m_tile_size = 0.0;
+    std::vector<MapCacheMesh>   m_meshes;
+};
+
+using MapCachePtr = std::shared_ptr<MapCache>;
+
+/**
+ * @brief Check for the map cache magic at the beginning of the file
+ */
+bool is_map_cache(const std::string& filename);
+
+void compute_face_normals(
+    const rmagine::MemoryView<rmagine::Point, rmagine::RAM>& vertices,
+    const rmagine::MemoryView<rmagine::Face, rmagine::RAM>& faces,
+    rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& face_normals);
+
+/**
+ * @brief View on a mesh in memory, e.g. to build a map from it. 
+ * The face normals must be filled
+ */
+MapCacheMesh map_cache_mesh_view(
+    const MapCacheMeshData& mesh);
+
+/**
+ * @brief Triangle meshes of an Assimp scene with the node transforms 
+ * baked into the vertices. One mesh per mesh instance. Points and lines are skipped
+ */
+std::vector<MapCacheMeshData> meshes_from_assimp(
+    const aiScene* ascene);
+
+/**
+ * @brief Partitions the meshes into square xy-tiles. Every face goes to 
+ * the tile containing its centroid. Faces of different meshes in the same tile 
+ * are merged into one mesh named "tile_<ix>_<iy>"
+ */
+std::vector<MapCacheMeshData> split_into_tiles(
+    const std::vector<MapCacheMeshData>& meshes,
+    float tile_size);
+
+/**
+ * @brief Writes meshes to a cache file. Throws std::runtime_error on failure
+ * 
+ * @param tile_size  edge length if the meshes are tiles of split_into_tiles. 0 otherwise
+ */
+void write_map_cache(
+    const std::string& filename,
+    const std::vector<MapCacheMeshData>& meshes,
+    const MapBuildHints& hints = {},
+    float tile_size = 0.0);
+
+} // namespace rmcl
+
+#endif // RMCL_MAP_MAP_CACHE_HPP
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Builds Embree maps from binary map caches
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_MAP_MAP_CACHE_EMBREE_HPP
+#define RMCL_MAP_MAP_CACHE_EMBREE_HPP
+
+#include <rmagine/map/EmbreeMap.hpp>
+#include <rmagine/map/embree/EmbreeMesh.hpp>
+#include <rmagine/map/embree/EmbreeScene.hpp>
+
+#include "MapCache.hpp"
+
+namespace rmcl
+{
+
+rmagine::EmbreeMeshPtr embree_mesh_from_cache(
+    const MapCacheMesh& mesh);
+
+/**
+ * @brief Sets build quality and scene flags before the scene is committed
+ */
+void apply_build_hints(
+    rmagine::EmbreeScenePtr scene, 
+    const MapBuildHints& hints);
+
+/**
+ * @brief Creates a committed scene containing the meshes
+ */
+rmagine::EmbreeScenePtr embree_scene_from_meshes(
+    const std::vector<MapCacheMesh>& meshes,
+    const MapBuildHints& hints = {});
+
+/**
+ * @brief Creates a committed scene containing all meshes of the cache
+ */
+rmagine::EmbreeScenePtr embree_scene_from_cache(
+    const MapCache& cache);
+
+rmagine::EmbreeMapPtr embree_map_from_cache(
+    const MapCache& cache);
+
+} // namespace rmcl
+
+#endif // RMCL_MAP_MAP_CACHE_EMBREE_HPP
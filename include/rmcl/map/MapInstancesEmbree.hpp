@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Embree maps that keep the instances of the Assimp scene graph
+ * 
+ * A mesh that is referenced by several nodes (e.g. identical shelving 
+ * units) is stored once in its own scene and placed with one Embree 
+ * instance per node. Raycasts traverse a two-level BVH. Meshes that 
+ * are used only once are transformed into map frame as usual.
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_MAP_MAP_INSTANCES_EMBREE_HPP
+#define RMCL_MAP_MAP_INSTANCES_EMBREE_HPP
+
+#include <rmagine/map/EmbreeMap.hpp>
+
+struct aiScene;
+
+namespace rmcl
+{
+
+/**
+ * @brief Creates a map from an Assimp scene and registers the 
+ * normal transforms of its instances (see EmbreeMapAttributes)
+ * 
+ * @param min_references  meshes referenced by at least this many nodes are instanced
+ */
+rmagine::EmbreeMapPtr embree_map_instanced(
+    const aiScene* ascene,
+    unsigned int min_references = 2);
+
+} // namespace rmcl
+
+#endif // RMCL_MAP_MAP_INSTANCES_EMBREE_HPP
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Streams the tiles of a tiled map cache into Embree scenes
+ * 
+ * A background thread keeps a scene of all tiles within a radius 
+ * around the current center. If the set of tiles changes, a new scene 
+ * is built from the tiles and handed over via callback. Tile meshes 
+ * are reused between scenes and released once they are far enough 
+ * away, so memory is bounded by the radius instead of the map size.
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_MAP_MAP_TILE_STREAMER_EMBREE_HPP
+#define RMCL_MAP_MAP_TILE_STREAMER_EMBREE_HPP
+
+#include <rmagine/map/EmbreeMap.hpp>
+#include <rmagine/map/embree/EmbreeMesh.hpp>
+
+#include "MapCache.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace rmcl
+{
+
+class MapTileStreamerEmbree
+{
+public:
+    using MapCallback = std::function<void(rmagine::EmbreeMapPtr)>;
+
+    /**
+     * @param cache     tiled map cache (cache->tileSize() > 0)
+     * @param radius    tiles within this xy-distance to the center are loaded
+     */
+    MapTileStreamerEmbree(
+        MapCachePtr cache, 
+        float radius);
+
+    ~MapTileStreamerEmbree();
+
+    /**
+     * @brief Builds the scene around center synchronously
+     */
+    rmagine::EmbreeMapPtr build(const rmagine::Vector& center);
+
+    /**
+     * @brief Starts the background thread. Checks for new tiles every 
+     * update_period seconds or as soon as the center jumps
+     * 
+     * @param callback  called from the background thread with every new map
+     */
+    void start(double update_period, MapCallback callback);
+
+    void stop();
+
+    // thread-safe
+    void setCenter(const rmagine::Vector& center);
+
+    inline size_t numLoadedTiles() const
+    {
+        return m_num_loaded;
+    }
+
+    /**
+     * @brief Held while the background thread reads the tile meshes, 
+     * which are shared with the current map. Lock it to modify them
+     */
+    inline std::mutex& meshMutex()
+    {
+        return m_mesh_mutex;
+    }
+
+protected:
+    void loop();
+
+    // ids of the tiles with an xy-distance <= radius to center
+    std::vector<size_t> tilesInRadius(
+        const rmagine::Vector& center, 
+        float radius) const;
+
+    rmagine::EmbreeMapPtr buildScene(
+        const std::vector<size_t>& tiles,
+        const rmagine::Vector& center);
+
+    // meshes of tiles within radius * MESH_KEEP_FACTOR stay in memory
+    static constexpr float MESH_KEEP_FACTOR = 1.5;
+
+    MapCachePtr m_cache;
+    float       m_radius;
+
+    // only accessed by the building thread
+    std::unordered_map<size_t, rmagine::EmbreeMeshPtr> m_meshes;
+    std::vector<size_t> m_active_tiles;
+    std::atomic<size_t> m_num_loaded;
+    std::mutex          m_mesh_mutex;
+
+    // center
+    std::mutex              m_center_mutex;
+    std::condition_variable m_center_cv;
+    rmagine::Vector         m_center;
+    rmagine::Vector         m_built_center;
+    bool                    m_center_jumped = false;
+
+    // thread
+    std::thread         m_thread;
+    std::atomic<bool>   m_stop;
+    double              m_update_period = 1.0;
+    MapCallback         m_callback;
+};
+
+using MapTileStreamerEmbreePtr = std::shared_ptr<MapTileStreamerEmbree>;
+
+} // namespace rmcl
+
+#endif // RMCL_MAP_MAP_TILE_STREAMER_EMBREE_HPP
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Incremental updates of Embree maps
+ * 
+ * Parts of the map that move (doors, shutters, racks) are marked as 
+ * dynamic. Their BVHs are refit instead of rebuilt and the scene switches 
+ * to a two-level structure, so the cost of an update is proportional to 
+ * the changed geometries instead of the whole map. Updates are queued 
+ * from any thread and applied between two correction steps.
+ * 
+ * The state of every touched mesh is remembered and applied again if 
+ * the map is replaced (hot-swap, tile streaming).
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_MAP_MAP_UPDATER_EMBREE_HPP
+#define RMCL_MAP_MAP_UPDATER_EMBREE_HPP
+
+#include <rmagine/map/EmbreeMap.hpp>
+#include <rmagine/map/embree/EmbreeGeometry.hpp>
+#include <rmagine/math/types.h>
+#include <rmagine/types/Memory.hpp>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rmcl
+{
+
+/**
+ * @brief Accumulated state of one mesh, identified by its name
+ */
+struct MeshState
+{
+    bool dynamic = false;
+
+    bool has_transform = false;
+    rmagine::Transform T;
+
+    // empty: vertices of the map
+    rmagine::Memory<rmagine::Point, rmagine::RAM> vertices;
+
+    bool enabled = true;
+};
+
+class MapUpdaterEmbree
+{
+public:
+    /**
+     * @brief Dynamic meshes are refit on every change. Static meshes 
+     * are rebuilt with the quality of the scene
+     */
+    void setDynamic(const std::string& mesh_name, bool dynamic = true);
+
+    void setTransform(const std::string& mesh_name, const rmagine::Transform& T);
+
+    /**
+     * @brief New vertex positions in mesh coordinates. Same number of 
+     * vertices, the faces stay
+     */
+    void setVertices(
+        const std::string& mesh_name, 
+        const rmagine::MemoryView<rmagine::Point, rmagine::RAM>& vertices);
+
+    void setEnabled(const std::string& mesh_name, bool enabled);
+
+    /**
+     * @brief Regions (e.g. floors) as lists of mesh name prefixes. Meshes of
+     * region i get bit i of their Embree geometry mask, so rays with another 
+     * mask skip them. Meshes without region are hit by every ray
+     */
+    void setRegions(const std::vector<std::vector<std::string> >& regions);
+
+    /**
+     * @brief Applies the queued updates to the map and recommits it. 
+     * No raycasts on the map must run meanwhile. Tile meshes are shared 
+     * with the MapTileStreamerEmbree: hold its meshMutex()
+     * 
+     * @return number of updated geometries. Changed region masks 
+     * do not count
+     */
+    size_t apply(rmagine::EmbreeMapPtr map);
+
+protected:
+    MeshState& state(const std::string& mesh_name);
+
+    void applyState(
+        rmagine::EmbreeGeometryPtr geom, 
+        const MeshState& state);
+
+    void applyRegions();
+
+    // normal transforms of moved instances, normal tables of moved meshes
+    void updateAttributes(
+        rmagine::EmbreeMapPtr map,
+        unsigned int geom_id,
+        const MeshState& state);
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, MeshState> m_states;
+    // names changed since the last apply
+    std::vector<std::string> m_changed;
+
+    std::vector<std::vector<std::string> > m_regions;
+    bool m_regions_changed = false;
+
+    // the map of the last apply. Another map gets all states
+    std::weak_ptr<rmagine::EmbreeMap> m_map;
+    // flags of its scene before the first apply
+    RTCSceneFlags m_scene_flags = RTC_SCENE_FLAG_NONE;
+    // name -> (geometry id, geometry)
+    std::unordered_map<std::string, std::pair<unsigned int, rmagine::EmbreeGeometryPtr> > m_geometries;
+};
+
+using MapUpdaterEmbreePtr = std::shared_ptr<MapUpdaterEmbree>;
+
+} // namespace rmcl
+
+#endif // RMCL_MAP_MAP_UPDATER_EMBREE_HPP
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Mesh simplification for level of detail maps
+ * 
+ * Vertex clustering with quadric error placement: all vertices of a 
+ * grid cell are merged into one vertex at the position that minimizes 
+ * the squared distances to the planes of the adjacent faces. Faces 
+ * that collapse are removed. Large planar structures (walls, floors) 
+ * are preserved while small details (furniture, fixtures) vanish.
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_MAP_MESH_SIMPLIFICATION_HPP
+#define RMCL_MAP_MESH_SIMPLIFICATION_HPP
+
+#include <string>
+#include <vector>
+
+#include "MapCache.hpp"
+
+namespace rmcl
+{
+
+/**
+ * @brief Simplifies a triangle mesh by clustering its vertices into cubic cells
+ * 
+ * @param cell_size  edge length of the cells. Details smaller than this vanish.
+ *                   Throws std::invalid_argument if it is not positive
+ * @return simplified mesh including face normals. Empty if everything collapsed
+ */
+MapCacheMeshData simplify_mesh(
+    const std::string& name,
+    const rmagine::MemoryView<rmagine::Point, rmagine::RAM>& vertices,
+    const rmagine::MemoryView<rmagine::Face, rmagine::RAM>& faces,
+    float cell_size);
+
+/**
+ * @brief Simplifies every mesh. Meshes that collapse completely are dropped
+ */
+std::vector<MapCacheMeshData> simplify_meshes(
+    const std::vector<MapCacheMesh>& meshes,
+    float cell_size);
+
+std::vector<MapCacheMeshData> simplify_meshes(
+    const std::vector<MapCacheMeshData>& meshes,
+    float cell_size);
+
+} // namespace rmcl
+
+#endif // RMCL_MAP_MESH_SIMPLIFICATION_HPP
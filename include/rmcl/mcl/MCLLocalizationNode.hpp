@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief MCLLocalizationNode. Monte Carlo localization in mesh maps on CPU
+ * 
+ * - Keeps a particle set of base -> map poses, moved by odometry
+ * - Scores all particles per scan by batched Embree range simulation 
+ *   and a beam model
+ * - Low-variance resampling, random particles for kidnapping recovery
+ * - While the particles are spread out, the estimate is the heaviest
+ *   pose cluster instead of the mean over all modes
+ * - Optionally refines the estimate with a few MICP steps once the 
+ *   particles have converged
+ * - Global localization (init.global) or initial pose on 'initialpose'
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_MCL_MCL_LOCALIZATION_NODE_HPP
+#define RMCL_MCL_MCL_LOCALIZATION_NODE_HPP
+
+#include <rclcpp/rclcpp.hpp>
+
+#include <rmagine/math/types.h>
+#include <rmagine/map/EmbreeMap.hpp>
+
+#include <rmcl/mcl/ParticleFilter.hpp>
+#include <rmcl/mcl/ParticleScorerEmbree.hpp>
+#include <rmcl/clustering/pose_clustering.h>
+#include <rmcl/correction/CorrectionParams.hpp>
+#include <rmcl/correction/SphereCorrectorEmbree.hpp>
+#include <rmcl/correction/OnDnCorrectorEmbree.hpp>
+#include <rmcl/util/ros_defines.h>
+
+#include <geometry_msgs/msg/pose_with_covariance_stamped.hpp>
+#include <geometry_msgs/msg/pose_array.hpp>
+#include <sensor_msgs/msg/laser_scan.hpp>
+#include <rmcl_msgs/msg/scan_stamped.hpp>
+#include <rmcl_msgs/msg/on_dn_stamped.hpp>
+#include <std_msgs/msg/header.hpp>
+#include <tf2_ros/transform_broadcaster.h>
+
+#include <memory>
+
+namespace rmcl
+{
+
+class MCLLocalizationNode : public rclcpp::Node
+{
+public:
+    explicit MCLLocalizationNode(
+        const rclcpp::NodeOptions& options = rclcpp::NodeOptions());
+
+private:
+    void loadMap(const std::string& filename);
+
+    void scanCB(const sensor_msgs::msg::LaserScan::ConstSharedPtr msg);
+
+    void scanStampedCB(const rmcl_msgs::msg::ScanStamped::ConstSharedPtr msg);
+
+    void ondnCB(const rmcl_msgs::msg::OnDnStamped::ConstSharedPtr msg);
+
+    void initialPoseCB(
+        const geometry_msgs::msg::PoseWithCovarianceStamped::ConstSharedPtr msg);
+
+    // one filter step: predict, weigh, resample, estimate
+    template<typename ModelT>
+    void update(
+        const std_msgs::msg::Header& header,
+        const ModelT& model);
+
+    // a few MICP steps from the estimate. Moves all particles along
+    template<typename ModelT>
+    bool refine(
+        const ModelT& model,
+        const rmagine::Transform& Tsb,
+        rmagine::Transform& Tbm);
+
+    bool lookupTransform(
+        const std::string& target_frame,
+        const std::string& source_frame,
+        const rclcpp::Time& stamp,
+        rmagine::Transform& T) const;
+
+    void publish(const rclcpp::Time& stamp);
+
+    void publishTF(const rclcpp::Time& stamp);
+
+    std::string m_map_frame;
+    std::string m_odom_frame;
+    std::string m_base_frame;
+    // empty: frame of the sensor messages
+    std::string m_sensor_frame;
+
+    rmagine::EmbreeMapPtr m_map;
+
+    ParticleFilterPtr m_pf;
+    ParticleScorerEmbreePtr m_scorer;
+    rmagine::Memory<float, rmagine::RAM> m_log_likelihoods;
+    // measured ranges of the current scan
+    rmagine::Memory<float, rmagine::RAM> m_ranges;
+
+    float m_likelihood_scale = 0.1;
+    float m_resample_neff_ratio = 0.5;
+    float m_update_min_dist = 0.1;
+    float m_update_min_angle = 0.1;
+
+    float m_init_sigma_trans = 0.5;
+    float m_init_sigma_yaw = 0.3;
+
+    // estimate from the heaviest mode
+    bool m_clustering = true;
+    PoseClusteringParams m_clustering_params;
+
+    // MICP refinement
+    bool m_refine = true;
+    unsigned int m_refine_iterations = 5;
+    // only refine if the particles are within this radius
+    float m_refine_max_spread = 0.3;
+    unsigned int m_refine_min_corr = 20;
+    CorrectionParams m_refine_params;
+    std::shared_ptr<SphereCorrectorEmbree> m_corr_sphere;
+    std::shared_ptr<OnDnCorrectorEmbree> m_corr_ondn;
+
+    bool m_initialized = false;
+    bool m_force_update = true;
+    bool m_has_last_odom = false;
+    rmagine::Transform m_Tbo_last;
+
+    // estimate
+    bool m_has_estimate = false;
+    rmagine::Transform m_Tom;
+    ParticleEstimate m_estimate;
+
+    double m_tf_rate = 50.0;
+    double m_transform_tolerance = 0.1;
+    bool m_publish_particles = true;
+
+    TFBufferPtr m_tf_buffer;
+    TFListenerPtr m_tf_listener;
+    std::unique_ptr<tf2_ros::TransformBroadcaster> m_br;
+
+    rclcpp::CallbackGroup::SharedPtr m_cb_group;
+    rclcpp::TimerBase::SharedPtr m_tf_timer;
+
+    rclcpp::SubscriptionBase::SharedPtr m_sensor_sub;
+    rclcpp::Subscription<geometry_msgs::msg::PoseWithCovarianceStamped>::SharedPtr m_initial_pose_sub;
+
+    rclcpp::Publisher<geometry_msgs::msg::PoseWithCovarianceStamped>::SharedPtr m_pose_pub;
+    rclcpp::Publisher<geometry_msgs::msg::PoseArray>::SharedPtr m_particles_pub;
+};
+
+using MCLLocalizationNodePtr = std::shared_ptr<MCLLocalizationNode>;
+
+} // namespace rmcl
+
+#endif // RMCL_MCL_MCL_LOCALIZATION_NODE_HPP
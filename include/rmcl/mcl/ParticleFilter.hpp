@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Particle set of the Monte Carlo localization
+ * 
+ * - Odometry motion model. Noise is applied in the plane (x, y, yaw),
+ *   z, roll and pitch follow the odometry
+ * - Multiplicative weight updates from per-particle log-likelihoods
+ * - Low-variance resampling with injection of random particles when 
+ *   the short-term likelihood drops below the long-term one (kidnapping)
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_MCL_PARTICLE_FILTER_HPP
+#define RMCL_MCL_PARTICLE_FILTER_HPP
+
+#include <rmagine/math/types.h>
+#include <rmagine/types/Memory.hpp>
+
+#include <memory>
+#include <random>
+
+namespace rmcl
+{
+
+struct MotionModelParams
+{
+    // translation noise per meter of translation
+    float alpha_trans_trans = 0.2;
+    // translation noise per radian of rotation
+    float alpha_trans_rot = 0.05;
+    // rotation noise per radian of rotation
+    float alpha_rot_rot = 0.2;
+    // rotation noise per meter of translation
+    float alpha_rot_trans = 0.05;
+    // noise added at every prediction, even without motion
+    float sigma_trans_min = 0.01;
+    float sigma_rot_min = 0.005;
+};
+
+struct RecoveryParams
+{
+    // smoothing of the long- and short-term average likelihood.
+    // alpha_slow << alpha_fast. 0 disables the injection
+    float alpha_slow = 0.001;
+    float alpha_fast = 0.1;
+};
+
+/**
+ * @brief Region in which random particles are drawn (global 
+ * localization, recovery). Uniform in x, y, z and yaw
+ */
+struct ParticleBounds
+{
+    rmagine::Vector min = {0.0, 0.0, 0.0};
+    rmagine::Vector max = {0.0, 0.0, 0.0};
+};
+
+struct ParticleEstimate
+{
+    // weighted mean
+    rmagine::Transform pose;
+    // covariance of the translation
+    rmagine::Matrix3x3 cov_trans;
+    // circular variance of the yaw
+    float var_yaw = 0.0;
+};
+
+class ParticleFilter
+{
+public:
+    ParticleFilter(size_t n_particles, unsigned int seed = std::random_device{}());
+
+    inline size_t size() const 
+    {
+        return m_particles.size();
+    }
+
+    inline const rmagine::Memory<rmagine::Transform, rmagine::RAM>& particles() const
+    {
+        return m_particles;
+    }
+
+    inline const rmagine::Memory<float, rmagine::RAM>& weights() const
+    {
+        return m_weights;
+    }
+
+    void setMotionModelParams(const MotionModelParams& params);
+
+    void setRecoveryParams(const RecoveryParams& params);
+
+    void setBounds(const ParticleBounds& bounds);
+
+    /**
+     * @brief Draw all particles around a pose. Planar noise (x, y, yaw)
+     */
+    void initGaussian(
+        const rmagine::Transform& mean,
+        float sigma_trans,
+        float sigma_yaw);
+
+    /**
+     * @brief Draw all particles uniformly within the bounds
+     */
+    void initUniform();
+
+    /**
+     * @brief Move every particle by the odometry delta (in base 
+     * coordinates of the previous pose) plus noise
+     */
+    void predict(const rmagine::Transform& Tdelta);
+
+    /**
+     * @brief Applies T to every particle from the left (map frame)
+     */
+    void transform(const rmagine::Transform& T);
+
+    /**
+     * @brief Multiplies the weights with exp(scale * log_likelihood)
+     * and normalizes them
+     * 
+     * @param scale Tempers the likelihood. Beams are not independent,
+     *   using their product as is makes the filter overconfident
+     */
+    void weigh(
+        const rmagine::MemoryView<float, rmagine::RAM>& log_likelihoods,
+        float scale = 1.0);
+
+    /**
+     * @brief Effective number of particles 1 / sum(w^2)
+     */
+    float neff() const;
+
+    /**
+     * @brief Low-variance resampling. Replaces particles by random ones
+     * in the bounds with the probability given by the recovery params
+     */
+    void resample();
+
+    ParticleEstimate estimate() const;
+
+    /**
+     * @brief Particle with the highest weight
+     */
+    size_t best() const;
+
+private:
+    rmagine::Transform randomPose();
+
+    rmagine::Memory<rmagine::Transform, rmagine::RAM> m_particles;
+    rmagine::Memory<float, rmagine::RAM> m_weights;
+    rmagine::Memory<rmagine::Transform, rmagine::RAM> m_particles_tmp;
+
+    MotionModelParams m_motion;
+    RecoveryParams m_recovery;
+    ParticleBounds m_bounds;
+
+    // average log-likelihoods for the recovery
+    bool  m_avg_init = false;
+    float m_ll_slow = 0.0;
+    float m_ll_fast = 0.0;
+
+    std::mt19937 m_rng;
+};
+
+using ParticleFilterPtr = std::shared_ptr<ParticleFilter>;
+
+} // namespace rmcl
+
+#endif // RMCL_MCL_PARTICLE_FILTER_HPP
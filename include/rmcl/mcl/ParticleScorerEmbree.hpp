@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Scores particles by batched range simulation with Embree
+ * 
+ * The scan is subsampled to at most max_beams beams. The simulators 
+ * cast these beams from all particles of a chunk at once, the beam 
+ * model then compares them to the measured ranges.
+ * 
+ * Spherical (LaserScan, ScanStamped) and OnDn sensors are supported.
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_MCL_PARTICLE_SCORER_EMBREE_HPP
+#define RMCL_MCL_PARTICLE_SCORER_EMBREE_HPP
+
+#include <memory>
+
+#include <rmagine/map/EmbreeMap.hpp>
+#include <rmagine/types/sensor_models.h>
+#include <rmagine/simulation/SphereSimulatorEmbree.hpp>
+#include <rmagine/simulation/OnDnSimulatorEmbree.hpp>
+
+#include "beam_model.h"
+
+namespace rmcl
+{
+
+class ParticleScorerEmbree
+{
+public:
+    ParticleScorerEmbree(rmagine::EmbreeMapPtr map);
+
+    void setMap(rmagine::EmbreeMapPtr map);
+
+    void setTsb(const rmagine::Transform& Tsb);
+
+    void setParams(const BeamModelParams& params);
+
+    /**
+     * @brief Upper bound of beams per particle
+     */
+    void setMaxBeams(size_t max_beams);
+
+    void setInputData(
+        const rmagine::SphericalModel& model,
+        const rmagine::MemoryView<float, rmagine::RAM>& ranges);
+
+    void setInputData(
+        const rmagine::OnDnModel& model,
+        const rmagine::MemoryView<float, rmagine::RAM>& ranges);
+
+    /**
+     * @brief Number of beams after subsampling
+     */
+    inline size_t numBeams() const
+    {
+        return m_ranges.size();
+    }
+
+    /**
+     * @brief Beam model log-likelihood of the current scan for every pose
+     */
+    void score(
+        const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
+        rmagine::MemoryView<float, rmagine::RAM>& log_likelihoods);
+
+private:
+    rmagine::SphereSimulatorEmbreePtr m_sim_sphere;
+    rmagine::OnDnSimulatorEmbreePtr m_sim_ondn;
+    // the one that matches the current input
+    bool m_ondn = false;
+
+    BeamModelParams m_params;
+    size_t m_max_beams = 1024;
+
+    // subsampled measurement
+    rmagine::Memory<float, rmagine::RAM> m_ranges;
+    float m_range_min = 0.0;
+    float m_range_max = 0.0;
+
+    rmagine::Bundle<rmagine::Ranges<rmagine::RAM> > m_sim;
+};
+
+using ParticleScorerEmbreePtr = std::shared_ptr<ParticleScorerEmbree>;
+
+} // namespace rmcl
+
+#endif // RMCL_MCL_PARTICLE_SCORER_EMBREE_HPP
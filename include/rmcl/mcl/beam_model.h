@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Beam model likelihood of simulated against real ranges
+ * 
+ * Per beam the log of a mixture of a Gaussian around the simulated 
+ * range and a uniform for unexpected objects, approximated by the 
+ * maximum of both terms. Without exp and log the inner loop over the
+ * beams of a particle vectorizes.
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_MCL_BEAM_MODEL_H
+#define RMCL_MCL_BEAM_MODEL_H
+
+#include <rmagine/types/Memory.hpp>
+
+namespace rmcl
+{
+
+struct BeamModelParams
+{
+    // standard deviation of the measured around the simulated range
+    float sigma_hit = 0.2;
+    // mixing weights of the measurement and the unexpected objects
+    float z_hit = 0.9;
+    float z_rand = 0.1;
+};
+
+/**
+ * @brief Sum of the per-beam log-likelihoods for every pose
+ * 
+ * @param ranges_real  measured ranges. Beams out of [range_min, range_max] are ignored
+ * @param ranges_sim   simulated ranges, ranges_real.size() per pose. Misses are
+ *                     treated as range_max
+ * @param log_likelihoods  one per pose
+ */
+void beam_log_likelihoods(
+    const rmagine::MemoryView<float, rmagine::RAM>& ranges_real,
+    const rmagine::MemoryView<float, rmagine::RAM>& ranges_sim,
+    float range_min, 
+    float range_max,
+    const BeamModelParams& params,
+    rmagine::MemoryView<float, rmagine::RAM>& log_likelihoods);
+
+} // namespace rmcl
+
+#endif // RMCL_MCL_BEAM_MODEL_H
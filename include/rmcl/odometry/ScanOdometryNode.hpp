@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief ScanOdometryNode. LiDAR odometry for robots without wheel 
+ * odometry
+ * 
+ * - Registers consecutive scans with ScanToScanOdometry
+ * - Broadcasts odom -> base at sensor rate, stamped with the scan.
+ *   MICP and MCL then get a motion prior between their corrections
+ * - Inputs: LaserScan, PointCloud2, rmcl ScanStamped and OnDnStamped
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_ODOMETRY_SCAN_ODOMETRY_NODE_HPP
+#define RMCL_ODOMETRY_SCAN_ODOMETRY_NODE_HPP
+
+#include <rclcpp/rclcpp.hpp>
+
+#include <rmagine/math/types.h>
+#include <rmagine/types/Memory.hpp>
+
+#include <rmcl/odometry/ScanToScanOdometry.hpp>
+#include <rmcl/util/ros_defines.h>
+
+#include <sensor_msgs/msg/laser_scan.hpp>
+#include <sensor_msgs/msg/point_cloud2.hpp>
+#include <rmcl_msgs/msg/scan_stamped.hpp>
+#include <rmcl_msgs/msg/on_dn_stamped.hpp>
+#include <std_msgs/msg/header.hpp>
+#include <tf2_ros/transform_broadcaster.h>
+
+#include <memory>
+
+namespace rmcl
+{
+
+class ScanOdometryNode : public rclcpp::Node
+{
+public:
+    explicit ScanOdometryNode(
+        const rclcpp::NodeOptions& options = rclcpp::NodeOptions());
+
+private:
+    void scanCB(const sensor_msgs::msg::LaserScan::ConstSharedPtr msg);
+
+    void pclCB(const sensor_msgs::msg::PointCloud2::ConstSharedPtr msg);
+
+    void scanStampedCB(const rmcl_msgs::msg::ScanStamped::ConstSharedPtr msg);
+
+    void ondnCB(const rmcl_msgs::msg::OnDnStamped::ConstSharedPtr msg);
+
+    // valid ranges to points in sensor coordinates
+    template<typename ModelT, typename RangesT>
+    void rangesToPoints(const ModelT& model, const RangesT& ranges);
+
+    // registers m_points (sensor coordinates) and publishes
+    void update(const std_msgs::msg::Header& header);
+
+    bool lookupSensorTransform(
+        const std::string& sensor_frame,
+        const rclcpp::Time& stamp);
+
+    std::string m_odom_frame;
+    std::string m_base_frame;
+    // empty: frame of the sensor messages
+    std::string m_sensor_frame;
+
+    // for point clouds without a sensor model
+    float m_range_min = 0.0;
+    float m_range_max = 100.0;
+
+    ScanToScanOdometryPtr m_odom;
+
+    // current scan: points in sensor, then in base coordinates
+    rmagine::Memory<rmagine::Vector, rmagine::RAM> m_points;
+
+    // sensor -> base. Assumed to be static
+    bool m_has_Tsb = false;
+    rmagine::Transform m_Tsb;
+
+    bool m_has_last_stamp = false;
+    rclcpp::Time m_last_stamp;
+
+    TFBufferPtr m_tf_buffer;
+    TFListenerPtr m_tf_listener;
+    std::unique_ptr<tf2_ros::TransformBroadcaster> m_br;
+
+    rclcpp::SubscriptionBase::SharedPtr m_sensor_sub;
+};
+
+using ScanOdometryNodePtr = std::shared_ptr<ScanOdometryNode>;
+
+} // namespace rmcl
+
+#endif // RMCL_ODOMETRY_SCAN_ODOMETRY_NODE_HPP
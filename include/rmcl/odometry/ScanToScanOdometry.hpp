@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief ScanToScanOdometry. LiDAR odometry by point-to-point ICP 
+ * between consecutive scans
+ * 
+ * - Correspondences: nearest neighbors of a subsampled scan in a 
+ *   KdTreeSoA of the full previous scan, rebuilt for every scan
+ * - Pose updates: means_covs_batched + Correction, as in MICP
+ * - Constant velocity prior: the last motion is the initial guess of
+ *   the next registration
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_ODOMETRY_SCAN_TO_SCAN_ODOMETRY_HPP
+#define RMCL_ODOMETRY_SCAN_TO_SCAN_ODOMETRY_HPP
+
+#include <rmagine/math/types.h>
+#include <rmagine/types/Memory.hpp>
+
+#include <rmcl/math/math.h>
+#include <rmcl/spatial/KdTreeSoA.hpp>
+
+#include <memory>
+
+namespace rmcl
+{
+
+struct ScanToScanOdometryParams
+{
+    // ICP iterations per scan
+    unsigned int iterations = 20;
+    // correspondences farther apart are rejected (m)
+    float max_corr_dist = 0.5;
+    // points per scan registered against the full previous scan
+    unsigned int max_points = 2000;
+    // stop iterating once an update is smaller than this (m, rad)
+    float converged_trans = 1e-4;
+    float converged_rot = 1e-4;
+    // registrations with fewer correspondences fall back to the prior
+    unsigned int min_corr = 50;
+};
+
+class ScanToScanOdometry
+{
+public:
+    ScanToScanOdometry(const ScanToScanOdometryParams& params = {});
+
+    void setParams(const ScanToScanOdometryParams& params);
+
+    /**
+     * @brief Registers a scan against the previous one and moves the
+     * pose by the result
+     * 
+     * @param points Valid points of the scan in base coordinates
+     * @return false if the registration failed. The pose then follows 
+     *   the motion prior
+     */
+    bool update(const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& points);
+
+    /**
+     * @brief Forgets the previous scan and restarts at Tbo
+     */
+    void reset(const rmagine::Transform& Tbo = rmagine::Transform::Identity());
+
+    /**
+     * @brief base -> odom
+     */
+    inline const rmagine::Transform& pose() const
+    {
+        return m_Tbo;
+    }
+
+    /**
+     * @brief Last motion. Current base in the base of the previous scan
+     */
+    inline const rmagine::Transform& delta() const
+    {
+        return m_Tdelta;
+    }
+
+    inline unsigned int numCorrespondences() const
+    {
+        return m_n_corr;
+    }
+
+    inline unsigned int numIterations() const
+    {
+        return m_n_iterations;
+    }
+
+private:
+    void subsample(const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& points);
+
+    void keepScan(const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& points);
+
+    ScanToScanOdometryParams m_params;
+
+    bool m_has_prev = false;
+    rmagine::Transform m_Tbo;
+    rmagine::Transform m_Tdelta;
+    unsigned int m_n_corr = 0;
+    unsigned int m_n_iterations = 0;
+
+    // previous scan, model of the registration
+    rmagine::Memory<rmagine::Vector, rmagine::RAM> m_scan_prev;
+    KdTreeSoA m_tree;
+
+    // current scan and ICP buffers
+    rmagine::Memory<rmagine::Vector, rmagine::RAM> m_scan;
+    rmagine::Memory<rmagine::Vector, rmagine::RAM> m_data;
+    rmagine::Memory<rmagine::Vector, rmagine::RAM> m_model;
+    rmagine::Memory<unsigned int, rmagine::RAM> m_mask;
+    rmagine::Memory<KdIndex, rmagine::RAM> m_ids;
+    rmagine::Memory<float, rmagine::RAM> m_dists_sq;
+
+    // one batch
+    rmagine::Memory<rmagine::Vector, rmagine::RAM> m_ds;
+    rmagine::Memory<rmagine::Vector, rmagine::RAM> m_ms;
+    rmagine::Memory<rmagine::Matrix3x3, rmagine::RAM> m_Cs;
+    rmagine::Memory<unsigned int, rmagine::RAM> m_Ncorr;
+    rmagine::Memory<rmagine::Transform, rmagine::RAM> m_Tupdate;
+
+    Correction m_correction;
+};
+
+using ScanToScanOdometryPtr = std::shared_ptr<ScanToScanOdometry>;
+
+} // namespace rmcl
+
+#endif // RMCL_ODOMETRY_SCAN_TO_SCAN_ODOMETRY_HPP
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Place recognition database
+ * 
+ * Place descriptors of scans simulated at poses over the map. 
+ * Create it with the map_to_place_db tool. The file is memory mapped
+ * and the descriptors are indexed with a FeatureKdTree, so a live scan 
+ * is turned into candidate poses without scoring poses one by one.
+ * 
+ * Layout (little endian, all offsets from file start, 64 byte aligned):
+ * - PlaceDatabaseHeader
+ * - poses (rm::Transform)
+ * - descriptors (float, n_places x rings * harmonics)
+ * - sector keys (float, n_places x sectors)
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_PLACE_RECOGNITION_PLACE_DATABASE_HPP
+#define RMCL_PLACE_RECOGNITION_PLACE_DATABASE_HPP
+
+#include <rmagine/types/Memory.hpp>
+#include <rmagine/math/types.h>
+
+#include <rmcl/place_recognition/PlaceDescriptor.hpp>
+#include <rmcl/spatial/FeatureKdTree.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rmcl
+{
+
+static constexpr char     PLACE_DB_MAGIC[8] = {'R', 'M', 'C', 'L', 'P', 'L', 'D', 'B'};
+static constexpr uint32_t PLACE_DB_VERSION = 1;
+static constexpr size_t   PLACE_DB_ALIGNMENT = 64;
+
+struct PlaceDatabaseHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t n_places;
+    // descriptor parameters
+    uint32_t rings;
+    uint32_t sectors;
+    uint32_t harmonics;
+    float    max_range;
+    float    min_z;
+    float    max_z;
+    uint64_t poses_offset;
+    uint64_t descriptors_offset;
+    uint64_t sector_keys_offset;
+};
+
+/**
+ * @brief Places as they are written to a database file
+ */
+struct PlaceDatabaseData
+{
+    PlaceDescriptorParams params;
+    rmagine::Memory<rmagine::Transform, rmagine::RAM> poses;
+    rmagine::Memory<float, rmagine::RAM> descriptors;
+    rmagine::Memory<float, rmagine::RAM> sector_keys;
+};
+
+struct PlaceCandidate
+{
+    // pose of the place rotated by the yaw of the sector key alignment
+    rmagine::Transform Tbm;
+    KdIndex place_id;
+    // squared distance of the descriptors
+    float descriptor_dist;
+    // mean squared difference of the aligned sector keys
+    float sector_dist;
+};
+
+/**
+ * @brief Read-only, memory mapped place database
+ */
+class PlaceDatabase
+{
+public:
+    /**
+     * @brief Maps the file into memory and indexes the descriptors. Throws 
+     * std::runtime_error if the file cannot be opened or is no place database
+     */
+    PlaceDatabase(const std::string& filename);
+
+    ~PlaceDatabase();
+
+    PlaceDatabase(const PlaceDatabase&) = delete;
+    PlaceDatabase& operator=(const PlaceDatabase&) = delete;
+
+    inline const PlaceDescriptorParams& params() const
+    {
+        return m_params;
+    }
+
+    inline const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& poses() const
+    {
+        return m_poses;
+    }
+
+    inline size_t size() const
+    {
+        return m_poses.size();
+    }
+
+    inline const std::string& filename() const
+    {
+        return m_filename;
+    }
+
+    /**
+     * @brief Up to k candidate poses for a scan in base coordinates, 
+     * most similar first
+     */
+    void query(
+        const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& points,
+        unsigned int k,
+        std::vector<PlaceCandidate>& candidates) const;
+
+private:
+    std::string m_filename;
+    int         m_fd = -1;
+    uint8_t*    m_data = nullptr;
+    size_t      m_size = 0;
+
+    PlaceDescriptorParams m_params;
+    rmagine::MemoryView<rmagine::Transform, rmagine::RAM> m_poses;
+    const float* m_descriptors = nullptr;
+    const float* m_sector_keys = nullptr;
+
+    FeatureKdTreePtr m_tree;
+};
+
+using PlaceDatabasePtr = std::shared_ptr<PlaceDatabase>;
+
+/**
+ * @brief Writes places to a database file. Throws std::runtime_error on failure
+ */
+void write_place_database(
+    const std::string& filename,
+    const PlaceDatabaseData& data);
+
+} // namespace rmcl
+
+#endif // RMCL_PLACE_RECOGNITION_PLACE_DATABASE_HPP
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Builds a place database from scans simulated in an Embree map
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_PLACE_RECOGNITION_PLACE_DATABASE_EMBREE_HPP
+#define RMCL_PLACE_RECOGNITION_PLACE_DATABASE_EMBREE_HPP
+
+#include <rmagine/map/EmbreeMap.hpp>
+#include <rmagine/types/sensor_models.h>
+#include <rmagine/math/types.h>
+
+#include <rmcl/place_recognition/PlaceDatabase.hpp>
+
+#include <vector>
+
+namespace rmcl
+{
+
+/**
+ * @brief Simulates one scan per pose and computes its place descriptor
+ * 
+ * @param Tbms poses of the base in the map
+ * @param model sensor model of the simulated scans
+ * @param Tsb sensor to base
+ * @param batch_size poses simulated at once
+ */
+PlaceDatabaseData build_place_database(
+    const rmagine::EmbreeMapPtr& map,
+    const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
+    const rmagine::SphericalModel& model,
+    const rmagine::Transform& Tsb,
+    const PlaceDescriptorParams& params,
+    size_t batch_size = 256);
+
+} // namespace rmcl
+
+#endif // RMCL_PLACE_RECOGNITION_PLACE_DATABASE_EMBREE_HPP
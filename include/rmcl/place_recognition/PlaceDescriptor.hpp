@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Rotation invariant place descriptors of range scans
+ * 
+ * The xy-plane around the robot is split into rings (range) and 
+ * sectors (bearing). A cell is occupied if any point falls into it.
+ * 
+ * - Descriptor: per ring the magnitudes of the first harmonics of 
+ *   the occupancy along the sectors. A yaw rotation of the robot 
+ *   circularly shifts the sectors and leaves the magnitudes unchanged
+ * - Sector key: occupied rings per sector. Not rotation invariant, 
+ *   used to estimate the yaw between two scans of the same place
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_PLACE_RECOGNITION_PLACE_DESCRIPTOR_HPP
+#define RMCL_PLACE_RECOGNITION_PLACE_DESCRIPTOR_HPP
+
+#include <rmagine/types/Memory.hpp>
+#include <rmagine/math/types.h>
+
+#include <limits>
+
+namespace rmcl {
+
+struct PlaceDescriptorParams {
+    unsigned int rings = 20;
+    unsigned int sectors = 60;
+    // harmonics per ring. The 0th is the occupied fraction of the ring
+    unsigned int harmonics = 3;
+    float max_range = 40.0;
+    // height band in base coordinates. Removes floor and ceiling
+    float min_z = std::numeric_limits<float>::lowest();
+    float max_z = std::numeric_limits<float>::max();
+
+    inline unsigned int descriptorSize() const
+    {
+        return rings * harmonics;
+    }
+};
+
+/**
+ * @brief Descriptor and sector key of a scan in base coordinates
+ * 
+ * @param descriptor params.descriptorSize() floats
+ * @param sector_key params.sectors floats
+ */
+void compute_place_descriptor(
+    const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& points,
+    const PlaceDescriptorParams& params,
+    float* descriptor,
+    float* sector_key);
+
+/**
+ * @brief Yaw of the base of scan b relative to the base of scan a, 
+ * found by aligning the sector keys over all circular shifts
+ * 
+ * @param dist mean squared difference of the aligned keys
+ */
+float sector_key_yaw(
+    const float* sector_key_a,
+    const float* sector_key_b,
+    unsigned int sectors,
+    float& dist);
+
+} // namespace rmcl
+
+#endif // RMCL_PLACE_RECOGNITION_PLACE_DESCRIPTOR_HPP
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Result set of the kd-tree queries. The k nearest neighbors
+ * within a maximum squared distance, kept sorted in caller provided 
+ * buffers. Fulfills the nanoflann result set interface.
+ * 
+ * nanoflann's KNNResultSet has no distance bound and its 
+ * RadiusResultSet allocates.
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_SPATIAL_BOUNDED_KNN_RESULT_SET_HPP
+#define RMCL_SPATIAL_BOUNDED_KNN_RESULT_SET_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rmcl
+{
+
+template<typename IndexT>
+class BoundedKnnResultSet
+{
+public:
+    BoundedKnnResultSet(
+        unsigned int capacity,
+        float max_dist_sq,
+        IndexT* ids,
+        float* dists_sq)
+    :m_capacity(capacity)
+    ,m_count(0)
+    ,m_max_dist_sq(max_dist_sq)
+    ,m_ids(ids)
+    ,m_dists_sq(dists_sq)
+    {
+
+    }
+
+    inline size_t size() const
+    {
+        return m_count;
+    }
+
+    inline bool empty() const
+    {
+        return m_count == 0;
+    }
+
+    inline bool full() const
+    {
+        return m_count == m_capacity;
+    }
+
+    inline bool addPoint(float dist_sq, IndexT id)
+    {
+        if(dist_sq > worstDist())
+        {
+            return true;
+        }
+
+        // insertion sort from the back
+        unsigned int i = (full() ? m_count - 1 : m_count);
+        for(; i > 0 && m_dists_sq[i - 1] > dist_sq; i--)
+        {
+            m_ids[i] = m_ids[i - 1];
+            m_dists_sq[i] = m_dists_sq[i - 1];
+        }
+        m_ids[i] = id;
+        m_dists_sq[i] = dist_sq;
+
+        if(!full())
+        {
+            m_count++;
+        }
+        return true;
+    }
+
+    inline float worstDist() const
+    {
+        return full() ? m_dists_sq[m_capacity - 1] : m_max_dist_sq;
+    }
+
+private:
+    unsigned int m_capacity;
+    unsigned int m_count;
+    float m_max_dist_sq;
+    IndexT* m_ids;
+    float* m_dists_sq;
+};
+
+} // namespace rmcl
+
+#endif // RMCL_SPATIAL_BOUNDED_KNN_RESULT_SET_HPP
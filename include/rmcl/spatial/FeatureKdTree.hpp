@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief FeatureKdTree. kd-tree over feature vectors of runtime dimension
+ * 
+ * The features are rows of a flat, row-major float array that is 
+ * not copied, e.g. the descriptors of a memory mapped file. The 
+ * caller keeps the array alive as long as the tree.
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_SPATIAL_FEATURE_KDTREE_HPP
+#define RMCL_SPATIAL_FEATURE_KDTREE_HPP
+
+#include <rmcl/spatial/KdTree.hpp>
+#include <nanoflann.hpp>
+
+#include <memory>
+
+namespace rmcl {
+
+class KdFeatures
+{
+public:
+    KdFeatures(const float* data, size_t n_features, unsigned int dim)
+    :m_data(data)
+    ,m_n(n_features)
+    ,m_dim(dim)
+    {
+
+    }
+
+    inline size_t kdtree_get_point_count() const {
+        return m_n;
+    }
+
+    inline float kdtree_get_pt(const size_t idx, const size_t dim) const
+    {
+        return m_data[idx * m_dim + dim];
+    }
+
+    template <class BBOX>
+    bool kdtree_get_bbox(BBOX& /* bb */) const { return false; }
+
+    inline const float* feature(size_t idx) const
+    {
+        return m_data + idx * m_dim;
+    }
+
+    inline unsigned int dim() const
+    {
+        return m_dim;
+    }
+
+    const float* m_data;
+    size_t m_n;
+    unsigned int m_dim;
+};
+
+using KdFeaturesPtr = std::shared_ptr<KdFeatures>;
+
+class FeatureKdTree : public nanoflann::KDTreeSingleIndexAdaptor<
+        nanoflann::L2_Simple_Adaptor<float, KdFeatures> ,
+        KdFeatures, -1 /* dim */, KdIndex>
+{
+public:
+    using Super = nanoflann::KDTreeSingleIndexAdaptor<
+        nanoflann::L2_Simple_Adaptor<float, KdFeatures> ,
+        KdFeatures, -1 /* dim */, KdIndex>;
+
+    FeatureKdTree(KdFeaturesPtr features, unsigned int leaf_size = 10);
+
+    /**
+     * @brief k nearest features, sorted by distance. Distances are squared
+     * 
+     * @param query dim() floats
+     * @param ids k
+     * @param dists_sq k
+     * @return number of neighbors found (< k if the tree is smaller)
+     */
+    unsigned int knn(
+        const float* query,
+        unsigned int k,
+        KdIndex* ids,
+        float* dists_sq) const;
+
+    inline unsigned int dim() const
+    {
+        return m_features->dim();
+    }
+
+    const KdFeaturesPtr dataset() const
+    {
+        return m_features;
+    }
+
+protected:
+    KdFeaturesPtr m_features;
+};
+
+using FeatureKdTreePtr = std::shared_ptr<FeatureKdTree>;
+
+} // namespace rmcl
+
+#endif // RMCL_SPATIAL_FEATURE_KDTREE_HPP
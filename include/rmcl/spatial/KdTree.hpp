@@ -40,6 +40,9 @@
 #include <rmagine/math/types.h>
 #include <nanoflann.hpp>
 #include <memory>
+#include <stdexcept>
+#include <cstdint>
+#include <limits>
 
 #include <vector>
 
@@ -83,36 +86,116 @@ public:
 
 using KdPointsPtr = std::shared_ptr<KdPoints>;
 
+// nanoflann >= 1.5
+using KdIndex = uint32_t;
+using KdResultItem = nanoflann::ResultItem<KdIndex, float>;
+constexpr KdIndex KD_INVALID_ID = std::numeric_limits<KdIndex>::max();
+
 class KdTree : public nanoflann::KDTreeSingleIndexAdaptor<
 		nanoflann::L2_Simple_Adaptor<float, KdPoints > ,
-		KdPoints, 3 /* dim */>
+		KdPoints, 3 /* dim */, KdIndex>
 {
 public:
     using Super = nanoflann::KDTreeSingleIndexAdaptor<
 		nanoflann::L2_Simple_Adaptor<float, KdPoints > ,
-		KdPoints, 3 /* dim */ >;
+		KdPoints, 3 /* dim */, KdIndex>;
 
     KdTree(KdPointsPtr points);
 
+    /**
+     * @brief Parameters of all queries. eps > 0 allows approximate
+     * nearest neighbors
+     */
+    inline void setSearchParameters(const nanoflann::SearchParameters& params)
+    {
+        m_search_params = params;
+    }
+
+    /**
+     * @return nearest point. Infinite if the tree has none
+     */
     rmagine::Vector nearest(
         const rmagine::Vector& query_point,
         bool query_in_index = false) const;
 
+    /**
+     * @return squared distance to the nearest point. Infinity if the 
+     * tree has none
+     */
     float nearestDist(
         const rmagine::Vector& query_point,
         bool query_in_index = false) const;
 
+    /**
+     * @return id of the nearest point. KD_INVALID_ID if the tree has none
+     */
     size_t nearestId(
         const rmagine::Vector& query_point,
         bool query_in_index = false) const;
 
+    // BATCHED QUERIES
+    // Queries run in parallel and write into preallocated buffers.
+    // Distances are squared. Unused slots get the id KD_INVALID_ID
+
+    /**
+     * @brief Nearest point per query. With query_in_index the queries 
+     * are points of the tree and the point itself is skipped
+     * 
+     * @param ids N
+     * @param dists_sq N
+     */
+    void nearest(
+        const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& queries,
+        rmagine::MemoryView<KdIndex, rmagine::RAM>& ids,
+        rmagine::MemoryView<float, rmagine::RAM>& dists_sq,
+        bool query_in_index = false) const;
+
+    /**
+     * @brief k nearest points per query, sorted by distance
+     * 
+     * @param ids N*k. Neighbors of query i start at i*k
+     * @param dists_sq N*k
+     * @param counts N. Number of neighbors found (< k if the tree is smaller)
+     */
+    void knn(
+        const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& queries,
+        unsigned int k,
+        rmagine::MemoryView<KdIndex, rmagine::RAM>& ids,
+        rmagine::MemoryView<float, rmagine::RAM>& dists_sq,
+        rmagine::MemoryView<unsigned int, rmagine::RAM>& counts) const;
+
+    /**
+     * @brief Up to max_neighbors nearest points within search_radius per query, 
+     * sorted by distance
+     * 
+     * @param ids N*max_neighbors. Neighbors of query i start at i*max_neighbors
+     * @param dists_sq N*max_neighbors
+     * @param counts N
+     */
+    void radius(
+        const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& queries,
+        float search_radius,
+        unsigned int max_neighbors,
+        rmagine::MemoryView<KdIndex, rmagine::RAM>& ids,
+        rmagine::MemoryView<float, rmagine::RAM>& dists_sq,
+        rmagine::MemoryView<unsigned int, rmagine::RAM>& counts) const;
+
     const KdPointsPtr dataset() const
     {
         return m_points;
     }
 
 protected:
+    // k nearest within max_dist_sq into ids/dists_sq (capacity k)
+    unsigned int search(
+        const rmagine::Vector& query_point,
+        unsigned int k,
+        float max_dist_sq,
+        KdIndex* ids,
+        float* dists_sq) const;
+
     KdPointsPtr m_points;
+    nanoflann::SearchParameters m_search_params;
 };
 
 using KdTreePtr = std::shared_ptr<KdTree>;
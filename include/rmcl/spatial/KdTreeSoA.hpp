@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief KdTreeSoA. 3D kd-tree that owns its points
+ * 
+ * - Points are stored per coordinate (SoA) in tree order, so leaves
+ *   are contiguous and scanned without indirection
+ * - Median split along the dimension of largest extent. Subtrees are 
+ *   built in parallel with OpenMP tasks
+ * - build() can be called again for every new cloud. Buffers only 
+ *   grow, a rebuild of the same size does not allocate
+ * - Same query API as KdTree. Returned ids refer to the order of the 
+ *   input points
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_SPATIAL_KDTREE_SOA_HPP
+#define RMCL_SPATIAL_KDTREE_SOA_HPP
+
+#include <rmagine/types/Memory.hpp>
+#include <rmagine/math/types.h>
+#include <rmcl/spatial/KdTree.hpp>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace rmcl
+{
+
+class KdTreeSoA
+{
+public:
+    KdTreeSoA(unsigned int leaf_size = 16);
+
+    KdTreeSoA(
+        const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& points,
+        unsigned int leaf_size = 16);
+
+    /**
+     * @brief (Re)builds the tree from a copy of the points
+     */
+    void build(const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& points);
+
+    inline size_t size() const
+    {
+        return m_ids.size();
+    }
+
+    /**
+     * @brief Point by its input id
+     */
+    rmagine::Vector point(size_t id) const;
+
+    size_t nearestId(
+        const rmagine::Vector& query_point,
+        bool query_in_index = false) const;
+
+    // BATCHED QUERIES. See KdTree
+
+    void nearest(
+        const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& queries,
+        rmagine::MemoryView<KdIndex, rmagine::RAM>& ids,
+        rmagine::MemoryView<float, rmagine::RAM>& dists_sq,
+        bool query_in_index = false) const;
+
+    void knn(
+        const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& queries,
+        unsigned int k,
+        rmagine::MemoryView<KdIndex, rmagine::RAM>& ids,
+        rmagine::MemoryView<float, rmagine::RAM>& dists_sq,
+        rmagine::MemoryView<unsigned int, rmagine::RAM>& counts) const;
+
+    void radius(
+        const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& queries,
+        float search_radius,
+        unsigned int max_neighbors,
+        rmagine::MemoryView<KdIndex, rmagine::RAM>& ids,
+        rmagine::MemoryView<float, rmagine::RAM>& dists_sq,
+        rmagine::MemoryView<unsigned int, rmagine::RAM>& counts) const;
+
+private:
+    struct Node
+    {
+        // points [begin, end) in tree order
+        KdIndex begin;
+        KdIndex end;
+        // the left child directly follows its parent
+        KdIndex right;
+        float split;
+        uint8_t dim;
+        bool leaf;
+    };
+
+    size_t numNodes(size_t n_points) const;
+
+    void buildNode(
+        const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& points,
+        size_t node_id, size_t begin, size_t end);
+
+    unsigned int search(
+        const rmagine::Vector& query_point,
+        unsigned int k,
+        float max_dist_sq,
+        KdIndex* ids,
+        float* dists_sq) const;
+
+    unsigned int m_leaf_size;
+
+    std::vector<Node> m_nodes;
+    // coordinates in tree order
+    std::array<std::vector<float>, 3> m_pts;
+    // tree order -> input id
+    std::vector<KdIndex> m_ids;
+    // input id -> tree order
+    std::vector<KdIndex> m_order;
+};
+
+using KdTreeSoAPtr = std::shared_ptr<KdTreeSoA>;
+
+} // namespace rmcl
+
+#endif // RMCL_SPATIAL_KDTREE_SOA_HPP
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Checkpoints of the localization state
+ * 
+ * A small text file with the last odom -> map estimate, the adapted 
+ * correction parameters of every sensor and the identity of the map 
+ * (path, size, modification time). After a restart the node resumes 
+ * from it if the map is still the same, instead of waiting for a new 
+ * pose guess.
+ * 
+ * Files are written to a temporary file first and then renamed, so a 
+ * crash during writing never leaves a broken checkpoint behind.
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_UTIL_CHECKPOINT_H
+#define RMCL_UTIL_CHECKPOINT_H
+
+#include <rmagine/math/types.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace rmcl
+{
+
+/**
+ * @brief Identifies a map file without reading it
+ */
+struct MapIdentity
+{
+    std::string file;
+    uint64_t    size = 0;
+    // modification time, nanoseconds since epoch
+    int64_t     mtime = 0;
+
+    inline bool operator==(const MapIdentity& other) const
+    {
+        return file == other.file && size == other.size && mtime == other.mtime;
+    }
+
+    inline bool operator!=(const MapIdentity& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+struct LocalizationCheckpoint
+{
+    MapIdentity map;
+    std::string map_frame;
+
+    // odom -> map
+    rmagine::Transform Tom;
+
+    // sensor name -> corr_params.max_distance
+    std::unordered_map<std::string, float> max_distances;
+
+    // wall time of writing, seconds since epoch
+    double stamp = 0.0;
+};
+
+/**
+ * @brief Identity of a map file. size and mtime are 0 if it does not exist
+ */
+MapIdentity map_identity(const std::string& filename);
+
+/**
+ * @brief Writes the checkpoint atomically (temporary file + rename)
+ * 
+ * @return false if the file could not be written
+ */
+bool save_checkpoint(
+    const std::string& filename,
+    const LocalizationCheckpoint& checkpoint);
+
+/**
+ * @return false if the file does not exist or is not a valid checkpoint
+ */
+bool load_checkpoint(
+    const std::string& filename,
+    LocalizationCheckpoint& checkpoint);
+
+} // namespace rmcl
+
+#endif // RMCL_UTIL_CHECKPOINT_H
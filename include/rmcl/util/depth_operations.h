@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Conversions of depth images to ranges
+ * 
+ * Depth images store the z-coordinate (optical frame) of each pixel 
+ * instead of the range along the ray. Converting requires a division 
+ * by the z-component of the ray direction per pixel. The direction only 
+ * depends on the camera model, so the inverse is precomputed once per
+ * model in a scale table.
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_UTIL_DEPTH_OPERATIONS_H
+#define RMCL_UTIL_DEPTH_OPERATIONS_H
+
+#include <rmagine/types/Memory.hpp>
+#include <rmagine/types/sensor_models.h>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace rmcl
+{
+
+/**
+ * @brief Computes the per-pixel factor from depth to range
+ * 
+ * - optical: scale = 1 / dir.z
+ * - else:    scale = 1 / dir.x
+ * 
+ * @param model     pinhole model
+ * @param optical   true if the directions are in optical coordinates
+ * @param scales    output. size: model.size()
+ */
+void depth_scale_table(
+    const rmagine::PinholeModel& model,
+    bool optical,
+    rmagine::MemoryView<float, rmagine::RAM>& scales);
+
+/**
+ * @brief Check if two pinhole models produce the same scale table
+ */
+bool depth_scale_table_equal(
+    const rmagine::PinholeModel& a,
+    const rmagine::PinholeModel& b);
+
+/**
+ * @brief Check if an image buffer holds height rows of 'step' bytes,
+ *   each wide enough for width pixels of bytes_per_pixel
+ * 
+ * Call before the depth_to_ranges_* conversions, which trust step
+ * 
+ * @param data_size size of the image buffer in bytes
+ */
+bool depth_image_layout_valid(
+    unsigned int width,
+    unsigned int height,
+    unsigned int step,
+    unsigned int bytes_per_pixel,
+    size_t data_size);
+
+/**
+ * @brief Converts a 32FC1 depth image (meters) to ranges
+ * 
+ * @param data      first byte of the image
+ * @param step      bytes per image row
+ * @param big_endian byte order of the image (is_bigendian)
+ * @param scales    scale table of depth_scale_table
+ * @param ranges    output. width x height
+ */
+void depth_to_ranges_32FC1(
+    const uint8_t* data,
+    unsigned int width,
+    unsigned int height,
+    unsigned int step,
+    bool big_endian,
+    const rmagine::MemoryView<float, rmagine::RAM>& scales,
+    rmagine::MemoryView<float, rmagine::RAM>& ranges);
+
+/**
+ * @brief Converts a 16UC1 depth image (millimeters) to ranges
+ * 
+ * Pixels with depth 0 (no measurement) are set to 'invalid'
+ * 
+ * @param data      first byte of the image
+ * @param step      bytes per image row
+ * @param big_endian byte order of the image (is_bigendian)
+ * @param scales    scale table of depth_scale_table
+ * @param invalid   range of invalid pixels
+ * @param ranges    output. width x height
+ */
+void depth_to_ranges_16UC1(
+    const uint8_t* data,
+    unsigned int width,
+    unsigned int height,
+    unsigned int step,
+    bool big_endian,
+    const rmagine::MemoryView<float, rmagine::RAM>& scales,
+    float invalid,
+    rmagine::MemoryView<float, rmagine::RAM>& ranges);
+
+} // namespace rmcl
+
+#endif // RMCL_UTIL_DEPTH_OPERATIONS_H
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2022, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * 
+ * @brief Bounds checks for arrays in memory mapped files
+ * 
+ * Offsets and counts read from a file header are untrusted. A truncated
+ * or corrupt file must not lead to reads outside of the mapping or to 
+ * misaligned arrays.
+ *
+ * @date 19.10.2026
+ * 
+ * @copyright Copyright (c) 2022, University Osnabrück. All rights reserved.
+ * This project is released under the 3-Clause BSD License.
+ * 
+ */
+
+#ifndef RMCL_UTIL_MAPPED_FILE_H
+#define RMCL_UTIL_MAPPED_FILE_H
+
+#include <cstdint>
+
+namespace rmcl
+{
+
+/**
+ * @brief Checks without overflow that 'count' elements of type T at 'offset' 
+ * lie inside a file of 'file_size' bytes and that offset is aligned for T
+ */
+template<typename T>
+inline bool mapped_array_valid(
+    uint64_t offset, 
+    uint64_t count, 
+    uint64_t file_size)
+{
+    if(offset % alignof(T) != 0 || offset > file_size)
+    {
+        return false;
+    }
+    return count <= (file_size - offset) / sizeof(T);
+}
+
+} // namespace rmcl
+
+#endif // RMCL_UTIL_MAPPED_FILE_H
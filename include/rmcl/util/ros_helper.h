@@ -9,7 +9,7 @@ namespace rmcl
 
 // special case for char arrays to be converted properly
 static std::string get_parameter(
-    rclcpp::Node::SharedPtr node,
+    rclcpp::Node* node,
     const std::string param_name,
     const std::string default_value)
 {
@@ -25,7 +25,7 @@ static std::string get_parameter(
 
 template<typename T> 
 static T get_parameter(
-    rclcpp::Node::SharedPtr node, 
+    rclcpp::Node* node, 
     const std::string& param_name,
     const T& default_value)
 {
@@ -39,6 +39,23 @@ static T get_parameter(
     return param_out;
 }
 
+static std::string get_parameter(
+    rclcpp::Node::SharedPtr node,
+    const std::string param_name,
+    const std::string default_value)
+{
+    return get_parameter(node.get(), param_name, default_value);
+}
+
+template<typename T> 
+static T get_parameter(
+    rclcpp::Node::SharedPtr node, 
+    const std::string& param_name,
+    const T& default_value)
+{
+    return get_parameter<T>(node.get(), param_name, default_value);
+}
+
 static std::optional<rclcpp::Parameter> get_parameter(
     rclcpp::Node::SharedPtr node, 
     const std::string& param_name)
@@ -128,7 +145,7 @@ public:
 };
 
 inline ParamTree<rclcpp::Parameter>::SharedPtr get_parameter_tree(
-    rclcpp::Node::SharedPtr node,
+    rclcpp::Node* node,
     std::string prefix)
 {
     ParamTree<rclcpp::Parameter>::SharedPtr ret;
@@ -146,6 +163,13 @@ inline ParamTree<rclcpp::Parameter>::SharedPtr get_parameter_tree(
     return ret;
 }
 
+inline ParamTree<rclcpp::Parameter>::SharedPtr get_parameter_tree(
+    rclcpp::Node::SharedPtr node,
+    std::string prefix)
+{
+    return get_parameter_tree(node.get(), prefix);
+}
+
 } // namespace rmcl
 
 #endif // RMCL_UTIL_ROS_HELPER_H
\ No newline at end of file
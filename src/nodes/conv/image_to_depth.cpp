@@ -3,163 +3,198 @@
 #include <sensor_msgs/msg/point_cloud.hpp>
 #include <sensor_msgs/msg/camera_info.hpp>
 #include <rmcl/util/conversions.h>
+#include <rmcl/util/depth_operations.h>
 #include <rmcl_msgs/msg/depth_stamped.hpp>
-#include <image_transport/image_transport.hpp>
 
-using namespace rmagine;
-using namespace rmcl;
+namespace rm = rmagine;
 
-sensor_msgs::msg::CameraInfo info;
-ros::Publisher pub_depth;
-ros::Publisher pub_cloud;
-image_transport::Publisher pub_image;
+namespace rmcl
+{
+
+class ImageToDepthNode : public rclcpp::Node
+{
+public:
+  explicit ImageToDepthNode(const rclcpp::NodeOptions& options = rclcpp::NodeOptions())
+  :rclcpp::Node("image_to_depth_node", options)
+  {
+    pub_depth_ = this->create_publisher<rmcl_msgs::msg::DepthStamped>(
+      "depth", 1);
+    pub_cloud_ = this->create_publisher<sensor_msgs::msg::PointCloud>(
+      "depth_cloud", 1);
 
-void convert(
+    // two options: either use fixed parameters from yaml or use camera info topic
+    sub_info_ = this->create_subscription<sensor_msgs::msg::CameraInfo>(
+      "info", 1,
+      [=](const sensor_msgs::msg::CameraInfo::ConstSharedPtr& msg) -> void
+      {
+        info_ = *msg;
+      });
+
+    sub_image_ = this->create_subscription<sensor_msgs::msg::Image>(
+      "image", 1,
+      [=](const sensor_msgs::msg::Image::ConstSharedPtr& msg) -> void
+      {
+        imageCB(msg);
+      });
+  }
+
+private:
+
+  void convert(
     const rmcl_msgs::msg::DepthStamped& from,
     sensor_msgs::msg::PointCloud& to,
-    bool optical = true)
-{
-    PinholeModel model;
-    convert(from.depth.info, model);
+    bool optical = true) const
+  {
+    rm::PinholeModel model;
+    rmcl::convert(from.depth.info, model);
 
     for(unsigned int vid = 0; vid < model.getHeight(); vid++)
     {
-        for(unsigned int hid = 0; hid < model.getWidth(); hid++)
+      for(unsigned int hid = 0; hid < model.getWidth(); hid++)
+      {
+        const unsigned int loc_id = model.getBufferId(vid, hid);
+        const float range = from.depth.data.ranges[loc_id];
+
+        if(model.range.inside(range))
         {
-            const unsigned int loc_id = model.getBufferId(vid, hid);
-            const float range = from.depth.data.ranges[loc_id];
-
-            if(model.range.inside(range))
-            {
-                Vector dir;
-
-                if(optical)
-                {
-                    dir = model.getDirectionOptical(vid, hid);
-                } else {
-                    dir = model.getDirection(vid, hid);
-                }
-
-                // dir /= dir.z;
-                Vector p = dir * range;
-                geometry_msgs::msg::Point32 p_ros;
-                p_ros.x = p.x;
-                p_ros.y = p.y;
-                p_ros.z = p.z;
-                to.points.push_back(p_ros);
-            }
+          rm::Vector dir;
+
+          if(optical)
+          {
+            dir = model.getDirectionOptical(vid, hid);
+          } else {
+            dir = model.getDirection(vid, hid);
+          }
+
+          // dir /= dir.z;
+          rm::Vector p = dir * range;
+          geometry_msgs::msg::Point32 p_ros;
+          p_ros.x = p.x;
+          p_ros.y = p.y;
+          p_ros.z = p.z;
+          to.points.push_back(p_ros);
         }
+      }
     }
 
     to.header.frame_id = from.header.frame_id;
     to.header.stamp = from.header.stamp;
-}
-
+  }
 
-void convert(
-    const sensor_msgs::msg::Image::ConstPtr& from,
+  void convert(
+    const sensor_msgs::msg::Image::ConstSharedPtr& from,
     rmcl_msgs::msg::Depth& to)
-{
-    
-    PinholeModel model;
-    convert(info, model);
-
-    unsigned int bytes = from->step / from->width;
+  {
+    rm::PinholeModel model;
+    rmcl::convert(info_, model);
 
+    unsigned int bytes_per_pixel = 0;
     if(from->encoding == "32FC1")
     {
-        if(bytes != 4)
-        {
-            std::cout << "32FC1 should have 4 bytes. Calculated " << bytes << std::endl;
-        }
+      bytes_per_pixel = sizeof(float);
+    } else if(from->encoding == "16UC1" || from->encoding == "mono16") {
+      bytes_per_pixel = sizeof(uint16_t);
+    } else {
+      RCLCPP_WARN_STREAM(this->get_logger(), "Could not convert image of encoding " << from->encoding);
+      to.data.ranges.resize(0);
+      return;
+    }
 
-        // Problem: 
-        // floating point value in pixel is not the range in meters!
-        // it is the scale of the camera vector intersecting the pixel
-        // with z=1
-        // the solution to that is in the for loop
-        // -- Tested on simulated depth images --
-        to.data.ranges.resize(from->width * from->height);
-        for(unsigned int vid = 0; vid < model.getHeight(); vid++)
-        {
-            for(unsigned int hid = 0; hid < model.getWidth(); hid++)
-            {
-                unsigned int loc_id = model.getBufferId(vid, hid);
-                const float wrong_range = *reinterpret_cast<const float*>(&from->data[loc_id * sizeof(float)]);
-                Vector dir = model.getDirectionOptical(vid, hid);
-                const float real_range = wrong_range / dir.z;
-                to.data.ranges[loc_id] = real_range;
-            }
-        }
-        
+    if(from->width != model.getWidth() || from->height != model.getHeight())
+    {
+      RCLCPP_WARN_STREAM(this->get_logger(), "Image size " << from->width << "x" << from->height
+        << " does not match the camera info " << model.getWidth() << "x" << model.getHeight());
+      to.data.ranges.resize(0);
+      return;
+    }
+
+    if(!depth_image_layout_valid(from->width, from->height, from->step,
+      bytes_per_pixel, from->data.size()))
+    {
+      RCLCPP_WARN_STREAM(this->get_logger(), "Dropping image: step " << from->step
+        << " and data size " << from->data.size() << " do not fit "
+        << from->width << "x" << from->height << " " << from->encoding);
+      to.data.ranges.resize(0);
+      return;
+    }
+
+    // Problem:
+    // floating point value in pixel is not the range in meters!
+    // it is the scale of the camera vector intersecting the pixel
+    // with z=1
+    // -- Tested on simulated depth images --
+    if(depth_scales_.size() != model.size()
+      || !depth_scale_table_equal(depth_scales_model_, model))
+    {
+      depth_scales_.resize(model.size());
+      depth_scale_table(model, true, depth_scales_);
+      depth_scales_model_ = model;
+    }
+
+    to.data.ranges.resize(from->width * from->height);
+    rm::MemoryView<float, rm::RAM> ranges(to.data.ranges.data(), to.data.ranges.size());
+
+    if(from->encoding == "32FC1")
+    {
+      depth_to_ranges_32FC1(from->data.data(),
+        from->width, from->height, from->step, from->is_bigendian,
+        depth_scales_, ranges);
     } else {
-        ROS_WARN_STREAM("Could not convert image of encoding " << from->encoding);
-        // pub_image.publish(from);
+      depth_to_ranges_16UC1(from->data.data(),
+        from->width, from->height, from->step, from->is_bigendian,
+        depth_scales_, to.info.range_max + 1.0, ranges);
     }
-}
+  }
 
-void convert(
-    const sensor_msgs::msg::CameraInfo& info,
-    const sensor_msgs::msg::Image::ConstPtr& dimage,
+  void convert(
+    const sensor_msgs::msg::Image::ConstSharedPtr& dimage,
     rmcl_msgs::msg::DepthStamped& depth)
-{
-    if(dimage->header.frame_id != info.header.frame_id)
+  {
+    if(dimage->header.frame_id != info_.header.frame_id)
     {
-        ROS_WARN("Cloud and Camera info are not in same frame");
+      RCLCPP_WARN(this->get_logger(), "Image and Camera info are not in same frame");
     }
 
     depth.header.stamp = dimage->header.stamp;
     depth.header.frame_id = dimage->header.frame_id;
-    convert(info, depth.depth.info);
-    
+    rmcl::convert(info_, depth.depth.info);
+
     // manual setting range limits
     depth.depth.info.range_min = 0.3;
     depth.depth.info.range_max = 8.0;
 
     convert(dimage, depth.depth);
-}
-
-void infoCB(const sensor_msgs::msg::CameraInfo::ConstPtr& msg)
-{
-    info = *msg;
-}
+  }
 
-void imageCB(const sensor_msgs::msg::Image::ConstPtr& msg)
-{
+  void imageCB(const sensor_msgs::msg::Image::ConstSharedPtr& msg)
+  {
     rmcl_msgs::msg::DepthStamped out;
-    
-    convert(info, msg, out);
+    convert(msg, out);
 
     if(out.depth.data.ranges.size() > 0)
     {
-        // std::cout << "Publish " << out.depth.ranges.size() << " points." << std::endl;
-        pub_depth.publish(out);
+      pub_depth_->publish(out);
 
-        sensor_msgs::msg::PointCloud out_cloud;
-        convert(out, out_cloud);
-        
-        pub_cloud.publish(out_cloud);
+      sensor_msgs::msg::PointCloud out_cloud;
+      convert(out, out_cloud);
+      pub_cloud_->publish(out_cloud);
     }
-}
-
-int main(int argc, char** argv)
-{
-    ros::init(argc, argv, "image_to_depth");
+  }
 
-    ros::NodeHandle nh;
-    ros::NodeHandle nh_p("~");
+  sensor_msgs::msg::CameraInfo info_;
 
-    image_transport::ImageTransport it(nh);
-    image_transport::Subscriber sub_image = it.subscribe("image", 1, imageCB);
+  // depth to range factors. recomputed if the camera info changes
+  rm::Memory<float, rm::RAM> depth_scales_;
+  rm::PinholeModel depth_scales_model_;
 
-    // two options: either use fixed parameters from yaml or use camera info topic
-    ros::Subscriber sub_info = nh.subscribe<sensor_msgs::msg::CameraInfo>("info", 1, infoCB);
+  rclcpp::Subscription<sensor_msgs::msg::CameraInfo>::SharedPtr sub_info_;
+  rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr sub_image_;
 
-    pub_depth = nh_p.advertise<rmcl_msgs::msg::DepthStamped>("depth", 1);
-    pub_cloud = nh_p.advertise<sensor_msgs::msg::PointCloud>("depth_cloud", 1);
-    pub_image = it.advertise("image_filtered", 1);
+  rclcpp::Publisher<rmcl_msgs::msg::DepthStamped>::SharedPtr pub_depth_;
+  rclcpp::Publisher<sensor_msgs::msg::PointCloud>::SharedPtr pub_cloud_;
+};
 
-    ros::spin();
+} // namespace rmcl
 
-    return 0;
-}
\ No newline at end of file
+#include "rclcpp_components/register_node_macro.hpp"
+RCLCPP_COMPONENTS_REGISTER_NODE(rmcl::ImageToDepthNode)
@@ -0,0 +1,138 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <rmagine/map/AssimpIO.hpp>
+#include <rmagine/util/StopWatch.hpp>
+
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <rmcl/map/MapCache.hpp>
+#include <rmcl/map/MeshSimplification.hpp>
+
+namespace rm = rmagine;
+
+using namespace rmcl;
+
+void print_usage()
+{
+  std::cout << "Usage: map_to_cache <input mesh> <output.rmclmap> [options]" << std::endl;
+  std::cout << "Options:" << std::endl;
+  std::cout << "  --quality <low|medium|high>  BVH build quality (default: medium)" << std::endl;
+  std::cout << "  --compact                    smaller BVH, slightly slower raycasting" << std::endl;
+  std::cout << "  --robust                     robust intersection tests" << std::endl;
+  std::cout << "  --tile-size <meters>         split the map into square xy-tiles for streaming" << std::endl;
+  std::cout << "  --simplify <meters>          write a simplified level of detail map (cell size)" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+  if(argc < 3)
+  {
+    print_usage();
+    return 1;
+  }
+
+  const std::string input = argv[1];
+  const std::string output = argv[2];
+
+  MapBuildHints hints;
+  float tile_size = 0.0;
+  float cell_size = 0.0;
+
+  for(int i=3; i<argc; i++)
+  {
+    const std::string arg = argv[i];
+    if(arg == "--quality" && i + 1 < argc)
+    {
+      const std::string quality = argv[++i];
+      if(quality == "low")
+      {
+        hints.quality = MapBuildQuality::LOW;
+      } else if(quality == "medium") {
+        hints.quality = MapBuildQuality::MEDIUM;
+      } else if(quality == "high") {
+        hints.quality = MapBuildQuality::HIGH;
+      } else {
+        std::cout << "Unknown quality: " << quality << std::endl;
+        return 1;
+      }
+    } else if(arg == "--compact") {
+      hints.compact = true;
+    } else if(arg == "--robust") {
+      hints.robust = true;
+    } else if(arg == "--tile-size" && i + 1 < argc) {
+      tile_size = std::stof(argv[++i]);
+      if(tile_size <= 0.0)
+      {
+        std::cout << "Tile size must be positive" << std::endl;
+        return 1;
+      }
+    } else if(arg == "--simplify" && i + 1 < argc) {
+      cell_size = std::stof(argv[++i]);
+      if(cell_size <= 0.0)
+      {
+        std::cout << "Cell size must be positive" << std::endl;
+        return 1;
+      }
+    } else {
+      std::cout << "Unknown option: " << arg << std::endl;
+      print_usage();
+      return 1;
+    }
+  }
+
+  rm::StopWatch sw;
+  double el;
+
+  sw();
+  rm::AssimpIO io;
+  const aiScene* ascene = io.ReadFile(input, aiProcess_Triangulate);
+  if(!ascene)
+  {
+    std::cout << "Could not load '" << input << "': " << io.GetErrorString() << std::endl;
+    return 1;
+  }
+
+  // node transforms are baked into the vertices
+  std::vector<MapCacheMeshData> meshes = meshes_from_assimp(ascene);
+  el = sw();
+
+  size_t n_faces = 0;
+  for(const MapCacheMeshData& mesh : meshes)
+  {
+    n_faces += mesh.faces.size();
+  }
+  std::cout << "Loaded " << meshes.size() << " meshes with " << n_faces << " faces in " << el << "s" << std::endl;
+
+  if(cell_size > 0.0)
+  {
+    sw();
+    meshes = simplify_meshes(meshes, cell_size);
+    el = sw();
+
+    n_faces = 0;
+    for(const MapCacheMeshData& mesh : meshes)
+    {
+      n_faces += mesh.faces.size();
+    }
+    std::cout << "Simplified to " << n_faces << " faces with " << cell_size << "m cells in " << el << "s" << std::endl;
+  }
+
+  if(tile_size > 0.0)
+  {
+    sw();
+    meshes = split_into_tiles(meshes, tile_size);
+    el = sw();
+    std::cout << "Split into " << meshes.size() << " tiles of " << tile_size << "m in " << el << "s" << std::endl;
+  }
+
+  sw();
+  write_map_cache(output, meshes, hints, tile_size);
+  el = sw();
+
+  std::cout << "Wrote '" << output << "' in " << el << "s" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,182 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include <rmagine/map/AssimpIO.hpp>
+#include <rmagine/util/StopWatch.hpp>
+
+#include <assimp/scene.h>
+
+#include <rmcl/map/MapCache.hpp>
+#include <rmcl/map/MapCacheEmbree.hpp>
+#include <rmcl/correction/RelocalizationEmbree.hpp>
+#include <rmcl/place_recognition/PlaceDatabaseEmbree.hpp>
+
+namespace rm = rmagine;
+
+using namespace rmcl;
+
+void print_usage()
+{
+  std::cout << "Usage: map_to_place_db <input mesh or .rmclmap> <output.rmclplaces> [options]" << std::endl;
+  std::cout << "Options:" << std::endl;
+  std::cout << "  --step <meters>           grid resolution of the places (default: 1.0)" << std::endl;
+  std::cout << "  --base-height <meters>    base above the floor (default: 0.0)" << std::endl;
+  std::cout << "  --min-headroom <meters>   free space above the floor (default: 0.5)" << std::endl;
+  std::cout << "  --z <meters>              all places at this height instead of on the floors" << std::endl;
+  std::cout << "  --sensor-height <meters>  sensor above the base (default: 0.5)" << std::endl;
+  std::cout << "  --h-beams <n>             horizontal beams of the simulated LiDAR (default: 360)" << std::endl;
+  std::cout << "  --v-beams <n>             vertical beams (default: 1)" << std::endl;
+  std::cout << "  --v-fov <degrees>         vertical field of view (default: 30)" << std::endl;
+  std::cout << "  --range-max <meters>      maximum range (default: 40.0)" << std::endl;
+  std::cout << "  --rings <n>               descriptor rings (default: 20)" << std::endl;
+  std::cout << "  --sectors <n>             descriptor sectors (default: 60)" << std::endl;
+  std::cout << "  --harmonics <n>           harmonics per ring (default: 3)" << std::endl;
+  std::cout << "  --min-z <meters>          ignore points below this height in base coordinates" << std::endl;
+  std::cout << "  --max-z <meters>          ignore points above this height in base coordinates" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+  if(argc < 3)
+  {
+    print_usage();
+    return 1;
+  }
+
+  const std::string input = argv[1];
+  const std::string output = argv[2];
+
+  RelocalizationParams grid;
+  float sensor_height = 0.5;
+  unsigned int h_beams = 360;
+  unsigned int v_beams = 1;
+  float v_fov = 30.0;
+  float range_max = 40.0;
+  PlaceDescriptorParams params;
+
+  for(int i=3; i<argc; i++)
+  {
+    const std::string arg = argv[i];
+    if(i + 1 >= argc)
+    {
+      std::cout << "Unknown option or missing value: " << arg << std::endl;
+      print_usage();
+      return 1;
+    }
+
+    if(arg == "--step")
+    {
+      grid.step = std::stof(argv[++i]);
+    } else if(arg == "--base-height") {
+      grid.base_height = std::stof(argv[++i]);
+    } else if(arg == "--min-headroom") {
+      grid.min_headroom = std::stof(argv[++i]);
+    } else if(arg == "--z") {
+      grid.floor = false;
+      grid.z = std::stof(argv[++i]);
+    } else if(arg == "--sensor-height") {
+      sensor_height = std::stof(argv[++i]);
+    } else if(arg == "--h-beams") {
+      h_beams = std::stoul(argv[++i]);
+    } else if(arg == "--v-beams") {
+      v_beams = std::stoul(argv[++i]);
+    } else if(arg == "--v-fov") {
+      v_fov = std::stof(argv[++i]);
+    } else if(arg == "--range-max") {
+      range_max = std::stof(argv[++i]);
+    } else if(arg == "--rings") {
+      params.rings = std::stoul(argv[++i]);
+    } else if(arg == "--sectors") {
+      params.sectors = std::stoul(argv[++i]);
+    } else if(arg == "--harmonics") {
+      params.harmonics = std::stoul(argv[++i]);
+    } else if(arg == "--min-z") {
+      params.min_z = std::stof(argv[++i]);
+    } else if(arg == "--max-z") {
+      params.max_z = std::stof(argv[++i]);
+    } else {
+      std::cout << "Unknown option: " << arg << std::endl;
+      print_usage();
+      return 1;
+    }
+  }
+
+  if(grid.step <= 0.0 || h_beams == 0 || v_beams == 0 || range_max <= 0.0
+    || params.rings == 0 || params.sectors == 0 || params.harmonics == 0)
+  {
+    std::cout << "Step, beams, range and descriptor sizes must be positive" << std::endl;
+    return 1;
+  }
+  params.max_range = range_max;
+
+  rm::StopWatch sw;
+  double el;
+
+  sw();
+  rm::EmbreeMapPtr map;
+  if(is_map_cache(input))
+  {
+    MapCache cache(input);
+    map = embree_map_from_cache(cache);
+  } else {
+    rm::AssimpIO io;
+    const aiScene* ascene = io.ReadFile(input, 0);
+    if(!ascene)
+    {
+      std::cout << "Could not load '" << input << "': " << io.GetErrorString() << std::endl;
+      return 1;
+    }
+    rm::EmbreeScenePtr scene = rm::make_embree_scene(ascene);
+    scene->commit();
+    map = std::make_shared<rm::EmbreeMap>(scene);
+  }
+  el = sw();
+  std::cout << "Loaded '" << input << "' in " << el << "s" << std::endl;
+
+  sw();
+  const std::vector<rm::Vector> positions = relocalization_positions(map, grid);
+  el = sw();
+  std::cout << "Found " << positions.size() << " places with " << grid.step << "m steps in " << el << "s" << std::endl;
+
+  if(positions.empty())
+  {
+    std::cout << "No free space found in the map" << std::endl;
+    return 1;
+  }
+
+  rm::Memory<rm::Transform, rm::RAM> Tbms(positions.size());
+  for(size_t i=0; i<positions.size(); i++)
+  {
+    Tbms[i] = rm::Transform::Identity();
+    Tbms[i].t = positions[i];
+  }
+
+  rm::SphericalModel model;
+  model.theta.min = -M_PI;
+  model.theta.inc = 2.0 * M_PI / static_cast<float>(h_beams);
+  model.theta.size = h_beams;
+  const float v_fov_rad = v_fov * M_PI / 180.0;
+  model.phi.min = (v_beams > 1) ? -v_fov_rad / 2.0 : 0.0;
+  model.phi.inc = (v_beams > 1) ? v_fov_rad / static_cast<float>(v_beams - 1) : 0.0;
+  model.phi.size = v_beams;
+  model.range.min = 0.0;
+  model.range.max = range_max;
+
+  rm::Transform Tsb = rm::Transform::Identity();
+  Tsb.t.z = sensor_height;
+
+  sw();
+  const PlaceDatabaseData data = build_place_database(map, Tbms, model, Tsb, params);
+  el = sw();
+  std::cout << "Simulated and described " << Tbms.size() << " scans in " << el << "s" << std::endl;
+
+  sw();
+  write_place_database(output, data);
+  el = sw();
+
+  std::cout << "Wrote '" << output << "' in " << el << "s" << std::endl;
+
+  return 0;
+}
@@ -117,7 +117,7 @@ private:
 
     if(this->has_parameter("debug_cloud"))
     {
-        this->get_parameter("debug_cloud").as_bool();
+        debug_cloud = this->get_parameter("debug_cloud").as_bool();
     } else {
         debug_cloud = false;
     }
@@ -159,7 +159,8 @@ private:
       }
     }
 
-    fillEmpty(scan_.scan);
+    scan.scan.info = scan_.scan.info;
+    fillEmpty(scan.scan);
 
     sensor_msgs::msg::PointField field_x;
     sensor_msgs::msg::PointField field_y;
@@ -182,7 +183,7 @@ private:
     }
 
     rm::SphericalModel model;
-    rmcl::convert(scan_.scan.info, model);
+    rmcl::convert(scan.scan.info, model);
 
     for (size_t i = 0; i < pcl->width * pcl->height; i++)
     {
@@ -243,7 +244,7 @@ private:
             // std::cout << "- matrix id (theta, phi): " << theta_id << ", " << phi_id << std::endl;
             // std::cout << "- valid: add" << std::endl;
             unsigned int p_id = model.getBufferId(phi_id, theta_id);
-            scan_.scan.data.ranges[p_id] = range_est;
+            scan.scan.data.ranges[p_id] = range_est;
           }
           
         } else {
@@ -262,22 +263,25 @@ private:
       focal_frame = msg->header.frame_id;
     }
 
-    scan_.header.stamp = msg->header.stamp;
-    scan_.header.frame_id = focal_frame;
-    if(!convert(msg, scan_))
+    // publishing a unique_ptr lets intra-process subscribers
+    // (e.g. MICP-L in the same container) take it without a copy
+    auto scan = std::make_unique<rmcl_msgs::msg::ScanStamped>();
+    scan->header.stamp = msg->header.stamp;
+    scan->header.frame_id = focal_frame;
+    if(!convert(msg, *scan))
     {
       return;
     }
 
-    pub_scan_->publish(scan_);
-
     if (debug_cloud)
     {
       sensor_msgs::msg::PointCloud cloud;
-      rmcl::convert(scan_, cloud);
+      rmcl::convert(*scan, cloud);
       cloud.header.stamp = msg->header.stamp;
       pub_debug_cloud_->publish(cloud);
     }
+
+    pub_scan_->publish(std::move(scan));
   }
 
   std::string focal_frame = "";
@@ -0,0 +1,15 @@
+#include <rclcpp/rclcpp.hpp>
+
+#include <rmcl/mcl/MCLLocalizationNode.hpp>
+
+int main(int argc, char** argv)
+{
+    rclcpp::init(argc, argv);
+
+    auto node = std::make_shared<rmcl::MCLLocalizationNode>();
+    rclcpp::spin(node);
+
+    rclcpp::shutdown();
+
+    return 0;
+}
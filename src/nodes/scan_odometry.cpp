@@ -0,0 +1,15 @@
+#include <rclcpp/rclcpp.hpp>
+
+#include <rmcl/odometry/ScanOdometryNode.hpp>
+
+int main(int argc, char** argv)
+{
+    rclcpp::init(argc, argv);
+
+    auto node = std::make_shared<rmcl::ScanOdometryNode>();
+    rclcpp::spin(node);
+
+    rclcpp::shutdown();
+
+    return 0;
+}
@@ -1,8 +1,102 @@
 #include "rmcl/clustering/clustering.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace rmcl 
 {
 
+namespace
+{
+
+// union-find for concurrent unions. Roots are always linked below the
+// smaller root, so parent[i] <= i holds and no cycles can form
+class AtomicUnionFind
+{
+public:
+    AtomicUnionFind(size_t n)
+    :m_parent(n)
+    {
+        #pragma omp parallel for
+        for(size_t i=0; i<n; i++)
+        {
+            m_parent[i].store(i, std::memory_order_relaxed);
+        }
+    }
+
+    KdIndex find(KdIndex i)
+    {
+        while(true)
+        {
+            KdIndex p = m_parent[i].load(std::memory_order_relaxed);
+            if(p == i)
+            {
+                return i;
+            }
+            const KdIndex gp = m_parent[p].load(std::memory_order_relaxed);
+            if(gp != p)
+            {
+                // path halving. Failing is fine, someone else shortened it
+                m_parent[i].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+            }
+            i = gp;
+        }
+    }
+
+    void unite(KdIndex a, KdIndex b)
+    {
+        while(true)
+        {
+            a = find(a);
+            b = find(b);
+            if(a == b)
+            {
+                return;
+            }
+            if(a > b)
+            {
+                std::swap(a, b);
+            }
+            // b must still be a root
+            KdIndex expected = b;
+            if(m_parent[b].compare_exchange_strong(expected, a, std::memory_order_relaxed))
+            {
+                return;
+            }
+        }
+    }
+
+private:
+    std::vector<std::atomic<KdIndex> > m_parent;
+};
+
+// 21 bits per axis. Voxels are counted from the bounding box minimum
+constexpr int64_t VOXEL_AXIS_SIZE = (1ll << 21);
+
+inline uint64_t voxel_key(int64_t ix, int64_t iy, int64_t iz)
+{
+    return static_cast<uint64_t>(ix)
+        | (static_cast<uint64_t>(iy) << 21)
+        | (static_cast<uint64_t>(iz) << 42);
+}
+
+inline bool voxel_valid(int64_t ix, int64_t iy, int64_t iz)
+{
+    return ix >= 0 && iy >= 0 && iz >= 0 
+        && ix < VOXEL_AXIS_SIZE && iy < VOXEL_AXIS_SIZE && iz < VOXEL_AXIS_SIZE;
+}
+
+} // namespace
+
 void sort_clusters(std::vector<std::vector<size_t> >& clusters)
 {
     std::sort(clusters.begin(), clusters.end(), 
@@ -18,69 +112,362 @@ void sort_clusters(std::vector<std::vector<size_t> >& clusters)
     // }
 }
 
+NeighborGraph radius_graph(
+    KdTreePtr index,
+    float search_dist)
+{
+    NeighborGraph graph;
+
+    const size_t Npoints = index->dataset()->kdtree_get_point_count();
+    const auto& data = index->dataset()->m_mem;
+
+    // nanoflann's L2 metric works on squared distances
+    const float search_dist_sq = search_dist * search_dist;
+
+    graph.offsets.resize(Npoints + 1);
+    graph.offsets[0] = 0;
+
+    #pragma omp parallel
+    {
+        #ifdef _OPENMP
+        const size_t n_threads = omp_get_num_threads();
+        const size_t thread_id = omp_get_thread_num();
+        #else
+        const size_t n_threads = 1;
+        const size_t thread_id = 0;
+        #endif
+
+        // contiguous range per thread. Then the thread local
+        // neighbor lists are one contiguous block of the CSR array
+        const size_t begin = Npoints * thread_id / n_threads;
+        const size_t end = Npoints * (thread_id + 1) / n_threads;
+
+        std::vector<KdResultItem> matches;
+        std::vector<KdIndex> neighbors_local;
+
+        for(size_t i = begin; i < end; i++)
+        {
+            index->radiusSearch(
+                reinterpret_cast<const float*>(&data[i].x), 
+                search_dist_sq, matches, 
+                nanoflann::SearchParameters(0.f, false));
+
+            graph.offsets[i + 1] = matches.size();
+            for(const KdResultItem& match : matches)
+            {
+                neighbors_local.push_back(match.first);
+            }
+        }
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            for(size_t i = 0; i < Npoints; i++)
+            {
+                graph.offsets[i + 1] += graph.offsets[i];
+            }
+            graph.neighbors.resize(graph.offsets[Npoints]);
+        }
+        // implicit barrier after single
+
+        std::copy(neighbors_local.begin(), neighbors_local.end(), 
+            graph.neighbors.begin() + graph.offsets[begin]);
+    }
+
+    return graph;
+}
+
+std::vector<std::vector<size_t> > dbscan(
+    const NeighborGraph& graph,
+    unsigned int min_pts_in_radius,
+    unsigned int min_pts_per_cluster)
+{
+    const size_t Npoints = graph.size();
+
+    std::vector<char> core(Npoints);
+
+    #pragma omp parallel for
+    for(size_t i = 0; i < Npoints; i++)
+    {
+        core[i] = (graph.degree(i) >= static_cast<size_t>(min_pts_in_radius));
+    }
+
+    // 1. connect core points with their core neighbors
+    AtomicUnionFind uf(Npoints);
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(size_t i = 0; i < Npoints; i++)
+    {
+        if(!core[i])
+        {
+            continue;
+        }
+        for(size_t j = graph.offsets[i]; j < graph.offsets[i + 1]; j++)
+        {
+            const KdIndex nb = graph.neighbors[j];
+            // every edge is seen from both sides
+            if(nb < i && core[nb])
+            {
+                uf.unite(i, nb);
+            }
+        }
+    }
+
+    // 2. labels. Core points: their root. Border points: root of 
+    // their first core neighbor. Noise: none
+    constexpr KdIndex NOISE = std::numeric_limits<KdIndex>::max();
+    std::vector<KdIndex> labels(Npoints, NOISE);
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(size_t i = 0; i < Npoints; i++)
+    {
+        if(core[i])
+        {
+            labels[i] = uf.find(i);
+            continue;
+        }
+        for(size_t j = graph.offsets[i]; j < graph.offsets[i + 1]; j++)
+        {
+            const KdIndex nb = graph.neighbors[j];
+            if(core[nb])
+            {
+                labels[i] = uf.find(nb);
+                break;
+            }
+        }
+    }
+
+    // 3. gather. Clusters are ordered by their smallest core point
+    std::vector<size_t> cluster_ids(Npoints, NOISE);
+    std::vector<std::vector<size_t> > clusters;
+
+    for(size_t i = 0; i < Npoints; i++)
+    {
+        const KdIndex label = labels[i];
+        if(label == NOISE)
+        {
+            continue;
+        }
+        if(cluster_ids[label] == NOISE)
+        {
+            cluster_ids[label] = clusters.size();
+            clusters.emplace_back();
+        }
+        clusters[cluster_ids[label]].push_back(i);
+    }
+
+    clusters.erase(std::remove_if(clusters.begin(), clusters.end(), 
+        [min_pts_per_cluster](const std::vector<size_t>& cluster) {
+            return cluster.size() < min_pts_per_cluster;
+        }), clusters.end());
+
+    return clusters;
+}
+
 std::vector<std::vector<size_t> > dbscan(
     KdTreePtr index, 
     float search_dist, 
     unsigned int min_pts_in_radius,
     unsigned int min_pts_per_cluster)
 {
-    size_t Npoints = index->m_size;
+    const NeighborGraph graph = radius_graph(index, search_dist);
+    return dbscan(graph, min_pts_in_radius, min_pts_per_cluster);
+}
 
+std::vector<std::vector<size_t> > voxel_clustering(
+    const rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& points,
+    float search_dist,
+    unsigned int min_pts_in_voxel,
+    unsigned int min_pts_per_cluster)
+{
     std::vector<std::vector<size_t> > clusters;
 
-    std::vector<bool> visited(Npoints);
-    std::vector<std::pair<unsigned int, float> > matches;
-    std::vector<std::pair<unsigned int, float> > sub_matches;
+    const size_t Npoints = points.size();
+    if(Npoints == 0)
+    {
+        return clusters;
+    }
+
+    // 1. bounds
+    float min_x = std::numeric_limits<float>::max();
+    float min_y = std::numeric_limits<float>::max();
+    float min_z = std::numeric_limits<float>::max();
+    float max_x = std::numeric_limits<float>::lowest();
+    float max_y = std::numeric_limits<float>::lowest();
+    float max_z = std::numeric_limits<float>::lowest();
+
+    #pragma omp parallel for reduction(min: min_x, min_y, min_z) reduction(max: max_x, max_y, max_z)
+    for(size_t i = 0; i < Npoints; i++)
+    {
+        min_x = std::min(min_x, points[i].x);
+        min_y = std::min(min_y, points[i].y);
+        min_z = std::min(min_z, points[i].z);
+        max_x = std::max(max_x, points[i].x);
+        max_y = std::max(max_y, points[i].y);
+        max_z = std::max(max_z, points[i].z);
+    }
+
+    const float inv_dist = 1.0 / search_dist;
+    const float max_extent = std::max(max_x - min_x, std::max(max_y - min_y, max_z - min_z));
+    if(max_extent * inv_dist >= static_cast<float>(VOXEL_AXIS_SIZE - 1))
+    {
+        throw std::invalid_argument("voxel_clustering: search_dist too small for the extent of the points");
+    }
 
-    auto data = index->dataset();
+    // 2. voxel of every point
+    std::vector<std::array<int32_t, 3> > point_voxel_coords(Npoints);
 
+    #pragma omp parallel for
     for(size_t i = 0; i < Npoints; i++)
     {
-        if (visited[i]) 
+        point_voxel_coords[i] = {
+            static_cast<int32_t>((points[i].x - min_x) * inv_dist),
+            static_cast<int32_t>((points[i].y - min_y) * inv_dist),
+            static_cast<int32_t>((points[i].z - min_z) * inv_dist)};
+    }
+
+    // 3. occupied voxels. Expected O(N)
+    std::unordered_map<uint64_t, KdIndex> voxel_ids;
+    voxel_ids.reserve(Npoints);
+    std::vector<std::array<int32_t, 3> > voxel_coords;
+    std::vector<unsigned int> voxel_counts;
+    std::vector<KdIndex> point_voxels(Npoints);
+
+    for(size_t i = 0; i < Npoints; i++)
+    {
+        const std::array<int32_t, 3>& c = point_voxel_coords[i];
+        auto it = voxel_ids.emplace(voxel_key(c[0], c[1], c[2]), voxel_coords.size());
+        if(it.second)
         {
-            continue;
+            voxel_coords.push_back(c);
+            voxel_counts.push_back(0);
         }
-        
-        index->radiusSearch(
-            reinterpret_cast<const float*>(&data->m_mem[i].x), 
-            search_dist, matches, 
-            nanoflann::SearchParams(32, 0.f, false));
-        
-        if (matches.size() < static_cast<size_t>(min_pts_in_radius)) 
+        voxel_counts[it.first->second]++;
+        point_voxels[i] = it.first->second;
+    }
+
+    const size_t Nvoxels = voxel_coords.size();
+
+    auto find_voxel = [&](const std::array<int32_t, 3>& c, int dx, int dy, int dz) -> KdIndex
+    {
+        const int64_t ix = c[0] + dx;
+        const int64_t iy = c[1] + dy;
+        const int64_t iz = c[2] + dz;
+        if(!voxel_valid(ix, iy, iz))
         {
-            continue;
+            return KD_INVALID_ID;
         }
+        // concurrent lookups in a const map are safe
+        const auto it = voxel_ids.find(voxel_key(ix, iy, iz));
+        return (it != voxel_ids.end()) ? it->second : KD_INVALID_ID;
+    };
 
-        visited[i] = true;
+    auto is_core = [&](KdIndex v) -> bool
+    {
+        return voxel_counts[v] >= min_pts_in_voxel;
+    };
 
-        std::vector<size_t> cluster = {i};
+    // 4. connect adjacent core voxels. The 13 offsets of the upper
+    // half of the neighborhood see every pair once
+    AtomicUnionFind uf(Nvoxels);
 
-        while (matches.empty() == false)
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(size_t v = 0; v < Nvoxels; v++)
+    {
+        if(!is_core(v))
+        {
+            continue;
+        }
+        for(int dx = -1; dx <= 1; dx++)
         {
-            auto nb_idx = matches.back().first;
-            matches.pop_back();
-            if (visited[nb_idx]) continue;
-            visited[nb_idx] = true;
+            for(int dy = -1; dy <= 1; dy++)
+            {
+                for(int dz = -1; dz <= 1; dz++)
+                {
+                    const bool upper = (dx > 0) || (dx == 0 && dy > 0) || (dx == 0 && dy == 0 && dz > 0);
+                    if(!upper)
+                    {
+                        continue;
+                    }
+                    const KdIndex nb = find_voxel(voxel_coords[v], dx, dy, dz);
+                    if(nb != KD_INVALID_ID && is_core(nb))
+                    {
+                        uf.unite(v, nb);
+                    }
+                }
+            }
+        }
+    }
 
-            index->radiusSearch(
-                reinterpret_cast<const float*>(&data->m_mem[nb_idx].x),
-                search_dist, sub_matches, 
-                nanoflann::SearchParams(32, 0.f, false));
+    // 5. voxel labels. Sparse voxels join their first core neighbor
+    std::vector<KdIndex> voxel_labels(Nvoxels, KD_INVALID_ID);
 
-            if (sub_matches.size() >= static_cast<size_t>(min_pts_in_radius))
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(size_t v = 0; v < Nvoxels; v++)
+    {
+        if(is_core(v))
+        {
+            voxel_labels[v] = uf.find(v);
+            continue;
+        }
+        for(int dx = -1; dx <= 1 && voxel_labels[v] == KD_INVALID_ID; dx++)
+        {
+            for(int dy = -1; dy <= 1 && voxel_labels[v] == KD_INVALID_ID; dy++)
             {
-                std::copy(sub_matches.begin(), sub_matches.end(), std::back_inserter(matches));
+                for(int dz = -1; dz <= 1; dz++)
+                {
+                    const KdIndex nb = find_voxel(voxel_coords[v], dx, dy, dz);
+                    if(nb != KD_INVALID_ID && is_core(nb))
+                    {
+                        voxel_labels[v] = uf.find(nb);
+                        break;
+                    }
+                }
             }
-            cluster.push_back(nb_idx);
         }
+    }
+
+    // 6. gather
+    std::vector<size_t> cluster_ids(Nvoxels, KD_INVALID_ID);
 
-        if(cluster.size() >= min_pts_per_cluster)
+    for(size_t i = 0; i < Npoints; i++)
+    {
+        const KdIndex label = voxel_labels[point_voxels[i]];
+        if(label == KD_INVALID_ID)
+        {
+            continue;
+        }
+        if(cluster_ids[label] == KD_INVALID_ID)
         {
-            clusters.emplace_back(std::move(cluster));
+            cluster_ids[label] = clusters.size();
+            clusters.emplace_back();
         }
+        clusters[cluster_ids[label]].push_back(i);
     }
 
+    clusters.erase(std::remove_if(clusters.begin(), clusters.end(), 
+        [min_pts_per_cluster](const std::vector<size_t>& cluster) {
+            return cluster.size() < min_pts_per_cluster;
+        }), clusters.end());
+
     return clusters;
 }
 
+std::vector<std::vector<size_t> > cluster_points(
+    const rmagine::Memory<rmagine::Vector, rmagine::RAM>& points,
+    ClusteringMethod method,
+    float search_dist,
+    unsigned int min_pts,
+    unsigned int min_pts_per_cluster)
+{
+    if(method == ClusteringMethod::VOXEL)
+    {
+        return voxel_clustering(points, search_dist, min_pts, min_pts_per_cluster);
+    }
+
+    KdPointsPtr kd_points = std::make_shared<KdPoints>(points);
+    KdTreePtr tree = std::make_shared<KdTree>(kd_points);
+    return dbscan(tree, search_dist, min_pts, min_pts_per_cluster);
+}
+
 } // namespace rmcl
\ No newline at end of file
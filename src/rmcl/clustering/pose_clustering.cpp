@@ -0,0 +1,280 @@
+#include "rmcl/clustering/pose_clustering.h"
+
+#include <rmcl/spatial/KdTree.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+namespace
+{
+
+constexpr size_t EMBEDDING_DIM = 5;
+
+inline float yaw_of(const rm::Quaternion& q)
+{
+    return std::atan2(2.0f * (q.w * q.z + q.x * q.y),
+        1.0f - 2.0f * (q.y * q.y + q.z * q.z));
+}
+
+// (x, y, z, r cos(yaw), r sin(yaw)) for every pose, row major
+class PoseEmbedding
+{
+public:
+    PoseEmbedding(
+        const rm::MemoryView<rm::Transform, rm::RAM>& poses,
+        float yaw_radius)
+    :m_data(poses.size() * EMBEDDING_DIM)
+    {
+        #pragma omp parallel for
+        for(size_t i=0; i<poses.size(); i++)
+        {
+            const rm::Transform& T = poses[i];
+            const float yaw = yaw_of(T.R);
+            float* e = &m_data[i * EMBEDDING_DIM];
+            e[0] = T.t.x;
+            e[1] = T.t.y;
+            e[2] = T.t.z;
+            e[3] = yaw_radius * std::cos(yaw);
+            e[4] = yaw_radius * std::sin(yaw);
+        }
+    }
+
+    inline const float* point(size_t idx) const
+    {
+        return &m_data[idx * EMBEDDING_DIM];
+    }
+
+    inline size_t kdtree_get_point_count() const
+    {
+        return m_data.size() / EMBEDDING_DIM;
+    }
+
+    inline float kdtree_get_pt(const size_t idx, const size_t dim) const
+    {
+        return m_data[idx * EMBEDDING_DIM + dim];
+    }
+
+    template <class BBOX>
+    bool kdtree_get_bbox(BBOX& /* bb */) const { return false; }
+
+private:
+    std::vector<float> m_data;
+};
+
+using PoseKdTree = nanoflann::KDTreeSingleIndexAdaptor<
+    nanoflann::L2_Simple_Adaptor<float, PoseEmbedding>,
+    PoseEmbedding, EMBEDDING_DIM, KdIndex>;
+
+void compute_cluster_stats(
+    const rm::MemoryView<rm::Transform, rm::RAM>& poses,
+    const rm::MemoryView<float, rm::RAM>& weights,
+    PoseCluster& cluster)
+{
+    double w_sum = 0.0;
+    size_t best = cluster.ids[0];
+    for(const size_t id : cluster.ids)
+    {
+        w_sum += weights[id];
+        if(weights[id] > weights[best])
+        {
+            best = id;
+        }
+    }
+    cluster.weight = w_sum;
+
+    // all members zero weighted: fall back to uniform weights
+    const bool uniform = !(w_sum > 0.0);
+    const double w_norm = uniform ? 1.0 / static_cast<double>(cluster.ids.size()) : 1.0 / w_sum;
+
+    const rm::Quaternion q_ref = poses[best].R;
+
+    double tx = 0.0, ty = 0.0, tz = 0.0;
+    double qx = 0.0, qy = 0.0, qz = 0.0, qw = 0.0;
+    double yc = 0.0, ys = 0.0;
+
+    for(const size_t id : cluster.ids)
+    {
+        const double w = (uniform ? 1.0 : weights[id]) * w_norm;
+        const rm::Transform& T = poses[id];
+        tx += w * T.t.x;
+        ty += w * T.t.y;
+        tz += w * T.t.z;
+
+        // q and -q are the same rotation
+        const float qdot = T.R.x * q_ref.x + T.R.y * q_ref.y + T.R.z * q_ref.z + T.R.w * q_ref.w;
+        const double sign = (qdot < 0.0) ? -1.0 : 1.0;
+        qx += sign * w * T.R.x;
+        qy += sign * w * T.R.y;
+        qz += sign * w * T.R.z;
+        qw += sign * w * T.R.w;
+
+        const float yaw = yaw_of(T.R);
+        yc += w * std::cos(yaw);
+        ys += w * std::sin(yaw);
+    }
+
+    cluster.pose.t = {
+        static_cast<float>(tx),
+        static_cast<float>(ty),
+        static_cast<float>(tz)};
+
+    const double qnorm = std::sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+    if(qnorm > 0.0)
+    {
+        cluster.pose.R.x = qx / qnorm;
+        cluster.pose.R.y = qy / qnorm;
+        cluster.pose.R.z = qz / qnorm;
+        cluster.pose.R.w = qw / qnorm;
+    } else {
+        cluster.pose.R = q_ref;
+    }
+
+    cluster.cov_trans.setZeros();
+    for(const size_t id : cluster.ids)
+    {
+        const float w = (uniform ? 1.0 : weights[id]) * w_norm;
+        const rm::Vector d = poses[id].t - cluster.pose.t;
+        cluster.cov_trans(0,0) += w * d.x * d.x;
+        cluster.cov_trans(0,1) += w * d.x * d.y;
+        cluster.cov_trans(0,2) += w * d.x * d.z;
+        cluster.cov_trans(1,1) += w * d.y * d.y;
+        cluster.cov_trans(1,2) += w * d.y * d.z;
+        cluster.cov_trans(2,2) += w * d.z * d.z;
+    }
+    cluster.cov_trans(1,0) = cluster.cov_trans(0,1);
+    cluster.cov_trans(2,0) = cluster.cov_trans(0,2);
+    cluster.cov_trans(2,1) = cluster.cov_trans(1,2);
+
+    const double R_len = std::max(std::sqrt(yc * yc + ys * ys), 1e-6);
+    cluster.var_yaw = -2.0 * std::log(std::min(R_len, 1.0));
+}
+
+} // namespace
+
+std::vector<PoseCluster> dbscan_poses(
+    const rm::MemoryView<rm::Transform, rm::RAM>& poses,
+    const rm::MemoryView<float, rm::RAM>& weights,
+    const PoseClusteringParams& params)
+{
+    std::vector<PoseCluster> clusters;
+
+    const size_t Nposes = poses.size();
+    if(Nposes == 0)
+    {
+        return clusters;
+    }
+
+    // a pure yaw difference of dist_yaw has the chord length dist_trans
+    const float dist_yaw = std::min(std::max(params.dist_yaw, 1e-6f), static_cast<float>(M_PI));
+    const float yaw_radius = params.dist_trans / (2.0 * std::sin(0.5 * dist_yaw));
+
+    PoseEmbedding embedding(poses, yaw_radius);
+    const PoseKdTree index(EMBEDDING_DIM, embedding, nanoflann::KDTreeSingleIndexAdaptorParams(10));
+
+    // nanoflann's L2 metric works on squared distances
+    const float search_dist_sq = params.dist_trans * params.dist_trans;
+
+    // 1. neighborhoods of all poses in parallel
+    std::vector<std::vector<KdIndex> > neighbors(Nposes);
+
+    #pragma omp parallel
+    {
+        std::vector<KdResultItem> matches;
+
+        #pragma omp for schedule(dynamic, 64)
+        for(size_t i=0; i<Nposes; i++)
+        {
+            index.radiusSearch(embedding.point(i), search_dist_sq, matches,
+                nanoflann::SearchParameters(0.f, false));
+
+            if(matches.size() < params.min_pts)
+            {
+                // no core pose. Its neighbors are never expanded from here
+                continue;
+            }
+
+            neighbors[i].resize(matches.size());
+            for(size_t j=0; j<matches.size(); j++)
+            {
+                neighbors[i][j] = matches[j].first;
+            }
+        }
+    }
+
+    // 2. expand the clusters from the core poses. Linear in the
+    // number of neighbor entries
+    constexpr int UNASSIGNED = -1;
+    std::vector<int> labels(Nposes, UNASSIGNED);
+    std::vector<KdIndex> stack;
+
+    for(size_t i=0; i<Nposes; i++)
+    {
+        if(labels[i] != UNASSIGNED || neighbors[i].empty())
+        {
+            continue;
+        }
+
+        const int label = clusters.size();
+        clusters.emplace_back();
+        PoseCluster& cluster = clusters.back();
+
+        labels[i] = label;
+        cluster.ids.push_back(i);
+        stack.assign(neighbors[i].begin(), neighbors[i].end());
+
+        while(!stack.empty())
+        {
+            const KdIndex nb = stack.back();
+            stack.pop_back();
+            if(labels[nb] != UNASSIGNED)
+            {
+                continue;
+            }
+
+            labels[nb] = label;
+            cluster.ids.push_back(nb);
+            // border poses join the cluster but do not grow it
+            stack.insert(stack.end(), neighbors[nb].begin(), neighbors[nb].end());
+        }
+    }
+
+    clusters.erase(std::remove_if(clusters.begin(), clusters.end(),
+        [&](const PoseCluster& cluster) {
+            return cluster.ids.size() < params.min_cluster_size;
+        }), clusters.end());
+
+    // 3. weighted statistics per cluster
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t i=0; i<clusters.size(); i++)
+    {
+        compute_cluster_stats(poses, weights, clusters[i]);
+    }
+
+    std::sort(clusters.begin(), clusters.end(),
+        [](const PoseCluster& a, const PoseCluster& b) -> bool
+        {
+            return a.weight > b.weight;
+        }
+    );
+
+    return clusters;
+}
+
+std::vector<PoseCluster> dbscan_poses(
+    const rm::MemoryView<rm::Transform, rm::RAM>& poses,
+    const PoseClusteringParams& params)
+{
+    rm::Memory<float, rm::RAM> weights(poses.size());
+    for(size_t i=0; i<weights.size(); i++)
+    {
+        weights[i] = 1.0;
+    }
+    return dbscan_poses(poses, weights, params);
+}
+
+} // namespace rmcl
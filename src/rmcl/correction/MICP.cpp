@@ -4,6 +4,24 @@
 #include <rmcl/util/ros_helper.h>
 
 #include <rmcl/math/math.h>
+#include <rmcl/map/MapCache.hpp>
+#include <rmcl/map/MeshSimplification.hpp>
+
+#if defined(RMCL_EMBREE) || defined(RMCL_OPTIX)
+#include <rmagine/map/AssimpIO.hpp>
+#endif // defined(RMCL_EMBREE) || defined(RMCL_OPTIX)
+
+#ifdef RMCL_EMBREE
+#include <rmcl/map/MapCacheEmbree.hpp>
+#include <rmcl/map/MapTileStreamerEmbree.hpp>
+#include <rmcl/map/MapInstancesEmbree.hpp>
+#include <rmcl/map/EmbreeMapAttributes.hpp>
+#include <rmcl/correction/RelocalizationEmbree.hpp>
+#endif // RMCL_EMBREE
+
+#ifdef RMCL_OPTIX
+#include <rmcl/map/MapCacheOptix.hpp>
+#endif // RMCL_OPTIX
 
 #ifdef RMCL_CUDA
 #include <rmcl/math/math.cuh>
@@ -11,12 +29,18 @@
 #endif // RMCL_CUDA
 
 #include <rmagine/util/StopWatch.hpp>
+#include <rmagine/math/math.h>
 
 #include <rclcpp/wait_for_message.hpp>
 #include <geometry_msgs/msg/transform_stamped.hpp>
+#include <tf2_ros/qos.hpp>
 
 #include <chrono>
 #include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <sstream>
 
 using namespace std::chrono_literals;
 
@@ -25,7 +49,32 @@ namespace rm = rmagine;
 namespace rmcl
 {
 
-MICP::MICP(rclcpp::Node::SharedPtr node)
+namespace
+{
+
+template<typename ModelT>
+void append_points_base(
+    const ModelT& model,
+    const rm::MemoryView<float, rm::RAM>& ranges,
+    const rm::Transform& Tsb,
+    std::vector<rm::Vector>& points)
+{
+    for(unsigned int vid = 0; vid < model.getHeight(); vid++)
+    {
+        for(unsigned int hid = 0; hid < model.getWidth(); hid++)
+        {
+            const unsigned int bid = model.getBufferId(vid, hid);
+            if(bid < ranges.size() && model.range.inside(ranges[bid]))
+            {
+                points.push_back(Tsb * (model.getOrigin(vid, hid) + model.getDirection(vid, hid) * ranges[bid]));
+            }
+        }
+    }
+}
+
+} // namespace
+
+MICP::MICP(rclcpp::Node* node)
 :m_nh(node)
 ,m_tf_buffer(new tf2_ros::Buffer(m_nh->get_clock()))
 ,m_tf_listener(new tf2_ros::TransformListener(*m_tf_buffer))
@@ -40,6 +89,22 @@ MICP::MICP(rclcpp::Node::SharedPtr node)
 
     m_nh_p = m_nh->create_sub_node(nh_name);
 
+    // invalidates the static transforms cached by the sensors. The 
+    // listener's own subscription may not have handed the message to the 
+    // buffer yet: insert it here first, so that a sensor seeing the new 
+    // version cannot cache the old transform (inserting twice is harmless)
+    m_tf_static_version = std::make_shared<std::atomic<uint64_t> >(0);
+    m_tf_static_sub = m_nh->create_subscription<tf2_msgs::msg::TFMessage>(
+        "/tf_static", tf2_ros::StaticListenerQoS(),
+        [this](const tf2_msgs::msg::TFMessage::ConstSharedPtr msg) -> void
+        {
+            for(const geometry_msgs::msg::TransformStamped& T : msg->transforms)
+            {
+                m_tf_buffer->setTransform(T, "micp_tf_static", true);
+            }
+            m_tf_static_version->fetch_add(1);
+        });
+
     std::cout << "MICP initiailized" << std::endl;
 
     std::cout << std::endl;
@@ -80,6 +145,26 @@ MICP::MICP(rclcpp::Node::SharedPtr node)
 
 MICP::~MICP()
 {
+    // threads use this
+    if(m_map_loader.joinable())
+    {
+        m_map_loader.join();
+    }
+
+    for(std::thread& loader : m_sensor_loaders)
+    {
+        if(loader.joinable())
+        {
+            loader.join();
+        }
+    }
+
+    #ifdef RMCL_EMBREE
+    if(m_tile_streamer)
+    {
+        m_tile_streamer->stop();
+    }
+    #endif // RMCL_EMBREE
     // std::cout << "MICP cleanup" << std::endl;
 }
 
@@ -104,8 +189,86 @@ void MICP::loadParams()
 
     checkTF(true);
 
+    #ifdef RMCL_EMBREE
+    m_map_tiles = get_parameter(m_nh, "map_tiles.enable", false);
+    m_map_tiles_radius = get_parameter(m_nh, "map_tiles.radius", 200.0);
+    m_map_tiles_update_period = get_parameter(m_nh, "map_tiles.update_period", 1.0);
+
+    std::vector<std::string> dynamic_meshes = get_parameter(m_nh, "map_dynamic_meshes", std::vector<std::string>());
+    for(const std::string& mesh_name : dynamic_meshes)
+    {
+        m_map_updater->setDynamic(mesh_name);
+    }
+
+    m_map_instances = get_parameter(m_nh, "map_instances", true);
+
+    // e.g. glass and vegetation: weight < 1 or ignored (0)
+    std::vector<std::string> weight_prefixes = get_parameter(m_nh, "map_weights.prefixes", std::vector<std::string>());
+    std::vector<double> weight_values = get_parameter(m_nh, "map_weights.values", std::vector<double>());
+    if(weight_prefixes.size() != weight_values.size())
+    {
+        RCLCPP_WARN_STREAM(m_nh->get_logger(), "map_weights.prefixes and map_weights.values differ in size. Ignoring map weights");
+    } else {
+        for(size_t i=0; i<weight_prefixes.size(); i++)
+        {
+            m_map_weights.emplace_back(weight_prefixes[i], static_cast<float>(weight_values[i]));
+        }
+    }
+
+    // regions: lists of mesh name prefixes
+    m_region_names = get_parameter(m_nh, "map_regions.names", std::vector<std::string>());
+    if(m_region_names.size() > 32)
+    {
+        RCLCPP_WARN_STREAM(m_nh->get_logger(), "Only 32 map regions are supported. Ignoring the rest");
+        m_region_names.resize(32);
+    }
+    if(!m_region_names.empty())
+    {
+        std::vector<std::vector<std::string> > regions;
+        for(const std::string& region_name : m_region_names)
+        {
+            regions.push_back(get_parameter(m_nh, "map_regions." + region_name, std::vector<std::string>()));
+        }
+        m_map_updater->setRegions(regions);
+        m_map_updater_lod->setRegions(regions);
+
+        std::string active_region = get_parameter(m_nh, "map_active_region", "");
+        if(!setActiveRegion(active_region))
+        {
+            RCLCPP_WARN_STREAM(m_nh->get_logger(), "Unknown map region '" << active_region << "'");
+        }
+        std::cout << "Map regions: " << m_region_names.size() << ", active: '" << active_region << "'" << std::endl;
+    }
+
+    m_stack_sensors = get_parameter(m_nh, "micp.stack_sensors", false);
+    if(m_stack_sensors)
+    {
+        std::cout << "Stacking Embree sensors into one ray set" << std::endl;
+    }
+    #endif // RMCL_EMBREE
+
+    m_lod = get_parameter(m_nh, "micp.lod.enable", false);
+    m_lod_map_filename = get_parameter(m_nh, "micp.lod.map_file", "");
+    m_lod_cell_size = get_parameter(m_nh, "micp.lod.cell_size", 0.25);
+    m_lod_trans_thresh = get_parameter(m_nh, "micp.lod.trans_thresh", 0.05);
+    m_lod_rot_thresh = get_parameter(m_nh, "micp.lod.rot_thresh", 0.02);
+    if(m_lod && m_lod_map_filename.empty() && !(m_lod_cell_size > 0.0))
+    {
+        RCLCPP_ERROR_STREAM(m_nh->get_logger(), "micp.lod.cell_size must be positive, got " 
+            << m_lod_cell_size << ". Disabling the simplified map");
+        m_lod = false;
+    }
+    if(m_lod)
+    {
+        std::cout << "Coarse corrections on a simplified map" << std::endl;
+    }
+
     loadMap(m_map_filename);
 
+    // setting map_file at runtime loads the new map in the background
+    m_param_cb_handle = m_nh->add_on_set_parameters_callback(
+        std::bind(&MICP::onParameters, this, std::placeholders::_1));
+
     std::map<std::string, rclcpp::Parameter> sensors_param;
 
     if(m_nh->get_parameters("sensors", sensors_param))
@@ -115,16 +278,32 @@ void MICP::loadParams()
         std::cout << "     --- SENSORS ---     " << std::endl;
         std::cout << "-------------------------" << std::endl;
 
+        // sensors wait for topics and models with timeouts. Load them 
+        // in parallel, each one is used as soon as it is ready
         ParamTree<rclcpp::Parameter>::SharedPtr sensors_param_tree = get_parameter_tree(m_nh, "sensors");
         for(auto elem : *sensors_param_tree)
         {
-            loadSensor(elem.second);
+            ParamTree<rclcpp::Parameter>::SharedPtr sensor_params = elem.second;
+            m_sensor_loaders.emplace_back([this, sensor_params]() {
+                // optix correctors need the cuda context of the map
+                useInThisThread();
+
+                try {
+                    if(!loadSensor(sensor_params))
+                    {
+                        RCLCPP_WARN_STREAM(m_nh->get_logger(), "Could not load sensor '" << sensor_params->name << "'");
+                    }
+                } catch(const std::exception& ex) {
+                    RCLCPP_ERROR_STREAM(m_nh->get_logger(), "Could not load sensor '" 
+                        << sensor_params->name << "': " << ex.what());
+                }
+            });
         }
     } else {
         std::cout << "ERROR: NO SENSORS" << std::endl;
     }
 
-    std::cout << "MICP load params - done. Valid Sensors: " << m_sensors.size() << std::endl;
+    std::cout << "MICP load params - done. Loading " << m_sensor_loaders.size() << " sensors in background" << std::endl;
 }
 
 bool MICP::loadSensor(
@@ -132,6 +311,9 @@ bool MICP::loadSensor(
 {
     std::string sensor_name = sensor_params->name;
 
+    // sensors are loaded in parallel. Print the block of each sensor at once
+    std::stringstream out;
+
     MICPRangeSensorPtr sensor = std::make_shared<MICPRangeSensor>();
 
     bool loading_error = false;
@@ -149,7 +331,7 @@ bool MICP::loadSensor(
     {
         auto param = sensor_params->at("type")->data;
 
-        // std::cout << "Searching for parameter: " << ss.str() << std::endl;
+        // out << "Searching for parameter: " << ss.str() << std::endl;
         sensor_type = param->as_string();
         if(sensor_type == "spherical") {
             sensor->type = 0;
@@ -160,9 +342,9 @@ bool MICP::loadSensor(
         } else if(sensor_type == "ondn") {
             sensor->type = 3;
         } else {
-            std::cout << "ERROR sensor type unknown: " << sensor_type << std::endl;
-            std::cout << "- supported: spherical, pinhole, o1dn, ondn" << std::endl;
-            std::cout << "- try to reconstruct type from other params" << std::endl; 
+            out << "ERROR sensor type unknown: " << sensor_type << std::endl;
+            out << "- supported: spherical, pinhole, o1dn, ondn" << std::endl;
+            out << "- try to reconstruct type from other params" << std::endl; 
         }
         sensor_type_found = true;
     }
@@ -173,13 +355,13 @@ bool MICP::loadSensor(
         sensor->frame = param->as_string();
     }
 
-    std::cout << "- " << TC_SENSOR << sensor_name << TC_END << std::endl;
+    out << "- " << TC_SENSOR << sensor_name << TC_END << std::endl;
 
     // load data or connect to a data topic
     if(sensor_params->find("topic") != sensor_params->end())
     {
-        std::cout << "  - data:\t\tTopic" << std::endl;
-        // std::cout << "has topic" << std::endl;
+        out << "  - data:\t\tTopic" << std::endl;
+        // out << "has topic" << std::endl;
         std::string topic_name;
         {
             topic_name = sensor_params->at("topic")->data->as_string();
@@ -191,7 +373,7 @@ bool MICP::loadSensor(
         }
         
         sensor->data_topic.name = topic_name;
-        std::cout << "    - topic:\t\t" << TC_TOPIC << sensor->data_topic.name << TC_END << std::endl;
+        out << "    - topic:\t\t" << TC_TOPIC << sensor->data_topic.name << TC_END << std::endl;
 
         if(sensor_params->find("topic_type") != sensor_params->end())
         {
@@ -227,10 +409,10 @@ bool MICP::loadSensor(
                 if(sensor->data_topic.msg != topic_type)
                 {
                     // WARNING
-                    std::cout << "WARNING: Topic type mismatch found:" << std::endl;
-                    std::cout << "-- user input: " << sensor->data_topic.msg << std::endl;
-                    std::cout << "-- topic type: " << topic_type << std::endl;
-                    std::cout << "Using actual topic type" << std::endl;
+                    out << "WARNING: Topic type mismatch found:" << std::endl;
+                    out << "-- user input: " << sensor->data_topic.msg << std::endl;
+                    out << "-- topic type: " << topic_type << std::endl;
+                    out << "Using actual topic type" << std::endl;
                 }
             }
 
@@ -242,9 +424,9 @@ bool MICP::loadSensor(
             if(sensor->data_topic.msg == "")
             {
                 // empty type
-                std::cout << "ERROR: TOPIC '" << sensor->data_topic.name << "' IS NOT EXISTING" << std::endl;
+                out << "ERROR: TOPIC '" << sensor->data_topic.name << "' IS NOT EXISTING" << std::endl;
             } else {
-                std::cout << "WAITING FOR TOPIC '" << sensor->data_topic.name << "' TO APPEAR" << std::endl;
+                out << "WAITING FOR TOPIC '" << sensor->data_topic.name << "' TO APPEAR" << std::endl;
             }
         }
 
@@ -265,7 +447,7 @@ bool MICP::loadSensor(
                 sensor->type = 1;
             }
 
-            std::cout << "    - msg:\t\t" << TC_MSG << sensor->data_topic.msg << TC_END << std::endl;
+            out << "    - msg:\t\t" << TC_MSG << sensor->data_topic.msg << TC_END << std::endl;
             // check if topic is valid
 
             checkTopic(sensor->data_topic, rclcpp::Duration(5s));
@@ -273,20 +455,20 @@ bool MICP::loadSensor(
             if(sensor->data_topic.data)
             {
                 sensor->frame = sensor->data_topic.frame;
-                std::cout << "    - data:\t\t" << TC_GREEN << "yes" << TC_END << std::endl;
-                std::cout << "    - frame:\t\t" << TC_FRAME << sensor->frame << TC_END << std::endl;
+                out << "    - data:\t\t" << TC_GREEN << "yes" << TC_END << std::endl;
+                out << "    - frame:\t\t" << TC_FRAME << sensor->frame << TC_END << std::endl;
             } else {
-                std::cout << "    - data:\t\t" << TC_RED << "no" << TC_END << std::endl;
+                out << "    - data:\t\t" << TC_RED << "no" << TC_END << std::endl;
             }
         } else {
-            std::cout << "    - msg:\t\t" << TC_RED << "not found" << TC_END << std::endl;
+            out << "    - msg:\t\t" << TC_RED << "not found" << TC_END << std::endl;
             loading_error = true;
         }
     } else if(sensor_params->find("ranges") != sensor_params->end()) {
-        // std::cout << "  - topic:\t\t" << TC_RED << "not found" << TC_END << std::endl;
+        // out << "  - topic:\t\t" << TC_RED << "not found" << TC_END << std::endl;
         // check if there is data in the parameters instead
 
-        std::cout << "  - data:\t\tParams" << std::endl;
+        out << "  - data:\t\tParams" << std::endl;
 
         std::vector<double> ranges = sensor_params->at("ranges")->data->as_double_array();
 
@@ -301,11 +483,11 @@ bool MICP::loadSensor(
         sensor->data_received_once = true;
 
     } else {
-        std::cout << "Where is the data?" << std::endl;
+        out << "Where is the data?" << std::endl;
         loading_error = true;
     }
 
-    // std::cout << "LOADING MODEL" << std::endl;
+    // out << "LOADING MODEL" << std::endl;
 
     // Loading model params
     // 1. Params: model parameters are listed as ROS parameters (static)
@@ -315,7 +497,7 @@ bool MICP::loadSensor(
     bool model_loaded = false;
     if(sensor_params->find("model") != sensor_params->end()) /// PARAMS
     {
-        std::cout << "  - model source:\t\tParams" << std::endl;
+        out << "  - model source:\t\tParams" << std::endl;
 
         auto model_params = sensor_params->at("model");
 
@@ -386,7 +568,7 @@ bool MICP::loadSensor(
             if(orig.size() != 3)
             {
                 // error
-                std::cout << "ERROR: origin point is not 3D" << std::endl;
+                out << "ERROR: origin point is not 3D" << std::endl;
             }
 
             model.orig.x = orig[0];
@@ -467,13 +649,13 @@ bool MICP::loadSensor(
             model_loaded = !model_loading_error;
         } else {
             // ERROR
-            std::cout << "Model type '" << sensor->type << "' not supported." << std::endl;
+            out << "Model type '" << sensor->type << "' not supported." << std::endl;
             loading_error = true;
         }
 
     } else if(sensor_params->find("model_topic") != sensor_params->end()) { /// TOPIC
 
-        std::cout << "  - model source:\t\tTopic" << std::endl;
+        out << "  - model source:\t\tTopic" << std::endl;
 
         sensor->has_info_topic = true;
 
@@ -484,7 +666,7 @@ bool MICP::loadSensor(
         }
         sensor->info_topic.name = info_topic_name;
 
-        std::cout << "    - topic:\t\t" << TC_TOPIC << sensor->info_topic.name  << TC_END << std::endl;
+        out << "    - topic:\t\t" << TC_TOPIC << sensor->info_topic.name  << TC_END << std::endl;
 
         if(sensor_params->find("model_topic_type") != sensor_params->end())
         {
@@ -518,10 +700,10 @@ bool MICP::loadSensor(
                 if(sensor->info_topic.msg != topic_type)
                 {
                     // WARNING
-                    std::cout << "WARNING: Topic type mismatch found:" << std::endl;
-                    std::cout << "-- user input: " << sensor->info_topic.msg << std::endl;
-                    std::cout << "-- topic type: " << topic_type << std::endl;
-                    std::cout << "Using actual topic type" << std::endl;
+                    out << "WARNING: Topic type mismatch found:" << std::endl;
+                    out << "-- user input: " << sensor->info_topic.msg << std::endl;
+                    out << "-- topic type: " << topic_type << std::endl;
+                    out << "Using actual topic type" << std::endl;
                 }
             }
 
@@ -530,9 +712,9 @@ bool MICP::loadSensor(
 
         if(sensor->info_topic.msg != "")
         {
-            std::cout << "    - msg:\t\t" << TC_MSG << sensor->info_topic.msg << TC_END << std::endl;
+            out << "    - msg:\t\t" << TC_MSG << sensor->info_topic.msg << TC_END << std::endl;
         } else {
-            std::cout << "    - msg:\t\t" << TC_RED << "not found" << TC_END << std::endl;
+            out << "    - msg:\t\t" << TC_RED << "not found" << TC_END << std::endl;
             loading_error = true;
         }
 
@@ -557,27 +739,27 @@ bool MICP::loadSensor(
             if(sensor->info_topic.msg == "rmcl_msgs/msg/ScanInfo")
             {
                 rmcl_msgs::msg::ScanInfo msg;
-                if(rclcpp::wait_for_message(msg, m_nh, sensor->info_topic.name, 3s))
+                if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), sensor->info_topic.name, 3s))
                 {
                     rm::SphericalModel model;
                     convert(msg, model);
                     sensor->model = model;
                     model_loaded = true;
                 } else {
-                    std::cout << "ERROR: Could not receive initial pinhole model!" << std::endl;
+                    out << "ERROR: Could not receive initial pinhole model!" << std::endl;
                 }
             }
         } else if(sensor_type == "pinhole") {
             
             if(sensor->info_topic.msg == "sensor_msgs/msg/CameraInfo")
             {
-                // std::cout << "Waiting for message on topic: " << sensor->info_topic.name << std::endl;
+                // out << "Waiting for message on topic: " << sensor->info_topic.name << std::endl;
                 sensor_msgs::msg::CameraInfo msg;
-                if(rclcpp::wait_for_message(msg, m_nh, sensor->info_topic.name, 3s))
+                if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), sensor->info_topic.name, 3s))
                 {
                     if(msg.header.frame_id != sensor->frame)
                     {
-                        std::cout << "WARNING: Image and CameraInfo are not in the same frame" << std::endl;
+                        out << "WARNING: Image and CameraInfo are not in the same frame" << std::endl;
                     }
                     
                     rm::PinholeModel model;
@@ -591,21 +773,21 @@ bool MICP::loadSensor(
                     sensor->model = model;
                     model_loaded = true;
                 } else {
-                    std::cout << "ERROR: Could not receive initial pinhole model!" << std::endl;
+                    out << "ERROR: Could not receive initial pinhole model!" << std::endl;
                 }
             }
 
             if(sensor->info_topic.msg == "rmcl_msgs/msg/DepthInfo")
             {
                 rmcl_msgs::msg::DepthInfo msg;
-                if(rclcpp::wait_for_message(msg, m_nh, sensor->info_topic.name, 3s))
+                if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), sensor->info_topic.name, 3s))
                 {
                     rm::PinholeModel model;
                     convert(msg, model);
                     sensor->model = model;
                     model_loaded = true;
                 } else {
-                    std::cout << "ERROR: Could not receive initial pinhole model!" << std::endl;
+                    out << "ERROR: Could not receive initial pinhole model!" << std::endl;
                 }
             }
 
@@ -615,14 +797,14 @@ bool MICP::loadSensor(
             if(sensor->info_topic.msg == "rmcl_msgs/msg/O1DnInfo")
             {
                 rmcl_msgs::msg::O1DnInfo msg;
-                if(rclcpp::wait_for_message(msg, m_nh, sensor->info_topic.name, 3s))
+                if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), sensor->info_topic.name, 3s))
                 {
                     rm::O1DnModel model;
                     convert(msg, model);
                     sensor->model = model;
                     model_loaded = true;
                 } else {
-                    std::cout << "ERROR: Could not receive initial o1dn model!" << std::endl;
+                    out << "ERROR: Could not receive initial o1dn model!" << std::endl;
                 }
             }
 
@@ -630,48 +812,48 @@ bool MICP::loadSensor(
             if(sensor->info_topic.msg == "rmcl_msgs/msg/OnDnInfo")
             {
                 rmcl_msgs::msg::OnDnInfo msg;
-                if(rclcpp::wait_for_message(msg, m_nh, sensor->info_topic.name, 3s))
+                if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), sensor->info_topic.name, 3s))
                 {
                     rm::OnDnModel model;
                     convert(msg, model);
                     sensor->model = model;
                     model_loaded = true;
                 } else {
-                    std::cout << "ERROR: Could not receive initial ondn model!" << std::endl;
+                    out << "ERROR: Could not receive initial ondn model!" << std::endl;
                 }
             }
         }
 
     } else { /// DATA
-        std::cout << "  - model source:\t\tData" << std::endl;
+        out << "  - model source:\t\tData" << std::endl;
 
         if(sensor_type == "spherical")
         {
             if(!model_loaded && sensor->data_topic.msg == "sensor_msgs/msg/LaserScan")
             {
                 sensor_msgs::msg::LaserScan msg;
-                if(rclcpp::wait_for_message(msg, m_nh, sensor->data_topic.name, 3s))
+                if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), sensor->data_topic.name, 3s))
                 {
                     rm::SphericalModel model;
                     convert(msg, model);
                     sensor->model = model;
                     model_loaded = true;
                 } else {
-                    std::cout << "error: get sensor_msgs/msg/LaserScan to init model" << std::endl;
+                    out << "error: get sensor_msgs/msg/LaserScan to init model" << std::endl;
                 }
             }
             
             if(!model_loaded && sensor->data_topic.msg == "rmcl_msgs/msg/ScanStamped")
             {
                 rmcl_msgs::msg::ScanStamped msg;
-                if(rclcpp::wait_for_message(msg, m_nh, sensor->data_topic.name, 3s))
+                if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), sensor->data_topic.name, 3s))
                 {
                     rm::SphericalModel model;
                     convert(msg.scan.info, model);
                     sensor->model = model;
                     model_loaded = true;
                 } else {
-                    std::cout << "error: get rmcl_msgs/msg/ScanStamped to init model" << std::endl;
+                    out << "error: get rmcl_msgs/msg/ScanStamped to init model" << std::endl;
                 }
             }
         } else if(sensor_type == "pinhole") {
@@ -679,14 +861,14 @@ bool MICP::loadSensor(
             if(!model_loaded && sensor->data_topic.msg == "rmcl_msgs/msg/DepthStamped")
             {
                 rmcl_msgs::msg::DepthStamped msg;
-                if(rclcpp::wait_for_message(msg, m_nh, sensor->data_topic.name, 3s))
+                if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), sensor->data_topic.name, 3s))
                 {
                     rm::PinholeModel model;
                     convert(msg.depth.info, model);
                     sensor->model = model;
                     model_loaded = true;
                 } else {
-                    std::cout << "error: get rmcl_msgs/msg/DepthStamped to init model" << std::endl;
+                    out << "error: get rmcl_msgs/msg/DepthStamped to init model" << std::endl;
                 }
             }
 
@@ -695,14 +877,14 @@ bool MICP::loadSensor(
             if(!model_loaded && sensor->data_topic.msg == "rmcl_msgs/msg/O1DnStamped")
             {
                 rmcl_msgs::msg::O1DnStamped msg;
-                if(rclcpp::wait_for_message(msg, m_nh, sensor->data_topic.name, 3s))
+                if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), sensor->data_topic.name, 3s))
                 {
                     rm::O1DnModel model;
                     convert(msg.o1dn.info, model);
                     sensor->model = model;
                     model_loaded = true;
                 } else {
-                    std::cout << "error: get rmcl_msgs/msg/DepthStamped to init model" << std::endl;
+                    out << "error: get rmcl_msgs/msg/DepthStamped to init model" << std::endl;
                 }
             }
         } else if(sensor_type == "ondn") {
@@ -710,14 +892,14 @@ bool MICP::loadSensor(
             if(!model_loaded && sensor->data_topic.msg == "rmcl_msgs/msg/OnDnStamped")
             {
                 rmcl_msgs::msg::OnDnStamped msg;
-                if(rclcpp::wait_for_message(msg, m_nh, sensor->data_topic.name, 3s))
+                if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), sensor->data_topic.name, 3s))
                 {
                     rm::OnDnModel model;
                     convert(msg.ondn.info, model);
                     sensor->model = model;
                     model_loaded = true;
                 } else {
-                    std::cout << "error: get rmcl_msgs/msg/DepthStamped to init model" << std::endl;
+                    out << "error: get rmcl_msgs/msg/DepthStamped to init model" << std::endl;
                 }
             }
         }
@@ -728,18 +910,18 @@ bool MICP::loadSensor(
     {
         if(model_loaded)
         {
-            std::cout << "  - type:\t\t" << sensor_type << " - loaded" << std::endl;
+            out << "  - type:\t\t" << sensor_type << " - loaded" << std::endl;
         } else {
-            std::cout << "  - type:\t\t" << sensor_type << " - " << TC_RED << "loading error" << TC_END << std::endl;
+            out << "  - type:\t\t" << sensor_type << " - " << TC_RED << "loading error" << TC_END << std::endl;
         }
     } else {
-        std::cout << "  - type:\t\t" << TC_RED << "unknown" << TC_END << std::endl;
+        out << "  - type:\t\t" << TC_RED << "unknown" << TC_END << std::endl;
     }
 
     // MICP params
     if(sensor_params->find("micp") != sensor_params->end())
     {
-        std::cout << "  - micp:" << std::endl;
+        out << "  - micp:" << std::endl;
         auto micp_params = sensor_params->at("micp");
 
         if(micp_params->find("backend") != micp_params->end())
@@ -748,13 +930,13 @@ bool MICP::loadSensor(
             if(backend_name == "embree")
             {
                 sensor->backend = 0;
-                std::cout << "    - backend:\t\t" << TC_BLUE << "embree" << TC_END << std::endl;
+                out << "    - backend:\t\t" << TC_BLUE << "embree" << TC_END << std::endl;
             } else if(backend_name == "optix") {
                 sensor->backend = 1;
-                std::cout << "    - backend:\t\t" << TC_BLUE << "optix" << TC_END << std::endl;
+                out << "    - backend:\t\t" << TC_BLUE << "optix" << TC_END << std::endl;
             } else {
                 // error
-                std::cout << "    - backend:\t\t" << TC_RED << backend_name << " - unknown" << TC_END << std::endl;
+                out << "    - backend:\t\t" << TC_RED << backend_name << " - unknown" << TC_END << std::endl;
             }
         } else {
             #ifdef RMCL_EMBREE
@@ -784,6 +966,26 @@ bool MICP::loadSensor(
         } else {
             sensor->corr_weight = 1.0;
         }
+
+        if(micp_params->find("stack") != micp_params->end())
+        {
+            sensor->stack = micp_params->at("stack")->data->as_bool();
+        }
+
+        if(micp_params->find("lod") != micp_params->end())
+        {
+            std::string lod_name = micp_params->at("lod")->data->as_string();
+            if(lod_name == "never")
+            {
+                sensor->lod = LODPolicy::NEVER;
+            } else if(lod_name == "always") {
+                sensor->lod = LODPolicy::ALWAYS;
+            } else if(lod_name == "coarse") {
+                sensor->lod = LODPolicy::COARSE;
+            } else {
+                out << "    - lod:\t\t" << TC_RED << lod_name << " - unknown" << TC_END << std::endl;
+            }
+        }
         
     } else {
         // taking fastest
@@ -801,15 +1003,16 @@ bool MICP::loadSensor(
     
     if(sensor->optical_coordinates)
     {
-        std::cout << "  - optical frame" << std::endl;
+        out << "  - optical frame" << std::endl;
     }
 
     if(loading_error)
     {
+        std::cout << out.str() << std::flush;
         return false;
     }
     
-    // std::cout << "POSTPROCESS" << std::endl;
+    // out << "POSTPROCESS" << std::endl;
 
 
     ////////////////////////
@@ -818,25 +1021,28 @@ bool MICP::loadSensor(
 
     // postcheck
     // check if optical: _optical suffix
-    // std::cout << "Searching for '_optical' in " << sensor->data_topic.frame << std::endl;
+    // out << "Searching for '_optical' in " << sensor->data_topic.frame << std::endl;
     
+    std::cout << out.str() << std::flush;
+
+    // maps are swapped under this lock (preCorrect). The sensor gets the current ones
+    std::lock_guard<std::mutex> guard(m_sensors_mutex);
+
     // connect sensor to ROS
     sensor->nh = m_nh;
     sensor->nh_p = m_nh_p;
     sensor->tf_buffer = m_tf_buffer;
+    sensor->tf_static_version = m_tf_static_version;
 
     // load additional params: duplicated from above
     sensor->fetchMICPParams();
-    // connect to sensor topics
-    sensor->connect();
-
 
     #ifdef RMCL_EMBREE
     if(sensor->type == 0) // spherical
     {
         sensor->corr_sphere_embree = std::make_shared<SphereCorrectorEmbree>(m_map_embree);
     } else if(sensor->type == 1) {
-        sensor->corr_pinhole_embree = std::make_shared<PinholeCorrectorEmbree>(m_map_embree);;
+        sensor->corr_pinhole_embree = std::make_shared<PinholeCorrectorEmbree>(m_map_embree);
     } else if(sensor->type == 2) {
         sensor->corr_o1dn_embree = std::make_shared<O1DnCorrectorEmbree>(m_map_embree);
     } else if(sensor->type == 3) {
@@ -857,11 +1063,26 @@ bool MICP::loadSensor(
     }
     #endif // RMCL_OPTIX
 
+    // the sensor switches between full and simplified map
+    sensor->lod_coarse = m_lod_coarse;
+    #ifdef RMCL_EMBREE
+    sensor->setMap(m_map_embree);
+    sensor->setLODMap(m_map_embree_lod);
+    #endif // RMCL_EMBREE
+
+    #ifdef RMCL_OPTIX
+    sensor->setMap(m_map_optix);
+    sensor->setLODMap(m_map_optix_lod);
+    #endif // RMCL_OPTIX
     
     sensor->fetchTF();
     sensor->updateCorrectors();
 
-    // add sensor to class
+    // connect to sensor topics last: callbacks on the multi-threaded
+    // executor use the correctors, maps and TF set up above
+    sensor->connect();
+
+    // add sensor to class. Active in correction once its data arrives
     m_sensors[sensor->name] = sensor;
 
     return true;
@@ -869,17 +1090,13 @@ bool MICP::loadSensor(
 
 void MICP::loadMap(std::string filename)
 {
-    #ifdef RMCL_EMBREE
-    m_map_embree = rm::import_embree_map(filename);
-    setMap(m_map_embree);
-    #else 
+    importMap(filename, false);
+
+    #ifndef RMCL_EMBREE
     m_corr_cpu = std::make_shared<Correction>();
     #endif // RMCL_EMBREE
 
-    #ifdef RMCL_OPTIX
-    m_map_optix = rm::import_optix_map(filename);
-    setMap(m_map_optix);
-    #else
+    #ifndef RMCL_OPTIX
     #ifdef RMCL_CUDA
     // initialize cuda correction without optix
     m_corr_gpu = std::make_shared<CorrectionCuda>(); 
@@ -887,175 +1104,741 @@ void MICP::loadMap(std::string filename)
     #endif // RMCL_OPTIX
 }
 
-#ifdef RMCL_EMBREE
-void MICP::setMap(rmagine::EmbreeMapPtr map)
+bool MICP::loadMapAsync(std::string filename)
 {
-    m_map_embree = map;
-    m_corr_cpu = std::make_shared<Correction>();
-
-    // update sensors
-    for(auto elem : m_sensors)
+    // parameter callbacks can arrive concurrently: only one starts a loader
+    bool loading = false;
+    if(!m_map_loading.compare_exchange_strong(loading, true))
     {
-        elem.second->setMap(map);
+        return false;
     }
-}
-#endif // RMCL_EMBREE
 
-#ifdef RMCL_OPTIX
-void MICP::setMap(rmagine::OptixMapPtr map)
-{
-    m_map_optix = map;
-    m_corr_gpu = std::make_shared<CorrectionCuda>(m_map_optix->scene()->stream());
-    
-    // update sensors
-    for(auto elem : m_sensors)
+    if(m_map_loader.joinable())
     {
-        elem.second->setMap(map);
+        m_map_loader.join();
     }
-}
-#endif // RMCL_OPTIX
 
+    m_map_loader = std::thread([this, filename]() {
+        // building optix scenes needs the cuda context of the current map
+        useInThisThread();
 
-#ifdef RMCL_CUDA
-void MICP::correct(
-    const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbm,
-    const rmagine::MemoryView<rmagine::Transform, rmagine::VRAM_CUDA>& Tbm_,
-    CorrectionPreResults<rm::VRAM_CUDA>& pre_res,
-    rmagine::MemoryView<rmagine::Transform, rmagine::VRAM_CUDA>& dT)
+        try {
+            importMap(filename, true);
+        } catch(const std::exception& ex) {
+            RCLCPP_ERROR_STREAM(m_nh->get_logger(), "Could not load map '" << filename 
+                << "': " << ex.what() << ". Keeping the current map");
+        }
+
+        m_map_loading = false;
+    });
+
+    return true;
+}
+
+void MICP::importMap(const std::string& filename, bool queue)
 {
-    // std::cout << "correct runtimes: " << std::endl;
-    // rm::StopWatch sw;
-    // double el;
-    // double el_total = 0.0;
+    rm::StopWatch sw;
+    sw();
 
+    #ifdef RMCL_EMBREE
+    MapTileStreamerEmbreePtr streamer;
+    rm::EmbreeMapPtr map_embree;
+    rm::EmbreeMapPtr map_embree_lod;
+    #endif // RMCL_EMBREE
 
-    // sw();
-    // extra memory
-    std::vector<CorrectionPreResults<rm::VRAM_CUDA> > results(m_sensors.size());
-    float weight_sum = 0.0;
-    std::vector<float> weights(m_sensors.size());
+    #ifdef RMCL_OPTIX
+    rm::OptixMapPtr map_optix;
+    rm::OptixMapPtr map_optix_lod;
+    #endif // RMCL_OPTIX
 
-    for(auto& elem : results)
-    {
-        elem.ms.resize(Tbm.size());
-        elem.ds.resize(Tbm.size());
-        elem.Cs.resize(Tbm.size());
-        elem.Ncorr.resize(Tbm.size());
-    }
+    // simplified meshes, if they are generated here
+    std::vector<MapCacheMeshData> lod_meshes;
+    const bool lod_generate = (m_lod && m_lod_map_filename.empty());
 
-    // sw();
-    size_t id = 0;
-    for(auto elem : m_sensors)
+    if(is_map_cache(filename))
     {
-        CorrectionPreResults<rm::VRAM_CUDA>& res_ = results[id];
+        // binary map cache: mmap, no parsing
+        MapCachePtr cache = std::make_shared<MapCache>(filename);
+        std::cout << "Loading map cache with " << cache->meshes().size() 
+            << " meshes, " << cache->numFaces() << " faces" << std::endl;
 
-        if(elem.second->data_received_once)
+        #ifdef RMCL_EMBREE
+        if(m_map_tiles && cache->tileSize() > 0.0)
         {
-            #ifdef RMCL_EMBREE
-            if(elem.second->backend == 0)
+            std::cout << "Streaming tiles of " << cache->tileSize() << "m within " 
+                << m_map_tiles_radius << "m" << std::endl;
+            streamer = std::make_shared<MapTileStreamerEmbree>(cache, m_map_tiles_radius);
+            map_embree = streamer->build(mapCenter());
+        } else {
+            if(m_map_tiles)
             {
-                CorrectionPreResults<rm::RAM> res;
-                res.ms.resize(Tbm.size());
-                res.ds.resize(Tbm.size());
-                res.Cs.resize(Tbm.size());
-                res.Ncorr.resize(Tbm.size());
+                RCLCPP_WARN_STREAM(m_nh->get_logger(), "map_tiles enabled but '" << filename 
+                    << "' is not tiled. Loading the whole map. Create it with: map_to_cache --tile-size");
+            }
+            map_embree = embree_map_from_cache(*cache);
+        }
+        #endif // RMCL_EMBREE
 
-                // compute
-                elem.second->computeCovs(Tbm, res);
+        #ifdef RMCL_OPTIX
+        map_optix = optix_map_from_cache(*cache);
+        #endif // RMCL_OPTIX
 
-                // upload
-                res_.ms = res.ms;
-                res_.ds = res.ds;
-                res_.Cs = res.Cs;
-                res_.Ncorr = res.Ncorr;
-            } else 
-            #endif // RMCL_EMBREE
-            #ifdef RMCL_OPTIX
-            if(elem.second->backend == 1) {
-                // use preuploaded poses as input
-                elem.second->computeCovs(Tbm_, res_);
-            } else
-            #endif // RMCL_OPTIX
-            {
-                std::cout << "backend " << elem.second->backend << " unknown" << std::endl;
-            }
+        if(lod_generate)
+        {
+            lod_meshes = simplify_meshes(cache->meshes(), m_lod_cell_size);
+        }
+    } else {
+        #if defined(RMCL_EMBREE) || defined(RMCL_OPTIX)
+        // parse once, share between backends
+        rm::AssimpIO io;
+        const aiScene* ascene = io.ReadFile(filename, 0);
+        if(!ascene)
+        {
+            RCLCPP_ERROR_STREAM(m_nh->get_logger(), "Could not load map '" << filename << "': " << io.GetErrorString());
+            throw std::runtime_error("Could not load map '" + filename + "'");
+        }
 
-            // dynamic weights
-            float w = elem.second->corr_weight;
-            weight_sum += w;
-            weights[id] = w;
+        if(lod_generate)
+        {
+            lod_meshes = simplify_meshes(meshes_from_assimp(ascene), m_lod_cell_size);
+        }
+        #endif // defined(RMCL_EMBREE) || defined(RMCL_OPTIX)
+
+        #ifdef RMCL_EMBREE
+        if(m_map_instances)
+        {
+            // repeated meshes: one geometry, many transforms
+            map_embree = embree_map_instanced(ascene);
         } else {
-            std::cout << "WARNING: still waiting for sensor data of " << elem.second->name << std::endl; 
-            weights[id] = 0.0;
+            rm::EmbreeScenePtr scene_embree = rm::make_embree_scene(ascene);
+            scene_embree->commit();
+            map_embree = std::make_shared<rm::EmbreeMap>(scene_embree);
         }
+        #endif // RMCL_EMBREE
 
-        id++;
+        #ifdef RMCL_OPTIX
+        rm::OptixScenePtr scene_optix = rm::make_optix_scene(ascene);
+        scene_optix->commit();
+        map_optix = std::make_shared<rm::OptixMap>(scene_optix);
+        #endif // RMCL_OPTIX
     }
-    
-    if(results.size() > 0)
+
+    #if defined(RMCL_EMBREE) || defined(RMCL_OPTIX)
+    if(m_lod)
     {
-        // normalize weights
-        // sw();
-        for(size_t i=0; i<weights.size(); i++)
+        // offline simplified map (map_to_cache --simplify) or generated above
+        MapCachePtr lod_cache;
+        std::vector<MapCacheMesh> lod_views;
+        if(!m_lod_map_filename.empty())
         {
-            weights[i] /= weight_sum;
+            if(is_map_cache(m_lod_map_filename))
+            {
+                lod_cache = std::make_shared<MapCache>(m_lod_map_filename);
+                lod_views = lod_cache->meshes();
+            } else {
+                rm::AssimpIO io;
+                const aiScene* ascene = io.ReadFile(m_lod_map_filename, 0);
+                if(!ascene)
+                {
+                    throw std::runtime_error("Could not load LOD map '" + m_lod_map_filename + "'");
+                }
+                lod_meshes = meshes_from_assimp(ascene);
+            }
         }
 
-        // CorrectionPreResults<rm::VRAM_CUDA> results_combined;
-        // pre_res;
-        if(pre_res.ms.size() < Tbm.size())
+        for(const MapCacheMeshData& mesh : lod_meshes)
         {
-            pre_res.ms.resize(Tbm.size());
-            pre_res.ds.resize(Tbm.size());
-            pre_res.Cs.resize(Tbm.size());
-            pre_res.Ncorr.resize(Tbm.size());
+            lod_views.push_back(map_cache_mesh_view(mesh));
         }
 
-        weighted_average(
-            results,
-            weights,
-            pre_res);
+        size_t n_faces = 0;
+        for(const MapCacheMesh& mesh : lod_views)
+        {
+            n_faces += mesh.faces.size();
+        }
+        std::cout << "LOD map: " << n_faces << " faces" << std::endl;
 
-        m_corr_gpu->correction_from_covs(pre_res, dT);
-    } else {
-        std::cout << "0 sensors" << std::endl;
-        // set identity
-        rm::setIdentity(dT);
-    }
-}
-#endif // RMCL_CUDA
+        #ifdef RMCL_EMBREE
+        map_embree_lod = std::make_shared<rm::EmbreeMap>(embree_scene_from_meshes(lod_views));
+        #endif // RMCL_EMBREE
 
-#ifdef RMCL_CUDA
-void MICP::correct(
-    const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbm,
-    const rmagine::MemoryView<rmagine::Transform, rmagine::VRAM_CUDA>& Tbm_,
-    CorrectionPreResults<rmagine::RAM>& pre_res,
-    rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& dT)
-{
-    // extra memory
-    std::vector<CorrectionPreResults<rm::RAM> > results(m_sensors.size());
-    float weight_sum = 0.0;
-    std::vector<float> weights(m_sensors.size());
+        #ifdef RMCL_OPTIX
+        map_optix_lod = std::make_shared<rm::OptixMap>(optix_scene_from_meshes(lod_views));
+        #endif // RMCL_OPTIX
+    }
+    #endif // defined(RMCL_EMBREE) || defined(RMCL_OPTIX)
 
-    for(auto& elem : results)
+    if(queue)
     {
-        elem.ms.resize(Tbm.size());
-        elem.ds.resize(Tbm.size());
-        elem.Cs.resize(Tbm.size());
-        elem.Ncorr.resize(Tbm.size());
+        // published by preCorrect together with the queued map
+        std::lock_guard<std::mutex> guard(m_map_file_mutex);
+        m_pending_map_file = filename;
     }
 
-    size_t id = 0;
-    for(auto elem : m_sensors)
+    #ifdef RMCL_EMBREE
+    // normals and weights per triangle for the correctors
+    if(map_embree)
+    {
+        build_map_attributes(map_embree, m_map_weights);
+    }
+    if(map_embree_lod)
+    {
+        build_map_attributes(map_embree_lod, m_map_weights);
+    }
+
+    // the old streamer must not deliver tiles of the old map after this
+    MapTileStreamerEmbreePtr streamer_old = std::atomic_exchange(&m_tile_streamer, streamer);
+    if(streamer_old)
+    {
+        streamer_old->stop();
+    }
+
+    if(queue)
+    {
+        queueMap(map_embree, map_embree_lod);
+    } else {
+        setLODMap(map_embree_lod);
+        setMap(map_embree);
+    }
+
+    if(streamer)
+    {
+        streamer->start(m_map_tiles_update_period, [this](rm::EmbreeMapPtr map) {
+            build_map_attributes(map, m_map_weights);
+            queueMap(map);
+        });
+    }
+    #endif // RMCL_EMBREE
+
+    #ifdef RMCL_OPTIX
+    if(queue)
+    {
+        queueMap(map_optix, map_optix_lod);
+    } else {
+        setLODMap(map_optix_lod);
+        setMap(map_optix);
+    }
+    #endif // RMCL_OPTIX
+
+    if(!queue)
+    {
+        std::lock_guard<std::mutex> guard(m_map_file_mutex);
+        m_map_file = filename;
+    }
+
+    std::cout << "Map '" << filename << "' loaded in " << sw() << "s" << std::endl;
+}
+
+#ifdef RMCL_EMBREE
+void MICP::setMap(rmagine::EmbreeMapPtr map)
+{
+    // sensors that are being loaded get either the old map and this update or the new map
+    std::lock_guard<std::mutex> guard(m_sensors_mutex);
+
+    m_map_embree = map;
+    m_corr_cpu = std::make_shared<Correction>();
+
+    if(m_stack_sensors)
+    {
+        if(!m_stack)
+        {
+            m_stack = std::make_shared<MICPSensorStack>(map);
+        } else {
+            m_stack->setMap(map);
+        }
+    }
+
+    // update sensors
+    for(auto elem : m_sensors)
+    {
+        elem.second->setMap(map);
+    }
+}
+
+void MICP::setLODMap(rmagine::EmbreeMapPtr map)
+{
+    // sensors that are being loaded get either the old map and this update or the new map
+    std::lock_guard<std::mutex> guard(m_sensors_mutex);
+
+    m_map_embree_lod = map;
+
+    for(auto elem : m_sensors)
+    {
+        elem.second->setLODMap(map);
+    }
+}
+
+float MICP::computeCovsEmbree(
+    const MICPRangeSensorPtr& sensor,
+    const rm::MemoryView<rm::Transform, rm::RAM>& Tbm,
+    CorrectionPreResults<rm::RAM>& res)
+{
+    if(m_stack && m_stack->contains(sensor->name))
+    {
+        if(sensor->name == m_stack->leader())
+        {
+            // all stacked sensors at once
+            m_stack->computeCovs(Tbm, res);
+            return m_stack->weight();
+        }
+
+        // already part of the leaders result
+        for(size_t i=0; i<Tbm.size(); i++)
+        {
+            res.ds[i] = {0.0, 0.0, 0.0};
+            res.ms[i] = {0.0, 0.0, 0.0};
+            res.Cs[i].setZeros();
+            res.Ncorr[i] = 0;
+            if(res.residuals.size() == Tbm.size())
+            {
+                res.residuals[i] = 0.0;
+            }
+        }
+        return 0.0;
+    }
+
+    sensor->computeCovs(Tbm, res);
+    return sensor->corr_weight;
+}
+#endif // RMCL_EMBREE
+
+#ifdef RMCL_OPTIX
+void MICP::setMap(rmagine::OptixMapPtr map)
+{
+    // sensors that are being loaded get either the old map and this update or the new map
+    std::lock_guard<std::mutex> guard(m_sensors_mutex);
+
+    m_map_optix = map;
+    m_corr_gpu = std::make_shared<CorrectionCuda>(m_map_optix->scene()->stream());
+    
+    // update sensors
+    for(auto elem : m_sensors)
+    {
+        elem.second->setMap(map);
+    }
+}
+
+void MICP::setLODMap(rmagine::OptixMapPtr map)
+{
+    // sensors that are being loaded get either the old map and this update or the new map
+    std::lock_guard<std::mutex> guard(m_sensors_mutex);
+
+    m_map_optix_lod = map;
+
+    for(auto elem : m_sensors)
+    {
+        elem.second->setLODMap(map);
+    }
+}
+#endif // RMCL_OPTIX
+
+
+#ifdef RMCL_EMBREE
+void MICP::queueMap(
+    rm::EmbreeMapPtr map, 
+    rm::EmbreeMapPtr map_lod)
+{
+    // LOD first: preCorrect takes it only together with the full map
+    if(map_lod)
+    {
+        std::atomic_store(&m_pending_map_embree_lod, map_lod);
+    }
+    std::atomic_store(&m_pending_map_embree, map);
+}
+#endif // RMCL_EMBREE
+
+#ifdef RMCL_OPTIX
+void MICP::queueMap(
+    rm::OptixMapPtr map, 
+    rm::OptixMapPtr map_lod)
+{
+    if(map_lod)
+    {
+        std::atomic_store(&m_pending_map_optix_lod, map_lod);
+    }
+    std::atomic_store(&m_pending_map_optix, map);
+}
+#endif // RMCL_OPTIX
+
+#ifdef RMCL_EMBREE
+void MICP::setMeshDynamic(const std::string& mesh_name, bool dynamic)
+{
+    m_map_updater->setDynamic(mesh_name, dynamic);
+}
+
+void MICP::setMeshTransform(const std::string& mesh_name, const rm::Transform& T)
+{
+    m_map_updater->setTransform(mesh_name, T);
+}
+
+void MICP::setMeshVertices(
+    const std::string& mesh_name, 
+    const rm::MemoryView<rm::Point, rm::RAM>& vertices)
+{
+    m_map_updater->setVertices(mesh_name, vertices);
+}
+
+void MICP::setMeshEnabled(const std::string& mesh_name, bool enabled)
+{
+    m_map_updater->setEnabled(mesh_name, enabled);
+}
+#endif // RMCL_EMBREE
+
+#ifdef RMCL_EMBREE
+bool MICP::setActiveRegion(const std::string& region)
+{
+    if(region == "" || region == "all")
+    {
+        m_ray_mask = 0xFFFFFFFF;
+        return true;
+    }
+
+    for(size_t i=0; i<m_region_names.size(); i++)
+    {
+        if(m_region_names[i] == region)
+        {
+            m_ray_mask = (1u << i);
+            return true;
+        }
+    }
+
+    return false;
+}
+#endif // RMCL_EMBREE
+
+void MICP::updateLOD(const rm::Transform& dT)
+{
+    const float trans = dT.t.l2norm();
+    const float rot = 2.0 * acos(std::min(1.0f, std::fabs(dT.R.w)));
+    m_lod_coarse = (trans > m_lod_trans_thresh || rot > m_lod_rot_thresh);
+}
+
+void MICP::setLODCoarse(bool coarse)
+{
+    m_lod_coarse = coarse;
+}
+
+void MICP::setMapCenter(const rm::Vector& center)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_map_center_mutex);
+        m_map_center = center;
+    }
+
+    #ifdef RMCL_EMBREE
+    MapTileStreamerEmbreePtr streamer = std::atomic_load(&m_tile_streamer);
+    if(streamer)
+    {
+        streamer->setCenter(center);
+    }
+    #endif // RMCL_EMBREE
+}
+
+rm::Vector MICP::mapCenter()
+{
+    std::lock_guard<std::mutex> guard(m_map_center_mutex);
+    return m_map_center;
+}
+
+std::string MICP::mapFile()
+{
+    std::lock_guard<std::mutex> guard(m_map_file_mutex);
+    return m_map_file;
+}
+
+void MICP::publishMapFile()
+{
+    std::lock_guard<std::mutex> guard(m_map_file_mutex);
+    if(!m_pending_map_file.empty())
+    {
+        m_map_file = m_pending_map_file;
+        m_pending_map_file.clear();
+    }
+}
+
+rcl_interfaces::msg::SetParametersResult MICP::onParameters(
+    const std::vector<rclcpp::Parameter>& params)
+{
+    rcl_interfaces::msg::SetParametersResult result;
+    result.successful = true;
+
+    for(const rclcpp::Parameter& param : params)
+    {
+        #ifdef RMCL_EMBREE
+        if(param.get_name() == "map_active_region" 
+            && param.get_type() == rclcpp::ParameterType::PARAMETER_STRING)
+        {
+            if(!setActiveRegion(param.as_string()))
+            {
+                result.successful = false;
+                result.reason = "Unknown map region '" + param.as_string() + "'";
+            }
+        }
+        #endif // RMCL_EMBREE
+
+        // same file again: reload, e.g. after the file was updated
+        if(param.get_name() == "map_file" 
+            && param.get_type() == rclcpp::ParameterType::PARAMETER_STRING)
+        {
+            if(!loadMapAsync(param.as_string()))
+            {
+                result.successful = false;
+                result.reason = "Still loading the previous map";
+            }
+        }
+    }
+
+    return result;
+}
+
+void MICP::preCorrect()
+{
+    // swap in maps that were built in the background. Correction steps
+    // that are already running keep the old map alive until they are done
+    #ifdef RMCL_EMBREE
+    rm::EmbreeMapPtr map_embree = std::atomic_exchange(&m_pending_map_embree, rm::EmbreeMapPtr());
+    if(map_embree)
+    {
+        rm::EmbreeMapPtr map_embree_lod = std::atomic_exchange(&m_pending_map_embree_lod, rm::EmbreeMapPtr());
+        if(map_embree_lod)
+        {
+            setLODMap(map_embree_lod);
+        }
+        setMap(map_embree);
+        publishMapFile();
+    }
+    #endif // RMCL_EMBREE
+
+    #ifdef RMCL_OPTIX
+    rm::OptixMapPtr map_optix = std::atomic_exchange(&m_pending_map_optix, rm::OptixMapPtr());
+    if(map_optix)
+    {
+        rm::OptixMapPtr map_optix_lod = std::atomic_exchange(&m_pending_map_optix_lod, rm::OptixMapPtr());
+        if(map_optix_lod)
+        {
+            setLODMap(map_optix_lod);
+        }
+        setMap(map_optix);
+        publishMapFile();
+    }
+    #endif // RMCL_OPTIX
+
+    // sensors that finished loading in the meantime
+    std::lock_guard<std::mutex> guard(m_sensors_mutex);
+
+    // sensors without data are skipped until their first message
+    m_sensors_active.clear();
+    for(auto elem : m_sensors)
+    {
+        if(elem.second->data_received_once)
+        {
+            m_sensors_active.insert(elem);
+        }
+    }
+
+    if(m_sensors_active.size() != m_n_sensors_active)
+    {
+        std::cout << "MICP - active sensors: " << m_sensors_active.size() << "/" << m_sensors.size() << std::endl;
+        m_n_sensors_active = m_sensors_active.size();
+    }
+
+    #ifdef RMCL_EMBREE
+    // no raycasts are running here
+    {
+        // tile meshes are shared with the scene the streamer builds next
+        std::unique_lock<std::mutex> mesh_lock;
+        MapTileStreamerEmbreePtr streamer = std::atomic_load(&m_tile_streamer);
+        if(streamer)
+        {
+            mesh_lock = std::unique_lock<std::mutex>(streamer->meshMutex());
+        }
+        m_map_updater->apply(m_map_embree);
+        m_map_updater_lod->apply(m_map_embree_lod);
+    }
+
+    // active region. The sensor lock keeps the data callbacks from 
+    // handing half-written parameters to the correctors
+    const unsigned int ray_mask = m_ray_mask;
+    for(auto elem : m_sensors)
+    {
+        elem.second->setRayMask(ray_mask);
+    }
+    #endif // RMCL_EMBREE
+
+    const bool coarse = m_lod_coarse;
+    for(auto elem : m_sensors)
+    {
+        elem.second->setLODCoarse(coarse);
+    }
+
+    #ifdef RMCL_EMBREE
+    if(m_stack)
+    {
+        m_stack->update(m_sensors_active);
+        m_stack->setRayMask(ray_mask);
+
+        // stacked sensors follow the level of detail of the leader
+        if(m_stack->active())
+        {
+            auto leader = m_sensors_active.find(m_stack->leader());
+            if(leader != m_sensors_active.end() && leader->second->usesLOD() && m_map_embree_lod)
+            {
+                m_stack->setMap(m_map_embree_lod);
+            } else {
+                m_stack->setMap(m_map_embree);
+            }
+        }
+    }
+    #endif // RMCL_EMBREE
+}
+
+#ifdef RMCL_CUDA
+void MICP::correct(
+    const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbm,
+    const rmagine::MemoryView<rmagine::Transform, rmagine::VRAM_CUDA>& Tbm_,
+    CorrectionPreResults<rm::VRAM_CUDA>& pre_res,
+    rmagine::MemoryView<rmagine::Transform, rmagine::VRAM_CUDA>& dT)
+{
+    preCorrect();
+
+    // std::cout << "correct runtimes: " << std::endl;
+    // rm::StopWatch sw;
+    // double el;
+    // double el_total = 0.0;
+
+
+    // sw();
+    // extra memory
+    std::vector<CorrectionPreResults<rm::VRAM_CUDA> > results(m_sensors_active.size());
+    float weight_sum = 0.0;
+    std::vector<float> weights(m_sensors_active.size());
+
+    for(auto& elem : results)
+    {
+        elem.ms.resize(Tbm.size());
+        elem.ds.resize(Tbm.size());
+        elem.Cs.resize(Tbm.size());
+        elem.Ncorr.resize(Tbm.size());
+    }
+
+    // sw();
+    size_t id = 0;
+    for(auto elem : m_sensors_active)
+    {
+        CorrectionPreResults<rm::VRAM_CUDA>& res_ = results[id];
+
+        if(elem.second->data_received_once)
+        {
+            float w = elem.second->corr_weight;
+
+            #ifdef RMCL_EMBREE
+            if(elem.second->backend == 0)
+            {
+                CorrectionPreResults<rm::RAM> res;
+                res.ms.resize(Tbm.size());
+                res.ds.resize(Tbm.size());
+                res.Cs.resize(Tbm.size());
+                res.Ncorr.resize(Tbm.size());
+
+                // compute
+                w = computeCovsEmbree(elem.second, Tbm, res);
+
+                // upload
+                res_.ms = res.ms;
+                res_.ds = res.ds;
+                res_.Cs = res.Cs;
+                res_.Ncorr = res.Ncorr;
+            } else 
+            #endif // RMCL_EMBREE
+            #ifdef RMCL_OPTIX
+            if(elem.second->backend == 1) {
+                // use preuploaded poses as input
+                elem.second->computeCovs(Tbm_, res_);
+            } else
+            #endif // RMCL_OPTIX
+            {
+                std::cout << "backend " << elem.second->backend << " unknown" << std::endl;
+            }
+
+            // dynamic weights
+            weight_sum += w;
+            weights[id] = w;
+        } else {
+            std::cout << "WARNING: still waiting for sensor data of " << elem.second->name << std::endl; 
+            weights[id] = 0.0;
+        }
+
+        id++;
+    }
+    
+    if(results.size() > 0 && weight_sum > 0.0)
+    {
+        // normalize weights
+        // sw();
+        for(size_t i=0; i<weights.size(); i++)
+        {
+            weights[i] /= weight_sum;
+        }
+
+        // CorrectionPreResults<rm::VRAM_CUDA> results_combined;
+        // pre_res;
+        if(pre_res.ms.size() < Tbm.size())
+        {
+            pre_res.ms.resize(Tbm.size());
+            pre_res.ds.resize(Tbm.size());
+            pre_res.Cs.resize(Tbm.size());
+            pre_res.Ncorr.resize(Tbm.size());
+        }
+
+        weighted_average(
+            results,
+            weights,
+            pre_res);
+
+        m_corr_gpu->correction_from_covs(pre_res, dT);
+    } else {
+        // no sensor is ready yet
+        // set identity
+        rm::setIdentity(dT);
+    }
+}
+#endif // RMCL_CUDA
+
+#ifdef RMCL_CUDA
+void MICP::correct(
+    const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbm,
+    const rmagine::MemoryView<rmagine::Transform, rmagine::VRAM_CUDA>& Tbm_,
+    CorrectionPreResults<rmagine::RAM>& pre_res,
+    rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& dT)
+{
+    preCorrect();
+
+    // extra memory
+    std::vector<CorrectionPreResults<rm::RAM> > results(m_sensors_active.size());
+    float weight_sum = 0.0;
+    std::vector<float> weights(m_sensors_active.size());
+
+    for(auto& elem : results)
+    {
+        elem.ms.resize(Tbm.size());
+        elem.ds.resize(Tbm.size());
+        elem.Cs.resize(Tbm.size());
+        elem.Ncorr.resize(Tbm.size());
+    }
+
+    size_t id = 0;
+    for(auto elem : m_sensors_active)
     {
         CorrectionPreResults<rm::RAM>& res = results[id];
         if(elem.second->data_received_once)
         {
+            float w = elem.second->corr_weight;
+
             #ifdef RMCL_EMBREE
             if(elem.second->backend == 0)
             {
                 // compute
-                elem.second->computeCovs(Tbm, res);
+                w = computeCovsEmbree(elem.second, Tbm, res);
             } else 
             #endif // RMCL_EMBREE
             #ifdef RMCL_OPTIX
@@ -1082,7 +1865,6 @@ void MICP::correct(
 
 
             // dynamic weights
-            float w = elem.second->corr_weight;
             weight_sum += w;
             weights[id] = w;
         } else {
@@ -1093,7 +1875,7 @@ void MICP::correct(
         id++;
     }
     
-    if(results.size() > 0)
+    if(results.size() > 0 && weight_sum > 0.0)
     {
         // normalize weights
         // sw();
@@ -1138,7 +1920,7 @@ void MICP::correct(
         // std::cout << "- C -> dT: " << el * 1000.0 << " ms" << std::endl;
         // std::cout << "- total: " << el_total * 1000.0 << " ms" << std::endl;
     } else {
-        std::cout << "0 sensors" << std::endl;
+        // no sensor is ready yet
         // set identity
         for(size_t i=0; i<dT.size(); i++)
         {
@@ -1154,13 +1936,15 @@ void MICP::correct(
     CorrectionPreResults<rmagine::VRAM_CUDA>& pre_res,
     rmagine::MemoryView<rmagine::Transform, rmagine::VRAM_CUDA>& dT)
 {
+    preCorrect();
+
     #ifdef RMCL_EMBREE
     rm::Memory<rm::Transform, rm::RAM> Tbm_ = Tbm;
     #endif // RMCL_EMBREE
 
-    std::vector<CorrectionPreResults<rm::VRAM_CUDA> > results(m_sensors.size());
+    std::vector<CorrectionPreResults<rm::VRAM_CUDA> > results(m_sensors_active.size());
     float weight_sum = 0.0;
-    std::vector<float> weights(m_sensors.size());
+    std::vector<float> weights(m_sensors_active.size());
 
     for(auto& elem : results)
     {
@@ -1172,12 +1956,14 @@ void MICP::correct(
 
 
     size_t id = 0;
-    for(auto elem : m_sensors)
+    for(auto elem : m_sensors_active)
     {
         if(elem.second->data_received_once)
         {
             CorrectionPreResults<rm::VRAM_CUDA>& res = results[id];
 
+            float w = elem.second->corr_weight;
+
             #ifdef RMCL_EMBREE
             if(elem.second->backend == 0)
             {
@@ -1188,7 +1974,7 @@ void MICP::correct(
                 res_.Cs.resize(Tbm.size());
                 res_.Ncorr.resize(Tbm.size());
 
-                elem.second->computeCovs(Tbm_, res_);
+                w = computeCovsEmbree(elem.second, Tbm_, res_);
 
                 // download
                 res.ms = res_.ms;
@@ -1209,7 +1995,6 @@ void MICP::correct(
             }
 
             // dynamic weights
-            float w = elem.second->corr_weight;
             weight_sum += w;
             weights[id] = w;
         } else {
@@ -1221,7 +2006,7 @@ void MICP::correct(
     }
 
 
-    if(results.size() > 0)
+    if(results.size() > 0 && weight_sum > 0.0)
     {
         // normalize weights
         // sw();
@@ -1263,7 +2048,7 @@ void MICP::correct(
 
         // std::cout << "- C -> dT: " << el * 1000.0 << " ms" << std::endl;
     } else {
-        // std::cout << "0 sensors" << std::endl;
+        // no sensor is ready yet
         // set identity
         for(size_t i=0; i<dT.size(); i++)
         {
@@ -1278,6 +2063,8 @@ void MICP::correct(
     CorrectionPreResults<rm::RAM>& pre_res,
     rm::MemoryView<rm::Transform, rm::RAM>& dT)
 {
+    preCorrect();
+
     // rm::StopWatch sw;
     // double el;
     // double el_total = 0.0;
@@ -1289,9 +2076,9 @@ void MICP::correct(
     rm::Memory<rm::Transform, rm::VRAM_CUDA> Tbm_ = Tbm;
     #endif // RMCL_OPTIX
 
-    std::vector<CorrectionPreResults<rm::RAM> > results(m_sensors.size());
+    std::vector<CorrectionPreResults<rm::RAM> > results(m_sensors_active.size());
     float weight_sum = 0.0;
-    std::vector<float> weights(m_sensors.size());
+    std::vector<float> weights(m_sensors_active.size());
 
     for(auto& elem : results)
     {
@@ -1308,16 +2095,18 @@ void MICP::correct(
 
     // sw();
     size_t id = 0;
-    for(auto elem : m_sensors)
+    for(auto elem : m_sensors_active)
     {
         if(elem.second->data_received_once)
         {
             CorrectionPreResults<rm::RAM>& res = results[id];
 
+            float w = elem.second->corr_weight;
+
             #ifdef RMCL_EMBREE
             if(elem.second->backend == 0)
             {
-                elem.second->computeCovs(Tbm, res);
+                w = computeCovsEmbree(elem.second, Tbm, res);
             } else
             #endif // RMCL_EMBREE
             #ifdef RMCL_OPTIX
@@ -1344,7 +2133,6 @@ void MICP::correct(
             }
 
             // dynamic weights
-            float w = elem.second->corr_weight;
             weight_sum += w;
             weights[id] = w;
         } else {
@@ -1358,7 +2146,7 @@ void MICP::correct(
     // el_total += el;
     // std::cout << "- computing covs (" << results.size() << " sensors): " << el * 1000.0 << " ms" << std::endl;
 
-    if(results.size() > 0)
+    if(results.size() > 0 && weight_sum > 0.0)
     {
         // normalize weights
         // sw();
@@ -1399,7 +2187,7 @@ void MICP::correct(
 
         // std::cout << "- C -> dT: " << el * 1000.0 << " ms" << std::endl;
     } else {
-        // std::cout << "0 sensors" << std::endl;
+        // no sensor is ready yet
         // set identity
         for(size_t i=0; i<dT.size(); i++)
         {
@@ -1409,6 +2197,309 @@ void MICP::correct(
     // std::cout << "- total: " << el_total * 1000.0 << " ms" << std::endl;
 }
 
+bool MICP::relocalize(
+    const RelocalizationParams& params,
+    std::vector<RelocalizationHypothesis>& hypotheses)
+{
+    hypotheses.clear();
+
+    #ifdef RMCL_EMBREE
+    preCorrect();
+    if(m_sensors_active.empty() || !m_map_embree)
+    {
+        return false;
+    }
+
+    rm::StopWatch sw;
+    sw();
+
+    // 1. CANDIDATES
+    rm::Memory<rm::Transform, rm::RAM> poses;
+    std::vector<float> yaws;
+    if(!params.place_db.empty())
+    {
+        if(!m_place_db || m_place_db->filename() != params.place_db)
+        {
+            try {
+                m_place_db = std::make_shared<PlaceDatabase>(params.place_db);
+            } catch(const std::runtime_error& ex) {
+                RCLCPP_ERROR_STREAM(m_nh->get_logger(), "MICP relocalization - " << ex.what());
+                return true;
+            }
+            std::cout << "MICP relocalization - loaded " << m_place_db->size() 
+                << " places of '" << params.place_db << "'" << std::endl;
+        }
+
+        // current scans of all sensors in base coordinates
+        std::vector<rm::Vector> points;
+        for(auto elem : m_sensors_active)
+        {
+            const MICPRangeSensorPtr sensor = elem.second;
+            if(sensor->type == 0)
+            {
+                append_points_base(std::get<0>(sensor->model), sensor->ranges, sensor->Tsb, points);
+            } else if(sensor->type == 2) {
+                append_points_base(std::get<2>(sensor->model), sensor->ranges, sensor->Tsb, points);
+            } else if(sensor->type == 3) {
+                append_points_base(std::get<3>(sensor->model), sensor->ranges, sensor->Tsb, points);
+            }
+            // depth cameras see too little of the place
+        }
+
+        std::vector<PlaceCandidate> places;
+        m_place_db->query(rm::MemoryView<rm::Vector, rm::RAM>(points.data(), points.size()), 
+            params.place_candidates, places);
+
+        poses.resize(places.size());
+        yaws.resize(places.size());
+        for(size_t i=0; i<places.size(); i++)
+        {
+            poses[i] = places[i].Tbm;
+            const rm::EulerAngles e = places[i].Tbm.R;
+            yaws[i] = e.yaw;
+        }
+    } else {
+        const std::vector<rm::Vector> positions = relocalization_positions(m_map_embree, params, m_ray_mask);
+        const size_t n_yaw = std::max(params.yaw_steps, 1u);
+
+        poses.resize(positions.size() * n_yaw);
+        yaws.resize(positions.size() * n_yaw);
+        for(size_t i=0; i<positions.size(); i++)
+        {
+            for(size_t k=0; k<n_yaw; k++)
+            {
+                const size_t id = i * n_yaw + k;
+                yaws[id] = -M_PI + 2.0 * M_PI * static_cast<float>(k) / static_cast<float>(n_yaw);
+                poses[id].t = positions[i];
+                poses[id].R.set(rm::EulerAngles{0.0, 0.0, yaws[id]});
+            }
+        }
+    }
+
+    const size_t n_cand = poses.size();
+    if(n_cand == 0)
+    {
+        std::cout << "MICP relocalization - no candidate poses found" << std::endl;
+        return true;
+    }
+
+    // wide correspondences for the coarse grid. An override instead of 
+    // corr_params: data callbacks in between keep using it, and the 
+    // adapted parameters stay untouched
+    float max_distance_old = 0.0;
+    for(auto elem : m_sensors_active)
+    {
+        {
+            std::lock_guard<std::mutex> sensor_guard(elem.second->corr_mutex);
+            max_distance_old = std::max(max_distance_old, elem.second->corr_params.max_distance);
+        }
+        elem.second->overrideMaxDistance(params.max_distance);
+    }
+    if(m_stack)
+    {
+        m_stack->setMaxDistance(params.max_distance);
+    }
+
+    // the simplified map is good enough to rank the candidates
+    const bool lod_coarse = m_lod_coarse;
+    m_lod_coarse = true;
+
+    // 2. SCORING. Correspondences of every candidate in large batches
+    std::vector<unsigned int> scores(n_cand, 0);
+    const size_t batch_size = std::max(params.batch_size, 1u);
+    for(size_t i0 = 0; i0 < n_cand; i0 += batch_size)
+    {
+        const size_t i1 = std::min(i0 + batch_size, n_cand);
+
+        rm::Memory<rm::Transform, rm::RAM> dT(i1 - i0);
+        CorrectionPreResults<rm::RAM> covs;
+        correct(poses(i0, i1), covs, dT);
+
+        for(size_t i=i0; i<i1 && i - i0 < covs.Ncorr.size(); i++)
+        {
+            scores[i] = covs.Ncorr[i - i0];
+        }
+    }
+    const double el_scoring = sw();
+
+    // 3. CLUSTERING. Best first, drop candidates near a better one.
+    // Not dbscan_poses: its chaining merges the evenly spaced candidate
+    // grid into a single cluster
+    std::vector<size_t> order(n_cand);
+    for(size_t i=0; i<n_cand; i++)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return scores[a] > scores[b];
+    });
+
+    std::vector<size_t> selected;
+    for(size_t id : order)
+    {
+        if(selected.size() >= params.top_k || scores[id] == 0)
+        {
+            break;
+        }
+
+        bool near = false;
+        for(size_t sid : selected)
+        {
+            const rm::Vector d = poses[id].t - poses[sid].t;
+            const float dyaw = std::fabs(std::remainder(yaws[id] - yaws[sid], 2.0 * M_PI));
+            if(d.l2norm() < params.cluster_dist && dyaw < params.cluster_yaw)
+            {
+                near = true;
+                break;
+            }
+        }
+
+        if(!near)
+        {
+            selected.push_back(id);
+        }
+    }
+
+    // 4. REFINEMENT. All hypotheses in one batch
+    if(!selected.empty())
+    {
+        m_lod_coarse = false;
+
+        rm::Memory<rm::Transform, rm::RAM> Tbms(selected.size());
+        for(size_t i=0; i<selected.size(); i++)
+        {
+            Tbms[i] = poses[selected[i]];
+        }
+
+        rm::Memory<rm::Transform, rm::RAM> dT(Tbms.size());
+        CorrectionPreResults<rm::RAM> covs;
+        for(unsigned int it=0; it<params.iterations; it++)
+        {
+            correct(Tbms, covs, dT);
+            Tbms = rm::multNxN(Tbms, dT);
+        }
+        // correspondences at the refined poses
+        correct(Tbms, covs, dT);
+
+        size_t n_ranges_valid = 0;
+        for(auto elem : m_sensors_active)
+        {
+            n_ranges_valid += elem.second->n_ranges_valid;
+        }
+
+        hypotheses.resize(Tbms.size());
+        for(size_t i=0; i<Tbms.size(); i++)
+        {
+            hypotheses[i].Tbm = Tbms[i];
+            hypotheses[i].Ncorr = (i < covs.Ncorr.size()) ? covs.Ncorr[i] : 0;
+            hypotheses[i].match_ratio = (n_ranges_valid > 0) 
+                ? static_cast<float>(hypotheses[i].Ncorr) / static_cast<float>(n_ranges_valid) : 0.0;
+        }
+
+        std::sort(hypotheses.begin(), hypotheses.end(), 
+            [](const RelocalizationHypothesis& a, const RelocalizationHypothesis& b) {
+                return a.Ncorr > b.Ncorr;
+            });
+    }
+
+    for(auto elem : m_sensors_active)
+    {
+        elem.second->overrideMaxDistance(0.0);
+    }
+    if(m_stack)
+    {
+        m_stack->setMaxDistance(max_distance_old);
+    }
+    m_lod_coarse = lod_coarse;
+
+    const double el_total = sw() + el_scoring;
+    std::cout << "MICP relocalization - " << n_cand << " hypotheses in " << el_scoring << "s (" 
+        << static_cast<double>(n_cand) / el_scoring << "/s), refined " << hypotheses.size() 
+        << " in " << el_total - el_scoring << "s" << std::endl;
+
+    return true;
+    #else // RMCL_EMBREE
+    (void)params;
+    hypotheses.clear();
+    RCLCPP_ERROR_ONCE(m_nh->get_logger(), "MICP relocalization requires the Embree backend");
+    return false;
+    #endif // RMCL_EMBREE
+}
+
+bool MICP::scorePoses(
+    const rm::MemoryView<rm::Transform, rm::RAM>& Tbms,
+    std::vector<PoseScore>& scores)
+{
+    scores.assign(Tbms.size(), PoseScore());
+
+    #ifdef RMCL_EMBREE
+    // scores on the full map. The simplified map is only good for ranking
+    const bool lod_coarse = m_lod_coarse;
+    m_lod_coarse = false;
+    preCorrect();
+    m_lod_coarse = lod_coarse;
+
+    if(m_sensors_active.empty() || !m_map_embree)
+    {
+        return false;
+    }
+
+    const size_t N = Tbms.size();
+
+    CorrectionPreResults<rm::RAM> res;
+    res.ds.resize(N);
+    res.ms.resize(N);
+    res.Cs.resize(N);
+    res.Ncorr.resize(N);
+    res.residuals.resize(N);
+
+    std::vector<float> residual_sums(N, 0.0);
+    size_t n_ranges_valid = 0;
+
+    for(auto elem : m_sensors_active)
+    {
+        const MICPRangeSensorPtr sensor = elem.second;
+        if(sensor->backend != 0)
+        {
+            continue;
+        }
+
+        if(!sensor->count_valid_ranges)
+        {
+            sensor->countValidRanges();
+        }
+        n_ranges_valid += sensor->n_ranges_valid;
+
+        computeCovsEmbree(sensor, Tbms, res);
+
+        for(size_t i=0; i<N; i++)
+        {
+            scores[i].Ncorr += res.Ncorr[i];
+            residual_sums[i] += res.residuals[i] * static_cast<float>(res.Ncorr[i]);
+        }
+    }
+
+    for(size_t i=0; i<N; i++)
+    {
+        PoseScore& score = scores[i];
+        if(score.Ncorr > 0)
+        {
+            score.residual = residual_sums[i] / static_cast<float>(score.Ncorr);
+        }
+        if(n_ranges_valid > 0)
+        {
+            score.match_ratio = static_cast<float>(score.Ncorr) / static_cast<float>(n_ranges_valid);
+        }
+    }
+
+    return true;
+    #else // RMCL_EMBREE
+    (void)Tbms;
+    RCLCPP_ERROR(m_nh->get_logger(), "MICP pose scoring requires the Embree backend");
+    return false;
+    #endif // RMCL_EMBREE
+}
+
 bool MICP::checkTF(bool prints)
 {
     std::cout << std::endl;
@@ -1426,9 +2517,9 @@ bool MICP::checkTF(bool prints)
         
         int num_tries = 10;
 
-        rclcpp::ExecutorOptions opts;
-        rclcpp::executors::SingleThreadedExecutor executor(opts);
-        executor.add_node(m_nh);
+        // the transform listener spins its own node in a separate thread.
+        // Do not add m_nh to a local executor: it might already be added
+        // to the executor of a component container
         rclcpp::Rate r(20);
 
         while(rclcpp::ok() && num_tries > 0 && !odom_to_base_available )
@@ -1441,7 +2532,6 @@ bool MICP::checkTF(bool prints)
             }
 
             r.sleep();
-            executor.spin_once();
             num_tries--;
         }
 
@@ -1481,63 +2571,63 @@ void MICP::checkTopic(
     if(info.msg == "sensor_msgs/msg/PointCloud2")
     {
         sensor_msgs::msg::PointCloud2 msg;
-        if(rclcpp::wait_for_message(msg, m_nh, info.name, timeout.to_chrono<ChronoDuration>()))
+        if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), info.name, timeout.to_chrono<ChronoDuration>()))
         {
             info.data = true;
             info.frame = msg.header.frame_id;
         }
     } else if(info.msg == "sensor_msgs/msg/PointCloud") {
         sensor_msgs::msg::PointCloud msg;
-        if(rclcpp::wait_for_message(msg, m_nh, info.name, timeout.to_chrono<ChronoDuration>()))
+        if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), info.name, timeout.to_chrono<ChronoDuration>()))
         {
             info.data = true;
             info.frame = msg.header.frame_id;
         }
     } else if(info.msg == "sensor_msgs/msg/LaserScan") {
         sensor_msgs::msg::LaserScan msg;
-        if(rclcpp::wait_for_message(msg, m_nh, info.name, timeout.to_chrono<ChronoDuration>()))
+        if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), info.name, timeout.to_chrono<ChronoDuration>()))
         {
             info.data = true;
             info.frame = msg.header.frame_id;
         }
     } else if(info.msg == "sensor_msgs/msg/Image") {
         sensor_msgs::msg::Image msg;
-        if(rclcpp::wait_for_message(msg, m_nh, info.name, timeout.to_chrono<ChronoDuration>()))
+        if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), info.name, timeout.to_chrono<ChronoDuration>()))
         {
             info.data = true;
             info.frame = msg.header.frame_id;
         }
     } else if(info.msg == "sensor_msgs/msg/CameraInfo") {
         sensor_msgs::msg::CameraInfo msg;
-        if(rclcpp::wait_for_message(msg, m_nh, info.name, timeout.to_chrono<ChronoDuration>()))
+        if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), info.name, timeout.to_chrono<ChronoDuration>()))
         {
             info.data = true;
             info.frame = msg.header.frame_id;
         }
     } else if(info.msg == "rmcl_msgs/msg/ScanStamped") {
         rmcl_msgs::msg::ScanStamped msg;
-        if(rclcpp::wait_for_message(msg, m_nh, info.name, timeout.to_chrono<ChronoDuration>()))
+        if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), info.name, timeout.to_chrono<ChronoDuration>()))
         {
             info.data = true;
             info.frame = msg.header.frame_id;
         }
     } else if(info.msg == "rmcl_msgs/msg/DepthStamped") {
         rmcl_msgs::msg::DepthStamped msg;
-        if(rclcpp::wait_for_message(msg, m_nh, info.name, timeout.to_chrono<ChronoDuration>()))
+        if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), info.name, timeout.to_chrono<ChronoDuration>()))
         {
             info.data = true;
             info.frame = msg.header.frame_id;
         }
     } else if(info.msg == "rmcl_msgs/msg/O1DnStamped") {
         rmcl_msgs::msg::O1DnStamped msg;
-        if(rclcpp::wait_for_message(msg, m_nh, info.name, timeout.to_chrono<ChronoDuration>()))
+        if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), info.name, timeout.to_chrono<ChronoDuration>()))
         {
             info.data = true;
             info.frame = msg.header.frame_id;
         }
     } else if(info.msg == "rmcl_msgs/msg/OnDnStamped") {
         rmcl_msgs::msg::OnDnStamped msg;
-        if(rclcpp::wait_for_message(msg, m_nh, info.name, timeout.to_chrono<ChronoDuration>()))
+        if(rclcpp::wait_for_message(msg, m_nh->shared_from_this(), info.name, timeout.to_chrono<ChronoDuration>()))
         {
             info.data = true;
             info.frame = msg.header.frame_id;
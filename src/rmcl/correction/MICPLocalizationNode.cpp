@@ -0,0 +1,777 @@
+#include "rmcl/correction/MICPLocalizationNode.hpp"
+
+#include <rmagine/util/prints.h>
+#include <rmagine/util/StopWatch.hpp>
+#include <rmagine/math/math.h>
+#ifdef RMCL_CUDA
+#include <rmagine/math/math.cuh>
+#endif // RMCL_CUDA
+
+#include <rmcl/util/checkpoint.h>
+#include <rmcl/util/conversions.h>
+#include <rmcl/util/ros_helper.h>
+
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+MICPLocalizationNode::MICPLocalizationNode(
+    const rclcpp::NodeOptions& options)
+:rclcpp::Node("micp_localization", rclcpp::NodeOptions(options)
+    .allow_undeclared_parameters(true)
+    .automatically_declare_parameters_from_overrides(true))
+{
+    m_base_frame = rmcl::get_parameter(this, "base_frame", "base_link");
+    m_odom_frame = rmcl::get_parameter(this, "odom_frame", "odom");
+    m_map_frame = rmcl::get_parameter(this, "map_frame", "map");
+
+    m_has_odom_frame = (m_odom_frame != "");
+
+    if(!m_has_odom_frame)
+    {
+        std::cout << "WARNING! Odom frame not specified -> you are entering untested terrain" << std::endl;
+    }
+
+    m_tf_rate = rmcl::get_parameter(this, "tf_rate", 50.0);
+    m_invert_tf = rmcl::get_parameter(this, "invert_tf", false);
+
+    m_corr_rate_max = rmcl::get_parameter(this, "micp.corr_rate_max", 10000.0);
+    m_print_corr_rate = rmcl::get_parameter(this, "micp.print_corr_rate", false);
+
+    m_adaptive_max_dist = rmcl::get_parameter(this, "micp.adaptive_max_dist", true);
+
+    m_correction_disabled = rmcl::get_parameter(this, "micp.disable_corr", false);
+
+    m_checkpoint_file = rmcl::get_parameter(this, "checkpoint.file", "");
+    m_checkpoint_period = rmcl::get_parameter(this, "checkpoint.period", 1.0);
+    m_checkpoint_restore = rmcl::get_parameter(this, "checkpoint.restore", true);
+    m_checkpoint_max_age = rmcl::get_parameter(this, "checkpoint.max_age", 0.0);
+
+    m_reloc_params.step = rmcl::get_parameter(this, "relocalization.step", m_reloc_params.step);
+    m_reloc_params.yaw_steps = rmcl::get_parameter(this, "relocalization.yaw_steps", 12);
+    m_reloc_params.floor = rmcl::get_parameter(this, "relocalization.floor", m_reloc_params.floor);
+    m_reloc_params.base_height = rmcl::get_parameter(this, "relocalization.base_height", m_reloc_params.base_height);
+    m_reloc_params.min_headroom = rmcl::get_parameter(this, "relocalization.min_headroom", m_reloc_params.min_headroom);
+    m_reloc_params.z = rmcl::get_parameter(this, "relocalization.z", m_reloc_params.z);
+    m_reloc_params.place_db = rmcl::get_parameter(this, "relocalization.place_db", "");
+    m_reloc_params.place_candidates = rmcl::get_parameter(this, "relocalization.place_candidates", 50);
+    m_reloc_params.max_distance = rmcl::get_parameter(this, "relocalization.max_dist", m_reloc_params.max_distance);
+    m_reloc_params.batch_size = rmcl::get_parameter(this, "relocalization.batch_size", 4096);
+    m_reloc_params.cluster_dist = rmcl::get_parameter(this, "relocalization.cluster_dist", m_reloc_params.cluster_dist);
+    m_reloc_params.cluster_yaw = rmcl::get_parameter(this, "relocalization.cluster_yaw", m_reloc_params.cluster_yaw);
+    m_reloc_params.top_k = rmcl::get_parameter(this, "relocalization.top_k", 10);
+    m_reloc_params.iterations = rmcl::get_parameter(this, "relocalization.iterations", 20);
+    m_reloc_lost_match_ratio = rmcl::get_parameter(this, "relocalization.lost_match_ratio", 0.0);
+    m_reloc_lost_time = rmcl::get_parameter(this, "relocalization.lost_time", 5.0);
+
+    m_initial_pose_offset = rm::Transform::Identity();
+    std::vector<double> trans, rot;
+    
+    if(this->get_parameter("micp.trans", trans))
+    {
+        if(trans.size() == 3)
+        {
+            m_initial_pose_offset.t.x = trans[0];
+            m_initial_pose_offset.t.y = trans[1];
+            m_initial_pose_offset.t.z = trans[2];
+        } else {
+            RCLCPP_WARN(this->get_logger(), "micp.trans must have 3 entries. Ignoring it.");
+        }
+    }
+
+    if(this->get_parameter("micp.rot", rot))
+    {
+        if(rot.size() == 3)
+        {
+            rm::EulerAngles e;
+            e.roll = rot[0];
+            e.pitch = rot[1];
+            e.yaw = rot[2];
+            m_initial_pose_offset.R.set(e);
+        } else if(rot.size() == 4) {
+            m_initial_pose_offset.R.x = rot[0];
+            m_initial_pose_offset.R.y = rot[1];
+            m_initial_pose_offset.R.z = rot[2];
+            m_initial_pose_offset.R.w = rot[3];
+        }
+    }
+
+    std::string combining_unit_str = rmcl::get_parameter(this, "micp.combining_unit", "cpu");
+    
+    if(combining_unit_str == "cpu")
+    {
+        m_combining_unit = 0;
+    } else if(combining_unit_str == "gpu") {
+        m_combining_unit = 1;
+    } else {
+        // ERROR
+        std::cout << "Combining Unit: " << combining_unit_str << " unknown!" << std::endl;
+        throw std::runtime_error("Combining Unit '" + combining_unit_str + "' unknown!");
+    }
+
+    m_Tom = rm::Transform::Identity();
+
+    m_T_base_odom.header.frame_id = m_odom_frame;
+    m_T_base_odom.child_frame_id = m_base_frame;
+    m_T_base_odom.transform.rotation.w = 1.0;
+    m_Tbo = rm::Transform::Identity();
+
+    m_tf_buffer = std::make_shared<tf2_ros::Buffer>(this->get_clock());
+    m_tf_listener = std::make_shared<tf2_ros::TransformListener>(*m_tf_buffer);
+    m_br = std::make_unique<tf2_ros::TransformBroadcaster>(this);
+
+    // the correction thread must not outlive the context, e.g. on Ctrl+C
+    m_on_shutdown_handle = this->get_node_base_interface()->get_context()->add_on_shutdown_callback(
+        [this]() -> void
+        {
+            shutdown();
+        });
+
+    // MICP waits for sensor topics with rclcpp::wait_for_message, which 
+    // needs shared_from_this(): not available inside the constructor. 
+    // Defer the rest to the first executor spin. init() blocks that 
+    // executor thread during the map load and the TF checks (seconds). 
+    // A multi-threaded executor keeps serving the other callbacks
+    m_init_timer = this->create_wall_timer(0ms, [this]() -> void
+    {
+        m_init_timer->cancel();
+        init();
+    });
+}
+
+MICPLocalizationNode::~MICPLocalizationNode()
+{
+    // unloaded from a component container before the context shuts down
+    this->get_node_base_interface()->get_context()->remove_on_shutdown_callback(m_on_shutdown_handle);
+    shutdown();
+}
+
+void MICPLocalizationNode::shutdown()
+{
+    std::lock_guard<std::mutex> guard(m_shutdown_mutex);
+    if(m_shut_down)
+    {
+        return;
+    }
+    m_shut_down = true;
+
+    m_stop_correction_thread = true;
+    if(m_correction_thread.joinable())
+    {
+        m_correction_thread.join();
+    }
+    // the thread might never have started
+    cancelPendingPoses();
+
+    // latest state for the next start
+    if(m_micp && m_checkpoint_file != "")
+    {
+        if(m_checkpoint_timer)
+        {
+            m_checkpoint_timer->cancel();
+        }
+        saveCheckpoint();
+    }
+}
+
+void MICPLocalizationNode::init()
+{
+    m_micp = std::make_shared<MICP>(this);
+    m_micp->loadParams();
+
+    if(m_checkpoint_file != "" && m_checkpoint_restore)
+    {
+        restoreCheckpoint();
+    }
+
+    m_pose_sub = this->create_subscription<geometry_msgs::msg::PoseStamped>(
+        "pose", 1, 
+        [this](const geometry_msgs::msg::PoseStamped::ConstSharedPtr msg) -> void
+        {
+            poseCB(msg);
+        });
+
+    m_pose_wc_sub = this->create_subscription<geometry_msgs::msg::PoseWithCovarianceStamped>(
+        "pose_wc", 1, 
+        [this](const geometry_msgs::msg::PoseWithCovarianceStamped::ConstSharedPtr msg) -> void
+        {
+            poseWcCB(msg);
+        });
+
+    // the correction thread picks the request up
+    m_relocalize_srv = this->create_service<std_srvs::srv::Trigger>(
+        "~/relocalize",
+        [this](
+            const std::shared_ptr<std_srvs::srv::Trigger::Request> req,
+            std::shared_ptr<std_srvs::srv::Trigger::Response> res) -> void
+        {
+            (void)req;
+            m_relocalize_requested = true;
+            res->success = true;
+            res->message = "Relocalization scheduled";
+        });
+
+    if(!m_pose_received && rmcl::get_parameter(this, "relocalization.on_start", false))
+    {
+        m_relocalize_requested = true;
+    }
+
+    // CORRECTION THREAD
+    {
+        // the context might have been shut down while loading
+        std::lock_guard<std::mutex> guard(m_shutdown_mutex);
+        if(m_shut_down)
+        {
+            return;
+        }
+        m_stop_correction_thread = false;
+        m_correction_thread = std::thread([this]() -> void
+        {
+            correctionLoop();
+        });
+    }
+
+    // MAIN LOOP TF
+    m_last_tf_stamp = this->now();
+    m_tf_timer = this->create_wall_timer(
+        std::chrono::duration<double>(1.0 / m_tf_rate), 
+        [this]() -> void
+        {
+            tfLoop();
+        });
+
+    if(m_checkpoint_file != "")
+    {
+        m_checkpoint_timer = this->create_wall_timer(
+            std::chrono::duration<double>(m_checkpoint_period), 
+            [this]() -> void
+            {
+                saveCheckpoint();
+            });
+    }
+
+    std::cout << "TF Rate: " << m_tf_rate << std::endl;
+    if(m_relocalize_requested)
+    {
+        std::cout << "Relocalizing once the sensors are ready..." << std::endl;
+    } else if(!m_pose_received) {
+        std::cout << "Waiting for pose guess..." << std::endl;
+    }
+}
+
+void MICPLocalizationNode::fetchTF()
+{
+    std::lock_guard<std::mutex> guard(m_T_base_odom_mutex);
+
+    if(m_has_odom_frame)
+    {
+        try {
+            m_T_base_odom = m_tf_buffer->lookupTransform(m_odom_frame, m_base_frame, tf2::TimePointZero);
+        }
+        catch (tf2::TransformException &ex) {
+            RCLCPP_WARN(this->get_logger(), "%s", ex.what());
+            RCLCPP_WARN_STREAM(this->get_logger(), "Source (Base): " << m_base_frame << ", Target (Odom): " << m_odom_frame);
+            return;
+        }
+    } else {
+        m_T_base_odom.header.frame_id = m_odom_frame;
+        m_T_base_odom.child_frame_id = m_base_frame;
+        m_T_base_odom.transform.translation.x = 0.0;
+        m_T_base_odom.transform.translation.y = 0.0;
+        m_T_base_odom.transform.translation.z = 0.0;
+        m_T_base_odom.transform.rotation.x = 0.0;
+        m_T_base_odom.transform.rotation.y = 0.0;
+        m_T_base_odom.transform.rotation.z = 0.0;
+        m_T_base_odom.transform.rotation.w = 1.0;
+    }
+
+    convert(m_T_base_odom.transform, m_Tbo);
+}
+
+void MICPLocalizationNode::updateTF()
+{
+    geometry_msgs::msg::TransformStamped T;
+
+    rm::Transform Tom, Tbo;
+    {
+        std::lock_guard<std::mutex> guard1(m_T_base_odom_mutex);
+        std::lock_guard<std::mutex> guard2(m_T_odom_map_mutex);
+        Tom = m_Tom;
+        Tbo = m_Tbo;
+    }
+
+    // What is the source frame?
+    if(m_has_odom_frame)
+    {
+        // With EKF and base_frame: Send odom to map
+        if(!m_invert_tf)
+        {
+            convert(Tom, T.transform);
+            T.header.frame_id = m_map_frame;
+            T.child_frame_id = m_odom_frame;
+        } else {
+            convert(~Tom, T.transform);
+            T.header.frame_id = m_odom_frame;
+            T.child_frame_id = m_map_frame;
+        }
+    } else {
+        // With base but no EKF: send base to map
+        auto Tbm = Tom * Tbo;
+        if(!m_invert_tf)
+        {
+            convert(Tbm, T.transform);
+            T.header.frame_id = m_map_frame;
+            T.child_frame_id = m_base_frame;
+        } else {
+            convert(~Tbm, T.transform);
+            T.header.frame_id = m_base_frame;
+            T.child_frame_id = m_map_frame;
+        }
+    }
+
+    T.header.stamp = this->now();
+    m_br->sendTransform(T);
+}
+
+void MICPLocalizationNode::correctOnce()
+{
+    std::lock_guard<std::mutex> guard1(m_T_base_odom_mutex);
+    std::lock_guard<std::mutex> guard2(m_T_odom_map_mutex);
+
+    // adapted parameters of a restored checkpoint
+    if(!m_checkpoint_max_distances.empty())
+    {
+        for(auto elem : m_micp->sensors())
+        {
+            auto it = m_checkpoint_max_distances.find(elem.first);
+            if(it != m_checkpoint_max_distances.end())
+            {
+                std::lock_guard<std::mutex> sensor_guard(elem.second->corr_mutex);
+                elem.second->corr_params.max_distance = it->second;
+                m_checkpoint_max_distances.erase(it);
+            }
+        }
+    }
+
+    // 1. Get Base in Map
+    rm::Transform Tbm = m_Tom * m_Tbo;
+    m_micp->setMapCenter(Tbm.t);
+
+    rm::Memory<rm::Transform, rm::RAM> poses(m_Nposes);
+    for(size_t i=0; i<m_Nposes; i++)
+    {
+        poses[i] = Tbm;
+    }
+
+    rm::Transform dT0;
+    unsigned int ncorr0 = 0;
+
+    #ifdef RMCL_CUDA
+        // exact copy of poses
+        rm::Memory<rm::Transform, rm::VRAM_CUDA> poses_ = poses;
+
+        // 0: use CPU to combine sensor corrections
+        // 1: use GPU to combine sensor corrections
+        if(m_combining_unit == 0)
+        { // CPU version
+
+            rm::Memory<rm::Transform, rm::RAM> dT(poses.size());
+            CorrectionPreResults<rm::RAM> covs;
+
+            m_micp->correct(poses, poses_, covs, dT);
+            poses = rm::multNxN(poses, dT);
+            dT0 = dT[0];
+            ncorr0 = (covs.Ncorr.size() > 0) ? covs.Ncorr[0] : 0;
+        }
+        else if(m_combining_unit == 1)
+        { // GPU version
+
+            rm::Memory<rm::Transform, rm::VRAM_CUDA> dT_(poses.size());
+            CorrectionPreResults<rm::VRAM_CUDA> covs_;
+
+            m_micp->correct(poses, poses_, covs_, dT_);
+            poses_ = rm::multNxN(poses_, dT_);
+            // download
+            poses = poses_;
+            rm::Memory<rm::Transform, rm::RAM> dT = dT_(0,1);
+            rm::Memory<unsigned int, rm::RAM> Ncorr = covs_.Ncorr(0,1);
+            dT0 = dT[0];
+            ncorr0 = Ncorr[0];
+        }
+    #else // RMCL_CUDA
+        
+        // 0: use CPU to combine sensor corrections
+        // 1: use GPU to combine sensor corrections
+        if(m_combining_unit == 0)
+        { // CPU version
+
+            rm::Memory<rm::Transform, rm::RAM> dT(poses.size());
+            CorrectionPreResults<rm::RAM> covs;
+
+            m_micp->correct(poses, covs, dT);
+            poses = rm::multNxN(poses, dT);
+            dT0 = dT[0];
+            ncorr0 = (covs.Ncorr.size() > 0) ? covs.Ncorr[0] : 0;
+        }
+        else if(m_combining_unit == 1)
+        { // GPU version
+
+            std::cout << "ERROR: combining unit " << m_combining_unit << " not available" << std::endl;
+        }
+    #endif // RMCL_CUDA
+
+    // large corrections: next steps on the simplified map
+    m_micp->updateLOD(dT0);
+
+    unsigned int n_valid_ranges = 0;
+    for(auto elem : m_micp->sensors())
+    {
+        n_valid_ranges += elem.second->n_ranges_valid;
+    }
+
+    float match_ratio = 0.0;
+    if(n_valid_ranges > 0)
+    {
+        match_ratio = static_cast<float>(ncorr0) / static_cast<float>(n_valid_ranges);
+    }
+
+    // tracking lost: relocalize once the matches stay low for a while
+    if(m_reloc_lost_match_ratio > 0.0 && n_valid_ranges > 0)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if(match_ratio >= m_reloc_lost_match_ratio)
+        {
+            m_lost = false;
+        } else if(!m_lost) {
+            m_lost = true;
+            m_lost_since = now;
+        } else if(now - m_lost_since > std::chrono::duration<double>(m_reloc_lost_time)) {
+            RCLCPP_WARN_STREAM(this->get_logger(), "Tracking lost (match ratio: " << match_ratio << "). Relocalizing");
+            m_relocalize_requested = true;
+            m_lost = false;
+        }
+    }
+
+    if(m_adaptive_max_dist)
+    {
+        float trans_force = dT0.t.l2norm();
+        float trans_progress = 1.0 / exp(10.0 * trans_force);
+
+        rm::Quaternion qunit;
+        qunit.setIdentity();
+        float qscalar = dT0.R.dot(qunit);
+        float rot_progress = qscalar * qscalar;
+
+        float adaption_rate = trans_progress * rot_progress * match_ratio;
+        
+        for(auto elem : m_micp->sensors())
+        {
+            elem.second->adaptCorrectionParams(match_ratio, adaption_rate);
+        }
+    }
+
+    // apply actual correction as Tom
+    if(!m_correction_disabled)
+    {
+        m_Tom = poses[0] * ~m_Tbo;
+    }
+}
+
+void MICPLocalizationNode::correct()
+{
+    scorePendingPoses();
+
+    if(m_relocalize_requested)
+    {
+        fetchTF();
+        if(relocalize())
+        {
+            m_relocalize_requested = false;
+        } else {
+            // no sensor is ready yet
+            std::this_thread::sleep_for(100ms);
+        }
+        return;
+    }
+
+    if(m_pose_received)
+    {
+        fetchTF();
+        correctOnce();
+    }
+}
+
+bool MICPLocalizationNode::relocalize()
+{
+    std::vector<RelocalizationHypothesis> hypotheses;
+    if(!m_micp->relocalize(m_reloc_params, hypotheses))
+    {
+        return false;
+    }
+
+    if(hypotheses.empty())
+    {
+        RCLCPP_WARN(this->get_logger(), "Relocalization failed: no hypothesis found");
+        return true;
+    }
+
+    const RelocalizationHypothesis& best = hypotheses[0];
+    {
+        std::lock_guard<std::mutex> guard1(m_T_base_odom_mutex);
+        std::lock_guard<std::mutex> guard2(m_T_odom_map_mutex);
+        m_Tom = best.Tbm * ~m_Tbo;
+
+        // converge from the initial correction parameters again
+        for(auto elem : m_micp->sensors())
+        {
+            CorrectionParams params;
+            {
+                std::lock_guard<std::mutex> sensor_guard(elem.second->corr_mutex);
+                params = elem.second->corr_params_init;
+            }
+            elem.second->setCorrectionParams(params);
+        }
+    }
+    m_pose_received = true;
+    m_lost = false;
+
+    std::cout << "Relocalized at " << best.Tbm.t.x << ", " << best.Tbm.t.y << ", " << best.Tbm.t.z 
+        << " (match ratio: " << best.match_ratio << ")" << std::endl;
+    if(hypotheses.size() > 1)
+    {
+        // similar ratios: ambiguous place
+        std::cout << "- next best: " << hypotheses[1].Tbm.t.x << ", " << hypotheses[1].Tbm.t.y << ", " << hypotheses[1].Tbm.t.z
+            << " (match ratio: " << hypotheses[1].match_ratio << ")" << std::endl;
+    }
+
+    return true;
+}
+
+std::future<std::vector<PoseScore> > MICPLocalizationNode::scorePoses(
+    rm::Memory<rm::Transform, rm::RAM> Tbms)
+{
+    ScoreRequest request;
+    request.Tbms = Tbms;
+    std::future<std::vector<PoseScore> > scores = request.scores.get_future();
+
+    std::lock_guard<std::mutex> guard(m_score_requests_mutex);
+    if(m_stop_correction_thread)
+    {
+        // nobody would serve it
+        request.scores.set_exception(std::make_exception_ptr(
+            std::runtime_error("MICP localization is shutting down")));
+    } else {
+        m_score_requests.push_back(std::move(request));
+    }
+    return scores;
+}
+
+void MICPLocalizationNode::cancelPendingPoses()
+{
+    std::lock_guard<std::mutex> guard(m_score_requests_mutex);
+    for(ScoreRequest& request : m_score_requests)
+    {
+        request.scores.set_exception(std::make_exception_ptr(
+            std::runtime_error("MICP localization is shutting down")));
+    }
+    m_score_requests.clear();
+}
+
+void MICPLocalizationNode::scorePendingPoses()
+{
+    std::vector<ScoreRequest> requests;
+    {
+        std::lock_guard<std::mutex> guard(m_score_requests_mutex);
+        requests.swap(m_score_requests);
+    }
+
+    for(ScoreRequest& request : requests)
+    {
+        try {
+            std::vector<PoseScore> scores;
+            if(!m_micp->scorePoses(request.Tbms, scores))
+            {
+                scores.clear();
+            }
+            request.scores.set_value(std::move(scores));
+        } catch(...) {
+            request.scores.set_exception(std::current_exception());
+        }
+    }
+}
+
+void MICPLocalizationNode::correctionLoop()
+{
+    rm::StopWatch sw;
+    double el;
+
+    // minimum duration for one loop
+    double el_min = 1.0 / m_corr_rate_max;
+
+    // reactivate cuda context if required
+    m_micp->useInThisThread();
+
+    while(!m_stop_correction_thread && rclcpp::ok())
+    {
+        sw();
+        correct();
+        el = sw();
+        double el_left = el_min - el;
+        if(el_left > 0.0)
+        {
+            std::this_thread::sleep_for(std::chrono::duration<double>(el_left));
+        }
+
+        if(m_print_corr_rate)
+        {
+            double total_dur = el;
+            if(el_left > 0.0)
+            {
+                total_dur += el_left;
+            }
+            std::cout << "- Current Correction Rate:  " << total_dur << " s" << ", " << 1.0/total_dur << " hz" << std::endl; 
+            std::cout << "- Possible Correction Rate: " << el << " s" << ", " << 1.0/el << " hz" << std::endl;
+        }
+    }
+
+    // also left on rclcpp::ok() == false: reject everything from now on
+    {
+        std::lock_guard<std::mutex> guard(m_score_requests_mutex);
+        m_stop_correction_thread = true;
+    }
+    cancelPendingPoses();
+}
+
+void MICPLocalizationNode::tfLoop()
+{
+    if(m_pose_received)
+    {   
+        rclcpp::Time new_stamp = this->now();
+        if(new_stamp > m_last_tf_stamp)
+        {
+            updateTF();
+            m_last_tf_stamp = new_stamp;
+        }
+    }
+}
+
+void MICPLocalizationNode::saveCheckpoint()
+{
+    if(!m_pose_received)
+    {
+        return;
+    }
+
+    // the timer and the shutdown path write the same file
+    std::lock_guard<std::mutex> checkpoint_guard(m_checkpoint_mutex);
+
+    LocalizationCheckpoint checkpoint;
+    checkpoint.map = map_identity(m_micp->mapFile());
+
+    {
+        // the correction step adapts the sensor parameters under this lock
+        std::lock_guard<std::mutex> guard(m_T_odom_map_mutex);
+        checkpoint.Tom = m_Tom;
+        checkpoint.map_frame = m_map_frame;
+        for(auto elem : m_micp->sensors())
+        {
+            checkpoint.max_distances[elem.first] = elem.second->corr_params.max_distance;
+        }
+    }
+
+    if(!save_checkpoint(m_checkpoint_file, checkpoint))
+    {
+        RCLCPP_WARN_STREAM_THROTTLE(this->get_logger(), *this->get_clock(), 10000, 
+            "Could not write checkpoint '" << m_checkpoint_file << "'");
+    }
+}
+
+bool MICPLocalizationNode::restoreCheckpoint()
+{
+    LocalizationCheckpoint checkpoint;
+    if(!load_checkpoint(m_checkpoint_file, checkpoint))
+    {
+        std::cout << "No checkpoint at '" << m_checkpoint_file << "'" << std::endl;
+        return false;
+    }
+
+    if(checkpoint.map != map_identity(m_micp->mapFile()))
+    {
+        RCLCPP_INFO_STREAM(this->get_logger(), "Checkpoint belongs to another map ('" 
+            << checkpoint.map.file << "'). Ignoring it");
+        return false;
+    }
+
+    const double now = std::chrono::duration<double>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    const double age = now - checkpoint.stamp;
+    if(m_checkpoint_max_age > 0.0 && age > m_checkpoint_max_age)
+    {
+        RCLCPP_INFO_STREAM(this->get_logger(), "Checkpoint is " << age << "s old. Ignoring it");
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard1(m_T_base_odom_mutex);
+        std::lock_guard<std::mutex> guard2(m_T_odom_map_mutex);
+
+        m_Tom = checkpoint.Tom;
+        if(checkpoint.map_frame != "")
+        {
+            m_map_frame = checkpoint.map_frame;
+        }
+
+        // sensors are still loading. Applied once they are there
+        m_checkpoint_max_distances = checkpoint.max_distances;
+
+        m_pose_received = true;
+    }
+
+    RCLCPP_INFO_STREAM(this->get_logger(), "Resumed from checkpoint (" << age << "s old)");
+    return true;
+}
+
+void MICPLocalizationNode::poseCB(
+    const geometry_msgs::msg::PoseStamped::ConstSharedPtr msg)
+{
+    std::lock_guard<std::mutex> guard1(m_T_base_odom_mutex);
+    std::lock_guard<std::mutex> guard2(m_T_odom_map_mutex);
+
+    RCLCPP_INFO_STREAM(this->get_logger(), " Received new pose guess");
+
+    m_map_frame = msg->header.frame_id;
+    
+    rm::Transform Tpm;
+    convert(msg->pose, Tpm);
+
+    // total transform: offset -> pose -> map
+    rm::Transform Tbm = Tpm * m_initial_pose_offset;
+
+    m_Tom = Tbm * ~m_Tbo;
+    m_pose_received = true;
+
+    if(m_micp)
+    {
+        m_micp->setLODCoarse(true);
+    }
+}
+
+void MICPLocalizationNode::poseWcCB(
+    const geometry_msgs::msg::PoseWithCovarianceStamped::ConstSharedPtr msg)
+{
+    auto pose = std::make_shared<geometry_msgs::msg::PoseStamped>();
+    pose->header = msg->header;
+    pose->pose = msg->pose.pose;
+
+    poseCB(pose);
+}
+
+} // namespace rmcl
+
+#include "rclcpp_components/register_node_macro.hpp"
+RCLCPP_COMPONENTS_REGISTER_NODE(rmcl::MICPLocalizationNode)
@@ -3,11 +3,13 @@
 // how to port this?
 // #include <ros/master.h>
 #include <vector>
+#include <chrono>
 
 
 #include <geometry_msgs/msg/transform_stamped.hpp>
 
 #include <rmcl/util/conversions.h>
+#include <rmcl/util/depth_operations.h>
 
 #include <rmcl/math/math.h>
 #include <rmcl/math/math_batched.h>
@@ -105,22 +107,37 @@ visualization_msgs::msg::Marker make_marker(
 
 void MICPRangeSensor::connect()
 {
+    // Data and info callbacks of one sensor share a mutually exclusive
+    // group: the info callbacks write the model the data callbacks read.
+    // Different sensors are processed in parallel by a multi-threaded executor
+    if(use_sensor_callback_group && !cb_group)
+    {
+        cb_group = nh->create_callback_group(
+            rclcpp::CallbackGroupType::MutuallyExclusive);
+    }
+
+    rclcpp::SubscriptionOptions options;
+    options.callback_group = cb_group;
+
     if(type == 0) { // Spherical
         if(data_topic.msg == "rmcl_msgs/msg/ScanStamped") {
             data_sub = nh->create_subscription<rmcl_msgs::msg::ScanStamped>(
                     data_topic.name, 1, 
-                    std::bind(&MICPRangeSensor::sphericalCB, this, std::placeholders::_1)
+                    std::bind(&MICPRangeSensor::sphericalCB, this, std::placeholders::_1),
+                    options
                 );
 
         } else if(data_topic.msg == "sensor_msgs/msg/PointCloud2") {
             data_sub = nh->create_subscription<sensor_msgs::msg::PointCloud2>(
                     data_topic.name, 1, 
-                    std::bind(&MICPRangeSensor::pclSphericalCB, this, std::placeholders::_1)
+                    std::bind(&MICPRangeSensor::pclSphericalCB, this, std::placeholders::_1),
+                    options
                 );
         } else if(data_topic.msg == "sensor_msgs/msg/LaserScan") {
             data_sub = nh->create_subscription<sensor_msgs::msg::LaserScan>(
                     data_topic.name, 1, 
-                    std::bind(&MICPRangeSensor::laserCB, this, std::placeholders::_1)
+                    std::bind(&MICPRangeSensor::laserCB, this, std::placeholders::_1),
+                    options
                 );
         } else {
             // TODO proper error msg
@@ -131,27 +148,29 @@ void MICPRangeSensor::connect()
         if(data_topic.msg == "rmcl_msgs/msg/DepthStamped") {
             data_sub = nh->create_subscription<rmcl_msgs::msg::DepthStamped>(
                     data_topic.name, 1,
-                    std::bind(&MICPRangeSensor::pinholeCB, this, std::placeholders::_1)
+                    std::bind(&MICPRangeSensor::pinholeCB, this, std::placeholders::_1),
+                    options
                 );
         } else if(data_topic.msg == "sensor_msgs/msg/PointCloud2") {
             data_sub = nh->create_subscription<sensor_msgs::msg::PointCloud2>(
                     data_topic.name, 1, 
-                    std::bind(&MICPRangeSensor::pclPinholeCB, this, std::placeholders::_1)
+                    std::bind(&MICPRangeSensor::pclPinholeCB, this, std::placeholders::_1),
+                    options
                 );
         } else if(data_topic.msg == "sensor_msgs/msg/Image") {
             // std::cout << "Connecting to depth image" << std::endl;
-            // create image transport if not yet done
 
-            if(!it)
-            {
-                it = std::make_shared<image_transport::ImageTransport>(nh);
-            }
+            // ImageTransport::subscribe does not accept subscription 
+            // options. Use the free function to pass the callback group
+            rmw_qos_profile_t qos = rmw_qos_profile_default;
+            qos.depth = 1;
 
             img_sub = std::make_shared<image_transport::Subscriber>(
-                    it->subscribe(
-                        data_topic.name, 1,
+                    image_transport::create_subscription(
+                        nh, data_topic.name,
                         std::bind(&MICPRangeSensor::imageCB, this, 
-                            std::placeholders::_1)
+                            std::placeholders::_1),
+                        "raw", qos, options
                     )
                 );
         }
@@ -160,19 +179,22 @@ void MICPRangeSensor::connect()
         if(data_topic.msg == "rmcl_msgs/msg/O1DnStamped") {
             data_sub = nh->create_subscription<rmcl_msgs::msg::O1DnStamped>(
                     data_topic.name, 1, 
-                    std::bind(&MICPRangeSensor::o1dnCB, this, std::placeholders::_1)
+                    std::bind(&MICPRangeSensor::o1dnCB, this, std::placeholders::_1),
+                    options
                 );
         } else if(data_topic.msg == "sensor_msgs/msg/PointCloud2") {
             data_sub = nh->create_subscription<sensor_msgs::msg::PointCloud2>(
                 data_topic.name, 1, 
-                std::bind(&MICPRangeSensor::pclO1DnCB, this, std::placeholders::_1)
+                std::bind(&MICPRangeSensor::pclO1DnCB, this, std::placeholders::_1),
+                options
             );
         }
     } else if(type == 3) { // OnDn
         if(data_topic.msg == "rmcl_msgs/msg/OnDnStamped") {
             data_sub = nh->create_subscription<rmcl_msgs::msg::OnDnStamped>(
                     data_topic.name, 1, 
-                    std::bind(&MICPRangeSensor::ondnCB, this, std::placeholders::_1)
+                    std::bind(&MICPRangeSensor::ondnCB, this, std::placeholders::_1),
+                    options
                 );
         }
     }
@@ -184,27 +206,32 @@ void MICPRangeSensor::connect()
         {
             info_sub = nh->create_subscription<sensor_msgs::msg::CameraInfo>(
                     info_topic.name, 1, 
-                    std::bind(&MICPRangeSensor::cameraInfoCB, this, std::placeholders::_1)
+                    std::bind(&MICPRangeSensor::cameraInfoCB, this, std::placeholders::_1),
+                    options
                 );
         } else if(info_topic.msg == "rmcl_msgs/msg/ScanInfo") {
             info_sub = nh->create_subscription<rmcl_msgs::msg::ScanInfo>(
                     info_topic.name, 1, 
-                    std::bind(&MICPRangeSensor::sphericalModelCB, this, std::placeholders::_1)
+                    std::bind(&MICPRangeSensor::sphericalModelCB, this, std::placeholders::_1),
+                    options
                 );
         } else if(info_topic.msg == "rmcl_msgs/msg/DepthInfo") {
             info_sub = nh->create_subscription<rmcl_msgs::msg::DepthInfo>(
                     info_topic.name, 1, 
-                    std::bind(&MICPRangeSensor::pinholeModelCB, this, std::placeholders::_1)
+                    std::bind(&MICPRangeSensor::pinholeModelCB, this, std::placeholders::_1),
+                    options
                 );
         } else if(info_topic.msg == "rmcl_msgs/msg/O1DnInfo") {
             info_sub = nh->create_subscription<rmcl_msgs::msg::O1DnInfo>(
                     info_topic.name, 1, 
-                    std::bind(&MICPRangeSensor::o1dnModelCB, this, std::placeholders::_1)
+                    std::bind(&MICPRangeSensor::o1dnModelCB, this, std::placeholders::_1),
+                    options
                 );
         } else if(info_topic.msg == "rmcl_msgs/msg/OnDnInfo") {
             info_sub = nh->create_subscription<rmcl_msgs::msg::OnDnInfo>(
                     info_topic.name, 1, 
-                    std::bind(&MICPRangeSensor::ondnModelCB, this, std::placeholders::_1)
+                    std::bind(&MICPRangeSensor::ondnModelCB, this, std::placeholders::_1),
+                    options
                 );
         } else {
             std::cout << "info topic message " << info_topic.msg << " not supported" << std::endl; 
@@ -279,6 +306,29 @@ void MICPRangeSensor::fetchMICPParams(bool init)
     }
     
 
+    // callback group of the sensor subscriptions
+    // - "sensor": own mutually exclusive group per sensor (default)
+    // - "default": default group of the node. All sensors are serialized
+    std::string callback_group_str;
+    if(micp_params_local.find("callback_group") != micp_params_local.end())
+    {
+        callback_group_str = micp_params_local.at("callback_group").as_string();
+    } else if(micp_params_global.find("callback_group") != micp_params_global.end()) {
+        callback_group_str = micp_params_global.at("callback_group").as_string();
+    } else {
+        callback_group_str = "sensor";
+    }
+
+    if(callback_group_str == "sensor")
+    {
+        use_sensor_callback_group = true;
+    } else if(callback_group_str == "default") {
+        use_sensor_callback_group = false;
+    } else {
+        std::cout << "WARNING: callback_group '" << callback_group_str << "' unknown. Using 'sensor'" << std::endl;
+        use_sensor_callback_group = true;
+    }
+
     std::string backend_str;
     if(micp_params_local.find("backend") != micp_params_local.end())
     {
@@ -294,6 +344,17 @@ void MICPRangeSensor::fetchMICPParams(bool init)
         backend = 1;
     }
 
+    // static sensor transforms are cached. They are looked up again
+    // if /tf_static changes or after tf_static_refresh seconds (<= 0: never)
+    if(micp_params_local.find("tf_static_refresh") != micp_params_local.end())
+    {
+        tf_static_refresh = micp_params_local.at("tf_static_refresh").as_double();
+    } else if(micp_params_global.find("tf_static_refresh") != micp_params_global.end()) {
+        tf_static_refresh = micp_params_global.at("tf_static_refresh").as_double();
+    } else {
+        tf_static_refresh = 10.0;
+    }
+
     if(micp_params_local.find("weight") != micp_params_local.end())
     {
         corr_weight = micp_params_local.at("weight").as_double();
@@ -370,55 +431,89 @@ void MICPRangeSensor::fetchMICPParams(bool init)
 
 void MICPRangeSensor::fetchTF()
 {
-    geometry_msgs::msg::TransformStamped T_sensor_base;
-
     if(frame != base_frame)
     {
-        try
+        rm::Transform T;
+        if(lookupTransform(base_frame, frame, T))
         {
-            T_sensor_base = tf_buffer->lookupTransform(base_frame, frame, tf2::TimePointZero);
-        } catch (tf2::TransformException &ex) {
-            RCLCPP_WARN(nh_sensor->get_logger(), "%s", ex.what());
-            RCLCPP_WARN_STREAM(nh_sensor->get_logger(), "Source: " << frame << ", Target: " << base_frame);
-            return;
+            Tsb = T;
         }
     } else {
-        T_sensor_base.header.frame_id = base_frame;
-        T_sensor_base.child_frame_id = frame;
-        T_sensor_base.transform.translation.x = 0.0;
-        T_sensor_base.transform.translation.y = 0.0;
-        T_sensor_base.transform.translation.z = 0.0;
-        T_sensor_base.transform.rotation.x = 0.0;
-        T_sensor_base.transform.rotation.y = 0.0;
-        T_sensor_base.transform.rotation.z = 0.0;
-        T_sensor_base.transform.rotation.w = 1.0;
-    }
-
-    convert(T_sensor_base.transform, Tsb);
+        Tsb = rm::Transform::Identity();
+    }
+}
+
+bool MICPRangeSensor::lookupTransform(
+    const std::string& target_frame,
+    const std::string& source_frame,
+    rmagine::Transform& T)
+{
+    const std::string key = target_frame + " <- " + source_frame;
+    const auto now = std::chrono::steady_clock::now();
+    const uint64_t static_version = (tf_static_version ? tf_static_version->load() : 0);
+
+    auto it = tf_cache.find(key);
+    if(it != tf_cache.end() && it->second.is_static 
+        && it->second.static_version == static_version)
+    {
+        const double age = std::chrono::duration<double>(now - it->second.last_lookup).count();
+        if(tf_static_refresh <= 0.0 || age < tf_static_refresh)
+        {
+            T = it->second.T;
+            return true;
+        }
+    }
+
+    geometry_msgs::msg::TransformStamped Tros;
+    try
+    {
+        Tros = tf_buffer->lookupTransform(target_frame, source_frame, tf2::TimePointZero);
+    } catch (tf2::TransformException &ex) {
+        RCLCPP_WARN(nh_sensor->get_logger(), "%s", ex.what());
+        RCLCPP_WARN_STREAM(nh_sensor->get_logger(), "Source: " << source_frame << ", Target: " << target_frame);
+        return false;
+    }
+
+    convert(Tros.transform, T);
+
+    // A chain that consists of static transforms only is returned 
+    // with stamp 0 for TimePointZero requests
+    TFCacheEntry& entry = tf_cache[key];
+    entry.T = T;
+    entry.is_static = (Tros.header.stamp.sec == 0 && Tros.header.stamp.nanosec == 0);
+    entry.static_version = static_version;
+    entry.last_lookup = now;
+
+    return true;
 }
 
 void MICPRangeSensor::updateCorrectors()
 {
+    std::lock_guard<std::mutex> guard(corr_mutex);
+    data_version++;
+
+    const CorrectionParams params = activeParams();
+
     #ifdef RMCL_EMBREE
     if(corr_sphere_embree)
     {
-        corr_sphere_embree->setParams(corr_params);
+        corr_sphere_embree->setParams(params);
         corr_sphere_embree->setModel(std::get<0>(model));
         corr_sphere_embree->setInputData(ranges);
         corr_sphere_embree->setTsb(Tsb);
     } else if(corr_pinhole_embree) {
-        corr_pinhole_embree->setParams(corr_params);
+        corr_pinhole_embree->setParams(params);
         corr_pinhole_embree->setModel(std::get<1>(model));
         corr_pinhole_embree->setInputData(ranges);
         corr_pinhole_embree->setOptical(optical_coordinates);
         corr_pinhole_embree->setTsb(Tsb);
     } else if(corr_o1dn_embree) {
-        corr_o1dn_embree->setParams(corr_params);
+        corr_o1dn_embree->setParams(params);
         corr_o1dn_embree->setModel(std::get<2>(model));
         corr_o1dn_embree->setInputData(ranges);
         corr_o1dn_embree->setTsb(Tsb);
     } else if(corr_ondn_embree) {
-        corr_ondn_embree->setParams(corr_params);
+        corr_ondn_embree->setParams(params);
         corr_ondn_embree->setModel(std::get<3>(model));
         corr_ondn_embree->setInputData(ranges);
         corr_ondn_embree->setTsb(Tsb);
@@ -428,23 +523,23 @@ void MICPRangeSensor::updateCorrectors()
     #ifdef RMCL_OPTIX
     if(corr_sphere_optix)
     {
-        corr_sphere_optix->setParams(corr_params);
+        corr_sphere_optix->setParams(params);
         corr_sphere_optix->setModel(std::get<0>(model));
         corr_sphere_optix->setInputData(ranges_gpu);
         corr_sphere_optix->setTsb(Tsb);
     } else if(corr_pinhole_optix) {
-        corr_pinhole_optix->setParams(corr_params);
+        corr_pinhole_optix->setParams(params);
         corr_pinhole_optix->setModel(std::get<1>(model));
         corr_pinhole_optix->setInputData(ranges_gpu);
         corr_pinhole_optix->setOptical(optical_coordinates);
         corr_pinhole_optix->setTsb(Tsb);
     } else if(corr_o1dn_optix) {
-        corr_o1dn_optix->setParams(corr_params);
+        corr_o1dn_optix->setParams(params);
         corr_o1dn_optix->setModel(std::get<2>(model));
         corr_o1dn_optix->setInputData(ranges_gpu);
         corr_o1dn_optix->setTsb(Tsb);
     } else if(corr_ondn_optix) {
-        corr_ondn_optix->setParams(corr_params);
+        corr_ondn_optix->setParams(params);
         corr_ondn_optix->setModel(std::get<3>(model));
         corr_ondn_optix->setInputData(ranges_gpu);
         corr_ondn_optix->setTsb(Tsb);
@@ -455,34 +550,87 @@ void MICPRangeSensor::updateCorrectors()
 #ifdef RMCL_EMBREE
 void MICPRangeSensor::setMap(rmagine::EmbreeMapPtr map)
 {
-    if(corr_sphere_embree)
-    {
-        corr_sphere_embree->setMap(map);
-    } else if(corr_pinhole_embree) {
-        corr_pinhole_embree->setMap(map);
-    } else if(corr_o1dn_embree) {
-        corr_o1dn_embree->setMap(map);
-    } else if(corr_ondn_embree) {
-        corr_ondn_embree->setMap(map);
-    }
+    std::lock_guard<std::mutex> guard(corr_mutex);
+    map_embree = map;
+    applyMaps();
+}
+
+void MICPRangeSensor::setLODMap(rmagine::EmbreeMapPtr map)
+{
+    std::lock_guard<std::mutex> guard(corr_mutex);
+    map_embree_lod = map;
+    applyMaps();
 }
 #endif // RMCL_EMBREE
 
 #ifdef RMCL_OPTIX
 void MICPRangeSensor::setMap(rmagine::OptixMapPtr map)
 {
-    if(corr_sphere_optix)
+    std::lock_guard<std::mutex> guard(corr_mutex);
+    map_optix = map;
+    applyMaps();
+}
+
+void MICPRangeSensor::setLODMap(rmagine::OptixMapPtr map)
+{
+    std::lock_guard<std::mutex> guard(corr_mutex);
+    map_optix_lod = map;
+    applyMaps();
+}
+#endif // RMCL_OPTIX
+
+void MICPRangeSensor::setLODCoarse(bool coarse)
+{
+    std::lock_guard<std::mutex> guard(corr_mutex);
+    if(coarse != lod_coarse)
     {
-        corr_sphere_optix->setMap(map);
-    } else if(corr_pinhole_optix) {
-        corr_pinhole_optix->setMap(map);
-    } else if(corr_o1dn_optix) {
-        corr_o1dn_optix->setMap(map);
-    } else if(corr_ondn_optix) {
-        corr_ondn_optix->setMap(map);
+        lod_coarse = coarse;
+        applyMaps();
     }
 }
-#endif // RMCL_OPTIX
+
+bool MICPRangeSensor::usesLOD() const
+{
+    return lod == LODPolicy::ALWAYS 
+        || (lod == LODPolicy::COARSE && lod_coarse);
+}
+
+void MICPRangeSensor::applyMaps()
+{
+    #ifdef RMCL_EMBREE
+    rm::EmbreeMapPtr map_e = (usesLOD() && map_embree_lod) ? map_embree_lod : map_embree;
+    if(map_e)
+    {
+        if(corr_sphere_embree)
+        {
+            corr_sphere_embree->setMap(map_e);
+        } else if(corr_pinhole_embree) {
+            corr_pinhole_embree->setMap(map_e);
+        } else if(corr_o1dn_embree) {
+            corr_o1dn_embree->setMap(map_e);
+        } else if(corr_ondn_embree) {
+            corr_ondn_embree->setMap(map_e);
+        }
+    }
+    #endif // RMCL_EMBREE
+
+    #ifdef RMCL_OPTIX
+    rm::OptixMapPtr map_o = (usesLOD() && map_optix_lod) ? map_optix_lod : map_optix;
+    if(map_o)
+    {
+        if(corr_sphere_optix)
+        {
+            corr_sphere_optix->setMap(map_o);
+        } else if(corr_pinhole_optix) {
+            corr_pinhole_optix->setMap(map_o);
+        } else if(corr_o1dn_optix) {
+            corr_o1dn_optix->setMap(map_o);
+        } else if(corr_ondn_optix) {
+            corr_ondn_optix->setMap(map_o);
+        }
+    }
+    #endif // RMCL_OPTIX
+}
 
 void MICPRangeSensor::countValidRanges()
 {
@@ -532,9 +680,77 @@ void MICPRangeSensor::adaptCorrectionParams(
     float match_ratio, 
     float adaption_rate)
 {
+    std::lock_guard<std::mutex> guard(corr_mutex);
     corr_params.max_distance = corr_params_init.max_distance + (adaptive_max_dist_min - corr_params_init.max_distance) * adaption_rate;
 }
 
+void MICPRangeSensor::setCorrectionParams(
+    const CorrectionParams& params)
+{
+    std::lock_guard<std::mutex> guard(corr_mutex);
+    corr_params = params;
+    applyParams();
+}
+
+void MICPRangeSensor::setRayMask(unsigned int ray_mask)
+{
+    std::lock_guard<std::mutex> guard(corr_mutex);
+    if(corr_params.ray_mask != ray_mask || corr_params_init.ray_mask != ray_mask)
+    {
+        corr_params_init.ray_mask = ray_mask;
+        corr_params.ray_mask = ray_mask;
+        applyParams();
+    }
+}
+
+void MICPRangeSensor::overrideMaxDistance(float max_distance)
+{
+    std::lock_guard<std::mutex> guard(corr_mutex);
+    max_distance_override = max_distance;
+    applyParams();
+}
+
+CorrectionParams MICPRangeSensor::activeParams() const
+{
+    CorrectionParams params = corr_params;
+    if(max_distance_override > 0.0)
+    {
+        params.max_distance = max_distance_override;
+    }
+    return params;
+}
+
+void MICPRangeSensor::applyParams()
+{
+    const CorrectionParams params = activeParams();
+
+    #ifdef RMCL_EMBREE
+    if(corr_sphere_embree)
+    {
+        corr_sphere_embree->setParams(params);
+    } else if(corr_pinhole_embree) {
+        corr_pinhole_embree->setParams(params);
+    } else if(corr_o1dn_embree) {
+        corr_o1dn_embree->setParams(params);
+    } else if(corr_ondn_embree) {
+        corr_ondn_embree->setParams(params);
+    }
+    #endif // RMCL_EMBREE
+
+    #ifdef RMCL_OPTIX
+    if(corr_sphere_optix)
+    {
+        corr_sphere_optix->setParams(params);
+    } else if(corr_pinhole_optix) {
+        corr_pinhole_optix->setParams(params);
+    } else if(corr_o1dn_optix) {
+        corr_o1dn_optix->setParams(params);
+    } else if(corr_ondn_optix) {
+        corr_ondn_optix->setParams(params);
+    }
+    #endif // RMCL_OPTIX
+}
+
 void MICPRangeSensor::computeCovs(
     const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
     CorrectionPreResults<rmagine::RAM>& res)
@@ -706,6 +922,15 @@ void MICPRangeSensor::computeCovs(
                 corr_ondn_embree->computeCovs(Tbms, res);
             }
         }
+
+        // the correspondence visualization computes no residuals
+        if(viz_corr && res.residuals.size() == Tbms.size())
+        {
+            for(size_t i=0; i<res.residuals.size(); i++)
+            {
+                res.residuals[i] = 0.0;
+            }
+        }
     }
     #endif // RMCL_EMBREE
     
@@ -950,6 +1175,21 @@ void MICPRangeSensor::computeCovs(
 }
 #endif // RMCL_CUDA
 
+void MICPRangeSensor::updateDepthScaleTable()
+{
+    const rm::PinholeModel model_ = std::get<1>(model);
+
+    if(depth_scales.size() != model_.size()
+        || depth_scales_optical != optical_coordinates
+        || !depth_scale_table_equal(depth_scales_model, model_))
+    {
+        depth_scales.resize(model_.size());
+        depth_scale_table(model_, optical_coordinates, depth_scales);
+        depth_scales_model = model_;
+        depth_scales_optical = optical_coordinates;
+    }
+}
+
 void MICPRangeSensor::enableValidRangesCounting(bool enable)
 {
     count_valid_ranges = enable;
@@ -973,7 +1213,7 @@ void MICPRangeSensor::enableVizCorrespondences(bool enable)
 }
 
 void MICPRangeSensor::sphericalCB(
-    const rmcl_msgs::msg::ScanStamped::SharedPtr msg)
+    const rmcl_msgs::msg::ScanStamped::ConstSharedPtr msg)
 {
     // ROS_INFO_STREAM("sensor: " << name << " received " << data_topic.msg << " message");
     fetchTF();
@@ -1006,7 +1246,7 @@ void MICPRangeSensor::sphericalCB(
 }
 
 void MICPRangeSensor::pinholeCB(
-    const rmcl_msgs::msg::DepthStamped::SharedPtr msg)
+    const rmcl_msgs::msg::DepthStamped::ConstSharedPtr msg)
 {
     // ROS_INFO_STREAM("sensor: " << name << " received " << data_topic.msg << " message");
     fetchTF();
@@ -1039,7 +1279,7 @@ void MICPRangeSensor::pinholeCB(
 }
 
 void MICPRangeSensor::o1dnCB(
-    const rmcl_msgs::msg::O1DnStamped::SharedPtr msg)
+    const rmcl_msgs::msg::O1DnStamped::ConstSharedPtr msg)
 {
     fetchTF();
 
@@ -1071,7 +1311,7 @@ void MICPRangeSensor::o1dnCB(
 }
 
 void MICPRangeSensor::ondnCB(
-    const rmcl_msgs::msg::OnDnStamped::SharedPtr msg)
+    const rmcl_msgs::msg::OnDnStamped::ConstSharedPtr msg)
 {
     fetchTF();
 
@@ -1103,7 +1343,7 @@ void MICPRangeSensor::ondnCB(
 }
 
 void MICPRangeSensor::pclSphericalCB(
-    const sensor_msgs::msg::PointCloud2::SharedPtr msg)
+    const sensor_msgs::msg::PointCloud2::ConstSharedPtr msg)
 {
     // ROS_INFO_STREAM("sensor: " << name << " received " << data_topic.msg << " message");
     fetchTF();
@@ -1112,13 +1352,7 @@ void MICPRangeSensor::pclSphericalCB(
 
     if(frame != msg->header.frame_id)
     {
-        try {
-            auto Tros = tf_buffer->lookupTransform(frame, msg->header.frame_id,
-                               tf2::TimePointZero);
-            convert(Tros.transform, T);
-        } catch (tf2::TransformException &ex) {
-            RCLCPP_WARN(nh_sensor->get_logger(), "%s", ex.what());
-        }
+        lookupTransform(frame, msg->header.frame_id, T);
     }
 
     
@@ -1215,7 +1449,7 @@ void MICPRangeSensor::pclSphericalCB(
 }
 
 void MICPRangeSensor::pclPinholeCB(
-    const sensor_msgs::msg::PointCloud2::SharedPtr msg)
+    const sensor_msgs::msg::PointCloud2::ConstSharedPtr msg)
 {
     // ROS_INFO_STREAM("sensor: " << name << " received " << data_topic.msg << " message");
     fetchTF();
@@ -1224,13 +1458,7 @@ void MICPRangeSensor::pclPinholeCB(
 
     if(frame != msg->header.frame_id)
     {
-        try {
-            auto Tros = tf_buffer->lookupTransform(frame, msg->header.frame_id,
-                               tf2::TimePointZero);
-            convert(Tros.transform, T);
-        } catch (tf2::TransformException &ex) {
-            RCLCPP_WARN(nh_sensor->get_logger(), "%s", ex.what());
-        }
+        lookupTransform(frame, msg->header.frame_id, T);
     }
 
     auto model_ = std::get<1>(model);
@@ -1312,7 +1540,7 @@ void MICPRangeSensor::pclPinholeCB(
 }
 
 void MICPRangeSensor::pclO1DnCB(
-    const sensor_msgs::msg::PointCloud2::SharedPtr msg)
+    const sensor_msgs::msg::PointCloud2::ConstSharedPtr msg)
 {
     // ROS_INFO_STREAM("sensor: " << name << " received " << data_topic.msg << " message");
     fetchTF();
@@ -1321,13 +1549,7 @@ void MICPRangeSensor::pclO1DnCB(
 
     if(frame != msg->header.frame_id)
     {
-        try {
-            auto Tros = tf_buffer->lookupTransform(frame, msg->header.frame_id,
-                               tf2::TimePointZero);
-            convert(Tros.transform, T);
-        } catch (tf2::TransformException &ex) {
-            RCLCPP_WARN(nh_sensor->get_logger(), "%s", ex.what());
-        }
+        lookupTransform(frame, msg->header.frame_id, T);
     }
     
     auto model_ = std::get<2>(model);
@@ -1540,7 +1762,7 @@ void MICPRangeSensor::pclO1DnCB(
 // }
 
 void MICPRangeSensor::laserCB(
-    const sensor_msgs::msg::LaserScan::SharedPtr msg)
+    const sensor_msgs::msg::LaserScan::ConstSharedPtr msg)
 {
     // ROS_INFO_STREAM("sensor: " << name << " received " << data_topic.msg << " message");
     fetchTF();
@@ -1578,55 +1800,57 @@ void MICPRangeSensor::imageCB(
     // ROS_INFO_STREAM("sensor: " << name << " received " << data_topic.msg << " message");
     fetchTF();
     
-    unsigned int bytes = msg->step / msg->width;
-    
-    if(msg->encoding == "32FC1")
-    {
-        if(bytes != 4)
-        {
-            std::cout << "32FC1 should have 4 bytes. Calculated " << bytes << std::endl;
-        }
+    auto model_ = std::get<1>(model);
 
-        // Problem: 
-        // floating point value in pixel is not the range in meters!
-        // it is the scale of the camera vector intersecting the pixel
-        // with z=1
-        // the solution to that is in the for loop
-        // -- Tested on simulated depth images --
-        if(ranges.size() < msg->width * msg->height)
-        {
-            ranges.resize(msg->width * msg->height);
-        }
+    if(msg->width != model_.getWidth() || msg->height != model_.getHeight())
+    {
+        RCLCPP_WARN_STREAM(nh_sensor->get_logger(), "Image size " << msg->width << "x" << msg->height 
+            << " does not match the camera model " << model_.getWidth() << "x" << model_.getHeight());
+        return;
+    }
 
-        auto model_ = std::get<1>(model);
+    // Problem: 
+    // floating point value in pixel is not the range in meters!
+    // it is the scale of the camera vector intersecting the pixel
+    // with z=1
+    // The per pixel scale only changes with the model -> cached
+    updateDepthScaleTable();
 
-        for(unsigned int vid = 0; vid < model_.getHeight(); vid++)
-        {
-            for(unsigned int hid = 0; hid < model_.getWidth(); hid++)
-            {
-                unsigned int loc_id = model_.getBufferId(vid, hid);
-                const float wrong_range = *reinterpret_cast<const float*>(&msg->data[loc_id * sizeof(float)]);
+    if(ranges.size() < msg->width * msg->height)
+    {
+        ranges.resize(msg->width * msg->height);
+    }
 
-                rm::Vector dir;
-                float real_range;
+    unsigned int bytes_per_pixel = 0;
+    if(msg->encoding == "32FC1")
+    {
+        bytes_per_pixel = sizeof(float);
+    } else if(msg->encoding == "16UC1" || msg->encoding == "mono16") {
+        bytes_per_pixel = sizeof(uint16_t);
+    } else {
+        RCLCPP_WARN_STREAM(nh_sensor->get_logger(), "Could not convert image of encoding " << msg->encoding);
+        return;
+    }
 
-                if(optical_coordinates)
-                {
-                    // std::cout << "OPTICAL" << std::endl;
-                    dir = model_.getDirectionOptical(vid, hid);
-                    real_range = wrong_range / dir.z;
-                } else {
-                    // std::cout << "NO OPTICAL" << std::endl;
-                    dir = model_.getDirection(vid, hid);
-                    real_range = wrong_range / dir.x;
-                }
+    if(!depth_image_layout_valid(msg->width, msg->height, msg->step, 
+        bytes_per_pixel, msg->data.size()))
+    {
+        RCLCPP_WARN_STREAM(nh_sensor->get_logger(), "Dropping image: step " << msg->step 
+            << " and data size " << msg->data.size() << " do not fit " 
+            << msg->width << "x" << msg->height << " " << msg->encoding);
+        return;
+    }
 
-                ranges[loc_id] = real_range;
-            }
-        }
-        
+    if(msg->encoding == "32FC1")
+    {
+        depth_to_ranges_32FC1(msg->data.data(), 
+            msg->width, msg->height, msg->step, msg->is_bigendian,
+            depth_scales, ranges);
     } else {
-        RCLCPP_WARN_STREAM(nh_sensor->get_logger(), "Could not convert image of encoding " << msg->encoding);
+        // millimeters
+        depth_to_ranges_16UC1(msg->data.data(), 
+            msg->width, msg->height, msg->step, msg->is_bigendian,
+            depth_scales, model_.range.max + 1.0, ranges);
     }
 
     #ifdef RMCL_CUDA
@@ -1648,7 +1872,7 @@ void MICPRangeSensor::imageCB(
 // info callbacks
 
 void MICPRangeSensor::sphericalModelCB(
-    const rmcl_msgs::msg::ScanInfo::SharedPtr msg)
+    const rmcl_msgs::msg::ScanInfo::ConstSharedPtr msg)
 {
     rm::SphericalModel model_ = std::get<0>(model);
     convert(*msg, model_);
@@ -1656,7 +1880,7 @@ void MICPRangeSensor::sphericalModelCB(
 }
 
 void MICPRangeSensor::pinholeModelCB(
-    const rmcl_msgs::msg::DepthInfo::SharedPtr msg)
+    const rmcl_msgs::msg::DepthInfo::ConstSharedPtr msg)
 {
     rm::PinholeModel model_ = std::get<1>(model);
     convert(*msg, model_);
@@ -1664,7 +1888,7 @@ void MICPRangeSensor::pinholeModelCB(
 }
 
 void MICPRangeSensor::o1dnModelCB(
-    const rmcl_msgs::msg::O1DnInfo::SharedPtr msg)
+    const rmcl_msgs::msg::O1DnInfo::ConstSharedPtr msg)
 {
     rm::O1DnModel model_ = std::get<2>(model);
     convert(*msg, model_);
@@ -1672,7 +1896,7 @@ void MICPRangeSensor::o1dnModelCB(
 }
 
 void MICPRangeSensor::ondnModelCB(
-    const rmcl_msgs::msg::OnDnInfo::SharedPtr msg)
+    const rmcl_msgs::msg::OnDnInfo::ConstSharedPtr msg)
 {
     rm::OnDnModel model_ = std::get<3>(model);
     convert(*msg, model_);
@@ -1680,7 +1904,7 @@ void MICPRangeSensor::ondnModelCB(
 }
 
 void MICPRangeSensor::cameraInfoCB(
-    const sensor_msgs::msg::CameraInfo::SharedPtr msg)
+    const sensor_msgs::msg::CameraInfo::ConstSharedPtr msg)
 {
     // ROS_INFO_STREAM("sensor - info: " << name << " received " << data_topic.msg << " message");
 
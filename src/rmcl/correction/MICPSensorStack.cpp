@@ -0,0 +1,274 @@
+#include "rmcl/correction/MICPSensorStack.hpp"
+
+#include <algorithm>
+
+#ifdef RMCL_EMBREE
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+namespace
+{
+
+// ray origins in sensor frame
+inline rm::Vector ray_origin(const rm::SphericalModel&, unsigned int, unsigned int)
+{
+    return {0.0, 0.0, 0.0};
+}
+
+inline rm::Vector ray_origin(const rm::PinholeModel&, unsigned int, unsigned int)
+{
+    return {0.0, 0.0, 0.0};
+}
+
+inline rm::Vector ray_origin(const rm::O1DnModel& model, unsigned int vid, unsigned int hid)
+{
+    return model.getOrigin(vid, hid);
+}
+
+inline rm::Vector ray_origin(const rm::OnDnModel& model, unsigned int vid, unsigned int hid)
+{
+    return model.getOrigin(vid, hid);
+}
+
+// ray directions in sensor frame
+template<typename ModelT>
+inline rm::Vector ray_direction(const ModelT& model, unsigned int vid, unsigned int hid, bool)
+{
+    return model.getDirection(vid, hid);
+}
+
+inline rm::Vector ray_direction(const rm::PinholeModel& model, unsigned int vid, unsigned int hid, bool optical)
+{
+    if(optical)
+    {
+        return model.getDirectionOptical(vid, hid);
+    }
+    return model.getDirection(vid, hid);
+}
+
+template<typename ModelT>
+void stack_rays(
+    const ModelT& model,
+    const MICPRangeSensor& sensor,
+    size_t offset,
+    rm::OnDnModel& stack,
+    rm::MemoryView<float, rm::RAM>& ranges,
+    rm::MemoryView<float, rm::RAM>& weights)
+{
+    const unsigned int W = model.getWidth();
+    const unsigned int H = model.getHeight();
+    const rm::Transform Tsb = sensor.Tsb;
+
+    #pragma omp parallel for default(shared) if(W * H > 1000)
+    for(unsigned int vid = 0; vid < H; vid++)
+    {
+        for(unsigned int hid = 0; hid < W; hid++)
+        {
+            const unsigned int loc_id = model.getBufferId(vid, hid);
+            const size_t stack_id = offset + loc_id;
+
+            stack.origs[stack_id] = Tsb * ray_origin(model, vid, hid);
+            stack.dirs[stack_id] = Tsb.R * ray_direction(model, vid, hid, sensor.optical_coordinates);
+
+            const float range = sensor.ranges[loc_id];
+            if(range >= model.range.min && range <= model.range.max)
+            {
+                ranges[stack_id] = range;
+            } else {
+                // outside of the stacks range interval [0, max]
+                ranges[stack_id] = -1.0;
+            }
+            weights[stack_id] = sensor.corr_weight;
+        }
+    }
+}
+
+size_t model_size(const SensorModelV& model)
+{
+    return std::visit([](const auto& m) -> size_t { 
+        return static_cast<size_t>(m.getWidth()) * m.getHeight(); 
+    }, model);
+}
+
+float model_range_max(const SensorModelV& model)
+{
+    return std::visit([](const auto& m) -> float { 
+        return m.range.max; 
+    }, model);
+}
+
+} // anonymous namespace
+
+MICPSensorStack::MICPSensorStack(rm::EmbreeMapPtr map)
+:m_corr(std::make_shared<OnDnCorrectorEmbree>(map))
+{
+    m_corr->setTsb(rm::Transform::Identity());
+}
+
+void MICPSensorStack::setMap(rm::EmbreeMapPtr map)
+{
+    m_corr->setMap(map);
+}
+
+void MICPSensorStack::update(
+    const std::unordered_map<std::string, MICPRangeSensorPtr>& sensors)
+{
+    std::vector<MICPRangeSensorPtr> members;
+    for(auto elem : sensors)
+    {
+        const MICPRangeSensorPtr& sensor = elem.second;
+        if(sensor->stack 
+            && sensor->backend == 0 
+            && sensor->data_received_once
+            && sensor->ranges.size() >= model_size(sensor->model))
+        {
+            members.push_back(sensor);
+        }
+    }
+
+    if(members.size() < 2)
+    {
+        // nothing to stack: sensors are corrected on their own
+        m_members.clear();
+        m_data_versions.clear();
+        return;
+    }
+
+    // deterministic ray order
+    std::sort(members.begin(), members.end(), 
+        [](const MICPRangeSensorPtr& a, const MICPRangeSensorPtr& b) {
+            return a->name < b->name;
+        });
+
+    bool changed = (members.size() != m_members.size());
+    for(size_t i=0; i<members.size() && !changed; i++)
+    {
+        changed = (members[i] != m_members[i] 
+            || members[i]->data_version != m_data_versions[i]);
+    }
+
+    if(changed)
+    {
+        m_members = members;
+        m_data_versions.resize(m_members.size());
+        for(size_t i=0; i<m_members.size(); i++)
+        {
+            m_data_versions[i] = m_members[i]->data_version;
+        }
+        rebuild();
+    }
+}
+
+void MICPSensorStack::rebuild()
+{
+    size_t Nrays = 0;
+    float range_max = 0.0;
+    CorrectionParams params = m_members[0]->corr_params;
+    m_weight = 0.0;
+
+    for(auto sensor : m_members)
+    {
+        Nrays += model_size(sensor->model);
+        range_max = std::max(range_max, model_range_max(sensor->model));
+        // one max distance for all rays: take the most tolerant one
+        params.max_distance = std::max(params.max_distance, sensor->corr_params.max_distance);
+        m_weight += sensor->corr_weight;
+    }
+
+    if(m_model.origs.size() != Nrays)
+    {
+        m_model.origs.resize(Nrays);
+        m_model.dirs.resize(Nrays);
+        m_ranges.resize(Nrays);
+        m_weights.resize(Nrays);
+    }
+
+    m_model.width = Nrays;
+    m_model.height = 1;
+    m_model.range.min = 0.0;
+    m_model.range.max = range_max;
+
+    size_t offset = 0;
+    for(auto sensor : m_members)
+    {
+        std::visit([&](const auto& model) {
+            stack_rays(model, *sensor, offset, m_model, m_ranges, m_weights);
+        }, sensor->model);
+        offset += model_size(sensor->model);
+    }
+
+    m_corr->setParams(params);
+    m_corr->setModel(m_model);
+    m_corr->setInputData(m_ranges);
+    m_corr->setInputWeights(m_weights);
+}
+
+void MICPSensorStack::setRayMask(unsigned int ray_mask)
+{
+    CorrectionParams params = m_corr->params();
+    if(params.ray_mask != ray_mask)
+    {
+        params.ray_mask = ray_mask;
+        m_corr->setParams(params);
+    }
+}
+
+void MICPSensorStack::setMaxDistance(float max_distance)
+{
+    CorrectionParams params = m_corr->params();
+    if(params.max_distance != max_distance)
+    {
+        params.max_distance = max_distance;
+        m_corr->setParams(params);
+    }
+}
+
+bool MICPSensorStack::active() const
+{
+    return !m_members.empty();
+}
+
+bool MICPSensorStack::contains(const std::string& sensor_name) const
+{
+    for(auto sensor : m_members)
+    {
+        if(sensor->name == sensor_name)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string MICPSensorStack::leader() const
+{
+    if(m_members.empty())
+    {
+        return "";
+    }
+    return m_members[0]->name;
+}
+
+float MICPSensorStack::weight() const
+{
+    return m_weight;
+}
+
+size_t MICPSensorStack::numRays() const
+{
+    return m_ranges.size();
+}
+
+void MICPSensorStack::computeCovs(
+    const rm::MemoryView<rm::Transform, rm::RAM>& Tbms,
+    CorrectionPreResults<rm::RAM>& res)
+{
+    m_corr->computeCovs(Tbms, res);
+}
+
+} // namespace rmcl
+
+#endif // RMCL_EMBREE
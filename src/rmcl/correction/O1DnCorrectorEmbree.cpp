@@ -2,6 +2,7 @@
 #include <Eigen/Dense>
 
 #include <rmcl/math/math.h>
+#include <rmcl/map/EmbreeMapAttributes.hpp>
 
 #include <rmagine/math/omp.h>
 
@@ -38,6 +39,8 @@ CorrectionResults<rm::RAM> O1DnCorrectorEmbree::correct(
     const float max_distance = m_params.max_distance;
 
     auto scene = m_map->scene->handle();
+    // precomputed normals and weights, instance transforms
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
 
     const rm::Transform Tsb = m_Tsb[0];
 
@@ -53,6 +56,7 @@ CorrectionResults<rm::RAM> O1DnCorrectorEmbree::correct(
         Vector Dmean = {0.0, 0.0, 0.0};
         Vector Mmean = {0.0, 0.0, 0.0};
         unsigned int Ncorr = 0;
+        float Wsum = 0.0;
         Matrix3x3 C;
         C.setZeros();
 
@@ -85,22 +89,20 @@ CorrectionResults<rm::RAM> O1DnCorrectorEmbree::correct(
                 rayhit.ray.dir_z = ray_dir_m.z;
                 rayhit.ray.tnear = 0;
                 rayhit.ray.tfar = std::numeric_limits<float>::infinity();
-                rayhit.ray.mask = -1;
+                rayhit.ray.mask = m_params.ray_mask;
                 rayhit.ray.flags = 0;
                 rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
                 rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 
                 rtcIntersect1(scene, &rayhit);
                 
-                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
+                // map space. Surfaces with weight 0 are ignored
+                Vector nint_m;
+                float w_map;
+                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID
+                    && hit_surface(attr.get(), rayhit.hit, nint_m, w_map);
                 if(sim_valid)
                 {
-                    Vector nint_m;
-                    nint_m.x = rayhit.hit.Ng_x;
-                    nint_m.y = rayhit.hit.Ng_y;
-                    nint_m.z = rayhit.hit.Ng_z;
-                    nint_m.normalizeInplace();
-
                     // Do point to plane ICP here
                     Vector preal_s, pint_s, nint_s;
                     preal_s = ray_orig_s + ray_dir_s * range_real;
@@ -133,10 +135,10 @@ CorrectionResults<rm::RAM> O1DnCorrectorEmbree::correct(
                         // - wrong: https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance
                         // use the following equations instead
                         {
-                            const float N_1 = static_cast<float>(Ncorr);
-                            const float N = static_cast<float>(Ncorr + 1);
-                            const float w1 = N_1/N;
-                            const float w2 = 1.0/N;
+                            const float N_1 = Wsum;
+                            const float N = Wsum + w_map;
+                            const float w1 = N_1 / N;
+                            const float w2 = w_map / N;
 
                             const rm::Vector d_mean_old = Dmean;
                             const rm::Vector m_mean_old = Mmean;
@@ -151,6 +153,7 @@ CorrectionResults<rm::RAM> O1DnCorrectorEmbree::correct(
                             Dmean = d_mean_new;
                             Mmean = m_mean_new;
                             C = C * w1 + P1 * w2 + P2 * w1;
+                            Wsum = N;
                             Ncorr = Ncorr + 1;
                         }
                     }
@@ -195,11 +198,15 @@ void O1DnCorrectorEmbree::computeCovs(
     rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& ds,
     rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& ms,
     rmagine::MemoryView<rmagine::Matrix3x3, rmagine::RAM>& Cs,
-    rmagine::MemoryView<unsigned int, rmagine::RAM>& Ncorr)
+    rmagine::MemoryView<unsigned int, rmagine::RAM>& Ncorr,
+    rmagine::MemoryView<float, rmagine::RAM>& residuals)
 {
     const float max_distance = m_params.max_distance;
+    const bool with_residuals = (residuals.size() == Tbms.size());
 
     auto scene = m_map->scene->handle();
+    // precomputed normals and weights, instance transforms
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
 
     const rm::Transform Tsb = m_Tsb[0];
 
@@ -216,6 +223,9 @@ void O1DnCorrectorEmbree::computeCovs(
         Vector Dmean = {0.0, 0.0, 0.0};
         Vector Mmean = {0.0, 0.0, 0.0};
         unsigned int Ncorr_ = 0;
+        // sum of point to plane distances
+        float Rsum = 0.0;
+        float Wsum = 0.0;
         Matrix3x3 C;
         C.setZeros();
 
@@ -248,7 +258,7 @@ void O1DnCorrectorEmbree::computeCovs(
                 rayhit.ray.dir_z = ray_dir_m.z;
                 rayhit.ray.tnear = 0;
                 rayhit.ray.tfar = std::numeric_limits<float>::infinity();
-                rayhit.ray.mask = -1;
+                rayhit.ray.mask = m_params.ray_mask;
                 rayhit.ray.flags = 0;
                 rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
                 rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
@@ -257,16 +267,13 @@ void O1DnCorrectorEmbree::computeCovs(
                 rtcIntersect1(scene, &rayhit);
                 
 
-                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
+                // map space. Surfaces with weight 0 are ignored
+                Vector nint_m;
+                float w_map;
+                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID
+                    && hit_surface(attr.get(), rayhit.hit, nint_m, w_map);
                 if(sim_valid)
                 {
-                    // map space
-                    Vector nint_m;
-                    nint_m.x = rayhit.hit.Ng_x;
-                    nint_m.y = rayhit.hit.Ng_y;
-                    nint_m.z = rayhit.hit.Ng_z;
-                    nint_m.normalizeInplace();
-
                     // Do point to plane ICP here
                     Vector preal_s, pint_s, nint_s;
                     preal_s = ray_orig_s + ray_dir_s * range_real;
@@ -299,10 +306,10 @@ void O1DnCorrectorEmbree::computeCovs(
                         // - wrong: https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance
                         // use the following equations instead
                         {
-                            const float N_1 = static_cast<float>(Ncorr_);
-                            const float N = static_cast<float>(Ncorr_ + 1);
-                            const float w1 = N_1/N;
-                            const float w2 = 1.0/N;
+                            const float N_1 = Wsum;
+                            const float N = Wsum + w_map;
+                            const float w1 = N_1 / N;
+                            const float w2 = w_map / N;
 
                             const rm::Vector d_mean_old = Dmean;
                             const rm::Vector m_mean_old = Mmean;
@@ -317,7 +324,9 @@ void O1DnCorrectorEmbree::computeCovs(
                             Dmean = d_mean_new;
                             Mmean = m_mean_new;
                             C = C * w1 + P1 * w2 + P2 * w1;
+                            Wsum = N;
                             Ncorr_ = Ncorr_ + 1;
+                            Rsum += distance;
                         }
                     }
                 }
@@ -325,17 +334,32 @@ void O1DnCorrectorEmbree::computeCovs(
         }
 
         Ncorr[pid] = Ncorr_;
+        if(with_residuals)
+        {
+            residuals[pid] = (Ncorr_ > 0) ? Rsum / static_cast<float>(Ncorr_) : 0.0;
+        }
         ds[pid] = Dmean;
         ms[pid] = Mmean;
         Cs[pid] = C;
     }
 }
 
+void O1DnCorrectorEmbree::computeCovs(
+    const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
+    rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& ds,
+    rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& ms,
+    rmagine::MemoryView<rmagine::Matrix3x3, rmagine::RAM>& Cs,
+    rmagine::MemoryView<unsigned int, rmagine::RAM>& Ncorr)
+{
+    rmagine::MemoryView<float, rmagine::RAM> residuals(nullptr, 0);
+    computeCovs(Tbms, ds, ms, Cs, Ncorr, residuals);
+}
+
 void O1DnCorrectorEmbree::computeCovs(
     const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
     CorrectionPreResults<rmagine::RAM>& res)
 {
-    computeCovs(Tbms, res.ds, res.ms, res.Cs, res.Ncorr);
+    computeCovs(Tbms, res.ds, res.ms, res.Cs, res.Ncorr, res.residuals);
 }
 
 CorrectionPreResults<rmagine::RAM> O1DnCorrectorEmbree::computeCovs(
@@ -362,6 +386,8 @@ void O1DnCorrectorEmbree::findSPC(
     const float max_distance = m_params.max_distance;
 
     auto scene = m_map->scene->handle();
+    // precomputed normals and weights, instance transforms
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
 
     const rm::Transform Tsb = m_Tsb[0];
 
@@ -406,23 +432,20 @@ void O1DnCorrectorEmbree::findSPC(
                 rayhit.ray.dir_z = ray_dir_m.z;
                 rayhit.ray.tnear = 0;
                 rayhit.ray.tfar = std::numeric_limits<float>::infinity();
-                rayhit.ray.mask = -1;
+                rayhit.ray.mask = m_params.ray_mask;
                 rayhit.ray.flags = 0;
                 rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
                 rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 
                 rtcIntersect1(scene, &rayhit);
 
-                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
+                // map space. Surfaces with weight 0 are ignored
+                Vector nint_m;
+                float w_map;
+                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID
+                    && hit_surface(attr.get(), rayhit.hit, nint_m, w_map);
                 if(sim_valid)
                 {
-                    // map space
-                    Vector nint_m;
-                    nint_m.x = rayhit.hit.Ng_x;
-                    nint_m.y = rayhit.hit.Ng_y;
-                    nint_m.z = rayhit.hit.Ng_z;
-                    nint_m.normalizeInplace();
-
                     // Do point to plane ICP here
                     Vector preal_s, pint_s, nint_s;
                     preal_s = ray_orig_s + ray_dir_s * range_real;
@@ -505,6 +528,8 @@ void O1DnCorrectorEmbree::findRCC(
     const float max_distance = m_params.max_distance;
 
     auto scene = m_map->scene->handle();
+    // precomputed normals and weights, instance transforms
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
 
     const rm::Transform Tsb = m_Tsb[0];
 
@@ -542,23 +567,20 @@ void O1DnCorrectorEmbree::findRCC(
             rayhit.ray.dir_z = ray_dir_m.z;
             rayhit.ray.tnear = 0;
             rayhit.ray.tfar = std::numeric_limits<float>::infinity();
-            rayhit.ray.mask = -1;
+            rayhit.ray.mask = m_params.ray_mask;
             rayhit.ray.flags = 0;
             rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
             rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 
             rtcIntersect1(scene, &rayhit);
 
-            bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
+            // map space. Surfaces with weight 0 are ignored
+            rm::Vector nint_m;
+            float w_map;
+            bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID
+                && hit_surface(attr.get(), rayhit.hit, nint_m, w_map);
             if(sim_valid)
             {
-                // map space
-                rm::Vector nint_m;
-                nint_m.x = rayhit.hit.Ng_x;
-                nint_m.y = rayhit.hit.Ng_y;
-                nint_m.z = rayhit.hit.Ng_z;
-                nint_m.normalizeInplace();
-
                 // Do point to plane ICP here
                 rm::Vector preal_s, pint_s, nint_s;
                 preal_s = ray_orig_s + ray_dir_s * range_real;
@@ -659,6 +681,9 @@ void O1DnCorrectorEmbree::findCPC(
     // - pro point: we could still set the max_distance value to inf to produce the same behavior
     const float max_distance = m_params.max_distance;
 
+    // precomputed normals and weights
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
+
     auto scene = m_map->scene->handle();
 
     const rm::Transform Tsb = m_Tsb[0];
@@ -693,13 +718,14 @@ void O1DnCorrectorEmbree::findCPC(
             // use embree's closest point functionality (TODO: improve speed)
             const rm::EmbreeClosestPointResult res = m_map->closestPoint(P_est_m, max_distance);
 
-            const bool res_valid = res.geomID != RTC_INVALID_GEOMETRY_ID && res.primID != RTC_INVALID_GEOMETRY_ID;
+            // map space. Surfaces with weight 0 are ignored
+            rm::Vector nint_m;
+            float w_map;
+            const bool res_valid = res.geomID != RTC_INVALID_GEOMETRY_ID && res.primID != RTC_INVALID_GEOMETRY_ID
+                && closest_point_surface(attr.get(), res, nint_m, w_map);
 
             if(res_valid)
             {
-                // map space
-                rm::Vector nint_m = res.n;
-                nint_m.normalizeInplace();
                 rm::Vector nint_b = Tmb.R * nint_m;
 
                 const rm::Point pint_m = res.p;
@@ -2,6 +2,7 @@
 #include <Eigen/Dense>
 
 #include <rmcl/math/math.h>
+#include <rmcl/map/EmbreeMapAttributes.hpp>
 
 #include <rmagine/math/omp.h>
 
@@ -27,6 +28,17 @@ void OnDnCorrectorEmbree::setInputData(
     m_ranges = ranges;
 }
 
+void OnDnCorrectorEmbree::setInputWeights(
+    const rmagine::MemoryView<float, rmagine::RAM>& weights)
+{
+    m_weights = weights;
+}
+
+void OnDnCorrectorEmbree::clearInputWeights()
+{
+    m_weights.resize(0);
+}
+
 CorrectionResults<rm::RAM> OnDnCorrectorEmbree::correct(
     const rm::MemoryView<rm::Transform, rm::RAM>& Tbms)
 {
@@ -37,9 +49,14 @@ CorrectionResults<rm::RAM> OnDnCorrectorEmbree::correct(
     const float max_distance = m_params.max_distance;
 
     auto scene = m_map->scene->handle();
+    // precomputed normals and weights, instance transforms
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
 
     const rm::Transform Tsb = m_Tsb[0];
 
+    // optional per-ray weights
+    const bool weighted = (m_weights.size() == m_ranges.size());
+
     #pragma omp parallel for default(shared) if(Tbms.size() > 4)
     for(size_t pid=0; pid < Tbms.size(); pid++)
     {
@@ -51,6 +68,7 @@ CorrectionResults<rm::RAM> OnDnCorrectorEmbree::correct(
 
         rm::Vector Dmean = {0.0, 0.0, 0.0};
         rm::Vector Mmean = {0.0, 0.0, 0.0};
+        float Wsum = 0.0;
         unsigned int Ncorr = 0;
         rm::Matrix3x3 C;
         C.setZeros();
@@ -69,6 +87,11 @@ CorrectionResults<rm::RAM> OnDnCorrectorEmbree::correct(
                     continue;
                 }
 
+                if(weighted && m_weights[loc_id] <= 0.0)
+                {
+                    continue;
+                }
+
                 const rm::Vector ray_orig_s = m_model->getOrigin(vid, hid);
                 const rm::Vector ray_orig_m = Tsm * ray_orig_s;
 
@@ -84,23 +107,20 @@ CorrectionResults<rm::RAM> OnDnCorrectorEmbree::correct(
                 rayhit.ray.dir_z = ray_dir_m.z;
                 rayhit.ray.tnear = 0;
                 rayhit.ray.tfar = std::numeric_limits<float>::infinity();
-                rayhit.ray.mask = -1;
+                rayhit.ray.mask = m_params.ray_mask;
                 rayhit.ray.flags = 0;
                 rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
                 rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 
                 rtcIntersect1(scene, &rayhit);
 
-                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
+                // map space. Surfaces with weight 0 are ignored
+                rm::Vector nint_m;
+                float w_map;
+                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID
+                    && hit_surface(attr.get(), rayhit.hit, nint_m, w_map);
                 if(sim_valid)
                 {
-                    // map space
-                    rm::Vector nint_m;
-                    nint_m.x = rayhit.hit.Ng_x;
-                    nint_m.y = rayhit.hit.Ng_y;
-                    nint_m.z = rayhit.hit.Ng_z;
-                    nint_m.normalizeInplace();
-
                     // Do point to plane ICP here
                     rm::Vector preal_s, pint_s, nint_s;
                     preal_s = ray_orig_s + ray_dir_s * range_real;
@@ -127,10 +147,11 @@ CorrectionResults<rm::RAM> OnDnCorrectorEmbree::correct(
                         // - wrong: https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance
                         // use the following equations instead
                         {
-                            const float N_1 = static_cast<float>(Ncorr);
-                            const float N = static_cast<float>(Ncorr + 1);
+                            const float w = (weighted ? m_weights[loc_id] : 1.0f) * w_map;
+                            const float N_1 = Wsum;
+                            const float N = Wsum + w;
                             const float w1 = N_1 / N;
-                            const float w2 = 1.0 / N;
+                            const float w2 = w / N;
 
                             const rm::Vector d_mean_old = Dmean;
                             const rm::Vector m_mean_old = Mmean;
@@ -145,6 +166,7 @@ CorrectionResults<rm::RAM> OnDnCorrectorEmbree::correct(
                             Dmean = d_mean_new;
                             Mmean = m_mean_new;
                             C = C * w1 + P1 * w2 + P2 * w1;
+                            Wsum = N;
                             Ncorr = Ncorr + 1;
                         }
                     }
@@ -189,14 +211,36 @@ void OnDnCorrectorEmbree::computeCovs(
     rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& ds,
     rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& ms,
     rmagine::MemoryView<rmagine::Matrix3x3, rmagine::RAM>& Cs,
-    rmagine::MemoryView<unsigned int, rmagine::RAM>& Ncorr)
+    rmagine::MemoryView<unsigned int, rmagine::RAM>& Ncorr,
+    rmagine::MemoryView<float, rmagine::RAM>& residuals)
 {
     const float max_distance = m_params.max_distance;
+    const bool with_residuals = (residuals.size() == Tbms.size());
 
     auto scene = m_map->scene->handle();
+    // precomputed normals and weights, instance transforms
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
 
     const rm::Transform Tsb = m_Tsb[0];
 
+    // optional per-ray weights
+    const bool weighted = (m_weights.size() == m_ranges.size());
+
+    if(Tbms.size() <= 4)
+    {
+        // too few poses to keep the threads busy: parallelize over rays instead
+        for(size_t pid=0; pid < Tbms.size(); pid++)
+        {
+            float residual;
+            computeCovsRayParallel(Tbms[pid], ds[pid], ms[pid], Cs[pid], Ncorr[pid], residual);
+            if(with_residuals)
+            {
+                residuals[pid] = residual;
+            }
+        }
+        return;
+    }
+
     #pragma omp parallel for default(shared) if(Tbms.size() > 4)
     for(size_t pid=0; pid < Tbms.size(); pid++)
     {
@@ -208,7 +252,10 @@ void OnDnCorrectorEmbree::computeCovs(
 
         rm::Vector Dmean = {0.0, 0.0, 0.0};
         rm::Vector Mmean = {0.0, 0.0, 0.0};
+        float Wsum = 0.0;
         unsigned int Ncorr_ = 0;
+        // sum of point to plane distances
+        float Rsum = 0.0;
         rm::Matrix3x3 C;
         C.setZeros();
 
@@ -226,6 +273,11 @@ void OnDnCorrectorEmbree::computeCovs(
                     continue;
                 }
 
+                if(weighted && m_weights[loc_id] <= 0.0)
+                {
+                    continue;
+                }
+
                 const rm::Vector ray_orig_s = m_model->getOrigin(vid, hid);
                 const rm::Vector ray_orig_m = Tsm * ray_orig_s;
 
@@ -241,23 +293,20 @@ void OnDnCorrectorEmbree::computeCovs(
                 rayhit.ray.dir_z = ray_dir_m.z;
                 rayhit.ray.tnear = 0;
                 rayhit.ray.tfar = std::numeric_limits<float>::infinity();
-                rayhit.ray.mask = -1;
+                rayhit.ray.mask = m_params.ray_mask;
                 rayhit.ray.flags = 0;
                 rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
                 rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 
                 rtcIntersect1(scene, &rayhit);
 
-                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
+                // map space. Surfaces with weight 0 are ignored
+                rm::Vector nint_m;
+                float w_map;
+                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID
+                    && hit_surface(attr.get(), rayhit.hit, nint_m, w_map);
                 if(sim_valid)
                 {
-                    // map space
-                    rm::Vector nint_m;
-                    nint_m.x = rayhit.hit.Ng_x;
-                    nint_m.y = rayhit.hit.Ng_y;
-                    nint_m.z = rayhit.hit.Ng_z;
-                    nint_m.normalizeInplace();
-
                     // sensor space
                     // Do point to plane ICP here
                     rm::Vector preal_s, pint_s, nint_s;
@@ -291,10 +340,11 @@ void OnDnCorrectorEmbree::computeCovs(
                         // - wrong: https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance
                         // use the following equations instead
                         {
-                            const float N_1 = static_cast<float>(Ncorr_);
-                            const float N = static_cast<float>(Ncorr_ + 1);
-                            const float w1 = N_1/N;
-                            const float w2 = 1.0/N;
+                            const float w = (weighted ? m_weights[loc_id] : 1.0f) * w_map;
+                            const float N_1 = Wsum;
+                            const float N = Wsum + w;
+                            const float w1 = N_1 / N;
+                            const float w2 = w / N;
 
                             const rm::Vector d_mean_old = Dmean;
                             const rm::Vector m_mean_old = Mmean;
@@ -309,7 +359,9 @@ void OnDnCorrectorEmbree::computeCovs(
                             Dmean = d_mean_new;
                             Mmean = m_mean_new;
                             C = C * w1 + P1 * w2 + P2 * w1;
+                            Wsum = N;
                             Ncorr_ = Ncorr_ + 1;
+                            Rsum += distance;
                         }
                     }
                 }
@@ -317,6 +369,10 @@ void OnDnCorrectorEmbree::computeCovs(
         }
 
         Ncorr[pid] = Ncorr_;
+        if(with_residuals)
+        {
+            residuals[pid] = (Ncorr_ > 0) ? Rsum / static_cast<float>(Ncorr_) : 0.0;
+        }
 
         if(Ncorr_ > 0)
         {
@@ -334,11 +390,194 @@ void OnDnCorrectorEmbree::computeCovs(
     }
 }
 
+void OnDnCorrectorEmbree::computeCovsRayParallel(
+    const rm::Transform& Tbm,
+    rm::Vector& d_mean,
+    rm::Vector& m_mean,
+    rm::Matrix3x3& C_out,
+    unsigned int& Ncorr_out,
+    float& residual_out)
+{
+    const float max_distance = m_params.max_distance;
+
+    auto scene = m_map->scene->handle();
+    // precomputed normals and weights, instance transforms
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
+
+    const rm::Transform Tsb = m_Tsb[0];
+    const rm::Transform Tsm = Tbm * Tsb;
+    const rm::Transform Tms = ~Tsm;
+
+    const bool weighted = (m_weights.size() == m_ranges.size());
+
+    const unsigned int width = m_model->getWidth();
+    const size_t Nrays = static_cast<size_t>(width) * m_model->getHeight();
+
+    rm::Vector Dmean = {0.0, 0.0, 0.0};
+    rm::Vector Mmean = {0.0, 0.0, 0.0};
+    float Wsum = 0.0;
+    unsigned int Ncorr = 0;
+    float Rsum = 0.0;
+    rm::Matrix3x3 C;
+    C.setZeros();
+
+    #pragma omp parallel default(shared) if(Nrays > 1000)
+    {
+        // thread local online update
+        rm::Vector Dmean_t = {0.0, 0.0, 0.0};
+        rm::Vector Mmean_t = {0.0, 0.0, 0.0};
+        float Wsum_t = 0.0;
+        unsigned int Ncorr_t = 0;
+        float Rsum_t = 0.0;
+        rm::Matrix3x3 C_t;
+        C_t.setZeros();
+
+        #pragma omp for nowait
+        for(size_t rid = 0; rid < Nrays; rid++)
+        {
+            const unsigned int vid = rid / width;
+            const unsigned int hid = rid % width;
+            const unsigned int loc_id = m_model->getBufferId(vid, hid);
+
+            const float range_real = m_ranges[loc_id];
+            if(range_real < m_model->range.min 
+                || range_real > m_model->range.max)
+            {
+                continue;
+            }
+
+            const float w_ray = (weighted ? m_weights[loc_id] : 1.0f);
+            if(w_ray <= 0.0)
+            {
+                continue;
+            }
+
+            const rm::Vector ray_orig_s = m_model->getOrigin(vid, hid);
+            const rm::Vector ray_orig_m = Tsm * ray_orig_s;
+
+            const rm::Vector ray_dir_s = m_model->getDirection(vid, hid);
+            const rm::Vector ray_dir_m = Tsm.R * ray_dir_s;
+
+            RTCRayHit rayhit;
+            rayhit.ray.org_x = ray_orig_m.x;
+            rayhit.ray.org_y = ray_orig_m.y;
+            rayhit.ray.org_z = ray_orig_m.z;
+            rayhit.ray.dir_x = ray_dir_m.x;
+            rayhit.ray.dir_y = ray_dir_m.y;
+            rayhit.ray.dir_z = ray_dir_m.z;
+            rayhit.ray.tnear = 0;
+            rayhit.ray.tfar = std::numeric_limits<float>::infinity();
+            rayhit.ray.mask = m_params.ray_mask;
+            rayhit.ray.flags = 0;
+            rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+            rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+
+            rtcIntersect1(scene, &rayhit);
+
+            // map space. Surfaces with weight 0 are ignored
+            rm::Vector nint_m;
+            float w_map;
+            if(rayhit.hit.geomID == RTC_INVALID_GEOMETRY_ID
+                || !hit_surface(attr.get(), rayhit.hit, nint_m, w_map))
+            {
+                continue;
+            }
+
+            const rm::Vector preal_s = ray_orig_s + ray_dir_s * range_real;
+            const rm::Vector pint_s = ray_orig_s + ray_dir_s * rayhit.ray.tfar;
+            const rm::Vector nint_s = Tms.R * nint_m;
+
+            const float signed_plane_dist = (pint_s - preal_s).dot(nint_s);
+            const rm::Vector pmesh_s = preal_s + nint_s * signed_plane_dist;
+
+            const float distance = (pmesh_s - preal_s).l2norm();
+
+            if(distance < max_distance)
+            {
+                const rm::Vector preal_b = Tsb * preal_s;
+                const rm::Vector pmesh_b = Tsb * pmesh_s;
+
+                const float w = w_ray * w_map;
+                const float N = Wsum_t + w;
+                const float w1 = Wsum_t / N;
+                const float w2 = w / N;
+
+                const rm::Vector d_mean_old = Dmean_t;
+                const rm::Vector m_mean_old = Mmean_t;
+
+                const rm::Vector d_mean_new = d_mean_old * w1 + preal_b * w2; 
+                const rm::Vector m_mean_new = m_mean_old * w1 + pmesh_b * w2;
+
+                auto P1 = (pmesh_b - m_mean_new).multT(preal_b - d_mean_new);
+                auto P2 = (m_mean_old - m_mean_new).multT(d_mean_old - d_mean_new);
+
+                Dmean_t = d_mean_new;
+                Mmean_t = m_mean_new;
+                C_t = C_t * w1 + P1 * w2 + P2 * w1;
+                Wsum_t = N;
+                Ncorr_t++;
+                Rsum_t += distance;
+            }
+        }
+
+        // merge thread results. same as weighted_average
+        #pragma omp critical
+        if(Ncorr_t > 0)
+        {
+            const float N = Wsum + Wsum_t;
+            const float w1 = Wsum / N;
+            const float w2 = Wsum_t / N;
+
+            const rm::Vector d_mean_new = Dmean * w1 + Dmean_t * w2;
+            const rm::Vector m_mean_new = Mmean * w1 + Mmean_t * w2;
+
+            auto P1 = C * w1 + C_t * w2;
+            auto P2 = (Mmean - m_mean_new).multT(Dmean - d_mean_new) * w1 
+                    + (Mmean_t - m_mean_new).multT(Dmean_t - d_mean_new) * w2;
+
+            Dmean = d_mean_new;
+            Mmean = m_mean_new;
+            C = P1 + P2;
+            Wsum = N;
+            Ncorr += Ncorr_t;
+            Rsum += Rsum_t;
+        }
+    }
+
+    Ncorr_out = Ncorr;
+    residual_out = (Ncorr > 0) ? Rsum / static_cast<float>(Ncorr) : 0.0;
+
+    if(Ncorr > 0)
+    {
+        // keep the scaling of computeCovs
+        C /= static_cast<float>(Ncorr);
+
+        d_mean = Dmean;
+        m_mean = Mmean;
+        C_out = C;
+    } else {
+        d_mean = {0.0, 0.0, 0.0};
+        m_mean = {0.0, 0.0, 0.0};
+        C_out.setZeros();
+    }
+}
+
+void OnDnCorrectorEmbree::computeCovs(
+    const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
+    rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& ds,
+    rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& ms,
+    rmagine::MemoryView<rmagine::Matrix3x3, rmagine::RAM>& Cs,
+    rmagine::MemoryView<unsigned int, rmagine::RAM>& Ncorr)
+{
+    rmagine::MemoryView<float, rmagine::RAM> residuals(nullptr, 0);
+    computeCovs(Tbms, ds, ms, Cs, Ncorr, residuals);
+}
+
 void OnDnCorrectorEmbree::computeCovs(
     const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
     CorrectionPreResults<rmagine::RAM>& res)
 {
-    computeCovs(Tbms, res.ds, res.ms, res.Cs, res.Ncorr);
+    computeCovs(Tbms, res.ds, res.ms, res.Cs, res.Ncorr, res.residuals);
 }
 
 CorrectionPreResults<rmagine::RAM> OnDnCorrectorEmbree::computeCovs(
@@ -365,6 +604,8 @@ void OnDnCorrectorEmbree::findSPC(
     const float max_distance = m_params.max_distance;
 
     auto scene = m_map->scene->handle();
+    // precomputed normals and weights, instance transforms
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
 
     const rm::Transform Tsb = m_Tsb[0];
 
@@ -410,23 +651,20 @@ void OnDnCorrectorEmbree::findSPC(
                 rayhit.ray.dir_z = ray_dir_m.z;
                 rayhit.ray.tnear = 0;
                 rayhit.ray.tfar = std::numeric_limits<float>::infinity();
-                rayhit.ray.mask = -1;
+                rayhit.ray.mask = m_params.ray_mask;
                 rayhit.ray.flags = 0;
                 rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
                 rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 
                 rtcIntersect1(scene, &rayhit);
 
-                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
+                // map space. Surfaces with weight 0 are ignored
+                rm::Vector nint_m;
+                float w_map;
+                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID
+                    && hit_surface(attr.get(), rayhit.hit, nint_m, w_map);
                 if(sim_valid)
                 {
-                    // map space
-                    rm::Vector nint_m;
-                    nint_m.x = rayhit.hit.Ng_x;
-                    nint_m.y = rayhit.hit.Ng_y;
-                    nint_m.z = rayhit.hit.Ng_z;
-                    nint_m.normalizeInplace();
-
                     // Do point to plane ICP here
                     rm::Vector preal_s, pint_s, nint_s;
                     preal_s = ray_orig_s + ray_dir_s * range_real;
@@ -509,6 +747,8 @@ void OnDnCorrectorEmbree::findRCC(
     const float max_distance = m_params.max_distance;
 
     auto scene = m_map->scene->handle();
+    // precomputed normals and weights, instance transforms
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
 
     const rm::Transform Tsb = m_Tsb[0];
 
@@ -546,23 +786,20 @@ void OnDnCorrectorEmbree::findRCC(
             rayhit.ray.dir_z = ray_dir_m.z;
             rayhit.ray.tnear = 0;
             rayhit.ray.tfar = std::numeric_limits<float>::infinity();
-            rayhit.ray.mask = -1;
+            rayhit.ray.mask = m_params.ray_mask;
             rayhit.ray.flags = 0;
             rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
             rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 
             rtcIntersect1(scene, &rayhit);
 
-            bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
+            // map space. Surfaces with weight 0 are ignored
+            rm::Vector nint_m;
+            float w_map;
+            bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID
+                && hit_surface(attr.get(), rayhit.hit, nint_m, w_map);
             if(sim_valid)
             {
-                // map space
-                rm::Vector nint_m;
-                nint_m.x = rayhit.hit.Ng_x;
-                nint_m.y = rayhit.hit.Ng_y;
-                nint_m.z = rayhit.hit.Ng_z;
-                nint_m.normalizeInplace();
-
                 // Do point to plane ICP here
                 rm::Vector preal_s, pint_s, nint_s;
                 preal_s = ray_orig_s + ray_dir_s * range_real;
@@ -659,6 +896,9 @@ void OnDnCorrectorEmbree::findCPC(
 {
     const float max_distance = m_params.max_distance;
 
+    // precomputed normals and weights
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
+
     auto scene = m_map->scene->handle();
 
     const rm::Transform Tsb = m_Tsb[0];
@@ -693,13 +933,14 @@ void OnDnCorrectorEmbree::findCPC(
             // use embree's closest point functionality (TODO: improve speed)
             const rm::EmbreeClosestPointResult res = m_map->closestPoint(P_est_m, max_distance);
 
-            bool res_valid = res.geomID != RTC_INVALID_GEOMETRY_ID && res.primID != RTC_INVALID_GEOMETRY_ID;
+            // map space. Surfaces with weight 0 are ignored
+            rm::Vector nint_m;
+            float w_map;
+            bool res_valid = res.geomID != RTC_INVALID_GEOMETRY_ID && res.primID != RTC_INVALID_GEOMETRY_ID
+                && closest_point_surface(attr.get(), res, nint_m, w_map);
 
             if(res_valid)
             {
-                // map space
-                rm::Vector nint_m = res.n;
-                nint_m.normalizeInplace();
                 rm::Vector nint_b = Tmb.R * nint_m;
 
                 const rm::Point pint_m = res.p;
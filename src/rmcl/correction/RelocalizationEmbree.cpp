@@ -0,0 +1,101 @@
+#include "rmcl/correction/RelocalizationEmbree.hpp"
+
+#include <cmath>
+#include <limits>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+std::vector<rm::Vector> relocalization_positions(
+    const rm::EmbreeMapPtr& map,
+    const RelocalizationParams& params,
+    unsigned int ray_mask)
+{
+    RTCScene scene = map->scene->handle();
+    RTCBounds bounds;
+    rtcGetSceneBounds(scene, &bounds);
+
+    if(!(bounds.upper_x >= bounds.lower_x) || params.step <= 0.0)
+    {
+        return {};
+    }
+
+    const size_t nx = static_cast<size_t>((bounds.upper_x - bounds.lower_x) / params.step) + 1;
+    const size_t ny = static_cast<size_t>((bounds.upper_y - bounds.lower_y) / params.step) + 1;
+
+    // distance to the first surface along a vertical ray
+    auto cast = [&](float x, float y, float z, float dir_z) -> RTCRayHit
+    {
+        RTCRayHit rayhit;
+        rayhit.ray.org_x = x;
+        rayhit.ray.org_y = y;
+        rayhit.ray.org_z = z;
+        rayhit.ray.dir_x = 0.0;
+        rayhit.ray.dir_y = 0.0;
+        rayhit.ray.dir_z = dir_z;
+        rayhit.ray.tnear = 0;
+        rayhit.ray.tfar = std::numeric_limits<float>::infinity();
+        rayhit.ray.mask = ray_mask;
+        rayhit.ray.flags = 0;
+        rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+        rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+        rtcIntersect1(scene, &rayhit);
+        return rayhit;
+    };
+
+    std::vector<std::vector<rm::Vector> > cells(nx * ny);
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t cid = 0; cid < nx * ny; cid++)
+    {
+        const float x = bounds.lower_x + (static_cast<float>(cid % nx) + 0.5) * params.step;
+        const float y = bounds.lower_y + (static_cast<float>(cid / nx) + 0.5) * params.step;
+
+        if(!params.floor)
+        {
+            cells[cid].push_back({x, y, params.z});
+            continue;
+        }
+
+        // walk down through all floors
+        float z_top = bounds.upper_z + 1.0;
+        for(size_t i=0; i<16; i++)
+        {
+            const RTCRayHit down = cast(x, y, z_top, -1.0);
+            if(down.hit.geomID == RTC_INVALID_GEOMETRY_ID)
+            {
+                break;
+            }
+
+            const float z_hit = z_top - down.ray.tfar;
+            z_top = z_hit - 0.01;
+
+            // floors face up or down. Skip slopes and walls
+            const float n_len = std::sqrt(down.hit.Ng_x * down.hit.Ng_x 
+                + down.hit.Ng_y * down.hit.Ng_y + down.hit.Ng_z * down.hit.Ng_z);
+            if(n_len <= 0.0 || std::fabs(down.hit.Ng_z) < 0.7 * n_len)
+            {
+                continue;
+            }
+
+            const RTCRayHit up = cast(x, y, z_hit + 0.01, 1.0);
+            const float headroom = (up.hit.geomID == RTC_INVALID_GEOMETRY_ID) 
+                ? std::numeric_limits<float>::infinity() : up.ray.tfar;
+            if(headroom >= params.min_headroom)
+            {
+                cells[cid].push_back({x, y, z_hit + params.base_height});
+            }
+        }
+    }
+
+    std::vector<rm::Vector> positions;
+    for(const std::vector<rm::Vector>& cell : cells)
+    {
+        positions.insert(positions.end(), cell.begin(), cell.end());
+    }
+    return positions;
+}
+
+} // namespace rmcl
@@ -6,6 +6,7 @@
 #include <rmagine/math/omp.h>
 
 #include <rmcl/math/math.h>
+#include <rmcl/map/EmbreeMapAttributes.hpp>
 
 #include <limits>
 
@@ -40,6 +41,8 @@ CorrectionResults<rmagine::RAM> SphereCorrectorEmbree::correct(
     const float max_distance = m_params.max_distance;
 
     auto scene = m_map->scene->handle();
+    // precomputed normals and weights, instance transforms
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
 
     #pragma omp parallel for default(shared) if(Tbms.size() > 4)
     for(size_t pid=0; pid < Tbms.size(); pid++)
@@ -54,6 +57,7 @@ CorrectionResults<rmagine::RAM> SphereCorrectorEmbree::correct(
         Vector Dmean = {0.0, 0.0, 0.0};
         Vector Mmean = {0.0, 0.0, 0.0};
         unsigned int Ncorr = 0;
+        float Wsum = 0.0;
         Matrix3x3 C;
         C.setZeros();
         
@@ -85,22 +89,20 @@ CorrectionResults<rmagine::RAM> SphereCorrectorEmbree::correct(
                 rayhit.ray.dir_z = ray_dir_m.z;
                 rayhit.ray.tnear = 0;
                 rayhit.ray.tfar = std::numeric_limits<float>::infinity();
-                rayhit.ray.mask = -1;
+                rayhit.ray.mask = m_params.ray_mask;
                 rayhit.ray.flags = 0;
                 rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
                 rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 
                 rtcIntersect1(scene, &rayhit);
 
-                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
+                // map space. Surfaces with weight 0 are ignored
+                Vector nint_m;
+                float w_map;
+                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID
+                    && hit_surface(attr.get(), rayhit.hit, nint_m, w_map);
                 if(sim_valid)
                 {
-                    Vector nint_m;
-                    nint_m.x = rayhit.hit.Ng_x;
-                    nint_m.y = rayhit.hit.Ng_y;
-                    nint_m.z = rayhit.hit.Ng_z;
-                    nint_m.normalizeInplace();
-
                     // Do point to plane ICP here
                     Vector preal_s, pint_s, nint_s;
                     preal_s = ray_dir_s * range_real;
@@ -134,10 +136,10 @@ CorrectionResults<rmagine::RAM> SphereCorrectorEmbree::correct(
                         // - wrong: https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance
                         // use the following equations instead
                         {
-                            const float N_1 = static_cast<float>(Ncorr);
-                            const float N = static_cast<float>(Ncorr + 1);
-                            const float w1 = N_1/N;
-                            const float w2 = 1.0/N;
+                            const float N_1 = Wsum;
+                            const float N = Wsum + w_map;
+                            const float w1 = N_1 / N;
+                            const float w2 = w_map / N;
 
                             const rm::Vector d_mean_old = Dmean;
                             const rm::Vector m_mean_old = Mmean;
@@ -152,6 +154,7 @@ CorrectionResults<rmagine::RAM> SphereCorrectorEmbree::correct(
                             Dmean = d_mean_new;
                             Mmean = m_mean_new;
                             C = C * w1 + P1 * w2 + P2 * w1;
+                            Wsum = N;
                             Ncorr = Ncorr + 1;
                         }
                     }
@@ -196,11 +199,15 @@ void SphereCorrectorEmbree::computeCovs(
     rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& ds,
     rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& ms,
     rmagine::MemoryView<rmagine::Matrix3x3, rmagine::RAM>& Cs,
-    rmagine::MemoryView<unsigned int, rmagine::RAM>& Ncorr)
+    rmagine::MemoryView<unsigned int, rmagine::RAM>& Ncorr,
+    rmagine::MemoryView<float, rmagine::RAM>& residuals)
 {
     const float max_distance = m_params.max_distance;
+    const bool with_residuals = (residuals.size() == Tbms.size());
 
     auto scene = m_map->scene->handle();
+    // precomputed normals and weights, instance transforms
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
 
     const rmagine::Transform Tsb = m_Tsb[0];
 
@@ -216,6 +223,9 @@ void SphereCorrectorEmbree::computeCovs(
         Vector Dmean = {0.0, 0.0, 0.0};
         Vector Mmean = {0.0, 0.0, 0.0};
         unsigned int Ncorr_ = 0;
+        // sum of point to plane distances
+        float Rsum = 0.0;
+        float Wsum = 0.0;
         Matrix3x3 C;
         C.setZeros();
 
@@ -246,23 +256,20 @@ void SphereCorrectorEmbree::computeCovs(
                 rayhit.ray.dir_z = ray_dir_m.z;
                 rayhit.ray.tnear = 0;
                 rayhit.ray.tfar = std::numeric_limits<float>::infinity();
-                rayhit.ray.mask = -1;
+                rayhit.ray.mask = m_params.ray_mask;
                 rayhit.ray.flags = 0;
                 rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
                 rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 
                 rtcIntersect1(scene, &rayhit);
 
-                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
+                // map space. Surfaces with weight 0 are ignored
+                Vector nint_m;
+                float w_map;
+                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID
+                    && hit_surface(attr.get(), rayhit.hit, nint_m, w_map);
                 if(sim_valid)
                 {
-                    // map space
-                    Vector nint_m;
-                    nint_m.x = rayhit.hit.Ng_x;
-                    nint_m.y = rayhit.hit.Ng_y;
-                    nint_m.z = rayhit.hit.Ng_z;
-                    nint_m.normalizeInplace();
-
                     // Do point to plane ICP here
                     Vector preal_s, pint_s, nint_s;
                     preal_s = ray_dir_s * range_real;
@@ -295,10 +302,10 @@ void SphereCorrectorEmbree::computeCovs(
                         // - wrong: https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance
                         // use the following equations instead
                         {
-                            const float N_1 = static_cast<float>(Ncorr_);
-                            const float N = static_cast<float>(Ncorr_ + 1);
-                            const float w1 = N_1/N;
-                            const float w2 = 1.0/N;
+                            const float N_1 = Wsum;
+                            const float N = Wsum + w_map;
+                            const float w1 = N_1 / N;
+                            const float w2 = w_map / N;
 
                             const rm::Vector d_mean_old = Dmean;
                             const rm::Vector m_mean_old = Mmean;
@@ -313,7 +320,9 @@ void SphereCorrectorEmbree::computeCovs(
                             Dmean = d_mean_new;
                             Mmean = m_mean_new;
                             C = C * w1 + P1 * w2 + P2 * w1;
+                            Wsum = N;
                             Ncorr_ = Ncorr_ + 1;
+                            Rsum += distance;
                         }
                     }
                 }
@@ -324,14 +333,29 @@ void SphereCorrectorEmbree::computeCovs(
         ms[pid] = Mmean;
         Cs[pid] = C;
         Ncorr[pid] = Ncorr_;
+        if(with_residuals)
+        {
+            residuals[pid] = (Ncorr_ > 0) ? Rsum / static_cast<float>(Ncorr_) : 0.0;
+        }
     }
 }
 
+void SphereCorrectorEmbree::computeCovs(
+    const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
+    rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& ds,
+    rmagine::MemoryView<rmagine::Vector, rmagine::RAM>& ms,
+    rmagine::MemoryView<rmagine::Matrix3x3, rmagine::RAM>& Cs,
+    rmagine::MemoryView<unsigned int, rmagine::RAM>& Ncorr)
+{
+    rmagine::MemoryView<float, rmagine::RAM> residuals(nullptr, 0);
+    computeCovs(Tbms, ds, ms, Cs, Ncorr, residuals);
+}
+
 void SphereCorrectorEmbree::computeCovs(
     const rmagine::MemoryView<rmagine::Transform, rmagine::RAM>& Tbms,
     CorrectionPreResults<rmagine::RAM>& res)
 {
-    computeCovs(Tbms, res.ds, res.ms, res.Cs, res.Ncorr);
+    computeCovs(Tbms, res.ds, res.ms, res.Cs, res.Ncorr, res.residuals);
 }
 
 CorrectionPreResults<rmagine::RAM> SphereCorrectorEmbree::computeCovs(
@@ -357,6 +381,8 @@ void SphereCorrectorEmbree::findSPC(
     const float max_distance = m_params.max_distance;
 
     auto scene = m_map->scene->handle();
+    // precomputed normals and weights, instance transforms
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
 
     const rm::Transform Tsb = m_Tsb[0];
 
@@ -399,23 +425,20 @@ void SphereCorrectorEmbree::findSPC(
                 rayhit.ray.dir_z = ray_dir_m.z;
                 rayhit.ray.tnear = 0;
                 rayhit.ray.tfar = std::numeric_limits<float>::infinity();
-                rayhit.ray.mask = -1;
+                rayhit.ray.mask = m_params.ray_mask;
                 rayhit.ray.flags = 0;
                 rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
                 rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 
                 rtcIntersect1(scene, &rayhit);
 
-                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
+                // map space. Surfaces with weight 0 are ignored
+                Vector nint_m;
+                float w_map;
+                bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID
+                    && hit_surface(attr.get(), rayhit.hit, nint_m, w_map);
                 if(sim_valid)
                 {
-                    // map space
-                    Vector nint_m;
-                    nint_m.x = rayhit.hit.Ng_x;
-                    nint_m.y = rayhit.hit.Ng_y;
-                    nint_m.z = rayhit.hit.Ng_z;
-                    nint_m.normalizeInplace();
-
                     // Do point to plane ICP here
                     Vector preal_s, pint_s, nint_s;
                     preal_s = ray_dir_s * range_real;
@@ -512,6 +535,8 @@ void SphereCorrectorEmbree::findRCC(
     const float max_distance = m_params.max_distance;
 
     auto scene = m_map->scene->handle();
+    // precomputed normals and weights, instance transforms
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
 
     const rm::Transform Tsb = m_Tsb[0];
 
@@ -549,23 +574,20 @@ void SphereCorrectorEmbree::findRCC(
             rayhit.ray.dir_z = ray_dir_m.z;
             rayhit.ray.tnear = 0;
             rayhit.ray.tfar = std::numeric_limits<float>::infinity();
-            rayhit.ray.mask = -1;
+            rayhit.ray.mask = m_params.ray_mask;
             rayhit.ray.flags = 0;
             rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
             rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 
             rtcIntersect1(scene, &rayhit);
 
-            bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
+            // map space. Surfaces with weight 0 are ignored
+            rm::Vector nint_m;
+            float w_map;
+            bool sim_valid = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID
+                && hit_surface(attr.get(), rayhit.hit, nint_m, w_map);
             if(sim_valid)
             {
-                // map space
-                rm::Vector nint_m;
-                nint_m.x = rayhit.hit.Ng_x;
-                nint_m.y = rayhit.hit.Ng_y;
-                nint_m.z = rayhit.hit.Ng_z;
-                nint_m.normalizeInplace();
-
                 // Do point to plane ICP here
                 rm::Vector preal_s, pint_s, nint_s;
                 preal_s = ray_orig_s + ray_dir_s * range_real;
@@ -663,6 +685,9 @@ void SphereCorrectorEmbree::findCPC(
 {
     const float max_distance = m_params.max_distance;
 
+    // precomputed normals and weights
+    const EmbreeMapAttributesPtr attr = find_map_attributes(m_map);
+
     const rm::Transform Tsb = m_Tsb[0];
 
     const rmagine::Transform Tsm = Tbm * Tsb;
@@ -695,13 +720,14 @@ void SphereCorrectorEmbree::findCPC(
             // use embree's closest point functionality (TODO: improve speed)
             const rm::EmbreeClosestPointResult res = m_map->closestPoint(P_est_m, max_distance);
 
-            const bool res_valid = res.geomID != RTC_INVALID_GEOMETRY_ID && res.primID != RTC_INVALID_GEOMETRY_ID;
+            // map space. Surfaces with weight 0 are ignored
+            rm::Vector nint_m;
+            float w_map;
+            const bool res_valid = res.geomID != RTC_INVALID_GEOMETRY_ID && res.primID != RTC_INVALID_GEOMETRY_ID
+                && closest_point_surface(attr.get(), res, nint_m, w_map);
 
             if(res_valid)
             {
-                // map space
-                rm::Vector nint_m = res.n;
-                nint_m.normalizeInplace();
                 rm::Vector nint_b = Tmb.R * nint_m;
 
                 const rm::Point pint_m = res.p;
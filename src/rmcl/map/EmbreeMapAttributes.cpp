@@ -0,0 +1,192 @@
+#include "rmcl/map/EmbreeMapAttributes.hpp"
+
+#include <rmagine/map/embree/EmbreeScene.hpp>
+#include <rmagine/map/embree/EmbreeMesh.hpp>
+#include <rmagine/map/embree/EmbreeInstance.hpp>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+namespace
+{
+
+struct RegistryEntry
+{
+    // detects a new scene at the address of a released one
+    std::weak_ptr<rm::EmbreeScene> scene;
+    EmbreeMapAttributesPtr         attributes;
+};
+
+std::mutex g_registry_mutex;
+std::unordered_map<const rm::EmbreeScene*, RegistryEntry> g_registry;
+
+float name_weight(
+    const std::string& name,
+    const std::vector<std::pair<std::string, float> >& weights)
+{
+    for(const auto& elem : weights)
+    {
+        if(name.compare(0, elem.first.size(), elem.first) == 0)
+        {
+            return elem.second;
+        }
+    }
+    return 1.0;
+}
+
+PrimitiveTablesPtr make_primitive_tables(
+    const rm::EmbreeScenePtr& scene,
+    const std::vector<std::pair<std::string, float> >& weights,
+    size_t& n_primitives)
+{
+    PrimitiveTablesPtr tables = std::make_shared<PrimitiveTables>();
+
+    for(auto elem : scene->geometries())
+    {
+        rm::EmbreeMeshPtr mesh = std::dynamic_pointer_cast<rm::EmbreeMesh>(elem.second);
+        if(!mesh)
+        {
+            continue;
+        }
+
+        if(elem.first >= tables->size())
+        {
+            tables->resize(elem.first + 1);
+        }
+
+        // Embree intersects the transformed vertices
+        (*tables)[elem.first] = make_primitive_table(
+            mesh->verticesTransformed(), mesh->faces(), name_weight(mesh->name, weights));
+        n_primitives += mesh->faces().size();
+    }
+
+    return tables;
+}
+
+} // namespace
+
+void register_map_attributes(
+    const rm::EmbreeMapPtr& map,
+    EmbreeMapAttributesPtr attributes)
+{
+    std::lock_guard<std::mutex> guard(g_registry_mutex);
+
+    // drop entries of released scenes
+    for(auto it = g_registry.begin(); it != g_registry.end(); )
+    {
+        if(it->second.scene.expired())
+        {
+            it = g_registry.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    g_registry[map->scene.get()] = {map->scene, attributes};
+}
+
+EmbreeMapAttributesPtr find_map_attributes(
+    const rm::EmbreeMapPtr& map)
+{
+    if(!map || !map->scene)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> guard(g_registry_mutex);
+    auto it = g_registry.find(map->scene.get());
+    if(it == g_registry.end() || it->second.scene.lock() != map->scene)
+    {
+        return nullptr;
+    }
+    return it->second.attributes;
+}
+
+PrimitiveTablePtr make_primitive_table(
+    const rm::MemoryView<rm::Point, rm::RAM>& vertices,
+    const rm::MemoryView<rm::Face, rm::RAM>& faces,
+    float weight)
+{
+    PrimitiveTablePtr table = std::make_shared<PrimitiveTable>();
+    table->nx.resize(faces.size());
+    table->ny.resize(faces.size());
+    table->nz.resize(faces.size());
+
+    for(size_t i=0; i<faces.size(); i++)
+    {
+        const rm::Point a = vertices[faces[i].v0];
+        const rm::Point b = vertices[faces[i].v1];
+        const rm::Point c = vertices[faces[i].v2];
+
+        // same orientation as Embree: (v1 - v0) x (v2 - v0)
+        rm::Vector n = (b - a).cross(c - a);
+        const float len = n.l2norm();
+        if(len > 0.0)
+        {
+            n = n / len;
+        }
+
+        table->nx[i] = n.x;
+        table->ny[i] = n.y;
+        table->nz[i] = n.z;
+    }
+
+    if(weight != 1.0)
+    {
+        table->weight.resize(faces.size(), weight);
+    }
+
+    return table;
+}
+
+EmbreeMapAttributesPtr build_map_attributes(
+    const rm::EmbreeMapPtr& map,
+    const std::vector<std::pair<std::string, float> >& weights)
+{
+    EmbreeMapAttributesPtr attributes = find_map_attributes(map);
+    if(!attributes)
+    {
+        attributes = std::make_shared<EmbreeMapAttributes>();
+    }
+
+    size_t n_primitives = 0;
+    PrimitiveTablesPtr tables = make_primitive_tables(map->scene, weights, n_primitives);
+    attributes->geometries = *tables;
+
+    // instanced scenes are shared by their instances, so are the tables
+    std::unordered_map<const rm::EmbreeScene*, PrimitiveTablesPtr> instance_tables;
+
+    for(auto elem : map->scene->geometries())
+    {
+        rm::EmbreeInstancePtr instance = std::dynamic_pointer_cast<rm::EmbreeInstance>(elem.second);
+        if(!instance 
+            || elem.first >= attributes->instances.size() 
+            || !attributes->instances[elem.first].valid)
+        {
+            continue;
+        }
+
+        rm::EmbreeScenePtr instanced_scene = instance->scene();
+        auto it = instance_tables.find(instanced_scene.get());
+        if(it == instance_tables.end())
+        {
+            it = instance_tables.emplace(instanced_scene.get(), 
+                make_primitive_tables(instanced_scene, {}, n_primitives)).first;
+        }
+
+        InstanceNormalTransform& inst = attributes->instances[elem.first];
+        inst.geometries = it->second;
+        inst.weight = name_weight(instance->name, weights);
+    }
+
+    register_map_attributes(map, attributes);
+
+    return attributes;
+}
+
+} // namespace rmcl
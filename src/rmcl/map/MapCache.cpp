@@ -0,0 +1,473 @@
+#include "rmcl/map/MapCache.hpp"
+
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <assimp/scene.h>
+
+#include <rmcl/util/mapped_file.h>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+namespace
+{
+
+constexpr uint32_t BUILD_FLAG_COMPACT = 1;
+constexpr uint32_t BUILD_FLAG_ROBUST  = 2;
+
+inline uint64_t align_up(uint64_t offset)
+{
+    return (offset + MAP_CACHE_ALIGNMENT - 1) / MAP_CACHE_ALIGNMENT * MAP_CACHE_ALIGNMENT;
+}
+
+void write_padding(std::ofstream& ofs, uint64_t offset)
+{
+    static const char zeros[MAP_CACHE_ALIGNMENT] = {0};
+    const uint64_t pos = static_cast<uint64_t>(ofs.tellp());
+    if(offset > pos)
+    {
+        ofs.write(zeros, offset - pos);
+    }
+}
+
+} // anonymous namespace
+
+MapCache::MapCache(const std::string& filename)
+:m_filename(filename)
+{
+    m_fd = ::open(filename.c_str(), O_RDONLY);
+    if(m_fd < 0)
+    {
+        throw std::runtime_error("MapCache - could not open '" + filename + "'");
+    }
+
+    struct stat st;
+    if(fstat(m_fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(MapCacheHeader))
+    {
+        ::close(m_fd);
+        throw std::runtime_error("MapCache - '" + filename + "' is too small");
+    }
+    m_size = st.st_size;
+
+    // private + writable: copy-on-write if anyone writes to the views
+    void* data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, m_fd, 0);
+    if(data == MAP_FAILED)
+    {
+        ::close(m_fd);
+        throw std::runtime_error("MapCache - could not map '" + filename + "'");
+    }
+    m_data = static_cast<uint8_t*>(data);
+    // everything is read once while building the acceleration structures
+    madvise(m_data, m_size, MADV_WILLNEED);
+
+    const MapCacheHeader* header = reinterpret_cast<const MapCacheHeader*>(m_data);
+    if(std::memcmp(header->magic, MAP_CACHE_MAGIC, sizeof(MAP_CACHE_MAGIC)) != 0)
+    {
+        munmap(m_data, m_size);
+        ::close(m_fd);
+        throw std::runtime_error("MapCache - '" + filename + "' is no map cache");
+    }
+
+    // version 1 has no tile_size. It reads as 0 from the zero padding behind the header
+    if(header->version < 1 || header->version > MAP_CACHE_VERSION)
+    {
+        munmap(m_data, m_size);
+        ::close(m_fd);
+        throw std::runtime_error("MapCache - '" + filename + "' has version " 
+            + std::to_string(header->version) + ". Expected " + std::to_string(MAP_CACHE_VERSION));
+    }
+
+    m_hints.quality = static_cast<MapBuildQuality>(header->build_quality);
+    m_hints.compact = (header->build_flags & BUILD_FLAG_COMPACT);
+    m_hints.robust = (header->build_flags & BUILD_FLAG_ROBUST);
+    m_tile_size = header->tile_size;
+
+    if(!mapped_array_valid<MapCacheMeshEntry>(header->meshes_offset, header->n_meshes, m_size))
+    {
+        munmap(m_data, m_size);
+        ::close(m_fd);
+        throw std::runtime_error("MapCache - '" + filename + "' is truncated");
+    }
+
+    const MapCacheMeshEntry* entries = reinterpret_cast<const MapCacheMeshEntry*>(m_data + header->meshes_offset);
+
+    m_meshes.resize(header->n_meshes);
+    for(size_t i=0; i<header->n_meshes; i++)
+    {
+        const MapCacheMeshEntry& entry = entries[i];
+
+        if(!mapped_array_valid<rm::Point>(entry.vertices_offset, entry.n_vertices, m_size)
+            || !mapped_array_valid<rm::Face>(entry.faces_offset, entry.n_faces, m_size)
+            || !mapped_array_valid<rm::Vector>(entry.normals_offset, entry.n_faces, m_size))
+        {
+            munmap(m_data, m_size);
+            ::close(m_fd);
+            throw std::runtime_error("MapCache - '" + filename + "' is truncated");
+        }
+
+        // the faces are used to index the vertices without further checks
+        const rm::Face* faces = reinterpret_cast<const rm::Face*>(m_data + entry.faces_offset);
+        const uint64_t n_vertices = entry.n_vertices;
+        bool faces_valid = true;
+        #pragma omp parallel for reduction(&&: faces_valid)
+        for(size_t j=0; j<entry.n_faces; j++)
+        {
+            const rm::Face& face = faces[j];
+            faces_valid = faces_valid && face.v0 < n_vertices 
+                && face.v1 < n_vertices && face.v2 < n_vertices;
+        }
+
+        if(!faces_valid)
+        {
+            munmap(m_data, m_size);
+            ::close(m_fd);
+            throw std::runtime_error("MapCache - '" + filename + "' has faces with invalid vertex ids");
+        }
+
+        MapCacheMesh& mesh = m_meshes[i];
+        mesh.name = std::string(entry.name, strnlen(entry.name, sizeof(entry.name)));
+        mesh.vertices = rm::MemoryView<rm::Point, rm::RAM>(
+            reinterpret_cast<rm::Point*>(m_data + entry.vertices_offset), entry.n_vertices);
+        mesh.faces = rm::MemoryView<rm::Face, rm::RAM>(
+            reinterpret_cast<rm::Face*>(m_data + entry.faces_offset), entry.n_faces);
+        mesh.face_normals = rm::MemoryView<rm::Vector, rm::RAM>(
+            reinterpret_cast<rm::Vector*>(m_data + entry.normals_offset), entry.n_faces);
+        mesh.bb_min = {entry.bb_min[0], entry.bb_min[1], entry.bb_min[2]};
+        mesh.bb_max = {entry.bb_max[0], entry.bb_max[1], entry.bb_max[2]};
+    }
+}
+
+MapCache::~MapCache()
+{
+    if(m_data)
+    {
+        munmap(m_data, m_size);
+    }
+    if(m_fd >= 0)
+    {
+        ::close(m_fd);
+    }
+}
+
+size_t MapCache::numFaces() const
+{
+    size_t n = 0;
+    for(const MapCacheMesh& mesh : m_meshes)
+    {
+        n += mesh.faces.size();
+    }
+    return n;
+}
+
+bool is_map_cache(const std::string& filename)
+{
+    std::ifstream ifs(filename, std::ios::binary);
+    if(!ifs)
+    {
+        return false;
+    }
+
+    char magic[sizeof(MAP_CACHE_MAGIC)];
+    ifs.read(magic, sizeof(magic));
+    return ifs.good() && std::memcmp(magic, MAP_CACHE_MAGIC, sizeof(magic)) == 0;
+}
+
+void compute_face_normals(
+    const rm::MemoryView<rm::Point, rm::RAM>& vertices,
+    const rm::MemoryView<rm::Face, rm::RAM>& faces,
+    rm::MemoryView<rm::Vector, rm::RAM>& face_normals)
+{
+    #pragma omp parallel for
+    for(size_t i=0; i<faces.size(); i++)
+    {
+        const rm::Face face = faces[i];
+        const rm::Vector a = vertices[face.v0];
+        const rm::Vector b = vertices[face.v1];
+        const rm::Vector c = vertices[face.v2];
+        face_normals[i] = (b - a).cross(c - a).normalize();
+    }
+}
+
+MapCacheMesh map_cache_mesh_view(
+    const MapCacheMeshData& mesh)
+{
+    MapCacheMesh view;
+    view.name = mesh.name;
+    view.vertices = rm::MemoryView<rm::Point, rm::RAM>(
+        const_cast<rm::Point*>(mesh.vertices.raw()), mesh.vertices.size());
+    view.faces = rm::MemoryView<rm::Face, rm::RAM>(
+        const_cast<rm::Face*>(mesh.faces.raw()), mesh.faces.size());
+    view.face_normals = rm::MemoryView<rm::Vector, rm::RAM>(
+        const_cast<rm::Vector*>(mesh.face_normals.raw()), mesh.face_normals.size());
+
+    const float inf = std::numeric_limits<float>::infinity();
+    view.bb_min = {inf, inf, inf};
+    view.bb_max = {-inf, -inf, -inf};
+    for(size_t i=0; i<mesh.vertices.size(); i++)
+    {
+        const rm::Point v = mesh.vertices[i];
+        view.bb_min = {std::min(view.bb_min.x, v.x), std::min(view.bb_min.y, v.y), std::min(view.bb_min.z, v.z)};
+        view.bb_max = {std::max(view.bb_max.x, v.x), std::max(view.bb_max.y, v.y), std::max(view.bb_max.z, v.z)};
+    }
+
+    return view;
+}
+
+namespace
+{
+
+void collect_meshes(
+    const aiScene* ascene,
+    const aiNode* node,
+    aiMatrix4x4 T,
+    std::vector<MapCacheMeshData>& meshes)
+{
+    T = T * node->mTransformation;
+
+    for(unsigned int i=0; i<node->mNumMeshes; i++)
+    {
+        const aiMesh* amesh = ascene->mMeshes[node->mMeshes[i]];
+
+        MapCacheMeshData mesh;
+        mesh.name = std::string(node->mName.C_Str()) + "/" + amesh->mName.C_Str();
+
+        mesh.vertices.resize(amesh->mNumVertices);
+        for(unsigned int j=0; j<amesh->mNumVertices; j++)
+        {
+            const aiVector3D v = T * amesh->mVertices[j];
+            mesh.vertices[j] = {v.x, v.y, v.z};
+        }
+
+        size_t n_faces = 0;
+        for(unsigned int j=0; j<amesh->mNumFaces; j++)
+        {
+            if(amesh->mFaces[j].mNumIndices == 3)
+            {
+                n_faces++;
+            }
+        }
+
+        mesh.faces.resize(n_faces);
+        size_t fid = 0;
+        for(unsigned int j=0; j<amesh->mNumFaces; j++)
+        {
+            const aiFace& face = amesh->mFaces[j];
+            if(face.mNumIndices == 3)
+            {
+                mesh.faces[fid++] = {face.mIndices[0], face.mIndices[1], face.mIndices[2]};
+            }
+        }
+
+        if(n_faces > 0)
+        {
+            mesh.face_normals.resize(n_faces);
+            compute_face_normals(mesh.vertices, mesh.faces, mesh.face_normals);
+            meshes.push_back(mesh);
+        }
+    }
+
+    for(unsigned int i=0; i<node->mNumChildren; i++)
+    {
+        collect_meshes(ascene, node->mChildren[i], T, meshes);
+    }
+}
+
+} // namespace
+
+std::vector<MapCacheMeshData> meshes_from_assimp(
+    const aiScene* ascene)
+{
+    std::vector<MapCacheMeshData> meshes;
+    collect_meshes(ascene, ascene->mRootNode, aiMatrix4x4(), meshes);
+    return meshes;
+}
+
+std::vector<MapCacheMeshData> split_into_tiles(
+    const std::vector<MapCacheMeshData>& meshes,
+    float tile_size)
+{
+    struct Tile
+    {
+        int ix;
+        int iy;
+        std::vector<rm::Point> vertices;
+        std::vector<rm::Face> faces;
+        // (mesh id, vertex id) -> tile vertex id
+        std::unordered_map<uint64_t, unsigned int> vertex_ids;
+    };
+
+    std::map<std::pair<int, int>, Tile> tiles;
+
+    for(size_t mid=0; mid<meshes.size(); mid++)
+    {
+        const MapCacheMeshData& mesh = meshes[mid];
+
+        for(size_t fid=0; fid<mesh.faces.size(); fid++)
+        {
+            const rm::Face face = mesh.faces[fid];
+            const rm::Point centroid = (mesh.vertices[face.v0] 
+                + mesh.vertices[face.v1] + mesh.vertices[face.v2]) / 3.0;
+
+            const int ix = static_cast<int>(std::floor(centroid.x / tile_size));
+            const int iy = static_cast<int>(std::floor(centroid.y / tile_size));
+
+            Tile& tile = tiles[{ix, iy}];
+            tile.ix = ix;
+            tile.iy = iy;
+
+            unsigned int tile_face[3];
+            const unsigned int vids[3] = {face.v0, face.v1, face.v2};
+            for(size_t i=0; i<3; i++)
+            {
+                const uint64_t key = (static_cast<uint64_t>(mid) << 32) | vids[i];
+                auto it = tile.vertex_ids.find(key);
+                if(it == tile.vertex_ids.end())
+                {
+                    it = tile.vertex_ids.emplace(key, tile.vertices.size()).first;
+                    tile.vertices.push_back(mesh.vertices[vids[i]]);
+                }
+                tile_face[i] = it->second;
+            }
+
+            tile.faces.push_back({tile_face[0], tile_face[1], tile_face[2]});
+        }
+    }
+
+    std::vector<MapCacheMeshData> tile_meshes;
+    tile_meshes.reserve(tiles.size());
+    for(auto& elem : tiles)
+    {
+        Tile& tile = elem.second;
+
+        MapCacheMeshData tile_mesh;
+        tile_mesh.name = "tile_" + std::to_string(tile.ix) + "_" + std::to_string(tile.iy);
+        tile_mesh.vertices.resize(tile.vertices.size());
+        std::copy(tile.vertices.begin(), tile.vertices.end(), tile_mesh.vertices.raw());
+        tile_mesh.faces.resize(tile.faces.size());
+        std::copy(tile.faces.begin(), tile.faces.end(), tile_mesh.faces.raw());
+        tile_meshes.push_back(tile_mesh);
+
+        // free early. Large maps
+        tile = Tile();
+    }
+
+    return tile_meshes;
+}
+
+void write_map_cache(
+    const std::string& filename,
+    const std::vector<MapCacheMeshData>& meshes,
+    const MapBuildHints& hints,
+    float tile_size)
+{
+    MapCacheHeader header;
+    std::memcpy(header.magic, MAP_CACHE_MAGIC, sizeof(MAP_CACHE_MAGIC));
+    header.version = MAP_CACHE_VERSION;
+    header.n_meshes = meshes.size();
+    header.build_quality = static_cast<uint32_t>(hints.quality);
+    header.build_flags = (hints.compact ? BUILD_FLAG_COMPACT : 0) 
+                       | (hints.robust ? BUILD_FLAG_ROBUST : 0);
+    header.meshes_offset = align_up(sizeof(MapCacheHeader));
+    header.tile_size = tile_size;
+    header.reserved = 0;
+
+    // compute layout
+    std::vector<MapCacheMeshEntry> entries(meshes.size());
+    uint64_t offset = align_up(header.meshes_offset + meshes.size() * sizeof(MapCacheMeshEntry));
+    for(size_t i=0; i<meshes.size(); i++)
+    {
+        const MapCacheMeshData& mesh = meshes[i];
+        MapCacheMeshEntry& entry = entries[i];
+        std::memset(&entry, 0, sizeof(MapCacheMeshEntry));
+        std::strncpy(entry.name, mesh.name.c_str(), sizeof(entry.name) - 1);
+
+        entry.n_vertices = mesh.vertices.size();
+        entry.n_faces = mesh.faces.size();
+
+        entry.vertices_offset = offset;
+        offset = align_up(offset + entry.n_vertices * sizeof(rm::Point));
+        entry.faces_offset = offset;
+        offset = align_up(offset + entry.n_faces * sizeof(rm::Face));
+        entry.normals_offset = offset;
+        offset = align_up(offset + entry.n_faces * sizeof(rm::Vector));
+
+        for(size_t j=0; j<3; j++)
+        {
+            entry.bb_min[j] = std::numeric_limits<float>::max();
+            entry.bb_max[j] = std::numeric_limits<float>::lowest();
+        }
+
+        for(size_t j=0; j<mesh.vertices.size(); j++)
+        {
+            const rm::Point p = mesh.vertices[j];
+            entry.bb_min[0] = std::min(entry.bb_min[0], p.x);
+            entry.bb_min[1] = std::min(entry.bb_min[1], p.y);
+            entry.bb_min[2] = std::min(entry.bb_min[2], p.z);
+            entry.bb_max[0] = std::max(entry.bb_max[0], p.x);
+            entry.bb_max[1] = std::max(entry.bb_max[1], p.y);
+            entry.bb_max[2] = std::max(entry.bb_max[2], p.z);
+        }
+    }
+
+    // write to a temporary file first. A crash never leaves a broken cache behind
+    const std::string filename_tmp = filename + ".tmp";
+    std::ofstream ofs(filename_tmp, std::ios::binary | std::ios::trunc);
+    if(!ofs)
+    {
+        throw std::runtime_error("write_map_cache - could not open '" + filename_tmp + "'");
+    }
+
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(MapCacheHeader));
+    write_padding(ofs, header.meshes_offset);
+    ofs.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(MapCacheMeshEntry));
+
+    for(size_t i=0; i<meshes.size(); i++)
+    {
+        const MapCacheMeshData& mesh = meshes[i];
+        const MapCacheMeshEntry& entry = entries[i];
+
+        write_padding(ofs, entry.vertices_offset);
+        ofs.write(reinterpret_cast<const char*>(mesh.vertices.raw()), entry.n_vertices * sizeof(rm::Point));
+
+        write_padding(ofs, entry.faces_offset);
+        ofs.write(reinterpret_cast<const char*>(mesh.faces.raw()), entry.n_faces * sizeof(rm::Face));
+
+        write_padding(ofs, entry.normals_offset);
+        if(mesh.face_normals.size() == mesh.faces.size())
+        {
+            ofs.write(reinterpret_cast<const char*>(mesh.face_normals.raw()), entry.n_faces * sizeof(rm::Vector));
+        } else {
+            rm::Memory<rm::Vector, rm::RAM> face_normals(mesh.faces.size());
+            compute_face_normals(mesh.vertices, mesh.faces, face_normals);
+            ofs.write(reinterpret_cast<const char*>(face_normals.raw()), entry.n_faces * sizeof(rm::Vector));
+        }
+    }
+
+    ofs.close();
+    if(!ofs)
+    {
+        throw std::runtime_error("write_map_cache - error while writing '" + filename_tmp + "'");
+    }
+
+    if(std::rename(filename_tmp.c_str(), filename.c_str()) != 0)
+    {
+        throw std::runtime_error("write_map_cache - could not move '" + filename_tmp + "' to '" + filename + "'");
+    }
+}
+
+} // namespace rmcl
@@ -0,0 +1,94 @@
+#include "rmcl/map/MapCacheEmbree.hpp"
+
+#include <algorithm>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+rm::EmbreeMeshPtr embree_mesh_from_cache(
+    const MapCacheMesh& mesh)
+{
+    rm::EmbreeMeshPtr emesh = std::make_shared<rm::EmbreeMesh>(
+        mesh.vertices.size(), mesh.faces.size());
+    emesh->name = mesh.name;
+
+    // the only copy: mapped file -> embree buffers
+    rm::MemoryView<rm::Point, rm::RAM> vertices = emesh->vertices();
+    rm::MemoryView<rm::Face, rm::RAM> faces = emesh->faces();
+    rm::MemoryView<rm::Vector, rm::RAM> face_normals = emesh->faceNormals();
+
+    std::copy(mesh.vertices.raw(), mesh.vertices.raw() + mesh.vertices.size(), vertices.raw());
+    std::copy(mesh.faces.raw(), mesh.faces.raw() + mesh.faces.size(), faces.raw());
+    std::copy(mesh.face_normals.raw(), mesh.face_normals.raw() + mesh.face_normals.size(), face_normals.raw());
+
+    emesh->apply();
+    emesh->commit();
+
+    return emesh;
+}
+
+void apply_build_hints(
+    rm::EmbreeScenePtr scene, 
+    const MapBuildHints& hints)
+{
+    RTCBuildQuality quality = RTC_BUILD_QUALITY_MEDIUM;
+    if(hints.quality == MapBuildQuality::LOW)
+    {
+        quality = RTC_BUILD_QUALITY_LOW;
+    } else if(hints.quality == MapBuildQuality::HIGH) {
+        quality = RTC_BUILD_QUALITY_HIGH;
+    }
+    rtcSetSceneBuildQuality(scene->handle(), quality);
+
+    int flags = RTC_SCENE_FLAG_NONE;
+    if(hints.compact)
+    {
+        flags |= RTC_SCENE_FLAG_COMPACT;
+    }
+    if(hints.robust)
+    {
+        flags |= RTC_SCENE_FLAG_ROBUST;
+    }
+    rtcSetSceneFlags(scene->handle(), static_cast<RTCSceneFlags>(flags));
+}
+
+rm::EmbreeScenePtr embree_scene_from_meshes(
+    const std::vector<MapCacheMesh>& meshes,
+    const MapBuildHints& hints)
+{
+    rm::EmbreeScenePtr scene = std::make_shared<rm::EmbreeScene>();
+    apply_build_hints(scene, hints);
+
+    std::vector<rm::EmbreeMeshPtr> emeshes(meshes.size());
+
+    // buffers are filled in parallel. Adding to the scene is serial
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t i=0; i<meshes.size(); i++)
+    {
+        emeshes[i] = embree_mesh_from_cache(meshes[i]);
+    }
+
+    for(auto emesh : emeshes)
+    {
+        scene->add(emesh);
+    }
+
+    scene->commit();
+    return scene;
+}
+
+rm::EmbreeScenePtr embree_scene_from_cache(
+    const MapCache& cache)
+{
+    return embree_scene_from_meshes(cache.meshes(), cache.hints());
+}
+
+rm::EmbreeMapPtr embree_map_from_cache(
+    const MapCache& cache)
+{
+    return std::make_shared<rm::EmbreeMap>(embree_scene_from_cache(cache));
+}
+
+} // namespace rmcl
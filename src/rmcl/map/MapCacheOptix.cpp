@@ -0,0 +1,51 @@
+#include "rmcl/map/MapCacheOptix.hpp"
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+rm::OptixMeshPtr optix_mesh_from_cache(
+    const MapCacheMesh& mesh)
+{
+    rm::OptixMeshPtr omesh = std::make_shared<rm::OptixMesh>();
+    omesh->name = mesh.name;
+
+    // upload directly from the mapped file
+    omesh->vertices = mesh.vertices;
+    omesh->faces = mesh.faces;
+    omesh->face_normals = mesh.face_normals;
+
+    omesh->apply();
+    omesh->commit();
+
+    return omesh;
+}
+
+rm::OptixScenePtr optix_scene_from_meshes(
+    const std::vector<MapCacheMesh>& meshes)
+{
+    rm::OptixScenePtr scene = std::make_shared<rm::OptixScene>();
+
+    for(const MapCacheMesh& mesh : meshes)
+    {
+        scene->add(optix_mesh_from_cache(mesh));
+    }
+
+    scene->commit();
+    return scene;
+}
+
+rm::OptixScenePtr optix_scene_from_cache(
+    const MapCache& cache)
+{
+    return optix_scene_from_meshes(cache.meshes());
+}
+
+rm::OptixMapPtr optix_map_from_cache(
+    const MapCache& cache)
+{
+    return std::make_shared<rm::OptixMap>(optix_scene_from_cache(cache));
+}
+
+} // namespace rmcl
@@ -0,0 +1,176 @@
+#include "rmcl/map/MapInstancesEmbree.hpp"
+#include "rmcl/map/MapCacheEmbree.hpp"
+#include "rmcl/map/EmbreeMapAttributes.hpp"
+
+#include <rmagine/map/embree/EmbreeInstance.hpp>
+
+#include <assimp/scene.h>
+
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+namespace
+{
+
+struct MeshNode
+{
+    unsigned int mesh_id;
+    aiMatrix4x4  T;
+    std::string  name;
+};
+
+void collect_mesh_nodes(
+    const aiNode* node,
+    aiMatrix4x4 T,
+    std::vector<MeshNode>& mesh_nodes)
+{
+    T = T * node->mTransformation;
+
+    for(unsigned int i=0; i<node->mNumMeshes; i++)
+    {
+        mesh_nodes.push_back({node->mMeshes[i], T, node->mName.C_Str()});
+    }
+
+    for(unsigned int i=0; i<node->mNumChildren; i++)
+    {
+        collect_mesh_nodes(node->mChildren[i], T, mesh_nodes);
+    }
+}
+
+// triangles of the mesh, vertices transformed with T
+MapCacheMeshData mesh_data(
+    const aiMesh* amesh,
+    const aiMatrix4x4& T,
+    const std::string& name)
+{
+    MapCacheMeshData mesh;
+    mesh.name = name;
+
+    mesh.vertices.resize(amesh->mNumVertices);
+    for(unsigned int i=0; i<amesh->mNumVertices; i++)
+    {
+        const aiVector3D v = T * amesh->mVertices[i];
+        mesh.vertices[i] = {v.x, v.y, v.z};
+    }
+
+    std::vector<rm::Face> faces;
+    faces.reserve(amesh->mNumFaces);
+    for(unsigned int i=0; i<amesh->mNumFaces; i++)
+    {
+        const aiFace& face = amesh->mFaces[i];
+        if(face.mNumIndices == 3)
+        {
+            faces.push_back({face.mIndices[0], face.mIndices[1], face.mIndices[2]});
+        }
+    }
+
+    mesh.faces.resize(faces.size());
+    std::copy(faces.begin(), faces.end(), mesh.faces.raw());
+
+    mesh.face_normals.resize(faces.size());
+    compute_face_normals(mesh.vertices, mesh.faces, mesh.face_normals);
+
+    return mesh;
+}
+
+} // namespace
+
+rm::EmbreeMapPtr embree_map_instanced(
+    const aiScene* ascene,
+    unsigned int min_references)
+{
+    std::vector<MeshNode> mesh_nodes;
+    collect_mesh_nodes(ascene->mRootNode, aiMatrix4x4(), mesh_nodes);
+
+    std::vector<unsigned int> references(ascene->mNumMeshes, 0);
+    for(const MeshNode& mesh_node : mesh_nodes)
+    {
+        references[mesh_node.mesh_id]++;
+    }
+
+    rm::EmbreeScenePtr scene = std::make_shared<rm::EmbreeScene>();
+    EmbreeMapAttributesPtr attributes = std::make_shared<EmbreeMapAttributes>();
+
+    // one scene per instanced mesh, in mesh coordinates
+    std::unordered_map<unsigned int, rm::EmbreeScenePtr> prototypes;
+
+    for(const MeshNode& mesh_node : mesh_nodes)
+    {
+        const aiMesh* amesh = ascene->mMeshes[mesh_node.mesh_id];
+        const std::string name = mesh_node.name + "/" + amesh->mName.C_Str();
+
+        if(references[mesh_node.mesh_id] < min_references)
+        {
+            MapCacheMeshData mesh = mesh_data(amesh, mesh_node.T, name);
+            if(mesh.faces.size() > 0)
+            {
+                scene->add(embree_mesh_from_cache(map_cache_mesh_view(mesh)));
+            }
+            continue;
+        }
+
+        auto proto_it = prototypes.find(mesh_node.mesh_id);
+        if(proto_it == prototypes.end())
+        {
+            MapCacheMeshData mesh = mesh_data(amesh, aiMatrix4x4(), amesh->mName.C_Str());
+            if(mesh.faces.size() == 0)
+            {
+                continue;
+            }
+
+            rm::EmbreeScenePtr proto = std::make_shared<rm::EmbreeScene>();
+            proto->add(embree_mesh_from_cache(map_cache_mesh_view(mesh)));
+            proto->commit();
+            proto_it = prototypes.emplace(mesh_node.mesh_id, proto).first;
+        }
+
+        aiVector3D scale, position;
+        aiQuaternion rotation;
+        mesh_node.T.Decompose(scale, rotation, position);
+
+        rm::Transform T;
+        T.R = {rotation.x, rotation.y, rotation.z, rotation.w};
+        T.t = {position.x, position.y, position.z};
+
+        rm::EmbreeInstancePtr instance = std::make_shared<rm::EmbreeInstance>();
+        instance->name = name;
+        instance->set(proto_it->second);
+        instance->setTransform(T);
+        instance->setScale({scale.x, scale.y, scale.z});
+        instance->apply();
+        instance->commit();
+
+        const unsigned int inst_id = scene->add(instance);
+        if(inst_id >= attributes->instances.size())
+        {
+            attributes->instances.resize(inst_id + 1);
+        }
+
+        InstanceNormalTransform& normal_transform = attributes->instances[inst_id];
+        normal_transform.R = T.R;
+        normal_transform.scale_inv = {1.0f / scale.x, 1.0f / scale.y, 1.0f / scale.z};
+        normal_transform.anisotropic = (scale.x != scale.y || scale.y != scale.z);
+        normal_transform.valid = true;
+    }
+
+    scene->commit();
+
+    std::cout << "Instanced map: " << prototypes.size() << " instanced meshes, " 
+        << scene->geometries().size() << " geometries" << std::endl;
+
+    rm::EmbreeMapPtr map = std::make_shared<rm::EmbreeMap>(scene);
+    if(!prototypes.empty())
+    {
+        register_map_attributes(map, attributes);
+    }
+    return map;
+}
+
+} // namespace rmcl
@@ -0,0 +1,210 @@
+#include "rmcl/map/MapTileStreamerEmbree.hpp"
+#include "rmcl/map/MapCacheEmbree.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+MapTileStreamerEmbree::MapTileStreamerEmbree(
+    MapCachePtr cache, 
+    float radius)
+:m_cache(cache)
+,m_radius(radius)
+,m_num_loaded(0)
+,m_stop(false)
+{
+    if(m_cache->tileSize() <= 0.0)
+    {
+        throw std::runtime_error("MapTileStreamerEmbree - '" + m_cache->filename() + "' is not tiled");
+    }
+
+    m_center = {0.0, 0.0, 0.0};
+    m_built_center = m_center;
+}
+
+MapTileStreamerEmbree::~MapTileStreamerEmbree()
+{
+    stop();
+}
+
+rm::EmbreeMapPtr MapTileStreamerEmbree::build(const rm::Vector& center)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_center_mutex);
+        m_center = center;
+        m_built_center = center;
+    }
+
+    m_active_tiles = tilesInRadius(center, m_radius);
+    return buildScene(m_active_tiles, center);
+}
+
+void MapTileStreamerEmbree::start(double update_period, MapCallback callback)
+{
+    stop();
+    m_update_period = update_period;
+    m_callback = callback;
+    m_stop = false;
+    m_thread = std::thread([this]() { loop(); });
+}
+
+void MapTileStreamerEmbree::stop()
+{
+    if(m_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_center_mutex);
+            m_stop = true;
+        }
+        m_center_cv.notify_all();
+        m_thread.join();
+    }
+}
+
+void MapTileStreamerEmbree::setCenter(const rm::Vector& center)
+{
+    bool jumped = false;
+    {
+        std::lock_guard<std::mutex> guard(m_center_mutex);
+        m_center = center;
+        // e.g. a new initial pose: dont wait for the next period
+        if((center - m_built_center).l2norm() > m_radius * 0.5)
+        {
+            m_center_jumped = true;
+            jumped = true;
+        }
+    }
+
+    if(jumped)
+    {
+        m_center_cv.notify_all();
+    }
+}
+
+void MapTileStreamerEmbree::loop()
+{
+    const auto period = std::chrono::duration<double>(m_update_period);
+
+    while(!m_stop)
+    {
+        rm::Vector center;
+        {
+            std::unique_lock<std::mutex> lock(m_center_mutex);
+            m_center_cv.wait_for(lock, period, [this]() { 
+                return m_stop || m_center_jumped;
+            });
+
+            if(m_stop)
+            {
+                break;
+            }
+
+            m_center_jumped = false;
+            center = m_center;
+            m_built_center = center;
+        }
+
+        std::vector<size_t> tiles = tilesInRadius(center, m_radius);
+        if(tiles != m_active_tiles)
+        {
+            rm::EmbreeMapPtr map = buildScene(tiles, center);
+            m_active_tiles = tiles;
+
+            if(m_callback)
+            {
+                // the callback reads the meshes, e.g. for the map attributes
+                std::lock_guard<std::mutex> guard(m_mesh_mutex);
+                m_callback(map);
+            }
+        }
+    }
+}
+
+std::vector<size_t> MapTileStreamerEmbree::tilesInRadius(
+    const rm::Vector& center, 
+    float radius) const
+{
+    std::vector<size_t> tiles;
+
+    const std::vector<MapCacheMesh>& meshes = m_cache->meshes();
+    for(size_t i=0; i<meshes.size(); i++)
+    {
+        const MapCacheMesh& mesh = meshes[i];
+        // xy-distance of center to the tiles bounding box
+        const float dx = std::max({mesh.bb_min.x - center.x, 0.0f, center.x - mesh.bb_max.x});
+        const float dy = std::max({mesh.bb_min.y - center.y, 0.0f, center.y - mesh.bb_max.y});
+
+        if(dx * dx + dy * dy <= radius * radius)
+        {
+            tiles.push_back(i);
+        }
+    }
+
+    return tiles;
+}
+
+rm::EmbreeMapPtr MapTileStreamerEmbree::buildScene(
+    const std::vector<size_t>& tiles,
+    const rm::Vector& center)
+{
+    // release meshes of tiles that are far away. Tiles just behind the border are kept 
+    // to avoid rebuilding them when driving back and forth. The old scene keeps 
+    // its meshes alive until it is swapped out
+    const std::vector<size_t> keep = tilesInRadius(center, m_radius * MESH_KEEP_FACTOR);
+    for(auto it = m_meshes.begin(); it != m_meshes.end(); )
+    {
+        if(!std::binary_search(keep.begin(), keep.end(), it->first))
+        {
+            it = m_meshes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::vector<size_t> missing;
+    for(size_t tile : tiles)
+    {
+        if(m_meshes.find(tile) == m_meshes.end())
+        {
+            missing.push_back(tile);
+        }
+    }
+
+    std::vector<rm::EmbreeMeshPtr> new_meshes(missing.size());
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t i=0; i<missing.size(); i++)
+    {
+        new_meshes[i] = embree_mesh_from_cache(m_cache->meshes()[missing[i]]);
+    }
+
+    for(size_t i=0; i<missing.size(); i++)
+    {
+        m_meshes[missing[i]] = new_meshes[i];
+    }
+
+    rm::EmbreeScenePtr scene = std::make_shared<rm::EmbreeScene>();
+    apply_build_hints(scene, m_cache->hints());
+
+    {
+        // kept meshes are part of the current map and might be updated meanwhile
+        std::lock_guard<std::mutex> guard(m_mesh_mutex);
+        for(size_t tile : tiles)
+        {
+            scene->add(m_meshes[tile]);
+        }
+        scene->commit();
+    }
+
+    m_num_loaded = m_meshes.size();
+
+    return std::make_shared<rm::EmbreeMap>(scene);
+}
+
+} // namespace rmcl
@@ -0,0 +1,274 @@
+#include "rmcl/map/MapUpdaterEmbree.hpp"
+#include "rmcl/map/EmbreeMapAttributes.hpp"
+
+#include <rmagine/map/embree/EmbreeMesh.hpp>
+#include <rmagine/map/embree/EmbreeScene.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+void MapUpdaterEmbree::setDynamic(const std::string& mesh_name, bool dynamic)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    state(mesh_name).dynamic = dynamic;
+}
+
+void MapUpdaterEmbree::setTransform(const std::string& mesh_name, const rm::Transform& T)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    MeshState& s = state(mesh_name);
+    s.has_transform = true;
+    s.T = T;
+}
+
+void MapUpdaterEmbree::setVertices(
+    const std::string& mesh_name, 
+    const rm::MemoryView<rm::Point, rm::RAM>& vertices)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    MeshState& s = state(mesh_name);
+    s.vertices.resize(vertices.size());
+    std::copy(vertices.raw(), vertices.raw() + vertices.size(), s.vertices.raw());
+}
+
+void MapUpdaterEmbree::setEnabled(const std::string& mesh_name, bool enabled)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    state(mesh_name).enabled = enabled;
+}
+
+void MapUpdaterEmbree::setRegions(
+    const std::vector<std::vector<std::string> >& regions)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_regions = regions;
+    m_regions_changed = true;
+}
+
+size_t MapUpdaterEmbree::apply(rm::EmbreeMapPtr map)
+{
+    if(!map)
+    {
+        return 0;
+    }
+
+    std::vector<std::pair<std::string, MeshState> > updates;
+    std::vector<std::string> dynamic_meshes;
+    const bool new_map = (m_map.lock() != map);
+    bool regions_changed = false;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for(const auto& elem : m_states)
+        {
+            if(elem.second.dynamic)
+            {
+                dynamic_meshes.push_back(elem.first);
+            }
+        }
+        regions_changed = m_regions_changed || (new_map && !m_regions.empty());
+        m_regions_changed = false;
+        if(new_map)
+        {
+            for(const auto& elem : m_states)
+            {
+                updates.emplace_back(elem.first, elem.second);
+            }
+        } else {
+            for(const std::string& name : m_changed)
+            {
+                updates.emplace_back(name, m_states[name]);
+            }
+        }
+        m_changed.clear();
+    }
+
+    if(new_map)
+    {
+        m_map = map;
+        m_scene_flags = rtcGetSceneFlags(map->scene->handle());
+        m_geometries.clear();
+        for(auto elem : map->scene->geometries())
+        {
+            m_geometries[elem.second->name] = {elem.first, elem.second};
+        }
+    }
+
+    size_t n_updated = 0;
+    for(const auto& update : updates)
+    {
+        auto it = m_geometries.find(update.first);
+        if(it == m_geometries.end())
+        {
+            // e.g. tile that is not loaded
+            continue;
+        }
+
+        applyState(it->second.second, update.second);
+        updateAttributes(map, it->second.first, update.second);
+        n_updated++;
+    }
+
+    if(n_updated > 0)
+    {
+        // two-level BVH: only the changed geometries are rebuilt or refit.
+        // Only worth it as long as this map has dynamic meshes
+        bool dynamic = false;
+        for(const std::string& name : dynamic_meshes)
+        {
+            if(m_geometries.find(name) != m_geometries.end())
+            {
+                dynamic = true;
+                break;
+            }
+        }
+
+        RTCScene scene = map->scene->handle();
+        const RTCSceneFlags flags = dynamic ? 
+            static_cast<RTCSceneFlags>(m_scene_flags | RTC_SCENE_FLAG_DYNAMIC) : m_scene_flags;
+        if(flags != rtcGetSceneFlags(scene))
+        {
+            rtcSetSceneFlags(scene, flags);
+        }
+    }
+
+    if(regions_changed)
+    {
+        // masks only: no geometry is updated and the scene flags stay
+        applyRegions();
+    }
+
+    if(n_updated > 0 || regions_changed)
+    {
+        map->scene->commit();
+    }
+
+    return n_updated;
+}
+
+void MapUpdaterEmbree::applyRegions()
+{
+    std::vector<std::vector<std::string> > regions;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        regions = m_regions;
+    }
+
+    for(const auto& elem : m_geometries)
+    {
+        const std::string& name = elem.first;
+
+        unsigned int mask = 0;
+        for(size_t i=0; i<regions.size() && i<32; i++)
+        {
+            for(const std::string& prefix : regions[i])
+            {
+                if(name.compare(0, prefix.size(), prefix) == 0)
+                {
+                    mask |= (1u << i);
+                }
+            }
+        }
+
+        if(mask == 0)
+        {
+            // part of every region, e.g. stairs
+            mask = 0xFFFFFFFF;
+        }
+
+        rm::EmbreeGeometryPtr geom = elem.second.second;
+        rtcSetGeometryMask(geom->handle(), mask);
+        geom->commit();
+    }
+}
+
+MeshState& MapUpdaterEmbree::state(const std::string& mesh_name)
+{
+    if(std::find(m_changed.begin(), m_changed.end(), mesh_name) == m_changed.end())
+    {
+        m_changed.push_back(mesh_name);
+    }
+    return m_states[mesh_name];
+}
+
+void MapUpdaterEmbree::applyState(
+    rm::EmbreeGeometryPtr geom, 
+    const MeshState& state)
+{
+    RTCGeometry handle = geom->handle();
+
+    // refit keeps the BVH topology. Valid as long as the faces stay
+    rtcSetGeometryBuildQuality(handle, 
+        state.dynamic ? RTC_BUILD_QUALITY_REFIT : RTC_BUILD_QUALITY_MEDIUM);
+
+    if(state.vertices.size() > 0)
+    {
+        rm::EmbreeMeshPtr mesh = std::dynamic_pointer_cast<rm::EmbreeMesh>(geom);
+        if(mesh && mesh->vertices().size() == state.vertices.size())
+        {
+            rm::MemoryView<rm::Point, rm::RAM> vertices = mesh->vertices();
+            std::copy(state.vertices.raw(), state.vertices.raw() + state.vertices.size(), vertices.raw());
+            mesh->computeFaceNormals();
+        } else {
+            std::cout << "MapUpdaterEmbree - '" << geom->name 
+                << "': vertices do not match the mesh. Skipping" << std::endl;
+        }
+    }
+
+    if(state.has_transform)
+    {
+        geom->setTransform(state.T);
+    }
+
+    geom->apply();
+
+    if(state.enabled)
+    {
+        rtcEnableGeometry(handle);
+    } else {
+        rtcDisableGeometry(handle);
+    }
+
+    geom->commit();
+}
+
+void MapUpdaterEmbree::updateAttributes(
+    rm::EmbreeMapPtr map,
+    unsigned int geom_id,
+    const MeshState& state)
+{
+    if(!state.has_transform && state.vertices.size() == 0)
+    {
+        return;
+    }
+
+    EmbreeMapAttributesPtr attributes = find_map_attributes(map);
+    if(!attributes)
+    {
+        return;
+    }
+
+    if(geom_id < attributes->instances.size() 
+        && attributes->instances[geom_id].valid)
+    {
+        if(state.has_transform)
+        {
+            attributes->instances[geom_id].R = state.T.R;
+        }
+    } else if(geom_id < attributes->geometries.size() 
+        && attributes->geometries[geom_id]) 
+    {
+        // the precomputed normals are outdated. Keep the weights, 
+        // the correctors normalize the hit normal instead
+        PrimitiveTable& table = *attributes->geometries[geom_id];
+        table.nx.clear();
+        table.ny.clear();
+        table.nz.clear();
+    }
+}
+
+} // namespace rmcl
@@ -0,0 +1,290 @@
+#include "rmcl/map/MeshSimplification.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <Eigen/Dense>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+namespace
+{
+
+// sum of squared distances to a set of planes: v^T A v + 2 b^T v + c
+struct Quadric
+{
+    Eigen::Matrix3d A = Eigen::Matrix3d::Zero();
+    Eigen::Vector3d b = Eigen::Vector3d::Zero();
+    double          c = 0.0;
+
+    void addPlane(const Eigen::Vector3d& n, double d, double weight)
+    {
+        A += weight * n * n.transpose();
+        b += weight * d * n;
+        c += weight * d * d;
+    }
+};
+
+struct Cluster
+{
+    Quadric         Q;
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    unsigned int    n = 0;
+    Eigen::Vector3d cell_min;
+};
+
+inline uint64_t cell_key(int64_t ix, int64_t iy, int64_t iz)
+{
+    // 21 bits per axis. Cells are counted from the bounding box minimum
+    constexpr uint64_t MASK = (1ull << 21) - 1;
+    return (static_cast<uint64_t>(ix) & MASK)
+        | ((static_cast<uint64_t>(iy) & MASK) << 21)
+        | ((static_cast<uint64_t>(iz) & MASK) << 42);
+}
+
+struct FaceHash
+{
+    size_t operator()(const std::array<unsigned int, 3>& f) const
+    {
+        size_t h = f[0];
+        h = h * 1000003u ^ f[1];
+        h = h * 1000003u ^ f[2];
+        return h;
+    }
+};
+
+// minimizer of the quadric. Falls back to the vertex mean in
+// directions the planes do not constrain (flat or straight regions)
+Eigen::Vector3d place_vertex(const Cluster& cluster, double cell_size)
+{
+    const Eigen::Vector3d mean = cluster.sum / static_cast<double>(cluster.n);
+
+    Eigen::JacobiSVD<Eigen::Matrix3d> svd(cluster.Q.A, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    const Eigen::Vector3d s = svd.singularValues();
+    if(s(0) <= 0.0)
+    {
+        return mean;
+    }
+
+    Eigen::Vector3d s_inv = Eigen::Vector3d::Zero();
+    for(int i=0; i<3; i++)
+    {
+        if(s(i) > 1e-3 * s(0))
+        {
+            s_inv(i) = 1.0 / s(i);
+        }
+    }
+
+    const Eigen::Matrix3d A_pinv = svd.matrixV() * s_inv.asDiagonal() * svd.matrixU().transpose();
+    const Eigen::Vector3d x = mean - A_pinv * (cluster.Q.A * mean + cluster.Q.b);
+
+    // keep the vertex near its cell. Otherwise thin features produce spikes
+    const Eigen::Vector3d margin = Eigen::Vector3d::Constant(0.5 * cell_size);
+    const Eigen::Vector3d lo = cluster.cell_min - margin;
+    const Eigen::Vector3d hi = cluster.cell_min + Eigen::Vector3d::Constant(cell_size) + margin;
+    if((x.array() < lo.array()).any() || (x.array() > hi.array()).any())
+    {
+        return mean;
+    }
+
+    return x;
+}
+
+inline void check_cell_size(float cell_size)
+{
+    // also false for NaN
+    if(!(cell_size > 0.0))
+    {
+        throw std::invalid_argument("Mesh simplification: cell size must be positive");
+    }
+}
+
+} // namespace
+
+MapCacheMeshData simplify_mesh(
+    const std::string& name,
+    const rm::MemoryView<rm::Point, rm::RAM>& vertices,
+    const rm::MemoryView<rm::Face, rm::RAM>& faces,
+    float cell_size)
+{
+    check_cell_size(cell_size);
+
+    MapCacheMeshData res;
+    res.name = name;
+
+    if(vertices.size() == 0 || faces.size() == 0)
+    {
+        return res;
+    }
+
+    Eigen::Vector3d bb_min = Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+    for(size_t i=0; i<vertices.size(); i++)
+    {
+        const Eigen::Vector3d v(vertices[i].x, vertices[i].y, vertices[i].z);
+        bb_min = bb_min.cwiseMin(v);
+    }
+
+    // 1. assign vertices to cells
+    std::unordered_map<uint64_t, unsigned int> cluster_ids;
+    std::vector<Cluster> clusters;
+    std::vector<unsigned int> vertex_cluster(vertices.size());
+
+    for(size_t i=0; i<vertices.size(); i++)
+    {
+        const Eigen::Vector3d v(vertices[i].x, vertices[i].y, vertices[i].z);
+        const Eigen::Vector3d c = ((v - bb_min) / cell_size).array().floor();
+
+        const uint64_t key = cell_key(
+            static_cast<int64_t>(c.x()),
+            static_cast<int64_t>(c.y()),
+            static_cast<int64_t>(c.z()));
+
+        auto it = cluster_ids.find(key);
+        if(it == cluster_ids.end())
+        {
+            it = cluster_ids.emplace(key, clusters.size()).first;
+            Cluster cluster;
+            cluster.cell_min = bb_min + c * cell_size;
+            clusters.push_back(cluster);
+        }
+
+        Cluster& cluster = clusters[it->second];
+        cluster.sum += v;
+        cluster.n++;
+        vertex_cluster[i] = it->second;
+    }
+
+    // 2. accumulate the area weighted face planes per cluster
+    for(size_t i=0; i<faces.size(); i++)
+    {
+        const rm::Face face = faces[i];
+        const Eigen::Vector3d a(vertices[face.v0].x, vertices[face.v0].y, vertices[face.v0].z);
+        const Eigen::Vector3d b(vertices[face.v1].x, vertices[face.v1].y, vertices[face.v1].z);
+        const Eigen::Vector3d c(vertices[face.v2].x, vertices[face.v2].y, vertices[face.v2].z);
+
+        const Eigen::Vector3d cross = (b - a).cross(c - a);
+        const double len = cross.norm();
+        if(len <= 0.0)
+        {
+            continue;
+        }
+
+        const Eigen::Vector3d n = cross / len;
+        const double d = -n.dot(a);
+        const double area = 0.5 * len;
+
+        clusters[vertex_cluster[face.v0]].Q.addPlane(n, d, area);
+        clusters[vertex_cluster[face.v1]].Q.addPlane(n, d, area);
+        clusters[vertex_cluster[face.v2]].Q.addPlane(n, d, area);
+    }
+
+    // 3. remap faces. Drop collapsed and duplicated faces
+    std::vector<rm::Face> faces_new;
+    std::unordered_set<std::array<unsigned int, 3>, FaceHash> faces_seen;
+    // cluster -> new vertex id
+    std::vector<unsigned int> vertex_ids(clusters.size(), std::numeric_limits<unsigned int>::max());
+    std::vector<unsigned int> used_clusters;
+
+    for(size_t i=0; i<faces.size(); i++)
+    {
+        const rm::Face face = faces[i];
+        const std::array<unsigned int, 3> f = {
+            vertex_cluster[face.v0],
+            vertex_cluster[face.v1],
+            vertex_cluster[face.v2]};
+
+        if(f[0] == f[1] || f[1] == f[2] || f[0] == f[2])
+        {
+            continue;
+        }
+
+        std::array<unsigned int, 3> f_sorted = f;
+        std::sort(f_sorted.begin(), f_sorted.end());
+        if(!faces_seen.insert(f_sorted).second)
+        {
+            continue;
+        }
+
+        unsigned int fv[3];
+        for(size_t j=0; j<3; j++)
+        {
+            if(vertex_ids[f[j]] == std::numeric_limits<unsigned int>::max())
+            {
+                vertex_ids[f[j]] = used_clusters.size();
+                used_clusters.push_back(f[j]);
+            }
+            fv[j] = vertex_ids[f[j]];
+        }
+
+        faces_new.push_back({fv[0], fv[1], fv[2]});
+    }
+
+    if(faces_new.empty())
+    {
+        return res;
+    }
+
+    // 4. place the remaining vertices
+    res.vertices.resize(used_clusters.size());
+    for(size_t i=0; i<used_clusters.size(); i++)
+    {
+        const Eigen::Vector3d x = place_vertex(clusters[used_clusters[i]], cell_size);
+        res.vertices[i] = {
+            static_cast<float>(x.x()),
+            static_cast<float>(x.y()),
+            static_cast<float>(x.z())};
+    }
+
+    res.faces.resize(faces_new.size());
+    std::copy(faces_new.begin(), faces_new.end(), res.faces.raw());
+
+    res.face_normals.resize(faces_new.size());
+    compute_face_normals(res.vertices, res.faces, res.face_normals);
+
+    return res;
+}
+
+std::vector<MapCacheMeshData> simplify_meshes(
+    const std::vector<MapCacheMesh>& meshes,
+    float cell_size)
+{
+    // not thrown from inside the parallel loop
+    check_cell_size(cell_size);
+
+    std::vector<MapCacheMeshData> res(meshes.size());
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t i=0; i<meshes.size(); i++)
+    {
+        res[i] = simplify_mesh(meshes[i].name, meshes[i].vertices, meshes[i].faces, cell_size);
+    }
+
+    res.erase(std::remove_if(res.begin(), res.end(), [](const MapCacheMeshData& mesh) {
+        return mesh.faces.size() == 0;
+    }), res.end());
+
+    return res;
+}
+
+std::vector<MapCacheMeshData> simplify_meshes(
+    const std::vector<MapCacheMeshData>& meshes,
+    float cell_size)
+{
+    std::vector<MapCacheMesh> views;
+    views.reserve(meshes.size());
+    for(const MapCacheMeshData& mesh : meshes)
+    {
+        views.push_back(map_cache_mesh_view(mesh));
+    }
+    return simplify_meshes(views, cell_size);
+}
+
+} // namespace rmcl
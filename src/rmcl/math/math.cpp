@@ -247,6 +247,12 @@ void weighted_average(
         for(size_t i=0; i<dataset_means.size(); i++)
         {
             const float w =  weights[i];
+            if(w <= 0.0)
+            {
+                // nothing to add. avoids 0/0 for leading zero weights
+                continue;
+            }
+
             const rm::Vector Di = dataset_means[i][pid];
             const rm::Vector Mi = model_means[i][pid];
             const rm::Matrix3x3 Ci = covs[i][pid];
@@ -0,0 +1,492 @@
+#include "rmcl/mcl/MCLLocalizationNode.hpp"
+
+#include <rmagine/map/AssimpIO.hpp>
+#include <rmagine/util/StopWatch.hpp>
+
+#include <rmcl/map/MapCache.hpp>
+#include <rmcl/map/MapCacheEmbree.hpp>
+#include <rmcl/map/EmbreeMapAttributes.hpp>
+#include <rmcl/util/conversions.h>
+#include <rmcl/util/ros_helper.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <type_traits>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+MCLLocalizationNode::MCLLocalizationNode(
+    const rclcpp::NodeOptions& options)
+:rclcpp::Node("mcl_localization", rclcpp::NodeOptions(options)
+    .allow_undeclared_parameters(true)
+    .automatically_declare_parameters_from_overrides(true))
+{
+    m_base_frame = rmcl::get_parameter(this, "base_frame", "base_link");
+    m_odom_frame = rmcl::get_parameter(this, "odom_frame", "odom");
+    m_map_frame = rmcl::get_parameter(this, "map_frame", "map");
+    m_sensor_frame = rmcl::get_parameter(this, "sensor.frame", "");
+
+    m_tf_rate = rmcl::get_parameter(this, "tf_rate", 50.0);
+    m_transform_tolerance = rmcl::get_parameter(this, "transform_tolerance", 0.1);
+    m_publish_particles = rmcl::get_parameter(this, "publish_particles", true);
+
+    const std::string map_file = rmcl::get_parameter(this, "map_file", "");
+    if(map_file == "")
+    {
+        RCLCPP_ERROR(this->get_logger(), "User must provide ~map_file");
+        throw std::runtime_error("User must provide ~map_file");
+    }
+    loadMap(map_file);
+
+    // FILTER
+    const int n_particles = rmcl::get_parameter(this, "particles", 2000);
+
+    MotionModelParams motion;
+    motion.alpha_trans_trans = rmcl::get_parameter(this, "motion.alpha_trans_trans", motion.alpha_trans_trans);
+    motion.alpha_trans_rot = rmcl::get_parameter(this, "motion.alpha_trans_rot", motion.alpha_trans_rot);
+    motion.alpha_rot_rot = rmcl::get_parameter(this, "motion.alpha_rot_rot", motion.alpha_rot_rot);
+    motion.alpha_rot_trans = rmcl::get_parameter(this, "motion.alpha_rot_trans", motion.alpha_rot_trans);
+    motion.sigma_trans_min = rmcl::get_parameter(this, "motion.sigma_trans_min", motion.sigma_trans_min);
+    motion.sigma_rot_min = rmcl::get_parameter(this, "motion.sigma_rot_min", motion.sigma_rot_min);
+
+    RecoveryParams recovery;
+    recovery.alpha_slow = rmcl::get_parameter(this, "recovery.alpha_slow", recovery.alpha_slow);
+    recovery.alpha_fast = rmcl::get_parameter(this, "recovery.alpha_fast", recovery.alpha_fast);
+
+    // random particles: x, y within the map, z as configured (floor height)
+    RTCBounds bounds;
+    rtcGetSceneBounds(m_map->scene->handle(), &bounds);
+    ParticleBounds pbounds;
+    pbounds.min = {bounds.lower_x, bounds.lower_y, 
+        static_cast<float>(rmcl::get_parameter(this, "init.z_min", 0.0))};
+    pbounds.max = {bounds.upper_x, bounds.upper_y, 
+        static_cast<float>(rmcl::get_parameter(this, "init.z_max", 0.0))};
+
+    m_pf = std::make_shared<ParticleFilter>(n_particles);
+    m_pf->setMotionModelParams(motion);
+    m_pf->setRecoveryParams(recovery);
+    m_pf->setBounds(pbounds);
+    m_log_likelihoods.resize(n_particles);
+
+    m_likelihood_scale = rmcl::get_parameter(this, "beam.likelihood_scale", 0.1);
+    m_resample_neff_ratio = rmcl::get_parameter(this, "resample_neff_ratio", 0.5);
+    m_update_min_dist = rmcl::get_parameter(this, "update_min_dist", 0.1);
+    m_update_min_angle = rmcl::get_parameter(this, "update_min_angle", 0.1);
+
+    m_init_sigma_trans = rmcl::get_parameter(this, "init.sigma_trans", 0.5);
+    m_init_sigma_yaw = rmcl::get_parameter(this, "init.sigma_yaw", 0.3);
+
+    // SCORING
+    BeamModelParams beam;
+    beam.sigma_hit = rmcl::get_parameter(this, "beam.sigma_hit", beam.sigma_hit);
+    beam.z_hit = rmcl::get_parameter(this, "beam.z_hit", beam.z_hit);
+    beam.z_rand = rmcl::get_parameter(this, "beam.z_rand", beam.z_rand);
+
+    m_scorer = std::make_shared<ParticleScorerEmbree>(m_map);
+    m_scorer->setParams(beam);
+    m_scorer->setMaxBeams(rmcl::get_parameter(this, "beam.max_beams", 512));
+
+    // CLUSTERING
+    m_clustering = rmcl::get_parameter(this, "clustering.enable", true);
+    m_clustering_params.dist_trans = rmcl::get_parameter(this, "clustering.dist_trans", m_clustering_params.dist_trans);
+    m_clustering_params.dist_yaw = rmcl::get_parameter(this, "clustering.dist_yaw", m_clustering_params.dist_yaw);
+    m_clustering_params.min_pts = rmcl::get_parameter(this, "clustering.min_pts", m_clustering_params.min_pts);
+
+    // REFINEMENT
+    m_refine = rmcl::get_parameter(this, "refine.enable", true);
+    m_refine_iterations = rmcl::get_parameter(this, "refine.iterations", 5);
+    m_refine_max_spread = rmcl::get_parameter(this, "refine.max_spread", 0.3);
+    m_refine_min_corr = rmcl::get_parameter(this, "refine.min_corr", 20);
+    m_refine_params.max_distance = rmcl::get_parameter(this, "refine.max_distance", 0.5);
+
+    m_corr_sphere = std::make_shared<SphereCorrectorEmbree>(m_map);
+    m_corr_sphere->setParams(m_refine_params);
+    m_corr_ondn = std::make_shared<OnDnCorrectorEmbree>(m_map);
+    m_corr_ondn->setParams(m_refine_params);
+
+    m_Tom = rm::Transform::Identity();
+    m_Tbo_last = rm::Transform::Identity();
+
+    m_tf_buffer = std::make_shared<tf2_ros::Buffer>(this->get_clock());
+    m_tf_listener = std::make_shared<tf2_ros::TransformListener>(*m_tf_buffer);
+    m_br = std::make_unique<tf2_ros::TransformBroadcaster>(this);
+
+    m_pose_pub = this->create_publisher<geometry_msgs::msg::PoseWithCovarianceStamped>("mcl_pose", 10);
+    m_particles_pub = this->create_publisher<geometry_msgs::msg::PoseArray>("particles", 1);
+
+    // scans, initial pose and the TF timer all use the particle filter and
+    // the odom to map transform. One mutually exclusive group keeps them
+    // serialized, also in a multi-threaded component container
+    m_cb_group = this->create_callback_group(
+        rclcpp::CallbackGroupType::MutuallyExclusive);
+    rclcpp::SubscriptionOptions sub_options;
+    sub_options.callback_group = m_cb_group;
+
+    // SENSOR
+    const std::string topic = rmcl::get_parameter(this, "sensor.topic", "scan");
+    const std::string msg_type = rmcl::get_parameter(this, "sensor.msg", "sensor_msgs/msg/LaserScan");
+
+    if(msg_type == "sensor_msgs/msg/LaserScan")
+    {
+        m_sensor_sub = this->create_subscription<sensor_msgs::msg::LaserScan>(
+            topic, rclcpp::SensorDataQoS(), 
+            [this](const sensor_msgs::msg::LaserScan::ConstSharedPtr msg) -> void
+            {
+                scanCB(msg);
+            }, sub_options);
+    } else if(msg_type == "rmcl_msgs/msg/ScanStamped") {
+        m_sensor_sub = this->create_subscription<rmcl_msgs::msg::ScanStamped>(
+            topic, rclcpp::SensorDataQoS(), 
+            [this](const rmcl_msgs::msg::ScanStamped::ConstSharedPtr msg) -> void
+            {
+                scanStampedCB(msg);
+            }, sub_options);
+    } else if(msg_type == "rmcl_msgs/msg/OnDnStamped") {
+        m_sensor_sub = this->create_subscription<rmcl_msgs::msg::OnDnStamped>(
+            topic, rclcpp::SensorDataQoS(), 
+            [this](const rmcl_msgs::msg::OnDnStamped::ConstSharedPtr msg) -> void
+            {
+                ondnCB(msg);
+            }, sub_options);
+    } else {
+        RCLCPP_ERROR_STREAM(this->get_logger(), "sensor.msg '" << msg_type << "' is not supported");
+        throw std::runtime_error("sensor.msg '" + msg_type + "' is not supported");
+    }
+
+    m_initial_pose_sub = this->create_subscription<geometry_msgs::msg::PoseWithCovarianceStamped>(
+        "initialpose", 1, 
+        [this](const geometry_msgs::msg::PoseWithCovarianceStamped::ConstSharedPtr msg) -> void
+        {
+            initialPoseCB(msg);
+        }, sub_options);
+
+    m_tf_timer = this->create_wall_timer(
+        std::chrono::duration<double>(1.0 / m_tf_rate), 
+        [this]() -> void
+        {
+            if(m_has_estimate)
+            {
+                publishTF(this->now());
+            }
+        }, m_cb_group);
+
+    std::cout << "MCL: " << n_particles << " particles, sensor: " << topic << " (" << msg_type << ")" << std::endl;
+
+    if(rmcl::get_parameter(this, "init.global", false))
+    {
+        std::cout << "MCL: global localization within x: [" << pbounds.min.x << ", " << pbounds.max.x 
+            << "], y: [" << pbounds.min.y << ", " << pbounds.max.y << "]" << std::endl;
+        m_pf->initUniform();
+        m_initialized = true;
+        m_force_update = true;
+    } else {
+        std::cout << "Waiting for pose guess..." << std::endl;
+    }
+}
+
+void MCLLocalizationNode::loadMap(const std::string& filename)
+{
+    rm::StopWatch sw;
+    sw();
+
+    if(is_map_cache(filename))
+    {
+        MapCachePtr cache = std::make_shared<MapCache>(filename);
+        m_map = embree_map_from_cache(*cache);
+    } else {
+        rm::AssimpIO io;
+        const aiScene* ascene = io.ReadFile(filename, 0);
+        if(!ascene)
+        {
+            RCLCPP_ERROR_STREAM(this->get_logger(), "Could not load map '" << filename << "': " << io.GetErrorString());
+            throw std::runtime_error("Could not load map '" + filename + "'");
+        }
+        rm::EmbreeScenePtr scene = rm::make_embree_scene(ascene);
+        scene->commit();
+        m_map = std::make_shared<rm::EmbreeMap>(scene);
+    }
+
+    // normals and weights for the MICP refinement
+    build_map_attributes(m_map);
+
+    std::cout << "MCL: loaded map '" << filename << "' in " << sw() << "s" << std::endl;
+}
+
+void MCLLocalizationNode::scanCB(
+    const sensor_msgs::msg::LaserScan::ConstSharedPtr msg)
+{
+    rm::SphericalModel model;
+    convert(*msg, model);
+
+    m_ranges.resize(msg->ranges.size());
+    std::copy(msg->ranges.begin(), msg->ranges.end(), m_ranges.raw());
+
+    update(msg->header, model);
+}
+
+void MCLLocalizationNode::scanStampedCB(
+    const rmcl_msgs::msg::ScanStamped::ConstSharedPtr msg)
+{
+    rm::SphericalModel model;
+    convert(msg->scan.info, model);
+
+    m_ranges.resize(msg->scan.data.ranges.size());
+    std::copy(msg->scan.data.ranges.begin(), msg->scan.data.ranges.end(), m_ranges.raw());
+
+    update(msg->header, model);
+}
+
+void MCLLocalizationNode::ondnCB(
+    const rmcl_msgs::msg::OnDnStamped::ConstSharedPtr msg)
+{
+    rm::OnDnModel model;
+    convert(msg->ondn.info, model);
+
+    m_ranges.resize(msg->ondn.data.ranges.size());
+    std::copy(msg->ondn.data.ranges.begin(), msg->ondn.data.ranges.end(), m_ranges.raw());
+
+    update(msg->header, model);
+}
+
+void MCLLocalizationNode::initialPoseCB(
+    const geometry_msgs::msg::PoseWithCovarianceStamped::ConstSharedPtr msg)
+{
+    if(msg->header.frame_id != m_map_frame)
+    {
+        RCLCPP_WARN_STREAM(this->get_logger(), "Initial pose is in frame '" << msg->header.frame_id 
+            << "', expected '" << m_map_frame << "'. Using it anyway");
+    }
+
+    rm::Transform Tbm;
+    convert(msg->pose.pose, Tbm);
+
+    // spread from the message, if given
+    const double var_trans = std::max(msg->pose.covariance[0], msg->pose.covariance[7]);
+    const double var_yaw = msg->pose.covariance[35];
+    const float sigma_trans = (var_trans > 0.0) ? std::sqrt(var_trans) : m_init_sigma_trans;
+    const float sigma_yaw = (var_yaw > 0.0) ? std::sqrt(var_yaw) : m_init_sigma_yaw;
+
+    m_pf->initGaussian(Tbm, sigma_trans, sigma_yaw);
+    m_initialized = true;
+    m_force_update = true;
+
+    std::cout << "MCL: initial pose received" << std::endl;
+}
+
+template<typename ModelT>
+void MCLLocalizationNode::update(
+    const std_msgs::msg::Header& header,
+    const ModelT& model)
+{
+    if(!m_initialized)
+    {
+        return;
+    }
+
+    rm::StopWatch sw;
+    sw();
+
+    const rclcpp::Time stamp = header.stamp;
+    const std::string sensor_frame = (m_sensor_frame != "") ? m_sensor_frame : header.frame_id;
+
+    rm::Transform Tsb, Tbo;
+    if(!lookupTransform(m_base_frame, sensor_frame, stamp, Tsb)
+        || !lookupTransform(m_odom_frame, m_base_frame, stamp, Tbo))
+    {
+        return;
+    }
+
+    // 1. PREDICT. Odometry delta in base coordinates
+    if(!m_has_last_odom)
+    {
+        m_Tbo_last = Tbo;
+        m_has_last_odom = true;
+    }
+    const rm::Transform Tdelta = ~m_Tbo_last * Tbo;
+    const float angle = 2.0 * std::acos(std::min(std::fabs(Tdelta.R.w), 1.0f));
+
+    if(!m_force_update 
+        && Tdelta.t.l2norm() < m_update_min_dist
+        && angle < m_update_min_angle)
+    {
+        // not moved enough: keep the estimate, follow the odometry
+        return;
+    }
+
+    m_pf->predict(Tdelta);
+    m_Tbo_last = Tbo;
+    m_force_update = false;
+
+    // 2. WEIGH
+    m_scorer->setTsb(Tsb);
+    m_scorer->setInputData(model, m_ranges);
+    m_scorer->score(m_pf->particles(), m_log_likelihoods);
+    m_pf->weigh(m_log_likelihoods, m_likelihood_scale);
+
+    // 3. ESTIMATE
+    m_estimate = m_pf->estimate();
+    float spread = std::sqrt(m_estimate.cov_trans(0,0) + m_estimate.cov_trans(1,1));
+
+    size_t n_modes = 1;
+    if(m_clustering && spread >= m_refine_max_spread)
+    {
+        // the mean of several modes lies somewhere in between
+        const std::vector<PoseCluster> modes = dbscan_poses(
+            m_pf->particles(), m_pf->weights(), m_clustering_params);
+        n_modes = modes.size();
+        if(!modes.empty())
+        {
+            m_estimate.pose = modes[0].pose;
+            m_estimate.cov_trans = modes[0].cov_trans;
+            m_estimate.var_yaw = modes[0].var_yaw;
+            spread = std::sqrt(m_estimate.cov_trans(0,0) + m_estimate.cov_trans(1,1));
+        }
+    }
+
+    if(m_refine && spread < m_refine_max_spread)
+    {
+        rm::Transform Tbm = m_estimate.pose;
+        if(refine(model, Tsb, Tbm))
+        {
+            m_pf->transform(Tbm * ~m_estimate.pose);
+            m_estimate.pose = Tbm;
+        }
+    }
+
+    m_Tom = m_estimate.pose * ~Tbo;
+    m_has_estimate = true;
+
+    // 4. RESAMPLE. After publishing the estimate of the weighted set
+    publish(stamp);
+
+    if(m_pf->neff() < m_resample_neff_ratio * m_pf->size())
+    {
+        m_pf->resample();
+    }
+
+    RCLCPP_DEBUG_STREAM(this->get_logger(), "MCL update: " << sw() * 1000.0 << "ms, " 
+        << m_scorer->numBeams() << " beams, " << n_modes << " modes, spread: " << spread << "m");
+}
+
+template<typename ModelT>
+bool MCLLocalizationNode::refine(
+    const ModelT& model,
+    const rm::Transform& Tsb,
+    rm::Transform& Tbm)
+{
+    rm::Memory<rm::Transform, rm::RAM> Tbms(1);
+    Tbms[0] = Tbm;
+
+    auto run = [&](auto& corr) -> bool
+    {
+        corr->setModel(model);
+        corr->setTsb(Tsb);
+        corr->setInputData(m_ranges);
+
+        bool corrected = false;
+        for(unsigned int i=0; i<m_refine_iterations; i++)
+        {
+            const CorrectionResults<rm::RAM> res = corr->correct(Tbms);
+            if(res.Ncorr[0] < m_refine_min_corr)
+            {
+                break;
+            }
+            Tbms[0] = Tbms[0] * res.Tdelta[0];
+            corrected = true;
+        }
+        return corrected;
+    };
+
+    bool corrected = false;
+    if constexpr(std::is_same<ModelT, rm::OnDnModel>::value)
+    {
+        corrected = run(m_corr_ondn);
+    } else {
+        corrected = run(m_corr_sphere);
+    }
+
+    if(corrected)
+    {
+        Tbm = Tbms[0];
+    }
+    return corrected;
+}
+
+bool MCLLocalizationNode::lookupTransform(
+    const std::string& target_frame,
+    const std::string& source_frame,
+    const rclcpp::Time& stamp,
+    rm::Transform& T) const
+{
+    geometry_msgs::msg::TransformStamped Tros;
+
+    try {
+        Tros = m_tf_buffer->lookupTransform(target_frame, source_frame, stamp, 
+            rclcpp::Duration::from_seconds(m_transform_tolerance));
+    } catch (tf2::TransformException&) {
+        // latest one, better than skipping the scan
+        try {
+            Tros = m_tf_buffer->lookupTransform(target_frame, source_frame, tf2::TimePointZero);
+        } catch (tf2::TransformException& ex) {
+            RCLCPP_WARN_STREAM_THROTTLE(this->get_logger(), *this->get_clock(), 2000, 
+                "MCL: " << source_frame << " -> " << target_frame << ": " << ex.what());
+            return false;
+        }
+    }
+
+    convert(Tros.transform, T);
+    return true;
+}
+
+void MCLLocalizationNode::publish(const rclcpp::Time& stamp)
+{
+    publishTF(stamp);
+
+    geometry_msgs::msg::PoseWithCovarianceStamped pose;
+    pose.header.stamp = stamp;
+    pose.header.frame_id = m_map_frame;
+    convert(m_estimate.pose, pose.pose.pose);
+    for(size_t i=0; i<3; i++)
+    {
+        for(size_t j=0; j<3; j++)
+        {
+            pose.pose.covariance[i * 6 + j] = m_estimate.cov_trans(i, j);
+        }
+    }
+    pose.pose.covariance[35] = m_estimate.var_yaw;
+    m_pose_pub->publish(pose);
+
+    if(m_publish_particles)
+    {
+        geometry_msgs::msg::PoseArray particles;
+        particles.header = pose.header;
+
+        const auto& Tbms = m_pf->particles();
+        particles.poses.resize(Tbms.size());
+        for(size_t i=0; i<Tbms.size(); i++)
+        {
+            convert(Tbms[i], particles.poses[i]);
+        }
+        m_particles_pub->publish(particles);
+    }
+}
+
+void MCLLocalizationNode::publishTF(const rclcpp::Time& stamp)
+{
+    geometry_msgs::msg::TransformStamped T;
+    convert(m_Tom, T.transform);
+    // valid a bit into the future, as the scans arrive with a delay
+    T.header.stamp = stamp + rclcpp::Duration::from_seconds(m_transform_tolerance);
+    T.header.frame_id = m_map_frame;
+    T.child_frame_id = m_odom_frame;
+    m_br->sendTransform(T);
+}
+
+} // namespace rmcl
+
+#include "rclcpp_components/register_node_macro.hpp"
+RCLCPP_COMPONENTS_REGISTER_NODE(rmcl::MCLLocalizationNode)
@@ -0,0 +1,322 @@
+#include "rmcl/mcl/ParticleFilter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+namespace
+{
+
+inline float yaw_of(const rm::Quaternion& q)
+{
+    return std::atan2(2.0f * (q.w * q.z + q.x * q.y), 
+        1.0f - 2.0f * (q.y * q.y + q.z * q.z));
+}
+
+inline rm::Quaternion yaw_rotation(float yaw)
+{
+    rm::Quaternion q;
+    q.set(rm::EulerAngles{0.0, 0.0, yaw});
+    return q;
+}
+
+} // namespace
+
+ParticleFilter::ParticleFilter(size_t n_particles, unsigned int seed)
+:m_particles(n_particles)
+,m_weights(n_particles)
+,m_particles_tmp(n_particles)
+,m_rng(seed)
+{
+    for(size_t i=0; i<n_particles; i++)
+    {
+        m_particles[i] = rm::Transform::Identity();
+        m_weights[i] = 1.0 / static_cast<float>(n_particles);
+    }
+}
+
+void ParticleFilter::setMotionModelParams(const MotionModelParams& params)
+{
+    m_motion = params;
+}
+
+void ParticleFilter::setRecoveryParams(const RecoveryParams& params)
+{
+    m_recovery = params;
+}
+
+void ParticleFilter::setBounds(const ParticleBounds& bounds)
+{
+    m_bounds = bounds;
+}
+
+void ParticleFilter::initGaussian(
+    const rm::Transform& mean,
+    float sigma_trans,
+    float sigma_yaw)
+{
+    std::normal_distribution<float> nd(0.0, 1.0);
+
+    for(size_t i=0; i<m_particles.size(); i++)
+    {
+        rm::Transform noise;
+        noise.t = {nd(m_rng) * sigma_trans, nd(m_rng) * sigma_trans, 0.0};
+        noise.R = yaw_rotation(nd(m_rng) * sigma_yaw);
+
+        m_particles[i] = mean * noise;
+        m_weights[i] = 1.0 / static_cast<float>(m_particles.size());
+    }
+
+    m_avg_init = false;
+}
+
+void ParticleFilter::initUniform()
+{
+    for(size_t i=0; i<m_particles.size(); i++)
+    {
+        m_particles[i] = randomPose();
+        m_weights[i] = 1.0 / static_cast<float>(m_particles.size());
+    }
+
+    m_avg_init = false;
+}
+
+void ParticleFilter::predict(const rm::Transform& Tdelta)
+{
+    const float trans = Tdelta.t.l2norm();
+    const float rot = std::fabs(yaw_of(Tdelta.R));
+
+    const float sigma_trans = m_motion.alpha_trans_trans * trans 
+        + m_motion.alpha_trans_rot * rot + m_motion.sigma_trans_min;
+    const float sigma_rot = m_motion.alpha_rot_rot * rot 
+        + m_motion.alpha_rot_trans * trans + m_motion.sigma_rot_min;
+
+    std::normal_distribution<float> nd(0.0, 1.0);
+
+    for(size_t i=0; i<m_particles.size(); i++)
+    {
+        // noise in base coordinates after the motion
+        rm::Transform noise;
+        noise.t = {nd(m_rng) * sigma_trans, nd(m_rng) * sigma_trans, 0.0};
+        noise.R = yaw_rotation(nd(m_rng) * sigma_rot);
+
+        m_particles[i] = m_particles[i] * Tdelta * noise;
+    }
+}
+
+void ParticleFilter::transform(const rm::Transform& T)
+{
+    for(size_t i=0; i<m_particles.size(); i++)
+    {
+        m_particles[i] = T * m_particles[i];
+    }
+}
+
+void ParticleFilter::weigh(
+    const rm::MemoryView<float, rm::RAM>& log_likelihoods,
+    float scale)
+{
+    const size_t N = m_particles.size();
+
+    float ll_max = -std::numeric_limits<float>::infinity();
+    for(size_t i=0; i<N; i++)
+    {
+        ll_max = std::max(ll_max, scale * log_likelihoods[i]);
+    }
+
+    if(!std::isfinite(ll_max))
+    {
+        // nothing to learn from this measurement
+        return;
+    }
+
+    double sum_exp = 0.0;
+    double wsum = 0.0;
+    for(size_t i=0; i<N; i++)
+    {
+        const float e = std::exp(scale * log_likelihoods[i] - ll_max);
+        sum_exp += e;
+        m_weights[i] *= e;
+        wsum += m_weights[i];
+    }
+
+    // log of the average likelihood. Smoothed in log space, 
+    // the raw likelihoods under- and overflow
+    const float ll_avg = ll_max + std::log(sum_exp / static_cast<double>(N));
+    if(!m_avg_init)
+    {
+        m_ll_slow = ll_avg;
+        m_ll_fast = ll_avg;
+        m_avg_init = true;
+    } else {
+        m_ll_slow += m_recovery.alpha_slow * (ll_avg - m_ll_slow);
+        m_ll_fast += m_recovery.alpha_fast * (ll_avg - m_ll_fast);
+    }
+
+    if(wsum > 0.0 && std::isfinite(wsum))
+    {
+        for(size_t i=0; i<N; i++)
+        {
+            m_weights[i] /= wsum;
+        }
+    } else {
+        for(size_t i=0; i<N; i++)
+        {
+            m_weights[i] = 1.0 / static_cast<float>(N);
+        }
+    }
+}
+
+float ParticleFilter::neff() const
+{
+    double sum_sq = 0.0;
+    for(size_t i=0; i<m_weights.size(); i++)
+    {
+        sum_sq += m_weights[i] * m_weights[i];
+    }
+    return (sum_sq > 0.0) ? 1.0 / sum_sq : 0.0;
+}
+
+void ParticleFilter::resample()
+{
+    const size_t N = m_particles.size();
+    const float step = 1.0 / static_cast<float>(N);
+
+    std::uniform_real_distribution<float> ud(0.0, 1.0);
+
+    // low-variance sampling: one random number, N equidistant pointers
+    const float r = ud(m_rng) * step;
+    double c = m_weights[0];
+    size_t i = 0;
+    for(size_t m=0; m<N; m++)
+    {
+        const double u = r + m * step;
+        while(u > c && i < N - 1)
+        {
+            i++;
+            c += m_weights[i];
+        }
+        m_particles_tmp[m] = m_particles[i];
+    }
+
+    // random particles if the measurements got much worse than usual
+    const bool bounds_valid = m_bounds.max.x > m_bounds.min.x 
+        && m_bounds.max.y > m_bounds.min.y;
+    if(bounds_valid && m_avg_init && m_recovery.alpha_slow > 0.0)
+    {
+        const float p_inject = std::max(0.0f, 1.0f - std::exp(m_ll_fast - m_ll_slow));
+        if(p_inject > 0.0)
+        {
+            for(size_t m=0; m<N; m++)
+            {
+                if(ud(m_rng) < p_inject)
+                {
+                    m_particles_tmp[m] = randomPose();
+                }
+            }
+            // wait for the averages to build up again
+            m_avg_init = false;
+        }
+    }
+
+    std::swap(m_particles, m_particles_tmp);
+    for(size_t m=0; m<N; m++)
+    {
+        m_weights[m] = step;
+    }
+}
+
+ParticleEstimate ParticleFilter::estimate() const
+{
+    ParticleEstimate res;
+
+    const rm::Quaternion q_ref = m_particles[best()].R;
+
+    rm::Vector t_mean = {0.0, 0.0, 0.0};
+    double qx = 0.0, qy = 0.0, qz = 0.0, qw = 0.0;
+    double yc = 0.0, ys = 0.0;
+
+    for(size_t i=0; i<m_particles.size(); i++)
+    {
+        const float w = m_weights[i];
+        const rm::Transform& T = m_particles[i];
+        t_mean = t_mean + T.t * w;
+
+        // q and -q are the same rotation
+        const float qdot = T.R.x * q_ref.x + T.R.y * q_ref.y + T.R.z * q_ref.z + T.R.w * q_ref.w;
+        const float sign = (qdot < 0.0) ? -1.0 : 1.0;
+        qx += sign * w * T.R.x;
+        qy += sign * w * T.R.y;
+        qz += sign * w * T.R.z;
+        qw += sign * w * T.R.w;
+
+        const float yaw = yaw_of(T.R);
+        yc += w * std::cos(yaw);
+        ys += w * std::sin(yaw);
+    }
+
+    const double qnorm = std::sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+    res.pose.t = t_mean;
+    if(qnorm > 0.0)
+    {
+        res.pose.R.x = qx / qnorm;
+        res.pose.R.y = qy / qnorm;
+        res.pose.R.z = qz / qnorm;
+        res.pose.R.w = qw / qnorm;
+    } else {
+        res.pose.R = q_ref;
+    }
+
+    res.cov_trans.setZeros();
+    for(size_t i=0; i<m_particles.size(); i++)
+    {
+        const float w = m_weights[i];
+        const rm::Vector d = m_particles[i].t - t_mean;
+        res.cov_trans(0,0) += w * d.x * d.x;
+        res.cov_trans(0,1) += w * d.x * d.y;
+        res.cov_trans(0,2) += w * d.x * d.z;
+        res.cov_trans(1,1) += w * d.y * d.y;
+        res.cov_trans(1,2) += w * d.y * d.z;
+        res.cov_trans(2,2) += w * d.z * d.z;
+    }
+    res.cov_trans(1,0) = res.cov_trans(0,1);
+    res.cov_trans(2,0) = res.cov_trans(0,2);
+    res.cov_trans(2,1) = res.cov_trans(1,2);
+
+    const double R_len = std::max(std::sqrt(yc * yc + ys * ys), 1e-6);
+    res.var_yaw = -2.0 * std::log(std::min(R_len, 1.0));
+
+    return res;
+}
+
+size_t ParticleFilter::best() const
+{
+    size_t best_id = 0;
+    for(size_t i=1; i<m_weights.size(); i++)
+    {
+        if(m_weights[i] > m_weights[best_id])
+        {
+            best_id = i;
+        }
+    }
+    return best_id;
+}
+
+rm::Transform ParticleFilter::randomPose()
+{
+    std::uniform_real_distribution<float> ud(0.0, 1.0);
+
+    rm::Transform T;
+    T.t.x = m_bounds.min.x + ud(m_rng) * (m_bounds.max.x - m_bounds.min.x);
+    T.t.y = m_bounds.min.y + ud(m_rng) * (m_bounds.max.y - m_bounds.min.y);
+    T.t.z = m_bounds.min.z + ud(m_rng) * (m_bounds.max.z - m_bounds.min.z);
+    T.R = yaw_rotation((2.0 * ud(m_rng) - 1.0) * M_PI);
+    return T;
+}
+
+} // namespace rmcl
@@ -0,0 +1,161 @@
+#include "rmcl/mcl/ParticleScorerEmbree.hpp"
+
+#include <algorithm>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+namespace
+{
+
+// particles simulated at once. Bounds the range buffer and keeps it in cache
+constexpr size_t CHUNK_SIZE = 256;
+
+inline size_t ceil_div(size_t a, size_t b)
+{
+    return (a + b - 1) / b;
+}
+
+} // namespace
+
+ParticleScorerEmbree::ParticleScorerEmbree(rm::EmbreeMapPtr map)
+:m_sim_sphere(std::make_shared<rm::SphereSimulatorEmbree>(map))
+,m_sim_ondn(std::make_shared<rm::OnDnSimulatorEmbree>(map))
+{
+    
+}
+
+void ParticleScorerEmbree::setMap(rm::EmbreeMapPtr map)
+{
+    m_sim_sphere->setMap(map);
+    m_sim_ondn->setMap(map);
+}
+
+void ParticleScorerEmbree::setTsb(const rm::Transform& Tsb)
+{
+    m_sim_sphere->setTsb(Tsb);
+    m_sim_ondn->setTsb(Tsb);
+}
+
+void ParticleScorerEmbree::setParams(const BeamModelParams& params)
+{
+    m_params = params;
+}
+
+void ParticleScorerEmbree::setMaxBeams(size_t max_beams)
+{
+    m_max_beams = std::max(max_beams, size_t(1));
+}
+
+void ParticleScorerEmbree::setInputData(
+    const rm::SphericalModel& model,
+    const rm::MemoryView<float, rm::RAM>& ranges)
+{
+    const size_t H = model.getHeight();
+    const size_t W = model.getWidth();
+
+    // strides per axis. Thin out the denser axis first
+    size_t sv = 1, sh = 1;
+    while(ceil_div(H, sv) * ceil_div(W, sh) > m_max_beams)
+    {
+        if(ceil_div(W, sh) >= ceil_div(H, sv))
+        {
+            sh++;
+        } else {
+            sv++;
+        }
+    }
+
+    rm::SphericalModel model_sub = model;
+    model_sub.phi.size = ceil_div(H, sv);
+    model_sub.phi.inc = model.phi.inc * sv;
+    model_sub.theta.size = ceil_div(W, sh);
+    model_sub.theta.inc = model.theta.inc * sh;
+
+    m_ranges.resize(model_sub.size());
+    for(size_t vid = 0; vid < model_sub.getHeight(); vid++)
+    {
+        for(size_t hid = 0; hid < model_sub.getWidth(); hid++)
+        {
+            m_ranges[model_sub.getBufferId(vid, hid)] 
+                = ranges[model.getBufferId(vid * sv, hid * sh)];
+        }
+    }
+
+    m_range_min = model.range.min;
+    m_range_max = model.range.max;
+
+    m_sim_sphere->setModel(model_sub);
+    m_ondn = false;
+}
+
+void ParticleScorerEmbree::setInputData(
+    const rm::OnDnModel& model,
+    const rm::MemoryView<float, rm::RAM>& ranges)
+{
+    const size_t stride = ceil_div(model.size(), m_max_beams);
+    const size_t n_beams = ceil_div(model.size(), stride);
+
+    rm::OnDnModel model_sub;
+    model_sub.width = n_beams;
+    model_sub.height = 1;
+    model_sub.range = model.range;
+    model_sub.origs.resize(n_beams);
+    model_sub.dirs.resize(n_beams);
+
+    m_ranges.resize(n_beams);
+    for(size_t i=0; i<n_beams; i++)
+    {
+        model_sub.origs[i] = model.origs[i * stride];
+        model_sub.dirs[i] = model.dirs[i * stride];
+        m_ranges[i] = ranges[i * stride];
+    }
+
+    m_range_min = model.range.min;
+    m_range_max = model.range.max;
+
+    m_sim_ondn->setModel(model_sub);
+    m_ondn = true;
+}
+
+void ParticleScorerEmbree::score(
+    const rm::MemoryView<rm::Transform, rm::RAM>& Tbms,
+    rm::MemoryView<float, rm::RAM>& log_likelihoods)
+{
+    const size_t n_beams = m_ranges.size();
+    if(n_beams == 0)
+    {
+        for(size_t i=0; i<Tbms.size(); i++)
+        {
+            log_likelihoods[i] = 0.0;
+        }
+        return;
+    }
+
+    if(m_sim.ranges.size() != CHUNK_SIZE * n_beams)
+    {
+        m_sim.ranges.resize(CHUNK_SIZE * n_beams);
+    }
+
+    for(size_t i0 = 0; i0 < Tbms.size(); i0 += CHUNK_SIZE)
+    {
+        const size_t i1 = std::min(i0 + CHUNK_SIZE, Tbms.size());
+        const size_t n = i1 - i0;
+
+        // the simulators only write the first n * n_beams ranges
+        if(m_ondn)
+        {
+            m_sim_ondn->simulate(Tbms(i0, i1), m_sim);
+        } else {
+            m_sim_sphere->simulate(Tbms(i0, i1), m_sim);
+        }
+
+        rm::MemoryView<float, rm::RAM> ll_chunk = log_likelihoods(i0, i1);
+        beam_log_likelihoods(m_ranges, m_sim.ranges(0, n * n_beams), 
+            m_range_min, m_range_max, m_params, ll_chunk);
+    }
+}
+
+} // namespace rmcl
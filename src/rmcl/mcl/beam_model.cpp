@@ -0,0 +1,62 @@
+#include "rmcl/mcl/beam_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+void beam_log_likelihoods(
+    const rm::MemoryView<float, rm::RAM>& ranges_real,
+    const rm::MemoryView<float, rm::RAM>& ranges_sim,
+    float range_min, 
+    float range_max,
+    const BeamModelParams& params,
+    rm::MemoryView<float, rm::RAM>& log_likelihoods)
+{
+    const size_t n_beams = ranges_real.size();
+    const size_t n_poses = log_likelihoods.size();
+
+    // log(z_hit * N(d; 0, sigma)) = ll_hit - d^2 * inv_2var
+    const float ll_hit = std::log(params.z_hit / (std::sqrt(2.0 * M_PI) * params.sigma_hit));
+    const float inv_2var = 0.5 / (params.sigma_hit * params.sigma_hit);
+    const float ll_rand = std::log(params.z_rand / range_max);
+
+    // invalid beams contribute 0. Masking instead of branching keeps
+    // the beam loop branch free
+    std::vector<float> real(n_beams);
+    std::vector<float> valid(n_beams);
+    for(size_t i=0; i<n_beams; i++)
+    {
+        const float r = ranges_real[i];
+        const bool v = (r >= range_min && r <= range_max);
+        real[i] = v ? r : 0.0;
+        valid[i] = v ? 1.0 : 0.0;
+    }
+
+    const float* real_ptr = real.data();
+    const float* valid_ptr = valid.data();
+    const float* sim_ptr = ranges_sim.raw();
+
+    #pragma omp parallel for if(n_poses > 16)
+    for(size_t pid=0; pid<n_poses; pid++)
+    {
+        const float* sim = sim_ptr + pid * n_beams;
+
+        float ll = 0.0;
+        #pragma omp simd reduction(+:ll)
+        for(size_t i=0; i<n_beams; i++)
+        {
+            const float s = std::min(sim[i], range_max);
+            const float d = s - real_ptr[i];
+            ll += valid_ptr[i] * std::max(ll_hit - d * d * inv_2var, ll_rand);
+        }
+
+        log_likelihoods[pid] = ll;
+    }
+}
+
+} // namespace rmcl
@@ -0,0 +1,229 @@
+#include "rmcl/odometry/ScanOdometryNode.hpp"
+
+#include <rmagine/util/StopWatch.hpp>
+
+#include <rmcl/util/conversions.h>
+#include <rmcl/util/ros_helper.h>
+
+#include <sensor_msgs/point_cloud2_iterator.hpp>
+
+#include <cmath>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+ScanOdometryNode::ScanOdometryNode(
+    const rclcpp::NodeOptions& options)
+:rclcpp::Node("scan_odometry", rclcpp::NodeOptions(options)
+    .allow_undeclared_parameters(true)
+    .automatically_declare_parameters_from_overrides(true))
+{
+    m_base_frame = rmcl::get_parameter(this, "base_frame", "base_link");
+    m_odom_frame = rmcl::get_parameter(this, "odom_frame", "odom");
+    m_sensor_frame = rmcl::get_parameter(this, "sensor.frame", "");
+    m_range_min = rmcl::get_parameter(this, "sensor.range_min", 0.0);
+    m_range_max = rmcl::get_parameter(this, "sensor.range_max", 100.0);
+
+    ScanToScanOdometryParams params;
+    params.iterations = rmcl::get_parameter(this, "icp.iterations", 20);
+    params.max_corr_dist = rmcl::get_parameter(this, "icp.max_corr_dist", 0.5);
+    params.max_points = rmcl::get_parameter(this, "icp.max_points", 2000);
+    params.min_corr = rmcl::get_parameter(this, "icp.min_corr", 50);
+    m_odom = std::make_shared<ScanToScanOdometry>(params);
+
+    m_tf_buffer = std::make_shared<tf2_ros::Buffer>(this->get_clock());
+    m_tf_listener = std::make_shared<tf2_ros::TransformListener>(*m_tf_buffer);
+    m_br = std::make_unique<tf2_ros::TransformBroadcaster>(this);
+
+    // SENSOR
+    const std::string topic = rmcl::get_parameter(this, "sensor.topic", "scan");
+    const std::string msg_type = rmcl::get_parameter(this, "sensor.msg", "sensor_msgs/msg/LaserScan");
+
+    if(msg_type == "sensor_msgs/msg/LaserScan")
+    {
+        m_sensor_sub = this->create_subscription<sensor_msgs::msg::LaserScan>(
+            topic, rclcpp::SensorDataQoS(),
+            [this](const sensor_msgs::msg::LaserScan::ConstSharedPtr msg) -> void
+            {
+                scanCB(msg);
+            });
+    } else if(msg_type == "sensor_msgs/msg/PointCloud2") {
+        m_sensor_sub = this->create_subscription<sensor_msgs::msg::PointCloud2>(
+            topic, rclcpp::SensorDataQoS(),
+            [this](const sensor_msgs::msg::PointCloud2::ConstSharedPtr msg) -> void
+            {
+                pclCB(msg);
+            });
+    } else if(msg_type == "rmcl_msgs/msg/ScanStamped") {
+        m_sensor_sub = this->create_subscription<rmcl_msgs::msg::ScanStamped>(
+            topic, rclcpp::SensorDataQoS(),
+            [this](const rmcl_msgs::msg::ScanStamped::ConstSharedPtr msg) -> void
+            {
+                scanStampedCB(msg);
+            });
+    } else if(msg_type == "rmcl_msgs/msg/OnDnStamped") {
+        m_sensor_sub = this->create_subscription<rmcl_msgs::msg::OnDnStamped>(
+            topic, rclcpp::SensorDataQoS(),
+            [this](const rmcl_msgs::msg::OnDnStamped::ConstSharedPtr msg) -> void
+            {
+                ondnCB(msg);
+            });
+    } else {
+        RCLCPP_ERROR_STREAM(this->get_logger(), "sensor.msg '" << msg_type << "' is not supported");
+        throw std::runtime_error("sensor.msg '" + msg_type + "' is not supported");
+    }
+
+    std::cout << "Scan odometry: " << m_odom_frame << " -> " << m_base_frame
+        << " from " << topic << " (" << msg_type << ")" << std::endl;
+}
+
+template<typename ModelT, typename RangesT>
+void ScanOdometryNode::rangesToPoints(const ModelT& model, const RangesT& ranges)
+{
+    m_points.resize(ranges.size());
+
+    size_t n_valid = 0;
+    for(unsigned int vid = 0; vid < model.getHeight(); vid++)
+    {
+        for(unsigned int hid = 0; hid < model.getWidth(); hid++)
+        {
+            const unsigned int bid = model.getBufferId(vid, hid);
+            const float range = ranges[bid];
+            if(model.range.inside(range))
+            {
+                m_points[n_valid++] = model.getOrigin(vid, hid) + model.getDirection(vid, hid) * range;
+            }
+        }
+    }
+
+    m_points.resize(n_valid);
+}
+
+void ScanOdometryNode::scanCB(
+    const sensor_msgs::msg::LaserScan::ConstSharedPtr msg)
+{
+    rm::SphericalModel model;
+    convert(*msg, model);
+    rangesToPoints(model, msg->ranges);
+    update(msg->header);
+}
+
+void ScanOdometryNode::pclCB(
+    const sensor_msgs::msg::PointCloud2::ConstSharedPtr msg)
+{
+    m_points.resize(msg->width * msg->height);
+
+    const float range_min_sq = m_range_min * m_range_min;
+    const float range_max_sq = m_range_max * m_range_max;
+
+    size_t n_valid = 0;
+    sensor_msgs::PointCloud2ConstIterator<float> it_x(*msg, "x");
+    sensor_msgs::PointCloud2ConstIterator<float> it_y(*msg, "y");
+    sensor_msgs::PointCloud2ConstIterator<float> it_z(*msg, "z");
+    for(; it_x != it_x.end(); ++it_x, ++it_y, ++it_z)
+    {
+        const rm::Vector p = {*it_x, *it_y, *it_z};
+        const float range_sq = p.l2normSquared();
+        if(std::isfinite(range_sq) && range_sq >= range_min_sq && range_sq <= range_max_sq)
+        {
+            m_points[n_valid++] = p;
+        }
+    }
+
+    m_points.resize(n_valid);
+    update(msg->header);
+}
+
+void ScanOdometryNode::scanStampedCB(
+    const rmcl_msgs::msg::ScanStamped::ConstSharedPtr msg)
+{
+    rm::SphericalModel model;
+    convert(msg->scan.info, model);
+    rangesToPoints(model, msg->scan.data.ranges);
+    update(msg->header);
+}
+
+void ScanOdometryNode::ondnCB(
+    const rmcl_msgs::msg::OnDnStamped::ConstSharedPtr msg)
+{
+    rm::OnDnModel model;
+    convert(msg->ondn.info, model);
+    rangesToPoints(model, msg->ondn.data.ranges);
+    update(msg->header);
+}
+
+bool ScanOdometryNode::lookupSensorTransform(
+    const std::string& sensor_frame,
+    const rclcpp::Time& stamp)
+{
+    if(m_has_Tsb)
+    {
+        return true;
+    }
+
+    try {
+        const geometry_msgs::msg::TransformStamped Tros = m_tf_buffer->lookupTransform(
+            m_base_frame, sensor_frame, stamp, rclcpp::Duration::from_seconds(0.1));
+        convert(Tros.transform, m_Tsb);
+        m_has_Tsb = true;
+    } catch (tf2::TransformException& ex) {
+        RCLCPP_WARN_STREAM_THROTTLE(this->get_logger(), *this->get_clock(), 2000,
+            "Scan odometry: " << sensor_frame << " -> " << m_base_frame << ": " << ex.what());
+    }
+
+    return m_has_Tsb;
+}
+
+void ScanOdometryNode::update(const std_msgs::msg::Header& header)
+{
+    rm::StopWatch sw;
+    sw();
+
+    const rclcpp::Time stamp = header.stamp;
+    const std::string sensor_frame = (m_sensor_frame != "") ? m_sensor_frame : header.frame_id;
+
+    if(!lookupSensorTransform(sensor_frame, stamp))
+    {
+        return;
+    }
+
+    if(m_has_last_stamp && stamp < m_last_stamp)
+    {
+        // time jumped back, e.g. a restarted bag file
+        RCLCPP_WARN(this->get_logger(), "Scan odometry: time jumped back. Reset");
+        m_odom->reset();
+    }
+    m_last_stamp = stamp;
+    m_has_last_stamp = true;
+
+    #pragma omp parallel for
+    for(size_t i=0; i<m_points.size(); i++)
+    {
+        m_points[i] = m_Tsb * m_points[i];
+    }
+
+    if(!m_odom->update(m_points))
+    {
+        RCLCPP_WARN_STREAM_THROTTLE(this->get_logger(), *this->get_clock(), 2000,
+            "Scan odometry: registration failed (" << m_odom->numCorrespondences()
+            << " correspondences). Following the last motion");
+    }
+
+    geometry_msgs::msg::TransformStamped T;
+    convert(m_odom->pose(), T.transform);
+    T.header.stamp = header.stamp;
+    T.header.frame_id = m_odom_frame;
+    T.child_frame_id = m_base_frame;
+    m_br->sendTransform(T);
+
+    RCLCPP_DEBUG_STREAM(this->get_logger(), "Scan odometry: " << sw() * 1000.0 << "ms, "
+        << m_points.size() << " points, " << m_odom->numIterations() << " iterations, "
+        << m_odom->numCorrespondences() << " correspondences");
+}
+
+} // namespace rmcl
+
+#include "rclcpp_components/register_node_macro.hpp"
+RCLCPP_COMPONENTS_REGISTER_NODE(rmcl::ScanOdometryNode)
@@ -0,0 +1,148 @@
+#include "rmcl/odometry/ScanToScanOdometry.hpp"
+
+#include <rmcl/math/math_batched.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+ScanToScanOdometry::ScanToScanOdometry(const ScanToScanOdometryParams& params)
+:m_params(params)
+,m_ds(1)
+,m_ms(1)
+,m_Cs(1)
+,m_Ncorr(1)
+,m_Tupdate(1)
+{
+    reset();
+}
+
+void ScanToScanOdometry::setParams(const ScanToScanOdometryParams& params)
+{
+    m_params = params;
+}
+
+void ScanToScanOdometry::reset(const rm::Transform& Tbo)
+{
+    m_has_prev = false;
+    m_Tbo = Tbo;
+    m_Tdelta = rm::Transform::Identity();
+    m_n_corr = 0;
+    m_n_iterations = 0;
+}
+
+void ScanToScanOdometry::subsample(const rm::MemoryView<rm::Vector, rm::RAM>& points)
+{
+    const size_t max_points = std::max(m_params.max_points, 1u);
+    const size_t stride = (points.size() + max_points - 1) / max_points;
+    const size_t n = (stride > 0) ? (points.size() + stride - 1) / stride : 0;
+
+    if(m_scan.size() != n)
+    {
+        m_scan.resize(n);
+    }
+
+    for(size_t i=0; i<n; i++)
+    {
+        m_scan[i] = points[i * stride];
+    }
+}
+
+void ScanToScanOdometry::keepScan(const rm::MemoryView<rm::Vector, rm::RAM>& points)
+{
+    // the model keeps all points. Nearest neighbors in a subsampled
+    // model are biased towards the previous scan and the odometry 
+    // would underestimate the motion
+    m_scan_prev = points;
+    m_tree.build(m_scan_prev);
+    m_has_prev = true;
+}
+
+bool ScanToScanOdometry::update(const rm::MemoryView<rm::Vector, rm::RAM>& points)
+{
+    subsample(points);
+
+    if(!m_has_prev)
+    {
+        keepScan(points);
+        return true;
+    }
+
+    const size_t N = m_scan.size();
+    if(m_data.size() != N)
+    {
+        m_data.resize(N);
+        m_model.resize(N);
+        m_mask.resize(N);
+        m_ids.resize(N);
+        m_dists_sq.resize(N);
+    }
+
+    const float max_corr_dist_sq = m_params.max_corr_dist * m_params.max_corr_dist;
+
+    // current base -> previous base. Starts at the last motion
+    rm::Transform T = m_Tdelta;
+    bool success = (N > 0);
+    m_n_corr = 0;
+    m_n_iterations = 0;
+
+    for(unsigned int iter = 0; iter < m_params.iterations && success; iter++)
+    {
+        #pragma omp parallel for
+        for(size_t i=0; i<N; i++)
+        {
+            m_data[i] = T * m_scan[i];
+        }
+
+        m_tree.nearest(m_data, m_ids, m_dists_sq);
+
+        #pragma omp parallel for
+        for(size_t i=0; i<N; i++)
+        {
+            if(m_ids[i] != KD_INVALID_ID && m_dists_sq[i] < max_corr_dist_sq)
+            {
+                m_mask[i] = 1;
+                m_model[i] = m_scan_prev[m_ids[i]];
+            } else {
+                m_mask[i] = 0;
+            }
+        }
+
+        means_covs_batched(m_data, m_model, m_mask, m_ds, m_ms, m_Cs, m_Ncorr);
+        m_n_corr = m_Ncorr[0];
+        m_n_iterations = iter + 1;
+
+        if(m_n_corr < m_params.min_corr)
+        {
+            success = false;
+            break;
+        }
+
+        m_correction.correction_from_covs(m_ds, m_ms, m_Cs, m_Ncorr, m_Tupdate);
+        const rm::Transform& dT = m_Tupdate[0];
+        T = dT * T;
+
+        const float dangle = 2.0 * std::acos(std::min(std::fabs(dT.R.w), 1.0f));
+        if(dT.t.l2norm() < m_params.converged_trans && dangle < m_params.converged_rot)
+        {
+            break;
+        }
+    }
+
+    if(success)
+    {
+        m_Tdelta = T;
+    }
+    // else: keep moving with the last motion
+
+    m_Tbo = m_Tbo * m_Tdelta;
+    keepScan(points);
+
+    return success;
+}
+
+} // namespace rmcl
@@ -0,0 +1,230 @@
+#include "rmcl/place_recognition/PlaceDatabase.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <rmcl/util/mapped_file.h>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+namespace
+{
+
+inline uint64_t align_up(uint64_t offset)
+{
+    return (offset + PLACE_DB_ALIGNMENT - 1) / PLACE_DB_ALIGNMENT * PLACE_DB_ALIGNMENT;
+}
+
+void write_padding(std::ofstream& ofs, uint64_t offset)
+{
+    static const char zeros[PLACE_DB_ALIGNMENT] = {0};
+    const uint64_t pos = static_cast<uint64_t>(ofs.tellp());
+    if(offset > pos)
+    {
+        ofs.write(zeros, offset - pos);
+    }
+}
+
+} // anonymous namespace
+
+PlaceDatabase::PlaceDatabase(const std::string& filename)
+:m_filename(filename)
+{
+    m_fd = ::open(filename.c_str(), O_RDONLY);
+    if(m_fd < 0)
+    {
+        throw std::runtime_error("PlaceDatabase - could not open '" + filename + "'");
+    }
+
+    struct stat st;
+    if(fstat(m_fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(PlaceDatabaseHeader))
+    {
+        ::close(m_fd);
+        throw std::runtime_error("PlaceDatabase - '" + filename + "' is too small");
+    }
+    m_size = st.st_size;
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if(data == MAP_FAILED)
+    {
+        ::close(m_fd);
+        throw std::runtime_error("PlaceDatabase - could not map '" + filename + "'");
+    }
+    m_data = static_cast<uint8_t*>(data);
+
+    auto fail = [&](const std::string& msg)
+    {
+        munmap(m_data, m_size);
+        ::close(m_fd);
+        throw std::runtime_error("PlaceDatabase - '" + filename + "' " + msg);
+    };
+
+    const PlaceDatabaseHeader* header = reinterpret_cast<const PlaceDatabaseHeader*>(m_data);
+    if(std::memcmp(header->magic, PLACE_DB_MAGIC, sizeof(PLACE_DB_MAGIC)) != 0)
+    {
+        fail("is no place database");
+    }
+
+    if(header->version != PLACE_DB_VERSION)
+    {
+        fail("has version " + std::to_string(header->version) 
+            + ". Expected " + std::to_string(PLACE_DB_VERSION));
+    }
+
+    m_params.rings = header->rings;
+    m_params.sectors = header->sectors;
+    m_params.harmonics = header->harmonics;
+    m_params.max_range = header->max_range;
+    m_params.min_z = header->min_z;
+    m_params.max_z = header->max_z;
+
+    // descriptorSize() must not wrap around
+    const uint64_t descriptor_size = static_cast<uint64_t>(header->rings) * header->harmonics;
+    if(descriptor_size == 0 || descriptor_size != m_params.descriptorSize() || m_params.sectors == 0)
+    {
+        fail("has invalid descriptor parameters");
+    }
+
+    // n rows of 'cols' floats. The row count is checked before multiplying
+    const size_t n = header->n_places;
+    auto rows_valid = [&](uint64_t offset, uint64_t cols)
+    {
+        return n <= (m_size / sizeof(float)) / cols
+            && mapped_array_valid<float>(offset, n * cols, m_size);
+    };
+
+    if(!mapped_array_valid<rm::Transform>(header->poses_offset, n, m_size)
+        || !rows_valid(header->descriptors_offset, descriptor_size)
+        || !rows_valid(header->sector_keys_offset, m_params.sectors))
+    {
+        fail("is truncated or misaligned");
+    }
+
+    m_poses = rm::MemoryView<rm::Transform, rm::RAM>(
+        reinterpret_cast<rm::Transform*>(m_data + header->poses_offset), n);
+    m_descriptors = reinterpret_cast<const float*>(m_data + header->descriptors_offset);
+    m_sector_keys = reinterpret_cast<const float*>(m_data + header->sector_keys_offset);
+
+    // the tree is rebuilt on every load. It only stores indices into the mapping
+    KdFeaturesPtr features = std::make_shared<KdFeatures>(m_descriptors, n, m_params.descriptorSize());
+    m_tree = std::make_shared<FeatureKdTree>(features);
+}
+
+PlaceDatabase::~PlaceDatabase()
+{
+    // the tree reads from the mapping
+    m_tree.reset();
+
+    if(m_data)
+    {
+        munmap(m_data, m_size);
+    }
+    if(m_fd >= 0)
+    {
+        ::close(m_fd);
+    }
+}
+
+void PlaceDatabase::query(
+    const rm::MemoryView<rm::Vector, rm::RAM>& points,
+    unsigned int k,
+    std::vector<PlaceCandidate>& candidates) const
+{
+    candidates.clear();
+
+    std::vector<float> descriptor(m_params.descriptorSize());
+    std::vector<float> sector_key(m_params.sectors);
+    compute_place_descriptor(points, m_params, descriptor.data(), sector_key.data());
+
+    std::vector<KdIndex> ids(k);
+    std::vector<float> dists_sq(k);
+    const unsigned int n = m_tree->knn(descriptor.data(), k, ids.data(), dists_sq.data());
+
+    candidates.resize(n);
+
+    #pragma omp parallel for
+    for(size_t i=0; i<n; i++)
+    {
+        PlaceCandidate& cand = candidates[i];
+        cand.place_id = ids[i];
+        cand.descriptor_dist = dists_sq[i];
+
+        const float yaw = sector_key_yaw(
+            m_sector_keys + static_cast<size_t>(ids[i]) * m_params.sectors, 
+            sector_key.data(), m_params.sectors, cand.sector_dist);
+
+        rm::Quaternion Rz;
+        Rz.set(rm::EulerAngles{0.0, 0.0, yaw});
+        cand.Tbm = m_poses[ids[i]];
+        cand.Tbm.R = cand.Tbm.R * Rz;
+    }
+}
+
+void write_place_database(
+    const std::string& filename,
+    const PlaceDatabaseData& data)
+{
+    const size_t n = data.poses.size();
+    const size_t dim = data.params.descriptorSize();
+    const size_t sectors = data.params.sectors;
+
+    if(data.descriptors.size() != n * dim || data.sector_keys.size() != n * sectors)
+    {
+        throw std::runtime_error("write_place_database - descriptors do not match the poses");
+    }
+
+    PlaceDatabaseHeader header;
+    std::memset(&header, 0, sizeof(PlaceDatabaseHeader));
+    std::memcpy(header.magic, PLACE_DB_MAGIC, sizeof(PLACE_DB_MAGIC));
+    header.version = PLACE_DB_VERSION;
+    header.n_places = n;
+    header.rings = data.params.rings;
+    header.sectors = data.params.sectors;
+    header.harmonics = data.params.harmonics;
+    header.max_range = data.params.max_range;
+    header.min_z = data.params.min_z;
+    header.max_z = data.params.max_z;
+    header.poses_offset = align_up(sizeof(PlaceDatabaseHeader));
+    header.descriptors_offset = align_up(header.poses_offset + n * sizeof(rm::Transform));
+    header.sector_keys_offset = align_up(header.descriptors_offset + n * dim * sizeof(float));
+
+    // write to a temporary file first. A crash never leaves a broken database behind
+    const std::string filename_tmp = filename + ".tmp";
+    std::ofstream ofs(filename_tmp, std::ios::binary | std::ios::trunc);
+    if(!ofs)
+    {
+        throw std::runtime_error("write_place_database - could not open '" + filename_tmp + "'");
+    }
+
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(PlaceDatabaseHeader));
+    write_padding(ofs, header.poses_offset);
+    ofs.write(reinterpret_cast<const char*>(data.poses.raw()), n * sizeof(rm::Transform));
+    write_padding(ofs, header.descriptors_offset);
+    ofs.write(reinterpret_cast<const char*>(data.descriptors.raw()), n * dim * sizeof(float));
+    write_padding(ofs, header.sector_keys_offset);
+    ofs.write(reinterpret_cast<const char*>(data.sector_keys.raw()), n * sectors * sizeof(float));
+
+    ofs.close();
+    if(!ofs)
+    {
+        throw std::runtime_error("write_place_database - error while writing '" + filename_tmp + "'");
+    }
+
+    if(std::rename(filename_tmp.c_str(), filename.c_str()) != 0)
+    {
+        throw std::runtime_error("write_place_database - could not move '" + filename_tmp + "' to '" + filename + "'");
+    }
+}
+
+} // namespace rmcl
@@ -0,0 +1,77 @@
+#include "rmcl/place_recognition/PlaceDatabaseEmbree.hpp"
+
+#include <rmagine/simulation/SphereSimulatorEmbree.hpp>
+
+#include <algorithm>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+PlaceDatabaseData build_place_database(
+    const rm::EmbreeMapPtr& map,
+    const rm::MemoryView<rm::Transform, rm::RAM>& Tbms,
+    const rm::SphericalModel& model,
+    const rm::Transform& Tsb,
+    const PlaceDescriptorParams& params,
+    size_t batch_size)
+{
+    const size_t n_places = Tbms.size();
+    const size_t n_beams = model.size();
+    const size_t dim = params.descriptorSize();
+    batch_size = std::max(batch_size, size_t(1));
+
+    PlaceDatabaseData data;
+    data.params = params;
+    data.poses.resize(n_places);
+    data.descriptors.resize(n_places * dim);
+    data.sector_keys.resize(n_places * params.sectors);
+
+    rm::SphereSimulatorEmbree sim(map);
+    sim.setModel(model);
+    sim.setTsb(Tsb);
+
+    rm::Bundle<rm::Ranges<rm::RAM> > res;
+    res.ranges.resize(batch_size * n_beams);
+
+    for(size_t i0 = 0; i0 < n_places; i0 += batch_size)
+    {
+        const size_t i1 = std::min(i0 + batch_size, n_places);
+        sim.simulate(Tbms(i0, i1), res);
+
+        #pragma omp parallel
+        {
+            rm::Memory<rm::Vector, rm::RAM> points(n_beams);
+
+            #pragma omp for
+            for(size_t i=i0; i<i1; i++)
+            {
+                const float* ranges = res.ranges.raw() + (i - i0) * n_beams;
+
+                // scan in base coordinates
+                size_t n_valid = 0;
+                for(unsigned int vid = 0; vid < model.getHeight(); vid++)
+                {
+                    for(unsigned int hid = 0; hid < model.getWidth(); hid++)
+                    {
+                        const float range = ranges[model.getBufferId(vid, hid)];
+                        if(model.range.inside(range))
+                        {
+                            points[n_valid++] = Tsb * (model.getDirection(vid, hid) * range);
+                        }
+                    }
+                }
+
+                data.poses[i] = Tbms[i];
+                compute_place_descriptor(points(0, n_valid), params, 
+                    data.descriptors.raw() + i * dim, 
+                    data.sector_keys.raw() + i * params.sectors);
+            }
+        }
+    }
+
+    return data;
+}
+
+} // namespace rmcl
@@ -0,0 +1,116 @@
+#include "rmcl/place_recognition/PlaceDescriptor.hpp"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace rm = rmagine;
+
+namespace rmcl {
+
+void compute_place_descriptor(
+    const rm::MemoryView<rm::Vector, rm::RAM>& points,
+    const PlaceDescriptorParams& params,
+    float* descriptor,
+    float* sector_key)
+{
+    const unsigned int R = params.rings;
+    const unsigned int S = params.sectors;
+    const unsigned int H = params.harmonics;
+
+    std::vector<unsigned char> occupied(R * S, 0);
+
+    const float ring_scale = static_cast<float>(R) / params.max_range;
+    const float sector_scale = static_cast<float>(S) / (2.0 * M_PI);
+
+    for(size_t i=0; i<points.size(); i++)
+    {
+        const rm::Vector p = points[i];
+        if(!(p.z >= params.min_z && p.z <= params.max_z))
+        {
+            continue;
+        }
+
+        // before the cast: converting inf, nan or huge values is undefined
+        const float range = std::sqrt(p.x * p.x + p.y * p.y);
+        if(!(range < params.max_range))
+        {
+            continue;
+        }
+
+        const unsigned int ring = static_cast<unsigned int>(range * ring_scale);
+        if(ring >= R)
+        {
+            continue;
+        }
+
+        unsigned int sector = static_cast<unsigned int>((std::atan2(p.y, p.x) + M_PI) * sector_scale);
+        if(sector >= S)
+        {
+            sector = 0;
+        }
+
+        occupied[ring * S + sector] = 1;
+    }
+
+    // magnitudes of the discrete fourier transform along the sectors
+    for(unsigned int r=0; r<R; r++)
+    {
+        const unsigned char* ring = occupied.data() + r * S;
+        for(unsigned int k=0; k<H; k++)
+        {
+            float re = 0.0;
+            float im = 0.0;
+            for(unsigned int s=0; s<S; s++)
+            {
+                if(ring[s])
+                {
+                    const float angle = 2.0 * M_PI * static_cast<float>(k * s) / static_cast<float>(S);
+                    re += std::cos(angle);
+                    im -= std::sin(angle);
+                }
+            }
+            descriptor[r * H + k] = std::sqrt(re * re + im * im) / static_cast<float>(S);
+        }
+    }
+
+    for(unsigned int s=0; s<S; s++)
+    {
+        unsigned int n = 0;
+        for(unsigned int r=0; r<R; r++)
+        {
+            n += occupied[r * S + s];
+        }
+        sector_key[s] = static_cast<float>(n) / static_cast<float>(R);
+    }
+}
+
+float sector_key_yaw(
+    const float* sector_key_a,
+    const float* sector_key_b,
+    unsigned int sectors,
+    float& dist)
+{
+    unsigned int best_shift = 0;
+    dist = std::numeric_limits<float>::max();
+
+    for(unsigned int shift=0; shift<sectors; shift++)
+    {
+        float d = 0.0;
+        for(unsigned int s=0; s<sectors; s++)
+        {
+            const float diff = sector_key_b[s] - sector_key_a[(s + shift) % sectors];
+            d += diff * diff;
+        }
+        if(d < dist)
+        {
+            dist = d;
+            best_shift = shift;
+        }
+    }
+
+    dist /= static_cast<float>(sectors);
+    return 2.0 * M_PI * static_cast<float>(best_shift) / static_cast<float>(sectors);
+}
+
+} // namespace rmcl
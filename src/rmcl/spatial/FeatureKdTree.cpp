@@ -0,0 +1,33 @@
+#include "rmcl/spatial/FeatureKdTree.hpp"
+
+#include "rmcl/spatial/BoundedKnnResultSet.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace rmcl {
+
+FeatureKdTree::FeatureKdTree(KdFeaturesPtr features, unsigned int leaf_size)
+:Super(features->dim(), *features, nanoflann::KDTreeSingleIndexAdaptorParams(std::max(leaf_size, 1u)))
+,m_features(features)
+{
+    // the index is built by the nanoflann constructor
+}
+
+unsigned int FeatureKdTree::knn(
+    const float* query,
+    unsigned int k,
+    KdIndex* ids,
+    float* dists_sq) const
+{
+    if(k == 0 || m_features->kdtree_get_point_count() == 0)
+    {
+        return 0;
+    }
+
+    BoundedKnnResultSet<KdIndex> resultSet(k, std::numeric_limits<float>::max(), ids, dists_sq);
+    findNeighbors(resultSet, query);
+    return resultSet.size();
+}
+
+} // namespace rmcl
@@ -1,86 +1,143 @@
 #include "rmcl/spatial/KdTree.hpp"
 
+#include "rmcl/spatial/BoundedKnnResultSet.hpp"
+
+#include <cmath>
+#include <limits>
+
 using namespace rmagine;
 
 namespace rmcl {
 
 KdTree::KdTree(KdPointsPtr points)
-:m_points(points)
-,Super(3, *points, nanoflann::KDTreeSingleIndexAdaptorParams(10) )
+:Super(3, *points, nanoflann::KDTreeSingleIndexAdaptorParams(10) )
+,m_points(points)
 {
-    buildIndex();
+    // the index is built by the nanoflann constructor
+}
+
+unsigned int KdTree::search(
+    const Vector& query_point,
+    unsigned int k,
+    float max_dist_sq,
+    KdIndex* ids,
+    float* dists_sq) const
+{
+    if(k == 0)
+    {
+        return 0;
+    }
+
+    BoundedKnnResultSet<KdIndex> resultSet(k, max_dist_sq, ids, dists_sq);
+    findNeighbors(resultSet, reinterpret_cast<const float*>(&query_point), m_search_params);
+    return resultSet.size();
 }
 
 Vector KdTree::nearest(
     const Vector& query_point,
     bool query_in_index) const
 {
-    if(query_in_index)
+    const size_t id = nearestId(query_point, query_in_index);
+    if(id == KD_INVALID_ID)
     {
-        const size_t num_results = 2;
-        nanoflann::KNNResultSet<float> resultSet(num_results);
-        size_t ret_index[2];
-        float out_dist_sqr[2];
-        resultSet.init(ret_index, out_dist_sqr);
-        findNeighbors(resultSet, reinterpret_cast<const float*>(&query_point), nanoflann::SearchParams(10));
-        return m_points->m_mem.at(ret_index[1]);
-    } else {
-        const size_t num_results = 1;
-        nanoflann::KNNResultSet<float> resultSet(num_results);
-        size_t ret_index;
-        float out_dist_sqr;
-        resultSet.init(&ret_index, &out_dist_sqr);
-        findNeighbors(resultSet, reinterpret_cast<const float*>(&query_point), nanoflann::SearchParams(10));
-        return m_points->m_mem.at(ret_index);
+        const float inf = std::numeric_limits<float>::infinity();
+        return {inf, inf, inf};
     }
+    return m_points->m_mem[id];
 }
 
 float KdTree::nearestDist(
     const Vector& query_point,
     bool query_in_index) const
 {
-    if(query_in_index)
+    KdIndex ret_index[2];
+    float out_dist_sqr[2];
+    const unsigned int k = (query_in_index ? 2 : 1);
+    if(search(query_point, k, std::numeric_limits<float>::max(), ret_index, out_dist_sqr) < k)
     {
-        const size_t num_results = 2;
-        nanoflann::KNNResultSet<float> resultSet(num_results);
-        size_t ret_index[2];
-        float out_dist_sqr[2];
-        resultSet.init(ret_index, out_dist_sqr);
-        findNeighbors(resultSet, reinterpret_cast<const float*>(&query_point), nanoflann::SearchParams(10));
-        return out_dist_sqr[1];
-    } else {
-        const size_t num_results = 1;
-        nanoflann::KNNResultSet<float> resultSet(num_results);
-        size_t ret_index;
-        float out_dist_sqr;
-        resultSet.init(&ret_index, &out_dist_sqr);
-        findNeighbors(resultSet, reinterpret_cast<const float*>(&query_point), nanoflann::SearchParams(10));
-        return out_dist_sqr;
+        return std::numeric_limits<float>::infinity();
     }
+    return out_dist_sqr[k - 1];
 }
 
 size_t KdTree::nearestId(
     const Vector& query_point,
     bool query_in_index) const
 {
-    if(query_in_index)
+    KdIndex ret_index[2];
+    float out_dist_sqr[2];
+    const unsigned int k = (query_in_index ? 2 : 1);
+    if(search(query_point, k, std::numeric_limits<float>::max(), ret_index, out_dist_sqr) < k)
+    {
+        return KD_INVALID_ID;
+    }
+    return ret_index[k - 1];
+}
+
+void KdTree::nearest(
+    const MemoryView<Vector, RAM>& queries,
+    MemoryView<KdIndex, RAM>& ids,
+    MemoryView<float, RAM>& dists_sq,
+    bool query_in_index) const
+{
+    const unsigned int k = (query_in_index ? 2 : 1);
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(size_t i=0; i<queries.size(); i++)
     {
-        const size_t num_results = 2;
-        nanoflann::KNNResultSet<float> resultSet(num_results);
-        size_t ret_index[2];
+        KdIndex ret_index[2];
         float out_dist_sqr[2];
-        resultSet.init(ret_index, out_dist_sqr);
-        findNeighbors(resultSet, reinterpret_cast<const float*>(&query_point), nanoflann::SearchParams(10));
-        return ret_index[1];
-    } else {
-        const size_t num_results = 1;
-        nanoflann::KNNResultSet<float> resultSet(num_results);
-        size_t ret_index;
-        float out_dist_sqr;
-        resultSet.init(&ret_index, &out_dist_sqr);
-        findNeighbors(resultSet, reinterpret_cast<const float*>(&query_point), nanoflann::SearchParams(10));
-        return ret_index;
+        const unsigned int n = search(queries[i], k, std::numeric_limits<float>::max(),
+            ret_index, out_dist_sqr);
+
+        if(n == k)
+        {
+            ids[i] = ret_index[k - 1];
+            dists_sq[i] = out_dist_sqr[k - 1];
+        } else {
+            ids[i] = KD_INVALID_ID;
+            dists_sq[i] = std::numeric_limits<float>::max();
+        }
+    }
+}
+
+void KdTree::knn(
+    const MemoryView<Vector, RAM>& queries,
+    unsigned int k,
+    MemoryView<KdIndex, RAM>& ids,
+    MemoryView<float, RAM>& dists_sq,
+    MemoryView<unsigned int, RAM>& counts) const
+{
+    radius(queries, std::numeric_limits<float>::infinity(), k, ids, dists_sq, counts);
+}
+
+void KdTree::radius(
+    const MemoryView<Vector, RAM>& queries,
+    float search_radius,
+    unsigned int max_neighbors,
+    MemoryView<KdIndex, RAM>& ids,
+    MemoryView<float, RAM>& dists_sq,
+    MemoryView<unsigned int, RAM>& counts) const
+{
+    // nanoflann's L2 metric works on squared distances
+    const float radius_sq = (std::isinf(search_radius) ?
+        std::numeric_limits<float>::max() : search_radius * search_radius);
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(size_t i=0; i<queries.size(); i++)
+    {
+        KdIndex* ids_i = ids.raw() + i * max_neighbors;
+        float* dists_i = dists_sq.raw() + i * max_neighbors;
+
+        const unsigned int n = search(queries[i], max_neighbors, radius_sq, ids_i, dists_i);
+        counts[i] = n;
+
+        for(unsigned int j=n; j<max_neighbors; j++)
+        {
+            ids_i[j] = KD_INVALID_ID;
+            dists_i[j] = std::numeric_limits<float>::max();
+        }
     }
 }
 
-} // namespace rmcl
\ No newline at end of file
+} // namespace rmcl
@@ -0,0 +1,317 @@
+#include "rmcl/spatial/KdTreeSoA.hpp"
+
+#include "rmcl/spatial/BoundedKnnResultSet.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace rmagine;
+
+namespace rmcl {
+
+namespace {
+
+// smaller subtrees are built by the task that reached them
+constexpr size_t PARALLEL_MIN_POINTS = 8192;
+
+// enough for 2^32 points and leaves of at least one point
+constexpr size_t MAX_DEPTH = 64;
+
+inline float coord(const MemoryView<Vector, RAM>& points, size_t id, unsigned int dim)
+{
+    return reinterpret_cast<const float*>(&points[id].x)[dim];
+}
+
+} // namespace
+
+KdTreeSoA::KdTreeSoA(unsigned int leaf_size)
+:m_leaf_size(std::max(leaf_size, 1u))
+{
+
+}
+
+KdTreeSoA::KdTreeSoA(
+    const MemoryView<Vector, RAM>& points,
+    unsigned int leaf_size)
+:KdTreeSoA(leaf_size)
+{
+    build(points);
+}
+
+size_t KdTreeSoA::numNodes(size_t n_points) const
+{
+    // the shape only depends on the number of points. Nodes are stored
+    // in preorder, so every subtree owns a known range of node ids
+    if(n_points <= m_leaf_size)
+    {
+        return 1;
+    }
+
+    // halving keeps the subtrees of depth d at floor(n / 2^d) or
+    // ceil(n / 2^d) points, the larger ones (n mod 2^d) times.
+    // w = 2^d of the deepest level with subtrees larger than a leaf
+    size_t w = 1;
+    while((n_points + 2 * w - 1) / (2 * w) > m_leaf_size)
+    {
+        w *= 2;
+    }
+
+    const size_t q = n_points / w;
+    const size_t r = n_points % w;
+    // only the larger subtrees split if the smaller ones fit into a leaf
+    const size_t n_leaves = (q > m_leaf_size) ? 2 * w : w + r;
+    return 2 * n_leaves - 1;
+}
+
+void KdTreeSoA::build(const MemoryView<Vector, RAM>& points)
+{
+    const size_t N = points.size();
+
+    // resize keeps the capacity: no allocation when rebuilding with
+    // clouds of similar size
+    m_ids.resize(N);
+    m_order.resize(N);
+    for(auto& pts : m_pts)
+    {
+        pts.resize(N);
+    }
+    m_nodes.resize(N > 0 ? numNodes(N) : 0);
+
+    if(N == 0)
+    {
+        return;
+    }
+
+    #pragma omp parallel
+    {
+        #pragma omp for
+        for(size_t i=0; i<N; i++)
+        {
+            m_ids[i] = i;
+        }
+
+        #pragma omp single
+        buildNode(points, 0, 0, N);
+        // implicit barrier: all tasks are done
+
+        // gather the coordinates in tree order
+        #pragma omp for
+        for(size_t i=0; i<N; i++)
+        {
+            const KdIndex id = m_ids[i];
+            m_pts[0][i] = points[id].x;
+            m_pts[1][i] = points[id].y;
+            m_pts[2][i] = points[id].z;
+            m_order[id] = i;
+        }
+    }
+}
+
+void KdTreeSoA::buildNode(
+    const MemoryView<Vector, RAM>& points,
+    size_t node_id, size_t begin, size_t end)
+{
+    Node& node = m_nodes[node_id];
+    node.begin = begin;
+    node.end = end;
+
+    if(end - begin <= m_leaf_size)
+    {
+        node.leaf = true;
+        return;
+    }
+    node.leaf = false;
+
+    // split the dimension of largest extent
+    Vector bb_min = points[m_ids[begin]];
+    Vector bb_max = bb_min;
+    for(size_t i = begin + 1; i < end; i++)
+    {
+        const Vector& p = points[m_ids[i]];
+        bb_min.x = std::min(bb_min.x, p.x);
+        bb_min.y = std::min(bb_min.y, p.y);
+        bb_min.z = std::min(bb_min.z, p.z);
+        bb_max.x = std::max(bb_max.x, p.x);
+        bb_max.y = std::max(bb_max.y, p.y);
+        bb_max.z = std::max(bb_max.z, p.z);
+    }
+    const Vector extent = bb_max - bb_min;
+    unsigned int dim = 0;
+    if(extent.y > extent.x)
+    {
+        dim = 1;
+    }
+    if(extent.z > ((dim == 0) ? extent.x : extent.y))
+    {
+        dim = 2;
+    }
+
+    const size_t mid = begin + (end - begin) / 2;
+    std::nth_element(
+        m_ids.begin() + begin, m_ids.begin() + mid, m_ids.begin() + end,
+        [&](KdIndex a, KdIndex b) {
+            return coord(points, a, dim) < coord(points, b, dim);
+        });
+
+    node.dim = dim;
+    node.split = coord(points, m_ids[mid], dim);
+
+    const size_t left_id = node_id + 1;
+    const size_t right_id = left_id + numNodes(mid - begin);
+    node.right = right_id;
+
+    const bool parallel = (end - begin > PARALLEL_MIN_POINTS);
+
+    #pragma omp task if(parallel)
+    buildNode(points, left_id, begin, mid);
+    #pragma omp task if(parallel)
+    buildNode(points, right_id, mid, end);
+    #pragma omp taskwait
+}
+
+Vector KdTreeSoA::point(size_t id) const
+{
+    const KdIndex i = m_order[id];
+    return {m_pts[0][i], m_pts[1][i], m_pts[2][i]};
+}
+
+unsigned int KdTreeSoA::search(
+    const Vector& query_point,
+    unsigned int k,
+    float max_dist_sq,
+    KdIndex* ids,
+    float* dists_sq) const
+{
+    if(k == 0 || m_nodes.empty())
+    {
+        return 0;
+    }
+
+    BoundedKnnResultSet<KdIndex> resultSet(k, max_dist_sq, ids, dists_sq);
+    const float* q = reinterpret_cast<const float*>(&query_point.x);
+
+    // (node, squared distance to its splitting plane)
+    struct Entry
+    {
+        KdIndex node;
+        float dist_sq;
+    };
+
+    Entry stack[MAX_DEPTH + 1];
+    size_t top = 0;
+    stack[top++] = {0, 0.0};
+
+    while(top > 0)
+    {
+        const Entry e = stack[--top];
+        if(e.dist_sq > resultSet.worstDist())
+        {
+            continue;
+        }
+
+        const Node& node = m_nodes[e.node];
+        if(node.leaf)
+        {
+            for(KdIndex i = node.begin; i < node.end; i++)
+            {
+                const float dx = m_pts[0][i] - q[0];
+                const float dy = m_pts[1][i] - q[1];
+                const float dz = m_pts[2][i] - q[2];
+                resultSet.addPoint(dx * dx + dy * dy + dz * dz, m_ids[i]);
+            }
+            continue;
+        }
+
+        const float diff = q[node.dim] - node.split;
+        const KdIndex near = (diff < 0.0) ? e.node + 1 : node.right;
+        const KdIndex far = (diff < 0.0) ? node.right : e.node + 1;
+
+        // far side first, the near side is popped next
+        stack[top++] = {far, diff * diff};
+        stack[top++] = {near, e.dist_sq};
+    }
+
+    return resultSet.size();
+}
+
+size_t KdTreeSoA::nearestId(
+    const Vector& query_point,
+    bool query_in_index) const
+{
+    KdIndex ret_index[2];
+    float out_dist_sqr[2];
+    const unsigned int k = (query_in_index ? 2 : 1);
+    if(search(query_point, k, std::numeric_limits<float>::max(), ret_index, out_dist_sqr) < k)
+    {
+        return KD_INVALID_ID;
+    }
+    return ret_index[k - 1];
+}
+
+void KdTreeSoA::nearest(
+    const MemoryView<Vector, RAM>& queries,
+    MemoryView<KdIndex, RAM>& ids,
+    MemoryView<float, RAM>& dists_sq,
+    bool query_in_index) const
+{
+    const unsigned int k = (query_in_index ? 2 : 1);
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(size_t i=0; i<queries.size(); i++)
+    {
+        KdIndex ret_index[2];
+        float out_dist_sqr[2];
+        const unsigned int n = search(queries[i], k, std::numeric_limits<float>::max(),
+            ret_index, out_dist_sqr);
+
+        if(n == k)
+        {
+            ids[i] = ret_index[k - 1];
+            dists_sq[i] = out_dist_sqr[k - 1];
+        } else {
+            ids[i] = KD_INVALID_ID;
+            dists_sq[i] = std::numeric_limits<float>::max();
+        }
+    }
+}
+
+void KdTreeSoA::knn(
+    const MemoryView<Vector, RAM>& queries,
+    unsigned int k,
+    MemoryView<KdIndex, RAM>& ids,
+    MemoryView<float, RAM>& dists_sq,
+    MemoryView<unsigned int, RAM>& counts) const
+{
+    radius(queries, std::numeric_limits<float>::infinity(), k, ids, dists_sq, counts);
+}
+
+void KdTreeSoA::radius(
+    const MemoryView<Vector, RAM>& queries,
+    float search_radius,
+    unsigned int max_neighbors,
+    MemoryView<KdIndex, RAM>& ids,
+    MemoryView<float, RAM>& dists_sq,
+    MemoryView<unsigned int, RAM>& counts) const
+{
+    const float radius_sq = (std::isinf(search_radius) ?
+        std::numeric_limits<float>::max() : search_radius * search_radius);
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(size_t i=0; i<queries.size(); i++)
+    {
+        KdIndex* ids_i = ids.raw() + i * max_neighbors;
+        float* dists_i = dists_sq.raw() + i * max_neighbors;
+
+        const unsigned int n = search(queries[i], max_neighbors, radius_sq, ids_i, dists_i);
+        counts[i] = n;
+
+        for(unsigned int j=n; j<max_neighbors; j++)
+        {
+            ids_i[j] = KD_INVALID_ID;
+            dists_i[j] = std::numeric_limits<float>::max();
+        }
+    }
+}
+
+} // namespace rmcl
@@ -0,0 +1,154 @@
+#include "rmcl/util/checkpoint.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#include <sys/stat.h>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+namespace
+{
+
+const std::string CHECKPOINT_MAGIC = "rmcl_checkpoint";
+const unsigned int CHECKPOINT_VERSION = 1;
+
+} // namespace
+
+MapIdentity map_identity(const std::string& filename)
+{
+    MapIdentity id;
+    id.file = filename;
+
+    struct stat st;
+    if(stat(filename.c_str(), &st) == 0)
+    {
+        id.size = static_cast<uint64_t>(st.st_size);
+        id.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000ll 
+            + static_cast<int64_t>(st.st_mtim.tv_nsec);
+    }
+
+    return id;
+}
+
+bool save_checkpoint(
+    const std::string& filename,
+    const LocalizationCheckpoint& checkpoint)
+{
+    const std::string filename_tmp = filename + ".tmp";
+
+    {
+        std::ofstream ofs(filename_tmp, std::ios::trunc);
+        if(!ofs)
+        {
+            return false;
+        }
+
+        ofs << std::setprecision(std::numeric_limits<double>::max_digits10);
+
+        const double stamp = std::chrono::duration<double>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+        ofs << CHECKPOINT_MAGIC << " " << CHECKPOINT_VERSION << "\n";
+        ofs << "stamp " << stamp << "\n";
+        ofs << "map_file " << std::quoted(checkpoint.map.file) << "\n";
+        ofs << "map_size " << checkpoint.map.size << "\n";
+        ofs << "map_mtime " << checkpoint.map.mtime << "\n";
+        ofs << "map_frame " << std::quoted(checkpoint.map_frame) << "\n";
+
+        const rm::Transform& T = checkpoint.Tom;
+        ofs << "Tom " << T.t.x << " " << T.t.y << " " << T.t.z << " " 
+            << T.R.x << " " << T.R.y << " " << T.R.z << " " << T.R.w << "\n";
+
+        for(const auto& elem : checkpoint.max_distances)
+        {
+            ofs << "max_distance " << std::quoted(elem.first) << " " << elem.second << "\n";
+        }
+
+        ofs.flush();
+        if(!ofs)
+        {
+            return false;
+        }
+    }
+
+    // atomic on POSIX: readers see either the old or the new checkpoint
+    return std::rename(filename_tmp.c_str(), filename.c_str()) == 0;
+}
+
+bool load_checkpoint(
+    const std::string& filename,
+    LocalizationCheckpoint& checkpoint)
+{
+    std::ifstream ifs(filename);
+    if(!ifs)
+    {
+        return false;
+    }
+
+    std::string magic;
+    unsigned int version = 0;
+    if(!(ifs >> magic >> version) 
+        || magic != CHECKPOINT_MAGIC 
+        || version != CHECKPOINT_VERSION)
+    {
+        return false;
+    }
+
+    LocalizationCheckpoint res;
+    bool has_pose = false;
+
+    std::string line;
+    while(std::getline(ifs, line))
+    {
+        std::istringstream iss(line);
+        std::string key;
+        if(!(iss >> key))
+        {
+            continue;
+        }
+
+        if(key == "stamp")
+        {
+            iss >> res.stamp;
+        } else if(key == "map_file") {
+            iss >> std::quoted(res.map.file);
+        } else if(key == "map_size") {
+            iss >> res.map.size;
+        } else if(key == "map_mtime") {
+            iss >> res.map.mtime;
+        } else if(key == "map_frame") {
+            iss >> std::quoted(res.map_frame);
+        } else if(key == "Tom") {
+            rm::Transform& T = res.Tom;
+            has_pose = static_cast<bool>(iss >> T.t.x >> T.t.y >> T.t.z 
+                >> T.R.x >> T.R.y >> T.R.z >> T.R.w);
+        } else if(key == "max_distance") {
+            std::string name;
+            float max_distance;
+            if(iss >> std::quoted(name) >> max_distance)
+            {
+                res.max_distances[name] = max_distance;
+            }
+        }
+        // unknown keys: written by a newer version, skip
+    }
+
+    if(!has_pose)
+    {
+        return false;
+    }
+
+    res.Tom.R.normalizeInplace();
+    checkpoint = res;
+    return true;
+}
+
+} // namespace rmcl
@@ -0,0 +1,154 @@
+#include "rmcl/util/depth_operations.h"
+
+#include <cstring>
+
+namespace rm = rmagine;
+
+namespace rmcl
+{
+
+namespace
+{
+
+inline bool host_is_big_endian()
+{
+    const uint16_t one = 1;
+    uint8_t first;
+    std::memcpy(&first, &one, 1);
+    return first == 0;
+}
+
+inline uint16_t byte_swap(uint16_t v)
+{
+    return static_cast<uint16_t>((v >> 8) | (v << 8));
+}
+
+inline uint32_t byte_swap(uint32_t v)
+{
+    return ((v >> 24) & 0x000000FFu) | ((v >> 8) & 0x0000FF00u)
+        | ((v << 8) & 0x00FF0000u) | ((v << 24) & 0xFF000000u);
+}
+
+} // namespace
+
+void depth_scale_table(
+    const rm::PinholeModel& model,
+    bool optical,
+    rm::MemoryView<float, rm::RAM>& scales)
+{
+    #pragma omp parallel for default(shared)
+    for(unsigned int vid = 0; vid < model.getHeight(); vid++)
+    {
+        for(unsigned int hid = 0; hid < model.getWidth(); hid++)
+        {
+            const unsigned int loc_id = model.getBufferId(vid, hid);
+            if(optical)
+            {
+                scales[loc_id] = 1.0 / model.getDirectionOptical(vid, hid).z;
+            } else {
+                scales[loc_id] = 1.0 / model.getDirection(vid, hid).x;
+            }
+        }
+    }
+}
+
+bool depth_scale_table_equal(
+    const rm::PinholeModel& a,
+    const rm::PinholeModel& b)
+{
+    return a.width == b.width && a.height == b.height
+        && a.f[0] == b.f[0] && a.f[1] == b.f[1]
+        && a.c[0] == b.c[0] && a.c[1] == b.c[1];
+}
+
+bool depth_image_layout_valid(
+    unsigned int width,
+    unsigned int height,
+    unsigned int step,
+    unsigned int bytes_per_pixel,
+    size_t data_size)
+{
+    if(static_cast<uint64_t>(step) < static_cast<uint64_t>(width) * bytes_per_pixel)
+    {
+        return false;
+    }
+    return static_cast<uint64_t>(height) * step <= data_size;
+}
+
+void depth_to_ranges_32FC1(
+    const uint8_t* data,
+    unsigned int width,
+    unsigned int height,
+    unsigned int step,
+    bool big_endian,
+    const rm::MemoryView<float, rm::RAM>& scales,
+    rm::MemoryView<float, rm::RAM>& ranges)
+{
+    const float* scales_ = scales.raw();
+    float* ranges_ = ranges.raw();
+    const bool swap = (big_endian != host_is_big_endian());
+
+    #pragma omp parallel for default(shared) if(height > 64)
+    for(unsigned int vid = 0; vid < height; vid++)
+    {
+        // rows are not necessarily aligned to 4 bytes
+        const uint8_t* row = data + static_cast<size_t>(vid) * step;
+        const size_t offset = static_cast<size_t>(vid) * width;
+        std::memcpy(ranges_ + offset, row, width * sizeof(float));
+
+        if(swap)
+        {
+            for(unsigned int hid = 0; hid < width; hid++)
+            {
+                uint32_t bits;
+                std::memcpy(&bits, ranges_ + offset + hid, sizeof(bits));
+                bits = byte_swap(bits);
+                std::memcpy(ranges_ + offset + hid, &bits, sizeof(bits));
+            }
+        }
+
+        #pragma omp simd
+        for(unsigned int hid = 0; hid < width; hid++)
+        {
+            ranges_[offset + hid] *= scales_[offset + hid];
+        }
+    }
+}
+
+void depth_to_ranges_16UC1(
+    const uint8_t* data,
+    unsigned int width,
+    unsigned int height,
+    unsigned int step,
+    bool big_endian,
+    const rm::MemoryView<float, rm::RAM>& scales,
+    float invalid,
+    rm::MemoryView<float, rm::RAM>& ranges)
+{
+    const float* scales_ = scales.raw();
+    float* ranges_ = ranges.raw();
+    const bool swap = (big_endian != host_is_big_endian());
+
+    #pragma omp parallel for default(shared) if(height > 64)
+    for(unsigned int vid = 0; vid < height; vid++)
+    {
+        // rows are not necessarily aligned to 2 bytes
+        const uint8_t* row = data + static_cast<size_t>(vid) * step;
+        const size_t offset = static_cast<size_t>(vid) * width;
+
+        #pragma omp simd
+        for(unsigned int hid = 0; hid < width; hid++)
+        {
+            uint16_t depth_mm;
+            std::memcpy(&depth_mm, row + hid * sizeof(uint16_t), sizeof(uint16_t));
+            if(swap)
+            {
+                depth_mm = byte_swap(depth_mm);
+            }
+            const float range = static_cast<float>(depth_mm) * 0.001f * scales_[offset + hid];
+            ranges_[offset + hid] = (depth_mm > 0) ? range : invalid;
+        }
+    }
+}
+
+} // namespace rmcl